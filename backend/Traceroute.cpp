@@ -7,12 +7,24 @@
 #include <unistd.h>
 #include <cstring>
 #include <chrono>
-#include <thread>
+#include <atomic>
+#include <algorithm>
 
 using namespace std;
 
-Traceroute::Traceroute(const std::string &targetHost, int maxHops, int timeout)
-    : target(targetHost), maxHops(maxHops), timeout(timeout) {}
+static const int PROBES_PER_HOP = 3;
+static const double MIN_PROBE_TIMEOUT_MS = 50.0;
+static const double UNKNOWN_HOP_TIMEOUT_MS = 250.0; // floor for a hop nothing is known about
+static const int SILENT_TRACE_LIMIT = 2;  // hop silent this many traces in a row gets one probe
+static const int MAX_SILENT_HOPS = 5;     // consecutive silent hops before giving up on the trace
+
+Traceroute::Traceroute(const std::string &targetHost, int maxHops, int timeout, PrefixRttTable *prefixRtts)
+    : target(targetHost), maxHops(maxHops), timeout(timeout), ident(allocateIdent()), prefixRtts(prefixRtts) {}
+
+uint16_t Traceroute::allocateIdent() {
+    static std::atomic<uint16_t> nextIdent{0};
+    return static_cast<uint16_t>(getpid() + nextIdent.fetch_add(1));
+}
 
 std::vector<Hop> Traceroute::performTrace() {
     std::vector<Hop> results;
@@ -31,23 +43,48 @@ std::vector<Hop> Traceroute::performTrace() {
     }
 
     bool reachedTarget = false;
+    int silentHops = 0;
+    double previousTimeout = 0;
     
-    for (int ttl = 1; ttl <= maxHops && !reachedTarget; ++ttl) {
-        // Send 3 probes per TTL (like standard traceroute)
+    for (int ttl = 1; ttl <= maxHops && !reachedTarget && silentHops < MAX_SILENT_HOPS; ++ttl) {
+        // Up to 3 probes per TTL (like standard traceroute)
         std::vector<ProbeResult> probes;
+
+        // Deadline: this hop's own RTTs, then earlier traces to the same /24,
+        // then a multiple of the previous hop, then the configured timeout
+        PrefixHopState known;
+        bool haveKnown = prefixRtts && prefixRtts->lookup(targetAddr.sin_addr.s_addr, ttl, known);
+        double fallback = previousTimeout > 0 ? max(UNKNOWN_HOP_TIMEOUT_MS, 3 * previousTimeout) : timeout;
+        RttEstimator hopRtt = haveKnown ? known.rtt : RttEstimator();
+        RttEstimator traceRtt;
+        double waitMs = hopRtt.timeout(MIN_PROBE_TIMEOUT_MS, timeout, min<double>(fallback, timeout));
+
+        int probeBudget = (haveKnown && known.silentTraces >= SILENT_TRACE_LIMIT) ? 1 : PROBES_PER_HOP;
+        int timeouts = 0;
         
-        for (int probe = 0; probe < 3; ++probe) {
-            ProbeResult result = sendProbe(sockfd, targetAddr, ttl, probe);
+        for (int probe = 0; probe < probeBudget; ++probe) {
+            ProbeResult result = sendProbe(sockfd, targetAddr, ttl, probe, waitMs);
             probes.push_back(result);
             
-            // Check if we reached the target
-            if (result.success && result.responseIP == target) {
-                reachedTarget = true;
+            if (result.success) {
+                hopRtt.addSample(result.rtt);
+                traceRtt.addSample(result.rtt);
+                waitMs = hopRtt.timeout(MIN_PROBE_TIMEOUT_MS, timeout, waitMs);
+
+                // Check if we reached the target
+                if (result.responseIP == target) {
+                    reachedTarget = true;
+                }
+            } else {
+                // Back off like a retransmission timer, and stop asking a hop that stays silent
+                waitMs = min<double>(waitMs * 2, timeout);
+                if (++timeouts >= 2 && traceRtt.samples == 0) break;
             }
-            
-            // Small delay between probes
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
         }
+
+        if (prefixRtts) prefixRtts->update(targetAddr.sin_addr.s_addr, ttl, traceRtt, traceRtt.samples > 0);
+        silentHops = traceRtt.samples > 0 ? 0 : silentHops + 1;
+        if (traceRtt.samples > 0) previousTimeout = hopRtt.timeout(MIN_PROBE_TIMEOUT_MS, timeout, timeout);
         
         // Process results for this TTL
         Hop hop = processProbesForHop(ttl, probes);
@@ -60,7 +97,7 @@ std::vector<Hop> Traceroute::performTrace() {
     return results;
 }
 
-Traceroute::ProbeResult Traceroute::sendProbe(int sockfd, const struct sockaddr_in &targetAddr, int ttl, int probeNum) {
+Traceroute::ProbeResult Traceroute::sendProbe(int sockfd, const struct sockaddr_in &targetAddr, int ttl, int probeNum, double waitMs) {
     ProbeResult result;
     result.success = false;
     result.rtt = -1.0;
@@ -76,7 +113,7 @@ Traceroute::ProbeResult Traceroute::sendProbe(int sockfd, const struct sockaddr_
     memset(&icmp, 0, sizeof(icmp));
     icmp.type = ICMP_ECHO;
     icmp.code = 0;
-    icmp.un.echo.id = getpid() & 0xFFFF;
+    icmp.un.echo.id = ident;
     icmp.un.echo.sequence = (ttl << 8) | probeNum; // Unique sequence per probe
     icmp.checksum = 0;
     icmp.checksum = checksum((unsigned short *)&icmp, sizeof(icmp));
@@ -87,43 +124,48 @@ Traceroute::ProbeResult Traceroute::sendProbe(int sockfd, const struct sockaddr_
     if (sendto(sockfd, &icmp, sizeof(icmp), 0, (struct sockaddr *)&targetAddr, sizeof(targetAddr)) < 0) {
         return result;
     }
+    probesSent++;
 
-    // Wait for response
-    fd_set readfds;
-    struct timeval tv;
-    tv.tv_sec = timeout / 1000;
-    tv.tv_usec = (timeout % 1000) * 1000;
+    // Wait for our reply; other tracers share the raw socket traffic
+    auto deadline = startTime + std::chrono::microseconds(static_cast<long>(waitMs * 1000));
+    uint16_t expectedSequence = icmp.un.echo.sequence;
 
-    FD_ZERO(&readfds);
-    FD_SET(sockfd, &readfds);
+    while (true) {
+        auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(
+            deadline - std::chrono::high_resolution_clock::now()).count();
+        if (remaining <= 0) break;
+
+        fd_set readfds;
+        struct timeval tv;
+        tv.tv_sec = remaining / 1000000;
+        tv.tv_usec = remaining % 1000000;
+
+        FD_ZERO(&readfds);
+        FD_SET(sockfd, &readfds);
+
+        if (select(sockfd + 1, &readfds, nullptr, nullptr, &tv) <= 0) break;
 
-    if (select(sockfd + 1, &readfds, nullptr, nullptr, &tv) > 0) {
         char buffer[1024];
         struct sockaddr_in fromAddr;
         socklen_t fromLen = sizeof(fromAddr);
-        
-        ssize_t bytesReceived = recvfrom(sockfd, buffer, sizeof(buffer), 0, 
+
+        ssize_t bytesReceived = recvfrom(sockfd, buffer, sizeof(buffer), 0,
                                        (struct sockaddr *)&fromAddr, &fromLen);
-        
-        if (bytesReceived > 0) {
-            auto endTime = std::chrono::high_resolution_clock::now();
-            auto duration = std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime);
-            
-            // Parse the IP header to get to ICMP
-            struct iphdr *ipHdr = (struct iphdr *)buffer;
-            int ipHeaderLen = ipHdr->ihl * 4;
-            
-            if (bytesReceived >= ipHeaderLen + sizeof(struct icmphdr)) {
-                struct icmphdr *icmpReply = (struct icmphdr *)(buffer + ipHeaderLen);
-                
-                // Check if this is our packet
-                if ((icmpReply->type == ICMP_TIME_EXCEEDED || icmpReply->type == ICMP_ECHOREPLY)) {
-                    result.success = true;
-                    result.rtt = duration.count() / 1000.0; // Convert to milliseconds
-                    result.responseIP = inet_ntoa(fromAddr.sin_addr);
-                }
-            }
+        if (bytesReceived <= 0) continue;
+
+        uint16_t sequence;
+        bool echoReply;
+        if (!matchReply(buffer, bytesReceived, ident, sequence, echoReply) || sequence != expectedSequence) {
+            continue;
         }
+
+        auto endTime = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime);
+
+        result.success = true;
+        result.rtt = duration.count() / 1000.0; // Convert to milliseconds
+        result.responseIP = inet_ntoa(fromAddr.sin_addr);
+        break;
     }
     
     return result;
@@ -155,6 +197,43 @@ Hop Traceroute::processProbesForHop(int ttl, const std::vector<ProbeResult> &pro
     return hop;
 }
 
+bool Traceroute::matchReply(const char *buffer, ssize_t len, uint16_t ident, uint16_t &sequence, bool &echoReply) {
+    if (len < (ssize_t)sizeof(struct iphdr)) return false;
+
+    const struct iphdr *ipHdr = (const struct iphdr *)buffer;
+    int ipHeaderLen = ipHdr->ihl * 4;
+    if (len < ipHeaderLen + (ssize_t)sizeof(struct icmphdr)) return false;
+
+    const struct icmphdr *icmpReply = (const struct icmphdr *)(buffer + ipHeaderLen);
+
+    if (icmpReply->type == ICMP_ECHOREPLY) {
+        if (icmpReply->un.echo.id != ident) return false;
+        sequence = icmpReply->un.echo.sequence;
+        echoReply = true;
+        return true;
+    }
+
+    if (icmpReply->type == ICMP_TIME_EXCEEDED) {
+        // The router quotes our original IP header plus the first 8 bytes of the echo request
+        const char *inner = buffer + ipHeaderLen + sizeof(struct icmphdr);
+        ssize_t innerLen = len - ipHeaderLen - sizeof(struct icmphdr);
+        if (innerLen < (ssize_t)sizeof(struct iphdr)) return false;
+
+        const struct iphdr *innerIp = (const struct iphdr *)inner;
+        int innerHeaderLen = innerIp->ihl * 4;
+        if (innerIp->protocol != IPPROTO_ICMP || innerLen < innerHeaderLen + (ssize_t)sizeof(struct icmphdr)) return false;
+
+        const struct icmphdr *innerIcmp = (const struct icmphdr *)(inner + innerHeaderLen);
+        if (innerIcmp->type != ICMP_ECHO || innerIcmp->un.echo.id != ident) return false;
+
+        sequence = innerIcmp->un.echo.sequence;
+        echoReply = false;
+        return true;
+    }
+
+    return false;
+}
+
 unsigned short Traceroute::checksum(unsigned short *buf, int len) {
     unsigned long sum = 0;
     
@@ -1,8 +1,10 @@
 #!/usr/bin/env python3
+import ipaddress
 import json
 import sys
 import time
 import threading
+from collections import deque
 from flask import Flask, jsonify, request
 from flask_socketio import SocketIO, emit
 from prediction_routes import prediction_bp, initialize_model
@@ -22,14 +24,54 @@ connected_clients = 0
 node_data = {}  # IP -> node info
 edge_data = {}  # (src_ip, dst_ip) -> edge info
 traceroute_paths = {}  # dst_ip -> list of hop IPs
+path_stats = {}  # dst_ip -> per-hop statistics from continuous path monitoring
+route_nodes = {0: {"ip": None, "parent": None, "ttl": 0}}  # mirror of the sniffer's route trie, id -> hop
+
+# Window feature vectors computed by the sniffer (same columns as network_features.csv)
+FEATURE_NAMES = [
+    "avg_packet_size", "unique_src_ips", "unique_dst_ips", "unique_src_ports",
+    "protocol_tcp", "protocol_udp", "protocol_icmp", "protocol_other",
+    "packet_rate", "port_scan_signals", "tcp_flag_syn", "tcp_flag_ack",
+    "tcp_flag_syn_without_ack", "tcp_flag_syn_without_ack_ratio"
+]
+window_features = {"tumbling": deque(maxlen=300), "sliding": deque(maxlen=300)}
+top_talkers = {}  # latest TOP_TALKERS record from the sniffer's heavy-hitter tracking
+alerts = deque(maxlen=500)  # recent alerts raised by the sniffer, oldest first
+histograms = deque(maxlen=120)  # HISTOGRAMS records: size / inter-arrival percentiles per traffic class
+tcp_metrics = deque(maxlen=120)  # TCP_METRICS records: passive handshake RTTs and connection health
+traffic = deque(maxlen=120)  # TRAFFIC records: exact per-interval totals from the sniffer's sharded counters
+traffic_counts = {"exact": False}  # once TRAFFIC records arrive, node and edge counts come from them alone
+counted_before_exact = deque()  # (timestamp, src, dst, count) of recent per-packet counts until then
+COUNTED_BEFORE_EXACT_SECONDS = 10
+sampling = deque(maxlen=100)  # SAMPLING records: the sniffer's per-packet record rate as its load changes
+tls_sessions = {}  # (client_ip, client_port, server_ip, server_port) -> SNI / JA3 of its ClientHello, oldest first
+MAX_TLS_SESSIONS = 10000
+MAX_NODE_LABELS = 16  # TLS names / fingerprints kept per node
+dns_names = {}  # ip -> name from the sniffer's DNS_BINDING records, oldest first
+MAX_DNS_NAMES = 20000
+node_tags = {}  # ip -> {"subnet", "asn", "site"} from the sniffer's NODE_TAG records, oldest first
+MAX_NODE_TAGS = 100000
+NODE_TAG_FIELDS = ("subnet", "asn", "site")
+
+# Roll-up of the graph sent to clients: nodes are merged into groups by
+# address prefix, ASN or site, so the graph is bounded by the number of
+# groups rather than addresses. Expanded groups are sent as their members.
+# Every socket client has its own roll-up; HTTP requests pass theirs as
+# ?rollup= and ?expand=, and both start from the default.
+ROLLUP_FALLBACK_PREFIX = 24  # grouping for addresses without the ASN / site tag the mode needs
+rollup = {"mode": None, "expanded": set()}  # default; mode: None, a prefix length, "asn" or "site"
+client_views = {}  # socket id -> {"mode", "expanded", "groups", "edges"}: its roll-up and the node / edge ids of its last full update
 
 def cleanup_old_data():
     """Remove nodes and edges that haven't been seen recently"""
     current_time = time.time()
     
+    # Routers on known routes stay, even if no new trace went through them
+    route_ips = {node["ip"] for node in route_nodes.values() if node["ip"] and node["ip"] != "*"}
+    
     # Clean up old nodes
     old_nodes = [node for node, data in node_data.items() 
-                 if current_time - data["last_seen"] > NODE_TIMEOUT]
+                 if current_time - data["last_seen"] > NODE_TIMEOUT and node not in route_ips]
     
     for node in old_nodes:
         del node_data[node]
@@ -37,7 +79,8 @@ def cleanup_old_data():
     
     # Clean up old edges
     old_edges = [edge for edge, data in edge_data.items() 
-                 if current_time - data["last_seen"] > NODE_TIMEOUT]
+                 if current_time - data["last_seen"] > NODE_TIMEOUT
+                 and not (data["type"] == "traceroute" and edge[1] in route_ips)]
     
     for edge in old_edges:
         del edge_data[edge]
@@ -51,53 +94,234 @@ def cleanup_old_data():
         del traceroute_paths[dst]
         print(f"[DEBUG] Removed old traceroute path: {dst}")
     
+    # Clean up monitored paths that stopped reporting
+    old_monitored = [dst for dst, data in path_stats.items()
+                     if current_time - data["last_seen"] > NODE_TIMEOUT]
+    
+    for dst in old_monitored:
+        del path_stats[dst]
+    
     if old_nodes or old_edges or old_paths:
         send_full_update()
 
-def send_full_update():
-    """Send complete graph state to all clients"""
-    if connected_clients > 0:
-        # Prepare nodes with metadata
-        nodes = []
-        for ip, data in node_data.items():
-            node = {
-                "id": ip,
-                "ip": ip,
-                "type": data.get("type", "host"),
-                "packet_count": data["packet_count"],
+def parse_rollup_mode(value):
+    """Roll-up mode from "none", "/24" / "24", "asn" or "site"; ValueError if invalid"""
+    if value is None or value in ("", "none"):
+        return None
+    if value in ("asn", "site"):
+        return value
+    length = int(str(value).lstrip("/"))
+    if not 1 <= length <= 32:
+        raise ValueError(f"prefix length {length} out of range")
+    return length
+
+def rollup_mode_name(mode):
+    return "none" if mode is None else f"/{mode}" if isinstance(mode, int) else mode
+
+def rollup_group(ip, data, mode):
+    """Group an address belongs to under a roll-up mode; the address itself if it stays apart"""
+    if mode is None or data.get("is_local"):
+        return ip
+    if mode == "asn" and data.get("asn"):
+        return f"AS{data['asn']}"
+    if mode == "site" and data.get("site"):
+        return f"site:{data['site']}"
+    length = mode if isinstance(mode, int) else ROLLUP_FALLBACK_PREFIX
+    try:
+        return str(ipaddress.ip_network(f"{ip}/{length}", strict=False))
+    except ValueError:
+        return ip
+
+def node_entry(ip, data):
+    """A node as sent to clients"""
+    return {
+        "id": ip,
+        "ip": ip,
+        "type": data.get("type", "host"),
+        "packet_count": data["packet_count"],
+        "first_seen": data["first_seen"],
+        "last_seen": data["last_seen"],
+        "is_local": data.get("is_local", False),
+        "name": data.get("name"),
+        **{field: data.get(field) for field in NODE_TAG_FIELDS},
+        "protocols": list(data["protocols"]),
+        "interfaces": sorted(data.get("interfaces", ())),
+        "tls_names": sorted(data.get("tls_names", ()))
+    }
+
+def build_graph(mode, expanded):
+    """Nodes, edges and the node id of every address, merged into groups unless mode is None"""
+    node_ids = {}
+    nodes = {}
+    for ip, data in node_data.items():
+        group = rollup_group(ip, data, mode)
+        if group == ip or group in expanded:
+            node_ids[ip] = ip
+            nodes[ip] = node_entry(ip, data)
+            if group != ip:
+                nodes[ip]["group"] = group
+            continue
+        
+        node_ids[ip] = group
+        node = nodes.get(group)
+        if node is None:
+            node = nodes[group] = {
+                "id": group,
+                "ip": group,
+                "type": "group",
+                "is_group": True,
+                "member_count": 0,
+                "packet_count": 0,
                 "first_seen": data["first_seen"],
                 "last_seen": data["last_seen"],
-                "is_local": data.get("is_local", False)
+                "is_local": False,
+                "name": group,
+                "protocols": set(),
+                "interfaces": set()
             }
-            nodes.append(node)
-        
-        # Prepare edges
-        edges = []
-        for (src, dst), data in edge_data.items():
-            edge = {
-                "source": src,
-                "target": dst,
+        node["member_count"] += 1
+        node["packet_count"] += data["packet_count"]
+        node["first_seen"] = min(node["first_seen"], data["first_seen"])
+        node["last_seen"] = max(node["last_seen"], data["last_seen"])
+        node["protocols"] |= data["protocols"]
+        node["interfaces"] |= data.get("interfaces", set())
+        if data.get("type") == "router":
+            node["type"] = "router_group"
+    
+    for node in nodes.values():
+        if node.get("is_group"):
+            node["protocols"] = list(node["protocols"])
+            node["interfaces"] = sorted(node["interfaces"])
+    
+    # Edges between the same two nodes add up; traffic inside a group is not drawn
+    edges = {}
+    for (src, dst), data in edge_data.items():
+        source, target = node_ids.get(src, src), node_ids.get(dst, dst)
+        if source == target and source != src:
+            continue
+        edge = edges.get((source, target))
+        if edge is None:
+            edges[(source, target)] = {
+                "source": source,
+                "target": target,
                 "type": data["type"],
                 "packet_count": data["packet_count"],
-                "protocols": list(data["protocols"]),
+                "protocols": set(data["protocols"]),
+                "interfaces": set(data.get("interfaces", ())),
                 "first_seen": data["first_seen"],
                 "last_seen": data["last_seen"]
             }
-            edges.append(edge)
-        
-        update_data = {
-            "type": "full",
-            "nodes": nodes,
-            "edges": edges,
-            "traceroute_paths": traceroute_paths,
-            "stats": {
-                "total_nodes": len(node_data),
-                "total_edges": len(edge_data),
-                "total_paths": len(traceroute_paths)
+            continue
+        edge["packet_count"] += data["packet_count"]
+        edge["protocols"] |= data["protocols"]
+        edge["interfaces"] |= data.get("interfaces", set())
+        edge["first_seen"] = min(edge["first_seen"], data["first_seen"])
+        edge["last_seen"] = max(edge["last_seen"], data["last_seen"])
+        if data["type"] == "traceroute":
+            edge["type"] = "traceroute"
+    for edge in edges.values():
+        edge["protocols"] = list(edge["protocols"])
+        edge["interfaces"] = sorted(edge["interfaces"])
+    
+    return list(nodes.values()), list(edges.values()), node_ids
+
+def rolled_path(path, node_ids):
+    """A path of addresses as node ids, with hops inside one group merged"""
+    rolled = []
+    for ip in path:
+        node_id = node_ids.get(ip, ip)
+        if not rolled or rolled[-1] != node_id:
+            rolled.append(node_id)
+    return rolled
+
+def rollup_node_id(ip, view):
+    """Id of the node an address is drawn as under a client's roll-up"""
+    group = rollup_group(ip, node_data.get(ip, {}), view["mode"])
+    return ip if group in view["expanded"] else group
+
+def rollup_changed(view, ips=(), edges=()):
+    """Whether new addresses or edges add nodes or edges to what a client was last sent"""
+    if view["mode"] is None:
+        return bool(ips or edges)
+    if any(rollup_node_id(ip, view) not in view["groups"] for ip in ips):
+        return True
+    for src, dst in edges:
+        source, target = rollup_node_id(src, view), rollup_node_id(dst, view)
+        if source != target and (source, target) not in view["edges"]:
+            return True
+    return False
+
+def update_clients(ips=(), edges=(), incremental=None):
+    """Full update to the clients whose graph new addresses or edges change, incremental(view) to the rest"""
+    stale = []
+    for sid, view in list(client_views.items()):
+        if rollup_changed(view, ips, edges):
+            stale.append(sid)
+        elif incremental:
+            socketio.emit("graph_update", incremental(view), to=sid)
+    if stale:
+        send_full_update(stale)
+
+def send_full_update(sids=None):
+    """Send complete graph state to these clients, all of them by default"""
+    graphs = {}  # clients with the same roll-up share one graph
+    for sid in list(client_views) if sids is None else sids:
+        view = client_views.get(sid)
+        if view is None:
+            continue
+        key = (view["mode"], frozenset(view["expanded"]))
+        if key not in graphs:
+            graphs[key] = full_update(view["mode"], view["expanded"])
+        update_data = graphs[key]
+        view["groups"] = {node["id"] for node in update_data["nodes"]}
+        view["edges"] = {(edge["source"], edge["target"]) for edge in update_data["edges"]}
+        socketio.emit("graph_update", update_data, to=sid)
+
+def full_update(mode, expanded):
+    """The full graph_update message under one roll-up"""
+    nodes, edges, node_ids = build_graph(mode, expanded)
+    update_data = {
+        "type": "full",
+        "nodes": nodes,
+        "edges": edges,
+        "traceroute_paths": {
+            dst_ip: {
+                "path": rolled_path([LOCAL_IP] + path_ips(path_data), node_ids),
+                "hop_count": path_data["hop_count"],
+                "last_seen": path_data["last_seen"]
             }
+            for dst_ip, path_data in traceroute_paths.items()
+        },
+        "stats": {
+            "total_nodes": len(node_data),
+            "total_edges": len(edge_data),
+            "total_paths": len(traceroute_paths),
+            "rollup": rollup_mode_name(mode),
+            "graph_nodes": len(nodes),
+            "graph_edges": len(edges)
         }
-        socketio.emit("graph_update", update_data)
-        print(f"[DEBUG] Sent full update: {len(node_data)} nodes, {len(edge_data)} edges, {len(traceroute_paths)} paths")
+    }
+    print(f"[DEBUG] Full update ({rollup_mode_name(mode)}): {len(nodes)} nodes, {len(edges)} edges, {len(traceroute_paths)} paths")
+    return update_data
+
+def route_path(node_id):
+    """Answered hop IPs from the local machine down to a route trie node"""
+    path = []
+    while node_id in route_nodes and node_id != 0:
+        node = route_nodes[node_id]
+        if node["ip"] != "*":
+            path.append(node["ip"])
+        node_id = node["parent"]
+    path.reverse()
+    return path
+
+def path_ips(path_data):
+    """Hop IPs of a traced path, stored either as a trie leaf or as full hops"""
+    if "leaf" in path_data:
+        return route_path(path_data["leaf"])
+    return [hop.get('responses', [{}])[0].get('ip', '*')
+            for hop in path_data["hops"]
+            if hop.get('responses') and hop['responses'][0].get('ip') != '*']
 
 def get_local_ip():
     """Get the local machine's IP address"""
@@ -119,6 +343,19 @@ def process_regular_packet(packet):
     src_ip = packet.get('src_ip', 'unknown')
     dst_ip = packet.get('dst_ip', 'unknown')
     protocol = packet.get('protocol', 'UNKNOWN')
+    # In XDP mode one record stands for every packet of a flow in the last tick,
+    # and under load one sampled record for `sample_rate` packets
+    count = packet.get('packets', 1) * packet.get('sample_rate', 1)
+    if traffic_counts["exact"]:
+        count = 0
+    elif src_ip not in ['unknown', '0.0.0.0'] and dst_ip not in ['unknown', '0.0.0.0']:
+        # The first TRAFFIC record takes these back if it covers them
+        timestamp = packet.get('timestamp', 0)
+        counted_before_exact.append((timestamp, src_ip, dst_ip, count))
+        while counted_before_exact and counted_before_exact[0][0] < timestamp - COUNTED_BEFORE_EXACT_SECONDS:
+            counted_before_exact.popleft()
+    # One sniffer may capture several interfaces
+    interface = packet.get('interface')
     
     # Skip invalid IPs
     if src_ip in ['unknown', '0.0.0.0'] or dst_ip in ['unknown', '0.0.0.0']:
@@ -131,32 +368,40 @@ def process_regular_packet(packet):
         node_data[src_ip] = {
             "first_seen": current_time,
             "last_seen": current_time,
-            "packet_count": 1,
+            "packet_count": count,
             "type": "local" if src_ip == LOCAL_IP else "remote",
             "is_local": src_ip == LOCAL_IP,
+            "name": dns_names.get(src_ip),
+            **node_tags.get(src_ip, {}),
             "protocols": {protocol}
         }
         new_nodes.append(src_ip)
     else:
         node_data[src_ip]["last_seen"] = current_time
-        node_data[src_ip]["packet_count"] += 1
+        node_data[src_ip]["packet_count"] += count
         node_data[src_ip]["protocols"].add(protocol)
+    if interface:
+        node_data[src_ip].setdefault("interfaces", set()).add(interface)
     
     # Process destination node
     if dst_ip not in node_data:
         node_data[dst_ip] = {
             "first_seen": current_time,
             "last_seen": current_time,
-            "packet_count": 1,
+            "packet_count": count,
             "type": "local" if dst_ip == LOCAL_IP else "remote",
             "is_local": dst_ip == LOCAL_IP,
+            "name": dns_names.get(dst_ip),
+            **node_tags.get(dst_ip, {}),
             "protocols": {protocol}
         }
         new_nodes.append(dst_ip)
     else:
         node_data[dst_ip]["last_seen"] = current_time
-        node_data[dst_ip]["packet_count"] += 1
+        node_data[dst_ip]["packet_count"] += count
         node_data[dst_ip]["protocols"].add(protocol)
+    if interface:
+        node_data[dst_ip].setdefault("interfaces", set()).add(interface)
     
     # Process edge
     edge_tuple = (src_ip, dst_ip)
@@ -166,32 +411,42 @@ def process_regular_packet(packet):
         edge_data[edge_tuple] = {
             "first_seen": current_time,
             "last_seen": current_time,
-            "packet_count": 1,
+            "packet_count": count,
             "type": "direct",
             "protocols": {protocol}
         }
         new_edge = {"source": src_ip, "target": dst_ip}
     else:
         edge_data[edge_tuple]["last_seen"] = current_time
-        edge_data[edge_tuple]["packet_count"] += 1
+        edge_data[edge_tuple]["packet_count"] += count
         edge_data[edge_tuple]["protocols"].add(protocol)
+    if interface:
+        edge_data[edge_tuple].setdefault("interfaces", set()).add(interface)
     
     # Send updates to connected clients
     if connected_clients > 0:
-        if new_nodes:
-            send_full_update()
-        elif new_edge:
-            update_data = {
-                "type": "edge",
-                "edge": {
-                    "source": src_ip,
-                    "target": dst_ip,
-                    "type": "direct",
-                    "packet_count": edge_data[edge_tuple]["packet_count"],
-                    "protocols": list(edge_data[edge_tuple]["protocols"])
+        stale = []
+        for sid, view in list(client_views.items()):
+            if view["mode"] is not None:
+                # Rolled up, most new addresses join a group the client already has
+                if rollup_changed(view, new_nodes, [edge_tuple] if new_edge else []):
+                    stale.append(sid)
+            elif new_nodes:
+                stale.append(sid)
+            elif new_edge:
+                update_data = {
+                    "type": "edge",
+                    "edge": {
+                        "source": src_ip,
+                        "target": dst_ip,
+                        "type": "direct",
+                        "packet_count": edge_data[edge_tuple]["packet_count"],
+                        "protocols": list(edge_data[edge_tuple]["protocols"])
+                    }
                 }
-            }
-            socketio.emit("graph_update", update_data)
+                socketio.emit("graph_update", update_data, to=sid)
+        if stale:
+            send_full_update(stale)
 
 def process_traceroute_packet(packet):
     """Process traceroute data to build network topology"""
@@ -296,17 +551,428 @@ def process_traceroute_packet(packet):
     
     # Send updates
     if connected_clients > 0:
-        if new_nodes or new_edges:
+        # Otherwise an incremental traceroute update
+        path = [LOCAL_IP] + [hop.get('responses', [{}])[0].get('ip', '*') 
+                for hop in hops if hop.get('responses') and hop['responses'][0].get('ip') != '*']
+        update_clients(new_nodes, [(edge["source"], edge["target"]) for edge in new_edges], lambda view: {
+            "type": "traceroute_update",
+            "dst_ip": dst_ip,
+            "path": rolled_path(path, {ip: rollup_node_id(ip, view) for ip in path})
+        })
+
+def process_route_packet(packet):
+    """Attach a new route suffix to the route trie mirror and merge only the new hops"""
+    current_time = time.time()
+    
+    dst_ip = packet.get('dst_ip')
+    if not dst_ip:
+        return
+    
+    reset = bool(packet.get('reset'))
+    if reset:
+        # The sniffer's trie started over with fresh ids; paths ending in
+        # the old nodes are gone, their routers age out like other nodes
+        route_nodes.clear()
+        route_nodes[0] = {"ip": None, "parent": None, "ttl": 0}
+        for stale in [dst for dst, data in traceroute_paths.items() if "leaf" in data]:
+            del traceroute_paths[stale]
+    
+    attach = packet.get('attach', 0)
+    if attach not in route_nodes:
+        print(f"[DEBUG] Route for {dst_ip} attaches to unknown node {attach}, skipping")
+        return
+    
+    new_nodes = []
+    new_edges = []
+    
+    parent = attach
+    for node in packet.get('nodes', []):
+        node_id = node.get('id')
+        hop_ip = node.get('ip', '*')
+        route_nodes[node_id] = {"ip": hop_ip, "parent": parent, "ttl": node.get('ttl', 0)}
+        
+        if hop_ip != "*":
+            # Add router node
+            if hop_ip not in node_data:
+                node_data[hop_ip] = {
+                    "first_seen": current_time,
+                    "last_seen": current_time,
+                    "packet_count": 1,
+                    "type": "router",
+                    "is_local": False,
+                    "protocols": {"ICMP"}
+                }
+                new_nodes.append(hop_ip)
+            
+            # Edge from the closest answered hop above this one
+            previous_path = route_path(parent)
+            previous_ip = previous_path[-1] if previous_path else LOCAL_IP
+            edge_tuple = (previous_ip, hop_ip)
+            
+            if edge_tuple not in edge_data:
+                edge_data[edge_tuple] = {
+                    "first_seen": current_time,
+                    "last_seen": current_time,
+                    "packet_count": 1,
+                    "type": "traceroute",
+                    "protocols": {"ICMP"},
+                    "ttl": node.get('ttl'),
+                    "avg_rtt": node.get('rtt', 0)
+                }
+                new_edges.append({"source": previous_ip, "target": hop_ip})
+        
+        parent = node_id
+    
+    leaf = packet.get('leaf', parent)
+    path = route_path(leaf)
+    traceroute_paths[dst_ip] = {
+        "last_seen": current_time,
+        "leaf": leaf,
+        "hop_count": route_nodes.get(leaf, {}).get("ttl", 0)
+    }
+    
+    # Add final edge to destination if the trace stopped short of it
+    last_ip = path[-1] if path else LOCAL_IP
+    if last_ip != dst_ip and last_ip != LOCAL_IP:
+        if dst_ip not in node_data:
+            node_data[dst_ip] = {
+                "first_seen": current_time,
+                "last_seen": current_time,
+                "packet_count": 1,
+                "type": "destination",
+                "is_local": False,
+                "protocols": {"ICMP"}
+            }
+            new_nodes.append(dst_ip)
+        
+        final_edge = (last_ip, dst_ip)
+        if final_edge not in edge_data:
+            edge_data[final_edge] = {
+                "first_seen": current_time,
+                "last_seen": current_time,
+                "packet_count": 1,
+                "type": "traceroute",
+                "protocols": {"ICMP"}
+            }
+            new_edges.append({"source": last_ip, "target": dst_ip})
+    
+    # Send updates
+    if connected_clients > 0:
+        if reset:
             send_full_update()
         else:
-            # Send incremental traceroute update
-            update_data = {
+            path = [LOCAL_IP] + path
+            update_clients(new_nodes, [(edge["source"], edge["target"]) for edge in new_edges], lambda view: {
                 "type": "traceroute_update",
                 "dst_ip": dst_ip,
-                "path": [LOCAL_IP] + [hop.get('responses', [{}])[0].get('ip', '*') 
-                        for hop in hops if hop.get('responses') and hop['responses'][0].get('ip') != '*']
+                "path": rolled_path(path, {ip: rollup_node_id(ip, view) for ip in path})
+            })
+
+def process_features(packet):
+    """Keep the most recent window feature vectors from the sniffer"""
+    history = window_features.get(packet.get('window'))
+    values = packet.get('values', [])
+    if history is None or len(values) != len(FEATURE_NAMES):
+        return
+    
+    features = dict(zip(FEATURE_NAMES, values))
+    features["window_start"] = packet.get('window_start')
+    features["window_size"] = packet.get('window_size')
+    if 'score' in packet:
+        features["score"] = packet.get('score')
+        features["anomalous"] = packet.get('anomalous', False)
+    history.append(features)
+    
+    # Alert once per outlier tumbling window; sliding windows overlap it
+    if features.get("anomalous") and packet.get('window') == 'tumbling':
+        alert = {
+            "type": "anomaly",
+            "score": features["score"],
+            "window_start": features["window_start"],
+            "window_size": features["window_size"],
+            "features": {name: features[name] for name in FEATURE_NAMES},
+            "timestamp": time.time()
+        }
+        alerts.append(alert)
+        print(f"[ALERT] Anomalous window at {alert['window_start']}: score {alert['score']:.3f}")
+        
+        if connected_clients > 0:
+            socketio.emit("alert", alert)
+
+def process_top_talkers(packet):
+    """Replace the top talker lists and push them to the topology view"""
+    global top_talkers
+    top_talkers = {key: packet.get(key, {}) for key in ("src", "dst", "ports", "edges")}
+    top_talkers["timestamp"] = packet.get('timestamp')
+    top_talkers["window"] = packet.get('window')
+    
+    if connected_clients > 0:
+        socketio.emit("graph_update", {"type": "top_talkers", "top_talkers": top_talkers})
+
+def process_fanout(packet):
+    """Record a scan / fan-out alert and notify connected clients"""
+    alert = {
+        "type": "fanout",
+        "ip": packet.get('ip'),
+        "role": packet.get('role'),
+        "metric": packet.get('metric'),
+        "estimate": packet.get('estimate'),
+        "threshold": packet.get('threshold'),
+        "window_start": packet.get('window_start'),
+        "timestamp": packet.get('timestamp', time.time())
+    }
+    alerts.append(alert)
+    print(f"[ALERT] {alert['ip']} as {alert['role']}: ~{alert['estimate']} distinct {alert['metric']} in window")
+    
+    if connected_clients > 0:
+        socketio.emit("alert", alert)
+
+def process_change(packet):
+    """Record a per-host rate change point and notify connected clients"""
+    alert = {
+        "type": "change",
+        "ip": packet.get('ip'),
+        "role": packet.get('role'),
+        "metric": packet.get('metric'),
+        "direction": packet.get('direction'),
+        "value": packet.get('value'),
+        "baseline": packet.get('baseline'),
+        "timestamp": packet.get('timestamp', time.time())
+    }
+    alerts.append(alert)
+    print(f"[ALERT] {alert['ip']} as {alert['role']}: {alert['metric']} went {alert['direction']} "
+          f"to {alert['value']:.1f} from ~{alert['baseline']:.1f}")
+    
+    if connected_clients > 0:
+        socketio.emit("alert", alert)
+
+def process_rule(packet):
+    """Record an alert raised by an operator rule and notify connected clients"""
+    alert = {
+        "type": "rule",
+        "rule": packet.get('rule'),
+        "metric": packet.get('metric'),
+        "by": packet.get('by'),
+        "key": packet.get('key'),
+        "total": packet.get('total'),
+        "threshold": packet.get('threshold'),
+        "window_start": packet.get('window_start'),
+        "src_ip": packet.get('src_ip'),
+        "dst_ip": packet.get('dst_ip'),
+        "src_port": packet.get('src_port'),
+        "dst_port": packet.get('dst_port'),
+        "timestamp": packet.get('timestamp', time.time())
+    }
+    alerts.append(alert)
+    subject = f"{alert['by']} {alert['key']}" if alert['by'] else f"{alert['src_ip']} -> {alert['dst_ip']}"
+    print(f"[ALERT] rule {alert['rule']} matched {subject}: {alert['metric']} {alert['total']} in window")
+    
+    if connected_clients > 0:
+        socketio.emit("alert", alert)
+
+def process_histograms(packet):
+    """Keep recent packet size and inter-arrival percentiles"""
+    histograms.append({
+        "timestamp": packet.get('timestamp'),
+        "interval": packet.get('interval'),
+        "classes": packet.get('classes', {})
+    })
+
+def process_tcp_metrics(packet):
+    """Keep recent passive TCP measurements and push them to connected clients"""
+    entry = {key: packet.get(key) for key in (
+        "timestamp", "interval", "flows", "active", "opened", "retransmits", "out_of_order",
+        "zero_windows", "resets", "syn_rtt_ms", "ack_rtt_ms")}
+    entry["connections"] = packet.get('connections', [])
+    for connection in entry["connections"]:
+        session = tls_sessions.get((connection.get("client_ip"), connection.get("client_port"),
+                                    connection.get("server_ip"), connection.get("server_port")))
+        if session:
+            connection["sni"] = session["sni"]
+            connection["ja3"] = session["ja3"]
+    tcp_metrics.append(entry)
+    
+    if connected_clients > 0:
+        socketio.emit("graph_update", {"type": "tcp_metrics", "tcp_metrics": entry})
+
+def process_tls(packet):
+    """Attach the SNI and JA3 fingerprint of a TLS ClientHello to its connection and nodes"""
+    client_ip, server_ip = packet.get('src_ip'), packet.get('dst_ip')
+    session = {
+        "sni": packet.get('sni'),
+        "ja3": packet.get('ja3'),
+        "version": packet.get('version'),
+        "timestamp": packet.get('timestamp', time.time())
+    }
+    key = (client_ip, packet.get('src_port'), server_ip, packet.get('dst_port'))
+    tls_sessions.pop(key, None)
+    tls_sessions[key] = session
+    while len(tls_sessions) > MAX_TLS_SESSIONS:
+        del tls_sessions[next(iter(tls_sessions))]
+    
+    if session["sni"] and server_ip in node_data:
+        names = node_data[server_ip].setdefault("tls_names", set())
+        if len(names) < MAX_NODE_LABELS:
+            names.add(session["sni"])
+    if session["ja3"] and client_ip in node_data:
+        fingerprints = node_data[client_ip].setdefault("ja3", set())
+        if len(fingerprints) < MAX_NODE_LABELS:
+            fingerprints.add(session["ja3"])
+
+def process_dns_binding(packet):
+    """Name a node after the DNS query that returned its address"""
+    ip, name = packet.get('ip'), packet.get('name')
+    if not ip or not name:
+        return
+    dns_names.pop(ip, None)
+    dns_names[ip] = name
+    while len(dns_names) > MAX_DNS_NAMES:
+        del dns_names[next(iter(dns_names))]
+    
+    if ip in node_data:
+        node_data[ip]["name"] = name
+        if connected_clients > 0:
+            socketio.emit("graph_update", {"type": "dns_binding", "ip": ip, "name": name})
+
+def process_node_tag(packet):
+    """Attach the subnet, ASN and site of an address's prefix to its node"""
+    ip = packet.get('ip')
+    if not ip:
+        return
+    tags = {field: packet.get(field) for field in NODE_TAG_FIELDS}
+    node_tags.pop(ip, None)
+    if tags["subnet"]:
+        node_tags[ip] = tags
+        while len(node_tags) > MAX_NODE_TAGS:
+            del node_tags[next(iter(node_tags))]
+    
+    if ip in node_data:
+        node_data[ip].update(tags)
+        if connected_clients > 0:
+            socketio.emit("graph_update", {"type": "node_tag", "ip": ip, **tags})
+
+def add_traffic_counts(hosts, edges, current_time):
+    """Add exact (ip, packets, bytes) host and (src, dst, packets, bytes) edge counts; returns the new nodes and edges"""
+    new_nodes = []
+    # With per-packet records shed, hosts and edges may only show up here
+    for ip, packets, size in hosts:
+        if ip not in node_data:
+            node_data[ip] = {
+                "first_seen": current_time,
+                "last_seen": current_time,
+                "packet_count": 0,
+                "type": "local" if ip == LOCAL_IP else "remote",
+                "is_local": ip == LOCAL_IP,
+                "name": dns_names.get(ip),
+                **node_tags.get(ip, {}),
+                "protocols": set()
             }
-            socketio.emit("graph_update", update_data)
+            new_nodes.append(ip)
+        node = node_data[ip]
+        node["last_seen"] = current_time
+        node["packet_count"] += packets
+        node["bytes"] = node.get("bytes", 0) + size
+    new_edges = []
+    for src, dst, packets, size in edges:
+        edge_tuple = (src, dst)
+        if edge_tuple not in edge_data:
+            edge_data[edge_tuple] = {
+                "first_seen": current_time,
+                "last_seen": current_time,
+                "packet_count": 0,
+                "type": "direct",
+                "protocols": set()
+            }
+            new_edges.append(edge_tuple)
+        info = edge_data[edge_tuple]
+        info["last_seen"] = current_time
+        info["packet_count"] += packets
+        info["bytes"] = info.get("bytes", 0) + size
+    return new_nodes, new_edges
+
+def take_back_packet_counts(since):
+    """Undo the per-packet counts from `since` on, which exact TRAFFIC counts replace"""
+    for timestamp, src_ip, dst_ip, count in counted_before_exact:
+        if timestamp < since:
+            continue
+        for ip in (src_ip, dst_ip):
+            if ip in node_data:
+                node_data[ip]["packet_count"] = max(0, node_data[ip]["packet_count"] - count)
+        if (src_ip, dst_ip) in edge_data:
+            info = edge_data[(src_ip, dst_ip)]
+            info["packet_count"] = max(0, info["packet_count"] - count)
+    counted_before_exact.clear()
+
+def process_traffic(packet):
+    """Add the exact packet and byte counts of one interval to the nodes and edges seen so far"""
+    if not traffic_counts["exact"]:
+        traffic_counts["exact"] = True
+        take_back_packet_counts(packet.get('timestamp', 0) - packet.get('interval', 1))
+    hosts = ((host.get('ip'), host.get('packets_in', 0) + host.get('packets_out', 0),
+              host.get('bytes_in', 0) + host.get('bytes_out', 0)) for host in packet.get('hosts', []))
+    edges = ((edge.get('src'), edge.get('dst'), edge.get('packets', 0), edge.get('bytes', 0))
+             for edge in packet.get('edges', []))
+    new_nodes, new_edges = add_traffic_counts(hosts, edges, time.time())
+    
+    entry = {key: packet.get(key) for key in (
+        "timestamp", "interval", "shards", "packets", "bytes", "flows", "untracked", "stalls",
+        "pages", "sensors", "duplicates")}
+    traffic.append(entry)
+    
+    if connected_clients > 0:
+        update_clients(new_nodes, new_edges)
+        socketio.emit("graph_update", {"type": "traffic", "traffic": entry})
+
+def process_traffic_page(packet):
+    """Add the hosts and edges of an interval that did not fit in its TRAFFIC record"""
+    # Rows: hosts [ip, packets_in, packets_out, bytes_in, bytes_out], edges [src, dst, packets, bytes]
+    # (a collector's unified pages add the edge's sensors)
+    hosts = ((row[0], row[1] + row[2], row[3] + row[4]) for row in packet.get('hosts', []) if len(row) == 5)
+    edges = (tuple(row[:4]) for row in packet.get('edges', []) if len(row) >= 4)
+    new_nodes, new_edges = add_traffic_counts(hosts, edges, time.time())
+    if connected_clients > 0 and (new_nodes or new_edges):
+        update_clients(new_nodes, new_edges)
+
+def process_sampling(packet):
+    """Note a change of the sniffer's per-packet record rate"""
+    entry = {key: packet.get(key) for key in (
+        "timestamp", "mode", "sample_rate", "load", "ring_occupancy", "kernel_drops", "shed")}
+    sampling.append(entry)
+    print(f"[SAMPLING] {entry['mode']} (1 in {entry['sample_rate']}), load {entry['load']:.2f}")
+    
+    if connected_clients > 0:
+        socketio.emit("graph_update", {"type": "sampling", "sampling": entry})
+
+def process_path_update(packet):
+    """Merge a change-only hop statistics update from path monitoring"""
+    current_time = time.time()
+    
+    dst_ip = packet.get('dst_ip')
+    if not dst_ip:
+        return
+    
+    path = path_stats.setdefault(dst_ip, {"hops": {}})
+    path["last_seen"] = current_time
+    path["hop_count"] = packet.get('hop_count', 0)
+    
+    # Drop hops beyond the current path length (the route got shorter)
+    for ttl in [t for t in path["hops"] if t > path["hop_count"]]:
+        del path["hops"][ttl]
+    
+    for hop in packet.get('hops', []):
+        path["hops"][hop.get('ttl')] = hop
+        
+        hop_ip = hop.get('ip')
+        if hop_ip and hop_ip != "*" and hop_ip in node_data:
+            node_data[hop_ip]["last_seen"] = current_time
+    
+    if connected_clients > 0:
+        socketio.emit("graph_update", {
+            "type": "path_update",
+            "dst_ip": dst_ip,
+            "hop_count": path["hop_count"],
+            "hops": packet.get('hops', [])
+        })
 
 def process_packet(packet):
     """Main packet processing function"""
@@ -314,6 +980,36 @@ def process_packet(packet):
     
     if protocol == 'TRACEROUTE':
         process_traceroute_packet(packet)
+    elif protocol == 'ROUTE':
+        process_route_packet(packet)
+    elif protocol == 'PATH_UPDATE':
+        process_path_update(packet)
+    elif protocol == 'FEATURES':
+        process_features(packet)
+    elif protocol == 'TOP_TALKERS':
+        process_top_talkers(packet)
+    elif protocol == 'FANOUT':
+        process_fanout(packet)
+    elif protocol == 'HISTOGRAMS':
+        process_histograms(packet)
+    elif protocol == 'CHANGE':
+        process_change(packet)
+    elif protocol == 'RULE':
+        process_rule(packet)
+    elif protocol == 'TCP_METRICS':
+        process_tcp_metrics(packet)
+    elif protocol == 'TLS':
+        process_tls(packet)
+    elif protocol == 'DNS_BINDING':
+        process_dns_binding(packet)
+    elif protocol == 'NODE_TAG':
+        process_node_tag(packet)
+    elif protocol == 'TRAFFIC':
+        process_traffic(packet)
+    elif protocol == 'TRAFFIC_PAGE':
+        process_traffic_page(packet)
+    elif protocol == 'SAMPLING':
+        process_sampling(packet)
     else:
         process_regular_packet(packet)
 
@@ -339,7 +1035,7 @@ def stdin_listener():
                 
             try:
                 packet = json.loads(line)
-                if isinstance(packet, dict) and ('src_ip' in packet or 'dst_ip' in packet or packet.get('protocol') == 'TRACEROUTE'):
+                if isinstance(packet, dict) and ('src_ip' in packet or 'dst_ip' in packet or packet.get('protocol') in ('TRACEROUTE', 'ROUTE', 'FEATURES', 'TOP_TALKERS', 'FANOUT', 'HISTOGRAMS', 'CHANGE', 'RULE', 'TCP_METRICS', 'DNS_BINDING', 'NODE_TAG', 'TRAFFIC', 'TRAFFIC_PAGE', 'SAMPLING')):
                     process_packet(packet)
                 else:
                     print(f"[DEBUG] Skipping invalid packet structure: {line[:50]}...")
@@ -359,6 +1055,11 @@ def index():
             "/api/graph": "GET - Get simplified graph structure",
             "/api/graph/detailed": "GET - Get detailed graph with metadata", 
             "/api/topology": "GET - Get network topology with path analysis",
+            "/api/paths/monitor": "GET - Get per-hop statistics of monitored paths",
+            "/api/features": "GET - Get recent window feature vectors (?window=tumbling|sliding)",
+            "/api/alerts": "GET - Get recent alerts raised by the sniffer (?type=fanout|anomaly|change|rule)",
+            "/api/histograms": "GET - Get packet size / inter-arrival percentiles (?class=all|tcp|udp|icmp|other|web|dns|ssh)",
+            "/api/tcp": "GET - Get passive TCP handshake RTTs, retransmissions and zero windows (?ip=<addr>)",
             "/stats": "GET - Get network statistics",
             "/predict/malicious-packet": "POST - Detect malicious network packets",
             "/predict/health": "GET - Check prediction service health",
@@ -367,26 +1068,69 @@ def index():
         "websocket_events": {
             "connect": "Auto-sends full graph update",
             "request_topology": "Request topology data",
-            "graph_update": "Receives real-time updates"
+            "graph_update": "Receives real-time updates",
+            "alert": "Receives alerts as the sniffer raises them"
         }
     })
 
 @app.route("/api/graph")
 def get_graph():
-    """Get simplified graph structure"""
+    """Get simplified graph structure, rolled up by ?rollup=/24|/16|asn|site with ?expand=group,..."""
+    try:
+        mode = parse_rollup_mode(request.args["rollup"]) if "rollup" in request.args else rollup["mode"]
+    except ValueError as error:
+        return {"error": str(error)}, 400
+    expanded = set(filter(None, request.args["expand"].split(","))) if "expand" in request.args else rollup["expanded"]
+    nodes, edges, _ = build_graph(mode, expanded)
     return {
-        "nodes": [{"id": ip, "type": data["type"], "is_local": data["is_local"]} 
-                 for ip, data in node_data.items()],
-        "edges": [{"source": s, "target": t, "type": data["type"]} 
-                 for (s, t), data in edge_data.items()],
+        "nodes": nodes,
+        "edges": [{"source": edge["source"], "target": edge["target"], "type": edge["type"],
+                   "packet_count": edge["packet_count"]}
+                 for edge in edges],
         "stats": {
             "total_nodes": len(node_data),
             "total_edges": len(edge_data),
             "traceroute_paths": len(traceroute_paths),
-            "local_ip": LOCAL_IP
+            "local_ip": LOCAL_IP,
+            "rollup": rollup_mode_name(mode),
+            "graph_nodes": len(nodes),
+            "graph_edges": len(edges)
         }
     }
 
+@app.route("/api/graph/group/<path:group>")
+def get_group_members(group):
+    """Addresses merged into one group, under ?rollup= or the current mode"""
+    try:
+        mode = parse_rollup_mode(request.args["rollup"]) if "rollup" in request.args else rollup["mode"]
+    except ValueError as error:
+        return {"error": str(error)}, 400
+    members = [node_entry(ip, data) for ip, data in node_data.items() if rollup_group(ip, data, mode) == group]
+    members.sort(key=lambda node: node["packet_count"], reverse=True)
+    return {"group": group, "rollup": rollup_mode_name(mode), "members": members}
+
+@app.route("/api/rollup", methods=["GET", "POST"])
+def rollup_settings():
+    """Get or set the default roll-up, for clients that connect later and requests without ?rollup="""
+    if request.method == "POST":
+        try:
+            set_rollup(rollup, request.get_json(silent=True))
+        except ValueError as error:
+            return {"error": str(error)}, 400
+    return {"mode": rollup_mode_name(rollup["mode"]), "expanded": sorted(rollup["expanded"])}
+
+def set_rollup(view, settings):
+    """Set a roll-up from {"mode": ..., "expand": [group, ...]}; ValueError if invalid"""
+    if not isinstance(settings, dict) or "mode" not in settings:
+        raise ValueError('"mode" is required')
+    mode = parse_rollup_mode(settings["mode"])
+    expand = settings.get("expand")
+    if expand is not None and (not isinstance(expand, list) or not all(isinstance(group, str) for group in expand)):
+        raise ValueError('"expand" must be a list of groups')
+    view["mode"] = mode
+    if expand is not None:
+        view["expanded"] = set(expand)
+
 @app.route("/api/graph/detailed")
 def get_detailed_graph():
     """Get detailed graph with all metadata"""
@@ -404,7 +1148,12 @@ def get_detailed_graph():
             "last_seen": data["last_seen"],
             "age_seconds": current_time - data["first_seen"],
             "is_local": data["is_local"],
-            "protocols": list(data["protocols"])
+            "name": data.get("name"),
+            **{field: data.get(field) for field in NODE_TAG_FIELDS},
+            "protocols": list(data["protocols"]),
+            "interfaces": sorted(data.get("interfaces", ())),
+            "tls_names": sorted(data.get("tls_names", ())),
+            "ja3": sorted(data.get("ja3", ()))
         }
         detailed_nodes.append(node)
     
@@ -417,6 +1166,7 @@ def get_detailed_graph():
             "type": data["type"],
             "packet_count": data["packet_count"],
             "protocols": list(data["protocols"]),
+            "interfaces": sorted(data.get("interfaces", ())),
             "first_seen": data["first_seen"],
             "last_seen": data["last_seen"],
             "age_seconds": current_time - data["first_seen"]
@@ -435,9 +1185,7 @@ def get_detailed_graph():
         paths_info[dst_ip] = {
             "hop_count": path_data["hop_count"],
             "last_traced": path_data["last_seen"],
-            "path": [LOCAL_IP] + [hop.get('responses', [{}])[0].get('ip', '*') 
-                    for hop in path_data["hops"] 
-                    if hop.get('responses') and hop['responses'][0].get('ip') != '*']
+            "path": [LOCAL_IP] + path_ips(path_data)
         }
     
     return {
@@ -465,13 +1213,7 @@ def get_topology():
     
     for dst_ip, path_data in traceroute_paths.items():
         if dst_ip in node_data:
-            hops = path_data["hops"]
-            path = [LOCAL_IP]
-            
-            for hop in hops:
-                responses = hop.get('responses', [])
-                if responses and responses[0].get('ip') != '*':
-                    path.append(responses[0]['ip'])
+            path = [LOCAL_IP] + path_ips(path_data)
             
             if len(path) > 1:
                 paths_from_local[dst_ip] = {
@@ -487,8 +1229,97 @@ def get_topology():
             "local": [ip for ip, data in node_data.items() if data["is_local"]],
             "routers": [ip for ip, data in node_data.items() if data["type"] == "router"],
             "destinations": [ip for ip, data in node_data.items() if data["type"] in ["remote", "destination"]]
-        }
+        },
+        "top_talkers": top_talkers
+    }
+@app.route("/api/paths/monitor")
+def get_monitored_paths():
+    """Get per-hop statistics of continuously monitored paths"""
+    return {
+        "paths": {
+            dst_ip: {
+                "hop_count": data["hop_count"],
+                "last_seen": data["last_seen"],
+                "hops": [data["hops"][ttl] for ttl in sorted(data["hops"])]
+            }
+            for dst_ip, data in path_stats.items()
+        },
+        "total_paths": len(path_stats)
+    }
+
+@app.route("/api/features")
+def get_window_features():
+    """Get the most recent window feature vectors computed by the sniffer"""
+    window = request.args.get('window', 'tumbling')
+    if window not in window_features:
+        return jsonify({"error": "window must be tumbling or sliding"}), 400
+    
+    limit = request.args.get('limit', 60, type=int)
+    features = list(window_features[window])[-limit:] if limit > 0 else []
+    return {
+        "window": window,
+        "features": features,
+        "total": len(features)
+    }
+
+@app.route("/api/alerts")
+def get_alerts():
+    """Get recent alerts, newest first"""
+    alert_type = request.args.get('type')
+    limit = request.args.get('limit', 100, type=int)
+    matching = [alert for alert in reversed(alerts) if not alert_type or alert["type"] == alert_type]
+    return {
+        "alerts": matching[:limit],
+        "total": len(matching)
+    }
+
+@app.route("/api/histograms")
+def get_histograms():
+    """Get the latest packet size / inter-arrival percentiles and their recent history"""
+    traffic_class = request.args.get('class', 'all')
+    limit = request.args.get('limit', 12, type=int)
+    recent = list(histograms)[-limit:] if limit > 0 else []
+    return {
+        "class": traffic_class,
+        "latest": recent[-1]["classes"].get(traffic_class) if recent else None,
+        "history": [
+            {"timestamp": entry["timestamp"], **entry["classes"][traffic_class]}
+            for entry in recent if traffic_class in entry["classes"]
+        ]
     }
+
+@app.route("/api/tcp")
+def get_tcp_metrics():
+    """Get the latest passive TCP measurements and the recent interval totals"""
+    ip = request.args.get('ip')
+    limit = request.args.get('limit', 12, type=int)
+    recent = list(tcp_metrics)[-limit:] if limit > 0 else []
+    latest = recent[-1] if recent else None
+    connections = latest["connections"] if latest else []
+    if ip:
+        connections = [c for c in connections if ip in (c.get("client_ip"), c.get("server_ip"))]
+    return {
+        "latest": {key: value for key, value in latest.items() if key != "connections"} if latest else None,
+        "connections": connections,
+        "history": [{key: value for key, value in entry.items() if key != "connections"} for entry in recent]
+    }
+
+@app.route("/api/traffic")
+def get_traffic():
+    """Get the exact packet, byte and flow totals of the recent intervals, with rates"""
+    limit = request.args.get('limit', 60, type=int)
+    recent = list(traffic)[-limit:] if limit > 0 else []
+    history = [{**entry,
+                "packets_per_second": entry["packets"] / entry["interval"] if entry["interval"] else None,
+                "bits_per_second": 8 * entry["bytes"] / entry["interval"] if entry["interval"] else None}
+               for entry in recent]
+    return {
+        "latest": history[-1] if history else None,
+        "history": history,
+        "sampling": sampling[-1] if sampling else None,
+        "sampling_changes": list(sampling)[-limit:] if limit > 0 else []
+    }
+
 @app.route("/api/packets/recent")
 def get_recent_packets():
     current_time = time.time()
@@ -841,17 +1672,33 @@ def stats():
 def handle_connect():
     global connected_clients
     connected_clients += 1
+    client_views[request.sid] = {"mode": rollup["mode"], "expanded": set(rollup["expanded"]),
+                                 "groups": set(), "edges": set()}
     print(f"[DEBUG] Client connected (total: {connected_clients})")
     
     # Send current state to new client
-    send_full_update()
+    send_full_update([request.sid])
 
 @socketio.on('disconnect')
 def handle_disconnect():
     global connected_clients
     connected_clients -= 1
+    client_views.pop(request.sid, None)
     print(f"[DEBUG] Client disconnected (remaining: {connected_clients})")
 
+@socketio.on('set_rollup')
+def handle_set_rollup(settings):
+    """Handle a client switching its own roll-up mode or expanding groups"""
+    view = client_views.get(request.sid)
+    if view is None:
+        return
+    try:
+        set_rollup(view, settings)
+    except ValueError as error:
+        emit("rollup_error", {"error": str(error)})
+        return
+    send_full_update([request.sid])
+
 @socketio.on('request_topology')
 def handle_topology_request():
     """Handle client request for topology data"""
@@ -0,0 +1,300 @@
+#include "batchDecoder.h"
+#include <algorithm>
+#include <cstring>
+#include <netinet/in.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCHDECODER_AVX2 1
+#endif
+
+using namespace std;
+
+static const uint32_t ETH_HEADER = 14;
+static const uint32_t MIN_FRAME = ETH_HEADER + 20; // Ethernet + IPv4 without options
+
+static uint16_t read16(const uint8_t *p) {
+    return uint16_t(p[0] << 8 | p[1]);
+}
+
+static uint32_t read32(const uint8_t *p) {
+    return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+}
+
+static void decodeFrame(const uint8_t *frame, uint32_t caplen, uint32_t len, double timestamp, DecodedFrame &out) {
+    out.valid = false;
+    if (len < MIN_FRAME || caplen < MIN_FRAME || read16(frame + 12) != 0x0800) return;
+
+    uint32_t ipHeaderLen = (frame[ETH_HEADER] & 0x0f) * 4;
+    uint8_t protocol = frame[ETH_HEADER + 9];
+    uint32_t l4 = ETH_HEADER + ipHeaderLen;
+    uint32_t minL4 = protocol == IPPROTO_TCP ? 20 : (protocol == IPPROTO_UDP || protocol == IPPROTO_ICMP) ? 8 : 0;
+    if (ipHeaderLen < 20 || len < l4 + minL4 || caplen < l4 + minL4) return;
+
+    PacketRecord &record = out.record;
+    record = PacketRecord();
+    record.timestamp = timestamp;
+    memcpy(&record.srcAddr, frame + ETH_HEADER + 12, 4);
+    memcpy(&record.dstAddr, frame + ETH_HEADER + 16, 4);
+    record.length = len;
+    out.valid = true;
+    out.ipProtocol = protocol;
+    out.icmpType = 0;
+    out.icmpCode = 0;
+
+    int headersLen = 0;
+    if (protocol == IPPROTO_TCP) {
+        const uint8_t *tcp = frame + l4;
+        record.protocol = PacketRecord::TCP;
+        record.srcPort = read16(tcp);
+        record.dstPort = read16(tcp + 2);
+        record.tcpSeq = read32(tcp + 4);
+        record.tcpAck = read32(tcp + 8);
+        record.tcpFlags = tcp[13] & 0x3f;
+        record.tcpWindow = read16(tcp + 14);
+        headersLen = ipHeaderLen + (tcp[12] >> 4) * 4;
+        record.payloadLength = max(0, read16(frame + ETH_HEADER + 2) - headersLen);
+    } else if (protocol == IPPROTO_UDP) {
+        const uint8_t *udp = frame + l4;
+        record.protocol = PacketRecord::UDP;
+        record.srcPort = read16(udp);
+        record.dstPort = read16(udp + 2);
+        headersLen = ipHeaderLen + 8;
+        record.payloadLength = max(0, read16(udp + 4) - 8);
+    } else if (protocol == IPPROTO_ICMP) {
+        record.protocol = PacketRecord::ICMP;
+        out.icmpType = frame[l4];
+        out.icmpCode = frame[l4 + 1];
+    }
+
+    if (headersLen > 0 && caplen > ETH_HEADER + headersLen) {
+        record.payload = frame + ETH_HEADER + headersLen;
+        record.payloadCaptured = min<uint32_t>(record.payloadLength, caplen - ETH_HEADER - headersLen);
+    }
+}
+
+void BatchDecoder::decodeScalar(const uint8_t *base, const uint32_t *offsets, const uint32_t *caplens,
+                                const uint32_t *lens, const double *timestamps, size_t count, DecodedFrame *out) {
+    for (size_t i = 0; i < count; ++i) decodeFrame(base + offsets[i], caplens[i], lens[i], timestamps[i], out[i]);
+}
+
+void BatchDecoder::decodeOne(const uint8_t *frame, uint32_t caplen, uint32_t len, double timestamp,
+                             DecodedFrame &out) {
+    decodeFrame(frame, caplen, len, timestamp, out);
+}
+
+#ifdef BATCHDECODER_AVX2
+
+// All lanes are 32 bits; frames are little-endian words as loaded
+namespace {
+
+struct Lanes {
+    alignas(32) uint32_t valid[BatchDecoder::GROUP];
+    alignas(32) uint32_t src[BatchDecoder::GROUP];
+    alignas(32) uint32_t dst[BatchDecoder::GROUP];
+    alignas(32) uint32_t protocol[BatchDecoder::GROUP]; // PacketRecord::Protocol
+    alignas(32) uint32_t ipProtocol[BatchDecoder::GROUP];
+    alignas(32) uint32_t ports[BatchDecoder::GROUP];    // source port low, destination port high; ICMP type, code
+    alignas(32) uint32_t seq[BatchDecoder::GROUP];
+    alignas(32) uint32_t ack[BatchDecoder::GROUP];
+    alignas(32) uint32_t flagsWindow[BatchDecoder::GROUP]; // TCP flags low, window high
+    alignas(32) uint32_t payloadLength[BatchDecoder::GROUP];
+    alignas(32) uint32_t payloadStart[BatchDecoder::GROUP];
+    alignas(32) uint32_t payloadCaptured[BatchDecoder::GROUP];
+    alignas(32) uint32_t hasPayload[BatchDecoder::GROUP];
+};
+
+} // namespace
+
+// 32-bit word at `pos` of each frame, 0 where the mask is off or the word was not captured
+__attribute__((target("avx2"))) static inline __m256i gatherWord(const uint8_t *base, __m256i offsets,
+                                                                  __m256i caplens, __m256i pos, __m256i mask) {
+    __m256i captured = _mm256_andnot_si256(_mm256_cmpgt_epi32(_mm256_add_epi32(pos, _mm256_set1_epi32(4)), caplens),
+                                           mask);
+    return _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int *>(base),
+                                       _mm256_add_epi32(offsets, pos), captured, 1);
+}
+
+// a >= b, per lane (values stay below 2^31)
+__attribute__((target("avx2"))) static inline __m256i atLeast(__m256i a, __m256i b) {
+    return _mm256_xor_si256(_mm256_cmpgt_epi32(b, a), _mm256_set1_epi32(-1));
+}
+
+__attribute__((target("avx2"))) static void decodeGroup(const uint8_t *base, const uint32_t *offsetArray,
+                                                         const uint32_t *caplenArray, const uint32_t *lenArray,
+                                                         Lanes &lanes) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i all = _mm256_set1_epi32(-1);
+    // Big-endian 16-bit halves and 32-bit words to host order
+    const __m256i swap16 = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    const __m256i swap32 = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                            3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    const __m256i low16 = _mm256_set1_epi32(0xffff);
+
+    __m256i offsets = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(offsetArray));
+    __m256i caplens = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(caplenArray));
+    __m256i lens = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lenArray));
+
+    // Ethernet type, IP version / header length; total length; protocol; addresses
+    __m256i word12 = gatherWord(base, offsets, caplens, _mm256_set1_epi32(12), all);
+    __m256i word16 = gatherWord(base, offsets, caplens, _mm256_set1_epi32(16), all);
+    __m256i word20 = gatherWord(base, offsets, caplens, _mm256_set1_epi32(20), all);
+    __m256i src = gatherWord(base, offsets, caplens, _mm256_set1_epi32(26), all);
+    __m256i dst = gatherWord(base, offsets, caplens, _mm256_set1_epi32(30), all);
+
+    __m256i isIpv4 = _mm256_cmpeq_epi32(_mm256_and_si256(word12, low16), _mm256_set1_epi32(0x0008));
+    __m256i ipHeaderLen = _mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(word12, 16), _mm256_set1_epi32(0x0f)), 2);
+    __m256i totalLength = _mm256_and_si256(_mm256_shuffle_epi8(word16, swap16), low16);
+    __m256i ipProtocol = _mm256_srli_epi32(word20, 24);
+
+    __m256i isTcp = _mm256_cmpeq_epi32(ipProtocol, _mm256_set1_epi32(IPPROTO_TCP));
+    __m256i isUdp = _mm256_cmpeq_epi32(ipProtocol, _mm256_set1_epi32(IPPROTO_UDP));
+    __m256i isIcmp = _mm256_cmpeq_epi32(ipProtocol, _mm256_set1_epi32(IPPROTO_ICMP));
+    __m256i isTransport = _mm256_or_si256(isTcp, isUdp);
+    __m256i hasL4 = _mm256_or_si256(isTransport, isIcmp);
+
+    __m256i protocol = _mm256_or_si256(_mm256_and_si256(isUdp, _mm256_set1_epi32(PacketRecord::UDP)),
+                                       _mm256_or_si256(_mm256_and_si256(isIcmp, _mm256_set1_epi32(PacketRecord::ICMP)),
+                                                       _mm256_andnot_si256(hasL4, _mm256_set1_epi32(PacketRecord::OTHER))));
+    __m256i minL4 = _mm256_or_si256(_mm256_and_si256(isTcp, _mm256_set1_epi32(20)),
+                                    _mm256_and_si256(_mm256_or_si256(isUdp, isIcmp), _mm256_set1_epi32(8)));
+
+    __m256i l4 = _mm256_add_epi32(ipHeaderLen, _mm256_set1_epi32(ETH_HEADER));
+    __m256i needed = _mm256_add_epi32(l4, minL4);
+    __m256i minFrame = _mm256_set1_epi32(MIN_FRAME);
+    __m256i valid = _mm256_and_si256(isIpv4, atLeast(ipHeaderLen, _mm256_set1_epi32(20)));
+    valid = _mm256_and_si256(valid, _mm256_and_si256(atLeast(lens, minFrame), atLeast(caplens, minFrame)));
+    valid = _mm256_and_si256(valid, _mm256_and_si256(atLeast(lens, needed), atLeast(caplens, needed)));
+
+    // Transport header words, fetched only for the lanes that have them
+    __m256i tcpLanes = _mm256_and_si256(valid, isTcp);
+    __m256i ports = gatherWord(base, offsets, caplens, l4, _mm256_and_si256(valid, hasL4));
+    __m256i word4 = gatherWord(base, offsets, caplens, _mm256_add_epi32(l4, _mm256_set1_epi32(4)),
+                               _mm256_and_si256(valid, isTransport));
+    __m256i word8 = gatherWord(base, offsets, caplens, _mm256_add_epi32(l4, _mm256_set1_epi32(8)), tcpLanes);
+    __m256i word12b = gatherWord(base, offsets, caplens, _mm256_add_epi32(l4, _mm256_set1_epi32(12)), tcpLanes);
+
+    // ICMP type and code stay as loaded, ports get swapped
+    ports = _mm256_blendv_epi8(ports, _mm256_shuffle_epi8(ports, swap16), isTransport);
+    __m256i dataOffset = _mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(word12b, 4), _mm256_set1_epi32(0x0f)), 2);
+    __m256i flagsWindow = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(word12b, 8), _mm256_set1_epi32(0x3f)),
+                                          _mm256_andnot_si256(low16, _mm256_shuffle_epi8(word12b, swap16)));
+    __m256i udpLength = _mm256_and_si256(_mm256_shuffle_epi8(word4, swap16), low16);
+
+    // IP + transport header bytes, then payload length and what of it was captured
+    __m256i headersLen = _mm256_add_epi32(ipHeaderLen, _mm256_blendv_epi8(_mm256_set1_epi32(8), dataOffset, isTcp));
+    __m256i payloadLength = _mm256_blendv_epi8(_mm256_sub_epi32(udpLength, _mm256_set1_epi32(8)),
+                                               _mm256_sub_epi32(totalLength, headersLen), isTcp);
+    payloadLength = _mm256_and_si256(_mm256_max_epi32(payloadLength, zero), isTransport);
+    __m256i payloadStart = _mm256_add_epi32(headersLen, _mm256_set1_epi32(ETH_HEADER));
+    __m256i hasPayload = _mm256_and_si256(isTransport, _mm256_cmpgt_epi32(caplens, payloadStart));
+    __m256i payloadCaptured = _mm256_and_si256(
+        _mm256_min_epi32(payloadLength, _mm256_sub_epi32(caplens, payloadStart)), hasPayload);
+
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes.valid), valid);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes.src), src);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes.dst), dst);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes.protocol), protocol);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes.ipProtocol), ipProtocol);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes.ports), ports);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes.seq), _mm256_shuffle_epi8(word4, swap32));
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes.ack), _mm256_shuffle_epi8(word8, swap32));
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes.flagsWindow), flagsWindow);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes.payloadLength), payloadLength);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes.payloadStart), payloadStart);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes.payloadCaptured), payloadCaptured);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes.hasPayload), hasPayload);
+}
+
+__attribute__((target("avx2"))) static void decodeAvx2(const uint8_t *base, const uint32_t *offsets,
+                                                        const uint32_t *caplens, const uint32_t *lens,
+                                                        const double *timestamps, size_t count, DecodedFrame *out) {
+    const size_t GROUP = BatchDecoder::GROUP;
+    Lanes lanes;
+
+    for (size_t first = 0; first < count; first += GROUP) {
+        size_t n = min(GROUP, count - first);
+
+        // Headers two groups ahead, so they arrive while this group and the next are decoded;
+        // with IP options and an unaligned start they reach into a second cache line
+        for (size_t i = first + 2 * GROUP; i < min(first + 3 * GROUP, count); ++i) {
+            _mm_prefetch(reinterpret_cast<const char *>(base + offsets[i]), _MM_HINT_T0);
+            _mm_prefetch(reinterpret_cast<const char *>(base + offsets[i] + 64), _MM_HINT_T0);
+        }
+
+        if (n == GROUP) {
+            decodeGroup(base, offsets + first, caplens + first, lens + first, lanes);
+        } else {
+            // Short tail: absent lanes have nothing captured, so every gather skips them
+            uint32_t tailOffsets[GROUP] = {}, tailCaplens[GROUP] = {}, tailLens[GROUP] = {};
+            copy(offsets + first, offsets + first + n, tailOffsets);
+            copy(caplens + first, caplens + first + n, tailCaplens);
+            copy(lens + first, lens + first + n, tailLens);
+            decodeGroup(base, tailOffsets, tailCaplens, tailLens, lanes);
+        }
+
+        for (size_t lane = 0; lane < n; ++lane) {
+            DecodedFrame &frame = out[first + lane];
+            frame.valid = lanes.valid[lane] != 0;
+            if (!frame.valid) continue;
+
+            PacketRecord &record = frame.record;
+            record = PacketRecord();
+            record.timestamp = timestamps[first + lane];
+            record.srcAddr = lanes.src[lane];
+            record.dstAddr = lanes.dst[lane];
+            record.length = lens[first + lane];
+            record.protocol = PacketRecord::Protocol(lanes.protocol[lane]);
+            frame.ipProtocol = uint8_t(lanes.ipProtocol[lane]);
+            frame.icmpType = 0;
+            frame.icmpCode = 0;
+
+            uint32_t ports = lanes.ports[lane];
+            if (record.protocol == PacketRecord::ICMP) {
+                frame.icmpType = uint8_t(ports);
+                frame.icmpCode = uint8_t(ports >> 8);
+                continue;
+            }
+            if (record.protocol == PacketRecord::OTHER) continue;
+
+            record.srcPort = uint16_t(ports);
+            record.dstPort = uint16_t(ports >> 16);
+            if (record.protocol == PacketRecord::TCP) {
+                record.tcpSeq = lanes.seq[lane];
+                record.tcpAck = lanes.ack[lane];
+                record.tcpFlags = uint8_t(lanes.flagsWindow[lane]);
+                record.tcpWindow = uint16_t(lanes.flagsWindow[lane] >> 16);
+            }
+            record.payloadLength = uint16_t(lanes.payloadLength[lane]);
+            if (lanes.hasPayload[lane]) {
+                record.payload = base + offsets[first + lane] + lanes.payloadStart[lane];
+                record.payloadCaptured = lanes.payloadCaptured[lane];
+            }
+        }
+    }
+}
+
+static bool haveAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+#endif // BATCHDECODER_AVX2
+
+void BatchDecoder::decode(const uint8_t *base, const uint32_t *offsets, const uint32_t *caplens, const uint32_t *lens,
+                          const double *timestamps, size_t count, DecodedFrame *out) {
+#ifdef BATCHDECODER_AVX2
+    if (haveAvx2()) {
+        decodeAvx2(base, offsets, caplens, lens, timestamps, count, out);
+        return;
+    }
+#endif
+    decodeScalar(base, offsets, caplens, lens, timestamps, count, out);
+}
+
+const char *BatchDecoder::implementation() {
+#ifdef BATCHDECODER_AVX2
+    if (haveAvx2()) return "avx2";
+#endif
+    return "scalar";
+}
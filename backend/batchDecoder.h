@@ -0,0 +1,53 @@
+#ifndef BATCHDECODER_H
+#define BATCHDECODER_H
+
+#include "packetSniffer.h"
+#include <cstdint>
+
+// Header decoding for groups of captured frames instead of one frame per
+// call. Frames are addressed as offsets from a common base (a block of
+// captured frames), so on AVX2 machines the
+// decoder takes 8 frames at a time: each header field of all 8 is fetched
+// with one masked gather, the IPv4 and TCP/UDP fields are byte-swapped with
+// shuffles, and the protocol classification, header length checks and
+// payload bounds are computed as lane masks without branches. The next
+// group's headers are prefetched while the current one is decoded. Other
+// machines get a scalar loop with the same results.
+//
+// The gathers pay off on frames that stay where they are: with --ring the
+// sniffer decodes each TPACKET_V3 block in one call (PacketRing). libpcap
+// only guarantees a frame until its callback returns, and copying frames
+// out to decode them together cost more than it saved, so the pcap path
+// decodes each frame in place with decodeOne().
+//
+// A frame is decoded if it is Ethernet + IPv4 with a sane header length
+// and long enough, both on the wire and as captured, for its TCP (20), UDP
+// (8) or ICMP (8) header; anything else is marked invalid. Gathers never
+// read past a frame's captured length.
+
+// A decoded frame: the shared record plus the fields only the JSON output uses
+struct DecodedFrame {
+    PacketRecord record; // payload points into the frame
+    bool valid = false;
+    uint8_t ipProtocol = 0;
+    uint8_t icmpType = 0;
+    uint8_t icmpCode = 0;
+};
+
+class BatchDecoder {
+public:
+    static constexpr size_t GROUP = 8;
+
+    // Decode `count` frames; frame i starts at base + offsets[i] (below 2 GB)
+    // with caplens[i] bytes captured of lens[i] on the wire
+    static void decode(const uint8_t *base, const uint32_t *offsets, const uint32_t *caplens, const uint32_t *lens,
+                       const double *timestamps, size_t count, DecodedFrame *out);
+    // One frame at a time; the reference the vector path is checked against
+    static void decodeScalar(const uint8_t *base, const uint32_t *offsets, const uint32_t *caplens,
+                             const uint32_t *lens, const double *timestamps, size_t count, DecodedFrame *out);
+    static void decodeOne(const uint8_t *frame, uint32_t caplen, uint32_t len, double timestamp, DecodedFrame &out);
+    // "avx2" or "scalar", whichever decode() uses on this machine
+    static const char *implementation();
+};
+
+#endif // BATCHDECODER_H
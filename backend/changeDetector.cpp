@@ -0,0 +1,198 @@
+#include "changeDetector.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <arpa/inet.h>
+
+using namespace std;
+
+static const double ALPHA = 0.1;          // EWMA weight of the newest tick
+static const double SLACK = 0.5;          // CUSUM allowance, in standard deviations
+static const uint32_t WARMUP_TICKS = 10;  // ticks that only train the baseline
+static const char *const METRIC_NAMES[] = {"packets_per_sec", "syn_per_sec", "bytes_per_sec"};
+
+static string addrToString(uint32_t addr) {
+    char buf[INET_ADDRSTRLEN];
+    struct in_addr in;
+    in.s_addr = addr;
+    inet_ntop(AF_INET, &in, buf, sizeof(buf));
+    return buf;
+}
+
+ChangeDetector::ChangeDetector(Emitter emitter, double tickSeconds, double threshold, double minRate,
+                               size_t maxHosts, int idleTicks)
+    : emit(std::move(emitter)), tickSeconds(tickSeconds), threshold(threshold), minRate(minRate),
+      maxHosts(maxHosts), idleTicks(max(1, min(idleTicks, WHEEL_SLOTS - 2))) {
+    sources.name = "src";
+    destinations.name = "dst";
+}
+
+void ChangeDetector::add(const PacketRecord &packet) {
+    int64_t tick = static_cast<int64_t>(floor(packet.timestamp / tickSeconds));
+    tick = max(tick, wheelTick); // late packets are counted in the open tick
+    advance(tick);
+
+    track(sources, 0, packet.srcAddr, tick, packet);
+    track(destinations, ROLE_BIT, packet.dstAddr, tick, packet);
+}
+
+void ChangeDetector::track(Role &role, uint32_t roleBit, uint32_t addr, int64_t tick, const PacketRecord &packet) {
+    uint32_t slot;
+    if (uint32_t *found = role.index.find(addr)) {
+        slot = *found;
+        closeTicks(role, role.hosts[slot], tick);
+    } else {
+        if (role.freeSlots.empty() && role.hosts.size() >= maxHosts) {
+            if (role.untracked++ == 0)
+                cerr << "⚠️  Change detector is tracking " << maxHosts << " " << role.name
+                     << " addresses, ignoring new ones until some expire\n";
+            return;
+        }
+        if (!role.freeSlots.empty()) {
+            slot = role.freeSlots.back();
+            role.freeSlots.pop_back();
+        } else {
+            slot = role.hosts.size();
+            role.hosts.emplace_back();
+        }
+        role.hosts[slot] = Host();
+        role.hosts[slot].addr = addr;
+        role.hosts[slot].used = true;
+        role.hosts[slot].tick = tick;
+        role.index.insert(addr, slot);
+    }
+
+    Host &host = role.hosts[slot];
+    host.lastActive = tick;
+    host.counts[PACKETS] += packet.packets;
+    host.counts[BYTES] += packet.length;
+    if ((packet.tcpFlags & PacketRecord::FLAG_SYN) && !(packet.tcpFlags & PacketRecord::FLAG_ACK))
+        host.counts[SYN] += packet.packets;
+
+    // Close this tick as soon as it is over
+    if (host.due != tick + 1) schedule(host, roleBit | slot, tick + 1);
+}
+
+void ChangeDetector::schedule(Host &host, uint32_t ref, int64_t due) {
+    host.due = due;
+    wheel[due & (WHEEL_SLOTS - 1)].push_back(ref);
+}
+
+void ChangeDetector::advance(int64_t now) {
+    if (wheelTick < 0) {
+        wheelTick = now;
+        return;
+    }
+    // After a gap longer than the wheel, visiting every slot once is enough
+    if (now - wheelTick > WHEEL_SLOTS) wheelTick = now - WHEEL_SLOTS;
+
+    while (wheelTick < now) {
+        ++wheelTick;
+        vector<uint32_t> refs;
+        refs.swap(wheel[wheelTick & (WHEEL_SLOTS - 1)]);
+        for (uint32_t ref : refs) visit(ref, wheelTick);
+    }
+}
+
+void ChangeDetector::visit(uint32_t ref, int64_t now) {
+    Role &role = (ref & ROLE_BIT) ? destinations : sources;
+    uint32_t slot = ref & ~ROLE_BIT;
+    Host &host = role.hosts[slot];
+    if (!host.used || host.due > now) return; // released or rescheduled since
+
+    closeTicks(role, host, now);
+
+    if (now - host.lastActive > idleTicks) {
+        release(role, slot);
+    } else if (host.lastActive == now - 1) {
+        schedule(host, ref, now + 1);                      // still active: close the next tick too
+    } else {
+        schedule(host, ref, host.lastActive + idleTicks + 1); // gone quiet: come back to expire it
+    }
+}
+
+void ChangeDetector::closeTicks(Role &role, Host &host, int64_t upTo) {
+    // Empty ticks beyond the idle timeout would only repeat the last one
+    if (upTo - host.tick > idleTicks + 1) host.tick = upTo - idleTicks - 1;
+
+    while (host.tick < upTo) {
+        double rates[METRICS];
+        for (int m = 0; m < METRICS; ++m) {
+            rates[m] = host.counts[m] / tickSeconds;
+            host.counts[m] = 0;
+        }
+        evaluate(role, host, rates);
+        host.tick++;
+    }
+}
+
+double ChangeDetector::countingNoise(const Host &host, Metric metric) const {
+    // Packets arriving at random at the baseline rate still vary by sqrt(count)
+    // per tick; a steady host must not look like a change because its own
+    // variance estimate happens to be small
+    double packets = max(host.detectors[PACKETS].mean, 1 / tickSeconds);
+    double noise = sqrt(max(host.detectors[metric].mean, 1 / tickSeconds) / tickSeconds);
+    if (metric == BYTES) {
+        double packetSize = host.detectors[BYTES].mean / packets;
+        noise = max(packetSize, 1.0) * sqrt(packets / tickSeconds);
+    }
+    return noise;
+}
+
+void ChangeDetector::evaluate(Role &role, Host &host, const double rates[METRICS]) {
+    host.ticksSeen++;
+    // Alerts need some traffic on either side of the change, so idle hosts stay quiet
+    bool significant = max(rates[PACKETS], host.detectors[PACKETS].mean) >= minRate;
+
+    for (int m = 0; m < METRICS; ++m) {
+        Detector &d = host.detectors[m];
+        double x = rates[m];
+
+        if (host.ticksSeen == 1) {
+            d.mean = x;
+            continue;
+        }
+
+        if (host.ticksSeen > WARMUP_TICKS) {
+            double sd = max(sqrt(d.var), countingNoise(host, Metric(m)));
+            double z = (x - d.mean) / sd;
+            d.up = max(0.0, d.up + z - SLACK);
+            d.down = max(0.0, d.down - z - SLACK);
+
+            if (!significant) {
+                d.up = d.down = 0;
+            } else if (d.up > threshold || d.down > threshold) {
+                bool up = d.up > threshold;
+                json record;
+                record["protocol"] = "CHANGE";
+                record["ip"] = addrToString(host.addr);
+                record["role"] = role.name;
+                record["metric"] = METRIC_NAMES[m];
+                record["direction"] = up ? "up" : "down";
+                record["value"] = x;
+                record["baseline"] = d.mean;
+                record["cusum"] = up ? d.up : d.down;
+                record["threshold"] = threshold;
+                record["timestamp"] = (host.tick + 1) * tickSeconds;
+                emit(record);
+
+                // Restart from the new level so the shift is reported once
+                d.mean = x;
+                d.up = d.down = 0;
+                continue;
+            }
+        }
+
+        double diff = x - d.mean;
+        double increment = ALPHA * diff;
+        d.mean += increment;
+        d.var = (1 - ALPHA) * (d.var + diff * increment);
+    }
+}
+
+void ChangeDetector::release(Role &role, uint32_t slot) {
+    Host &host = role.hosts[slot];
+    role.index.erase(host.addr);
+    host.used = false;
+    role.freeSlots.push_back(slot);
+}
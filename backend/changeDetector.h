@@ -0,0 +1,85 @@
+#ifndef CHANGEDETECTOR_H
+#define CHANGEDETECTOR_H
+
+#include "packetSniffer.h"
+#include "flatTable.h"
+#include <functional>
+
+// Rate change points per source and destination address.
+// Every tracked address counts packets, SYNs and bytes per tick. When a
+// tick closes, each rate is compared with its EWMA baseline and the
+// standardized deviation feeds a two-sided CUSUM. A CHANGE alert goes out
+// as soon as either side crosses the threshold: a flood that builds up
+// slowly still drifts ahead of its lagging baseline and accumulates.
+// Hosts live in a flat table with fixed-size state. A timer wheel closes
+// the tick of every active host as time passes and expires hosts that have
+// been idle for `idleTicks`; the empty ticks in between are only
+// evaluated when the host is seen again or expires.
+
+class ChangeDetector {
+public:
+    using Emitter = std::function<void(const json &)>;
+
+    ChangeDetector(Emitter emitter, double tickSeconds = 1, double threshold = 8, double minRate = 20,
+                   size_t maxHosts = 65536, int idleTicks = 30);
+
+    void add(const PacketRecord &packet);
+
+private:
+    enum Metric { PACKETS = 0, SYN, BYTES, METRICS };
+
+    // EWMA baseline and CUSUM statistics of one rate
+    struct Detector {
+        double mean = 0;
+        double var = 0;
+        double up = 0;
+        double down = 0;
+    };
+
+    struct Host {
+        uint32_t addr = 0;
+        bool used = false;
+        uint32_t ticksSeen = 0;   // closed ticks, for the warm-up
+        int64_t tick = 0;         // open tick
+        int64_t lastActive = 0;   // last tick with a packet
+        int64_t due = -1;         // tick at which the wheel visits this host
+        uint64_t counts[METRICS] = {};
+        Detector detectors[METRICS];
+    };
+
+    struct Role {
+        const char *name;
+        FlatTable<uint32_t, uint32_t> index; // address -> host slot
+        std::vector<Host> hosts;
+        std::vector<uint32_t> freeSlots;
+        size_t untracked = 0;               // packets of addresses that did not fit
+    };
+
+    static const int WHEEL_SLOTS = 64;     // ticks ahead the wheel can schedule
+    static const uint32_t ROLE_BIT = 1u << 31;
+
+    Emitter emit;
+    double tickSeconds;
+    double threshold;
+    double minRate;
+    size_t maxHosts;
+    int idleTicks;
+    Role sources;
+    Role destinations;
+
+    // Host references (role bit | slot) by due tick modulo WHEEL_SLOTS. Entries
+    // whose host has since been rescheduled or released are skipped.
+    std::vector<uint32_t> wheel[WHEEL_SLOTS];
+    int64_t wheelTick = -1;
+
+    void track(Role &role, uint32_t roleBit, uint32_t addr, int64_t tick, const PacketRecord &packet);
+    void schedule(Host &host, uint32_t ref, int64_t due);
+    void advance(int64_t now);
+    void visit(uint32_t ref, int64_t now);
+    void closeTicks(Role &role, Host &host, int64_t upTo);
+    void evaluate(Role &role, Host &host, const double rates[METRICS]);
+    double countingNoise(const Host &host, Metric metric) const; // standard deviation floor
+    void release(Role &role, uint32_t slot);
+};
+
+#endif // CHANGEDETECTOR_H
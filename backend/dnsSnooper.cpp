@@ -0,0 +1,197 @@
+#include "dnsSnooper.h"
+#include <algorithm>
+#include <cstring>
+#include <arpa/inet.h>
+
+using namespace std;
+
+static const uint16_t TYPE_A = 1;
+static const uint16_t CLASS_IN = 1;
+static const int MAX_POINTERS = 16; // compression pointers followed per name
+
+static string addrToString(uint32_t addr) {
+    char buf[INET_ADDRSTRLEN];
+    struct in_addr in;
+    in.s_addr = addr;
+    inet_ntop(AF_INET, &in, buf, sizeof(buf));
+    return buf;
+}
+
+static uint16_t read16(const uint8_t *p) {
+    return uint16_t(p[0]) << 8 | p[1];
+}
+
+// Decode the (possibly compressed) name at `pos` into `out`, lowercased and
+// with anything unprintable replaced; `pos` moves past the name. With a null
+// `out` the name is only skipped.
+static bool readName(const uint8_t *data, size_t length, size_t &pos, char *out, size_t outSize) {
+    size_t p = pos;
+    size_t n = 0;
+    bool jumped = false;
+    int pointers = 0;
+
+    while (true) {
+        if (p >= length) return false;
+        uint8_t label = data[p];
+        if (label == 0) {
+            p++;
+            break;
+        }
+        if ((label & 0xC0) == 0xC0) {
+            if (p + 1 >= length || ++pointers > MAX_POINTERS) return false;
+            if (!jumped) pos = p + 2;
+            jumped = true;
+            p = size_t(label & 0x3F) << 8 | data[p + 1];
+            continue;
+        }
+        if (label & 0xC0) return false; // extended label types
+        if (p + 1 + label > length) return false;
+        if (out) {
+            if (n + label + 1 >= outSize) return false;
+            if (n > 0) out[n++] = '.';
+            for (size_t i = 0; i < label; ++i) {
+                uint8_t c = data[p + 1 + i];
+                out[n++] = c > 0x20 && c < 0x7f ? char(tolower(c)) : '?';
+            }
+        }
+        p += 1 + label;
+    }
+    if (!jumped) pos = p;
+    if (out) out[n] = '\0';
+    return true;
+}
+
+DnsSnooper::DnsSnooper(Emitter emitter, size_t maxEntries, uint32_t minTtl, uint32_t maxTtl)
+    : emit(std::move(emitter)), maxEntries(max<size_t>(1, maxEntries)), minTtl(minTtl), maxTtl(max(minTtl, maxTtl)) {}
+
+void DnsSnooper::add(const PacketRecord &packet) {
+    if (packet.protocol != PacketRecord::UDP || packet.srcPort != 53 || packet.payloadCaptured < 12) return;
+    expire(packet.timestamp);
+    parseResponse(packet.payload, packet.payloadCaptured, packet.timestamp);
+}
+
+void DnsSnooper::parseResponse(const uint8_t *data, size_t length, double timestamp) {
+    uint16_t flags = read16(data + 2);
+    bool response = flags & 0x8000;
+    uint16_t opcode = (flags >> 11) & 0xF;
+    uint16_t rcode = flags & 0xF;
+    if (!response || opcode != 0 || rcode != 0) return;
+
+    uint16_t questions = read16(data + 4);
+    uint16_t answers = read16(data + 6);
+    if (questions == 0 || answers == 0) return;
+
+    // Bind the addresses to the name the client asked for
+    size_t pos = 12;
+    char name[256];
+    if (!readName(data, length, pos, name, sizeof(name)) || name[0] == '\0') return;
+    pos += 4;
+    for (uint16_t q = 1; q < questions; ++q) {
+        if (!readName(data, length, pos, nullptr, 0)) return;
+        pos += 4;
+    }
+
+    for (uint16_t a = 0; a < answers; ++a) {
+        if (!readName(data, length, pos, nullptr, 0) || pos + 10 > length) return;
+        uint16_t type = read16(data + pos);
+        uint16_t rrClass = read16(data + pos + 2);
+        uint32_t ttl = uint32_t(read16(data + pos + 4)) << 16 | read16(data + pos + 6);
+        uint16_t rdLength = read16(data + pos + 8);
+        pos += 10;
+        if (pos + rdLength > length) return;
+
+        if (type == TYPE_A && rrClass == CLASS_IN && rdLength == 4) {
+            uint32_t addr;
+            memcpy(&addr, data + pos, 4); // already in network byte order
+            bind(addr, name, ttl, timestamp);
+        }
+        pos += rdLength;
+    }
+}
+
+void DnsSnooper::bind(uint32_t addr, const char *name, uint32_t ttl, double timestamp) {
+    ttl = min(max(ttl, minTtl), maxTtl);
+    double expires = timestamp + ttl;
+
+    Entry *entry;
+    bool changed;
+    if (uint32_t *found = index.find(addr)) {
+        entry = &entries[*found];
+        changed = entry->name != name;
+        // Its heap entry comes due at the old expiry and is pushed back then
+        entry->expires = max(entry->expires, expires);
+        if (changed) {
+            entry->name = name;
+            entry->expires = expires;
+        }
+    } else {
+        if (index.size() >= maxEntries && !evictOne()) return;
+
+        uint32_t slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            slot = entries.size();
+            entries.emplace_back();
+        }
+        entry = &entries[slot];
+        entry->addr = addr;
+        entry->used = true;
+        entry->expires = expires;
+        entry->name = name;
+        index.insert(addr, slot);
+        expiries.emplace(expires, slot);
+        changed = true;
+    }
+    if (!changed) return;
+
+    json record;
+    record["protocol"] = "DNS_BINDING";
+    record["ip"] = addrToString(addr);
+    record["name"] = entry->name;
+    record["ttl"] = ttl;
+    record["expires"] = entry->expires;
+    record["timestamp"] = timestamp;
+    emit(record);
+}
+
+const string *DnsSnooper::lookup(uint32_t addr, double now) {
+    uint32_t *slot = index.find(addr);
+    if (!slot || entries[*slot].expires <= now) return nullptr;
+    return &entries[*slot].name;
+}
+
+void DnsSnooper::expire(double now) {
+    while (!expiries.empty() && expiries.top().first <= now) {
+        uint32_t slot = expiries.top().second;
+        expiries.pop();
+        if (entries[slot].expires > now) {
+            expiries.emplace(entries[slot].expires, slot); // refreshed since it was scheduled
+        } else {
+            release(slot);
+        }
+    }
+}
+
+bool DnsSnooper::evictOne() {
+    while (!expiries.empty()) {
+        Expiry top = expiries.top();
+        expiries.pop();
+        if (entries[top.second].expires > top.first) {
+            expiries.emplace(entries[top.second].expires, top.second);
+            continue;
+        }
+        release(top.second);
+        return true;
+    }
+    return false;
+}
+
+void DnsSnooper::release(uint32_t slot) {
+    Entry &entry = entries[slot];
+    index.erase(entry.addr);
+    entry.used = false;
+    entry.name.clear();
+    freeSlots.push_back(slot);
+}
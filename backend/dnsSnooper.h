@@ -0,0 +1,57 @@
+#ifndef DNSSNOOPER_H
+#define DNSSNOOPER_H
+
+#include "packetSniffer.h"
+#include "flatTable.h"
+#include <functional>
+#include <queue>
+
+// Address -> name bindings learned from the DNS responses the sniffer
+// already captures on UDP port 53, so nodes can be labelled without any
+// lookups of our own. Every A record binds its address to the name that was
+// asked for (not the CNAME target, which is usually a CDN host). Bindings
+// live for their record's TTL, clamped to [minTtl, maxTtl]; when the cache
+// is full the binding that expires first makes room. A DNS_BINDING record
+// goes out when an address gets a binding or its name changes, not on every
+// refresh.
+
+class DnsSnooper {
+public:
+    using Emitter = std::function<void(const json &)>;
+
+    DnsSnooper(Emitter emitter, size_t maxEntries = 16384, uint32_t minTtl = 60, uint32_t maxTtl = 86400);
+
+    void add(const PacketRecord &packet);
+
+    // Name bound to `addr` (network byte order) at `now`, nullptr if none
+    const std::string *lookup(uint32_t addr, double now);
+    size_t size() const { return index.size(); }
+
+private:
+    struct Entry {
+        uint32_t addr = 0;
+        bool used = false;
+        double expires = 0;
+        std::string name;
+    };
+
+    using Expiry = std::pair<double, uint32_t>; // expiry time, slot
+
+    Emitter emit;
+    size_t maxEntries;
+    uint32_t minTtl;
+    uint32_t maxTtl;
+    FlatTable<uint32_t, uint32_t> index;       // address -> entry slot
+    std::vector<Entry> entries;
+    std::vector<uint32_t> freeSlots;
+    // Soonest expiry first; entries refreshed since are found stale and skipped
+    std::priority_queue<Expiry, std::vector<Expiry>, std::greater<Expiry>> expiries;
+
+    void parseResponse(const uint8_t *data, size_t length, double timestamp);
+    void bind(uint32_t addr, const char *name, uint32_t ttl, double timestamp);
+    void expire(double now);
+    bool evictOne();
+    void release(uint32_t slot);
+};
+
+#endif // DNSSNOOPER_H
@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""
+Export the isolation forest trained by train_model.py to the flat binary
+format read by the sniffer's native scorer (isolationForest.cpp).
+
+Layout (little endian):
+    "NVIF", u16 version, u16 feature_count, u32 tree_count,
+    f64 path_length_norm (average path length for max_samples_), f64 offset_,
+    feature names (u8 length + utf-8 bytes each),
+    f64 center[feature_count], f64 scale[feature_count]   (RobustScaler)
+    per tree: u32 node_count, u16 max_depth,
+              u16 feature[n], f32 threshold[n], u32 child[n], f32 leaf_depth[n]
+
+Nodes are renumbered breadth first so the two children of a node are
+adjacent: next = child + (x > threshold). Leaves point at themselves with
+an infinite threshold, so a fixed number of steps walks every sample to
+its leaf without branches. leaf_depth is the leaf's depth plus the
+average path length of the samples that ended there, as in sklearn.
+
+Usage: python3 export_model.py [model.pkl] [output.bin] [--verify features.csv]
+"""
+import math
+import os
+import struct
+import sys
+
+import joblib
+import numpy as np
+
+MAGIC = b'NVIF'
+VERSION = 1
+
+
+def average_path_length(n):
+    """Average path length of an unsuccessful BST search among n samples"""
+    if n <= 1:
+        return 0.0
+    if n == 2:
+        return 1.0
+    return 2.0 * (math.log(n - 1.0) + np.euler_gamma) - 2.0 * (n - 1.0) / n
+
+
+def float_threshold(threshold):
+    """Largest float32 <= threshold: for float32 x, x <= threshold iff x <= result"""
+    value = np.float32(threshold)
+    if float(value) > threshold:
+        value = np.nextafter(value, np.float32(-np.inf))
+    return float(value)
+
+
+def flatten_tree(tree, features):
+    """Breadth-first node arrays of one sklearn tree, in model feature indices"""
+    order = [0]
+    depth = {0: 0}
+    position = {0: 0}
+    i = 0
+    while i < len(order):
+        node = order[i]
+        i += 1
+        left = tree.children_left[node]
+        if left == -1:
+            continue
+        for child in (left, tree.children_right[node]):
+            position[child] = len(order)
+            depth[child] = depth[node] + 1
+            order.append(child)
+
+    feature, threshold, child, leaf_depth = [], [], [], []
+    for index, node in enumerate(order):
+        left = tree.children_left[node]
+        if left == -1:
+            feature.append(0)
+            threshold.append(float('inf'))
+            child.append(index)
+            leaf_depth.append(depth[node] + average_path_length(tree.n_node_samples[node]))
+        else:
+            feature.append(int(features[tree.feature[node]]))
+            threshold.append(float_threshold(tree.threshold[node]))
+            child.append(position[left])
+            leaf_depth.append(0.0)
+
+    return feature, threshold, child, leaf_depth, max(depth.values())
+
+
+def export(model_path, output_path):
+    model = joblib.load(model_path)
+    forest = model['isolation_forest']
+    scaler = model['scaler']
+    names = list(model['feature_names'])
+    count = len(names)
+
+    center = scaler.center_ if getattr(scaler, 'center_', None) is not None else np.zeros(count)
+    scale = scaler.scale_ if getattr(scaler, 'scale_', None) is not None else np.ones(count)
+
+    out = bytearray()
+    out += MAGIC
+    out += struct.pack('<HHI', VERSION, count, len(forest.estimators_))
+    out += struct.pack('<dd', average_path_length(forest.max_samples_), forest.offset_)
+    for name in names:
+        encoded = name.encode('utf-8')
+        out += struct.pack('<B', len(encoded)) + encoded
+    out += struct.pack(f'<{count}d', *center)
+    out += struct.pack(f'<{count}d', *scale)
+
+    for estimator, features in zip(forest.estimators_, forest.estimators_features_):
+        feature, threshold, child, leaf_depth, max_depth = flatten_tree(estimator.tree_, features)
+        n = len(feature)
+        out += struct.pack('<IH', n, max_depth)
+        out += struct.pack(f'<{n}H', *feature)
+        out += struct.pack(f'<{n}f', *threshold)
+        out += struct.pack(f'<{n}I', *child)
+        out += struct.pack(f'<{n}f', *leaf_depth)
+
+    os.makedirs(os.path.dirname(output_path) or '.', exist_ok=True)
+    with open(output_path, 'wb') as f:
+        f.write(out)
+
+    print(f"[SUCCESS] Exported {len(forest.estimators_)} trees over {count} features to {output_path}")
+    print(f"[INFO] Size: {len(out) / 1024:.1f} KB")
+    return model
+
+
+def flat_scores(model, X):
+    """Score X the way the native scorer walks the exported arrays"""
+    forest = model['isolation_forest']
+    scaler = model['scaler']
+    X = scaler.transform(X).astype(np.float32)
+    total = np.zeros(len(X))
+    for estimator, features in zip(forest.estimators_, forest.estimators_features_):
+        feature, threshold, child, leaf_depth, max_depth = flatten_tree(estimator.tree_, features)
+        feature, threshold = np.array(feature), np.array(threshold, dtype=np.float32)
+        child, leaf_depth = np.array(child), np.array(leaf_depth)
+        node = np.zeros(len(X), dtype=np.int64)
+        for _ in range(max_depth):
+            node = child[node] + (X[np.arange(len(X)), feature[node]] > threshold[node])
+        total += leaf_depth[node]
+    return -np.power(2.0, -total / (len(forest.estimators_) * average_path_length(forest.max_samples_)))
+
+
+def verify(model, csv_path):
+    import pandas as pd
+    df = pd.read_csv(csv_path)[model['feature_names']].fillna(0)
+    expected = model['isolation_forest'].score_samples(model['scaler'].transform(df))
+    actual = flat_scores(model, df.values)
+    error = np.max(np.abs(expected - actual))
+    print(f"[INFO] Max score difference over {len(df)} rows: {error:.3e}")
+    return error < 1e-6
+
+
+def main():
+    script_dir = os.path.dirname(os.path.abspath(__file__))
+    args = [arg for arg in sys.argv[1:] if not arg.startswith('--')]
+    model_path = args[0] if len(args) > 0 else os.path.join(script_dir, 'models', 'malicious_packet_model.pkl')
+    output_path = args[1] if len(args) > 1 else os.path.join(script_dir, 'models', 'isolation_forest.bin')
+
+    model = export(model_path, output_path)
+
+    if '--verify' in sys.argv:
+        index = sys.argv.index('--verify')
+        csv_path = sys.argv[index + 1] if index + 1 < len(sys.argv) else os.path.join(script_dir, 'network_features.csv')
+        if not verify(model, csv_path):
+            print("[ERROR] Exported trees do not reproduce sklearn's scores")
+            sys.exit(1)
+        print("[SUCCESS] Exported trees reproduce sklearn's scores")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,109 @@
+#include "fanoutTracker.h"
+#include <iostream>
+#include <cmath>
+#include <arpa/inet.h>
+
+using namespace std;
+
+// Separate seeds keep the port and peer hashes of one key unrelated
+static const uint64_t PORT_SEED = 0x5f0e1d2c3b4a6978ULL;
+static const uint64_t PEER_SEED = 0x1234fedc5678ba90ULL;
+
+static string addrToString(uint32_t addr) {
+    char buf[INET_ADDRSTRLEN];
+    struct in_addr in;
+    in.s_addr = addr;
+    inet_ntop(AF_INET, &in, buf, sizeof(buf));
+    return buf;
+}
+
+FanoutTracker::FanoutTracker(Emitter emitter, double windowSeconds, double portThreshold,
+                             double peerThreshold, size_t maxKeys, size_t maxSketches)
+    : emit(std::move(emitter)), windowSeconds(windowSeconds), portThreshold(portThreshold),
+      peerThreshold(peerThreshold), maxKeys(maxKeys), pool(maxSketches) {
+    sources.name = "src";
+    destinations.name = "dst";
+}
+
+FanoutStats *FanoutTracker::lookup(Role &role, uint32_t addr) {
+    if (uint32_t *slot = role.index.find(addr)) return &role.stats[*slot];
+    if (role.stats.size() >= maxKeys) return nullptr;
+
+    role.index.insert(addr, role.stats.size());
+    role.addrs.push_back(addr);
+    role.stats.emplace_back();
+    return &role.stats.back();
+}
+
+void FanoutTracker::add(const PacketRecord &packet) {
+    int64_t index = static_cast<int64_t>(floor(packet.timestamp / windowSeconds));
+    if (index > windowIndex) {
+        if (windowIndex >= 0) closeWindow();
+        windowIndex = index;
+    }
+
+    bool hasPort = packet.protocol == PacketRecord::TCP || packet.protocol == PacketRecord::UDP;
+    uint64_t portHash = mix64((uint64_t(packet.protocol) << 16 | packet.dstPort) ^ PORT_SEED);
+
+    if (FanoutStats *stats = lookup(sources, packet.srcAddr)) {
+        bool portsChanged = hasPort && stats->ports.add(portHash, pool);
+        bool peersChanged = stats->peers.add(mix64(packet.dstAddr ^ PEER_SEED), pool);
+        check(sources, packet.srcAddr, *stats, portsChanged, peersChanged, packet.timestamp);
+    } else {
+        sources.untracked++;
+    }
+
+    if (FanoutStats *stats = lookup(destinations, packet.dstAddr)) {
+        bool portsChanged = hasPort && stats->ports.add(portHash, pool);
+        bool peersChanged = stats->peers.add(mix64(packet.srcAddr ^ PEER_SEED), pool);
+        check(destinations, packet.dstAddr, *stats, portsChanged, peersChanged, packet.timestamp);
+    } else {
+        destinations.untracked++;
+    }
+}
+
+void FanoutTracker::check(Role &role, uint32_t addr, FanoutStats &stats, bool portsChanged,
+                          bool peersChanged, double timestamp) {
+    // Estimates only move when a register does, so most packets skip this
+    if (portsChanged && !stats.portsFlagged && portThreshold > 0 && stats.ports.estimate() >= portThreshold) {
+        stats.portsFlagged = true;
+        alert(role, addr, "ports", stats.ports, portThreshold, timestamp);
+    }
+    if (peersChanged && !stats.peersFlagged && peerThreshold > 0 && stats.peers.estimate() >= peerThreshold) {
+        stats.peersFlagged = true;
+        alert(role, addr, "peers", stats.peers, peerThreshold, timestamp);
+    }
+}
+
+void FanoutTracker::alert(Role &role, uint32_t addr, const char *metric, const DistinctCount &count,
+                          double threshold, double timestamp) {
+    json record;
+    record["protocol"] = "FANOUT";
+    record["ip"] = addrToString(addr);
+    record["role"] = role.name;
+    record["metric"] = metric;
+    record["estimate"] = lround(count.estimate());
+    record["threshold"] = threshold;
+    record["window_start"] = windowIndex * windowSeconds;
+    record["window_size"] = windowSeconds;
+    record["timestamp"] = timestamp;
+    if (count.saturated()) record["saturated"] = true;
+    emit(record);
+}
+
+void FanoutTracker::closeWindow() {
+    for (Role *role : {&sources, &destinations}) {
+        if (role->untracked > 0) {
+            cerr << "⚠️  Fan-out tracking full: " << role->untracked << " packets of untracked "
+                 << role->name << " addresses in the last window\n";
+        }
+        for (auto &stats : role->stats) {
+            stats.ports.release(pool);
+            stats.peers.release(pool);
+        }
+        role->stats.clear();
+        role->addrs.clear();
+        role->index.clear();
+        role->untracked = 0;
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef FANOUTTRACKER_H
+#define FANOUTTRACKER_H
+
+#include "packetSniffer.h"
+#include "flatTable.h"
+#include "hyperLogLog.h"
+#include <functional>
+
+// Distinct ports and peers per source and per destination address, per
+// tumbling window, in bounded memory. Every tracked address keeps two
+// DistinctCounts, which stay exact for a handful of values and then move to
+// a 1 KB HyperLogLog from a shared pool. A FANOUT alert goes out the moment
+// an estimate crosses its threshold, not when the window closes:
+//   src/ports  one source probing many ports (port scan)
+//   src/peers  one source talking to many hosts (sweep, worm)
+//   dst/ports  many ports of one host being hit (distributed scan)
+//   dst/peers  many sources converging on one host (DDoS)
+
+struct FanoutStats {
+    DistinctCount ports;
+    DistinctCount peers;
+    bool portsFlagged = false;
+    bool peersFlagged = false;
+};
+
+class FanoutTracker {
+public:
+    using Emitter = std::function<void(const json &)>;
+
+    FanoutTracker(Emitter emitter, double windowSeconds = 10, double portThreshold = 100,
+                  double peerThreshold = 100, size_t maxKeys = 16384, size_t maxSketches = 1024);
+
+    void add(const PacketRecord &packet);
+
+private:
+    struct Role {
+        const char *name;
+        FlatTable<uint32_t, uint32_t> index; // address -> stats slot
+        std::vector<uint32_t> addrs;         // slot -> address
+        std::vector<FanoutStats> stats;
+        size_t untracked = 0;                // packets of addresses that did not fit
+    };
+
+    Emitter emit;
+    double windowSeconds;
+    double portThreshold;
+    double peerThreshold;
+    size_t maxKeys;
+    SketchPool pool;
+    Role sources;
+    Role destinations;
+    int64_t windowIndex = -1;
+
+    FanoutStats *lookup(Role &role, uint32_t addr);
+    void check(Role &role, uint32_t addr, FanoutStats &stats, bool portsChanged, bool peersChanged, double timestamp);
+    void alert(Role &role, uint32_t addr, const char *metric, const DistinctCount &count,
+               double threshold, double timestamp);
+    void closeWindow();
+};
+
+#endif // FANOUTTRACKER_H
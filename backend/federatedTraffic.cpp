@@ -0,0 +1,258 @@
+#include "federatedTraffic.h"
+#include <algorithm>
+#include <cmath>
+#include <arpa/inet.h>
+
+using namespace std;
+
+namespace {
+
+bool parseAddr(const json &value, uint32_t &addr) {
+    return value.is_string() && inet_pton(AF_INET, value.get_ref<const string &>().c_str(), &addr) == 1;
+}
+
+bool parseAddr(const json &record, const char *field, uint32_t &addr) {
+    auto value = record.find(field);
+    return value != record.end() && parseAddr(*value, addr);
+}
+
+string addrToString(uint32_t addr) {
+    char buf[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr, buf, sizeof(buf));
+    return buf;
+}
+
+uint64_t number(const json &record, const char *field, uint64_t fallback) {
+    auto value = record.find(field);
+    return value != record.end() && value->is_number() ? value->get<uint64_t>() : fallback;
+}
+
+} // namespace
+
+FederatedTraffic::FederatedTraffic(Emitter emitter, double intervalSeconds, size_t pageEntries)
+    : emitter(std::move(emitter)), intervalSeconds(intervalSeconds), pageEntries(max<size_t>(1, pageEntries)) {}
+
+uint16_t FederatedTraffic::sensorId(const string &sensor) {
+    auto it = sensorIds.find(sensor);
+    if (it != sensorIds.end()) return it->second;
+    uint16_t id = uint16_t(sensorNames.size());
+    sensorNames.push_back(sensor);
+    sensorIds.emplace(sensor, id);
+    return id;
+}
+
+bool FederatedTraffic::add(const json &record, const string &sensor) {
+    auto protocol = record.find("protocol");
+    auto timestamp = record.find("timestamp");
+    if (protocol == record.end() || !protocol->is_string() || timestamp == record.end() || !timestamp->is_number())
+        return true;
+
+    const string &type = protocol->get_ref<const string &>();
+    bool traffic = type == "TRAFFIC";
+    bool page = type == "TRAFFIC_PAGE";
+    bool packet = type == "TCP" || type == "UDP" || type == "ICMP" || type == "Other";
+    if (!traffic && !page && !packet) return true;
+
+    double at = timestamp->get<double>();
+    // A TRAFFIC record is stamped with the end of its interval
+    if (traffic || page) at -= record.value("interval", intervalSeconds) / 2;
+    Interval &interval = intervalFor(int64_t(floor(at / intervalSeconds)));
+
+    uint16_t id = sensorId(sensor);
+    if (traffic || page) {
+        if (interval.fromTraffic.size() <= id) interval.fromTraffic.resize(id + 1, false);
+        interval.fromTraffic[id] = true;
+        auto list = record.find("edges");
+        if (list == record.end() || !list->is_array()) return false;
+        for (const json &edge : *list) {
+            uint32_t src, dst;
+            if (traffic) {
+                if (!parseAddr(edge, "src", src) || !parseAddr(edge, "dst", dst)) continue;
+                count(interval, src, dst, id, true, number(edge, "packets", 0), number(edge, "bytes", 0));
+            } else {
+                // Rows: [src, dst, packets, bytes]
+                if (!edge.is_array() || edge.size() < 4 || !parseAddr(edge[0], src) || !parseAddr(edge[1], dst) ||
+                    !edge[2].is_number() || !edge[3].is_number())
+                    continue;
+                count(interval, src, dst, id, true, edge[2].get<uint64_t>(), edge[3].get<uint64_t>());
+            }
+        }
+        return false;
+    }
+
+    uint32_t src, dst;
+    if (!parseAddr(record, "src_ip", src) || !parseAddr(record, "dst_ip", dst)) return true;
+    // In-kernel flow counts carry several packets; a sampled packet stands for sample_rate
+    uint64_t rate = number(record, "sample_rate", 1);
+    count(interval, src, dst, id, false, number(record, "packets", 1) * rate, number(record, "length", 0) * rate);
+    return true;
+}
+
+FederatedTraffic::Interval &FederatedTraffic::intervalFor(int64_t index) {
+    while (!intervals.empty() && intervals.front().index + 1 < index) {
+        closeInterval(intervals.front());
+        intervals.pop_front();
+    }
+    if (!intervals.empty() && index < intervals.front().index) {
+        late++;
+        return intervals.front();
+    }
+
+    auto position = intervals.end();
+    while (position != intervals.begin() && prev(position)->index >= index) --position;
+    if (position != intervals.end() && position->index == index) return *position;
+    position = intervals.insert(position, Interval());
+    position->index = index;
+    return *position;
+}
+
+void FederatedTraffic::count(Interval &interval, uint32_t src, uint32_t dst, uint16_t sensor, bool fromTraffic,
+                             uint64_t packets, uint64_t bytes) {
+    uint64_t key = uint64_t(src) << 32 | dst;
+    vector<SensorCounts> &bySensor = *interval.edges.insert(key, vector<SensorCounts>()).first;
+
+    auto it = find_if(bySensor.begin(), bySensor.end(), [&](const SensorCounts &s) { return s.sensor == sensor; });
+    if (it == bySensor.end()) {
+        bySensor.push_back(SensorCounts());
+        it = bySensor.end() - 1;
+        it->sensor = sensor;
+    }
+    Counts &counts = fromTraffic ? it->fromTraffic : it->fromPackets;
+    counts.packets += packets;
+    counts.bytes += bytes;
+}
+
+void FederatedTraffic::flush() {
+    for (Interval &interval : intervals) closeInterval(interval);
+    intervals.clear();
+}
+
+void FederatedTraffic::closeInterval(Interval &interval) {
+    auto &edges = interval.edges;
+    Counts total, duplicate;
+    vector<bool> seen(sensorNames.size(), false);
+    vector<pair<uint64_t, Counts>> unified;
+    vector<vector<uint16_t>> edgeSensors;
+    unified.reserve(edges.size());
+    edgeSensors.reserve(edges.size());
+
+    edges.forEach([&](uint64_t key, const vector<SensorCounts> &bySensor) {
+        Counts best;
+        Counts sum;
+        vector<uint16_t> sensors;
+        for (const SensorCounts &s : bySensor) {
+            // Exact counters win over the same sensor's packet records of the interval
+            bool exact = s.sensor < interval.fromTraffic.size() && interval.fromTraffic[s.sensor];
+            const Counts &counts = exact ? s.fromTraffic : s.fromPackets;
+            if (counts.packets == 0) continue;
+            sensors.push_back(s.sensor);
+            seen[s.sensor] = true;
+            sum.packets += counts.packets;
+            sum.bytes += counts.bytes;
+            if (counts.packets > best.packets || (counts.packets == best.packets && counts.bytes > best.bytes))
+                best = counts;
+        }
+        if (best.packets == 0) return;
+        total.packets += best.packets;
+        total.bytes += best.bytes;
+        duplicate.packets += sum.packets - best.packets;
+        duplicate.bytes += sum.bytes - best.bytes;
+        unified.push_back({key, best});
+        edgeSensors.push_back(std::move(sensors));
+    });
+
+    // Quiet interval, nothing to report
+    if (unified.empty()) return;
+    duplicates += duplicate.packets;
+
+    FlatTable<uint32_t, HostCounts> hostTable;
+    for (const auto &[key, counts] : unified) {
+        HostCounts &src = *hostTable.insert(uint32_t(key >> 32), HostCounts()).first;
+        src.packetsOut += counts.packets;
+        src.bytesOut += counts.bytes;
+        HostCounts &dst = *hostTable.insert(uint32_t(key), HostCounts()).first;
+        dst.packetsIn += counts.packets;
+        dst.bytesIn += counts.bytes;
+    }
+
+    // Every host and edge, busiest first by bytes
+    vector<pair<uint32_t, HostCounts>> hosts;
+    hosts.reserve(hostTable.size());
+    hostTable.forEach([&](uint32_t addr, const HostCounts &counts) { hosts.push_back({addr, counts}); });
+    sort(hosts.begin(), hosts.end(), [](const auto &a, const auto &b) {
+        return a.second.bytesIn + a.second.bytesOut > b.second.bytesIn + b.second.bytesOut;
+    });
+
+    vector<size_t> order(unified.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    sort(order.begin(), order.end(),
+         [&](size_t a, size_t b) { return unified[a].second.bytes > unified[b].second.bytes; });
+    auto sensorsOf = [&](size_t edge) {
+        json names = json::array();
+        for (uint16_t sensor : edgeSensors[edge]) names.push_back(sensorNames[sensor]);
+        return names;
+    };
+
+    size_t pages = max<size_t>(1, (max(hosts.size(), order.size()) + pageEntries - 1) / pageEntries);
+    json sensorList = json::array();
+    for (size_t i = 0; i < seen.size(); ++i)
+        if (seen[i]) sensorList.push_back(sensorNames[i]);
+
+    json record;
+    record["protocol"] = "TRAFFIC";
+    record["timestamp"] = (interval.index + 1) * intervalSeconds;
+    record["interval"] = intervalSeconds;
+    record["sensors"] = sensorList;
+    record["packets"] = total.packets;
+    record["bytes"] = total.bytes;
+    record["duplicates"] = {{"packets", duplicate.packets}, {"bytes", duplicate.bytes}};
+    record["pages"] = pages;
+
+    json hostList = json::array();
+    for (size_t i = 0; i < hosts.size() && i < pageEntries; ++i) {
+        const HostCounts &counts = hosts[i].second;
+        hostList.push_back({{"ip", addrToString(hosts[i].first)},
+                            {"packets_in", counts.packetsIn},
+                            {"packets_out", counts.packetsOut},
+                            {"bytes_in", counts.bytesIn},
+                            {"bytes_out", counts.bytesOut}});
+    }
+    json edgeList = json::array();
+    for (size_t i = 0; i < order.size() && i < pageEntries; ++i) {
+        uint64_t key = unified[order[i]].first;
+        edgeList.push_back({{"src", addrToString(uint32_t(key >> 32))},
+                            {"dst", addrToString(uint32_t(key))},
+                            {"packets", unified[order[i]].second.packets},
+                            {"bytes", unified[order[i]].second.bytes},
+                            {"sensors", sensorsOf(order[i])}});
+    }
+    record["hosts"] = hostList;
+    record["edges"] = edgeList;
+    emitter(record);
+
+    // The rest as rows, in the sniffer's TRAFFIC_PAGE layout plus the edges' sensors
+    for (size_t page = 1; page < pages; ++page) {
+        json rest;
+        rest["protocol"] = "TRAFFIC_PAGE";
+        rest["timestamp"] = (interval.index + 1) * intervalSeconds;
+        rest["interval"] = intervalSeconds;
+        rest["page"] = page;
+        rest["pages"] = pages;
+        json hostRows = json::array();
+        for (size_t i = page * pageEntries; i < hosts.size() && i < (page + 1) * pageEntries; ++i) {
+            const HostCounts &counts = hosts[i].second;
+            hostRows.push_back(json::array({addrToString(hosts[i].first), counts.packetsIn, counts.packetsOut,
+                                            counts.bytesIn, counts.bytesOut}));
+        }
+        json edgeRows = json::array();
+        for (size_t i = page * pageEntries; i < order.size() && i < (page + 1) * pageEntries; ++i) {
+            uint64_t key = unified[order[i]].first;
+            edgeRows.push_back(json::array({addrToString(uint32_t(key >> 32)), addrToString(uint32_t(key)),
+                                            unified[order[i]].second.packets, unified[order[i]].second.bytes,
+                                            sensorsOf(order[i])}));
+        }
+        rest["hosts"] = hostRows;
+        rest["edges"] = edgeRows;
+        emitter(rest);
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef FEDERATEDTRAFFIC_H
+#define FEDERATEDTRAFFIC_H
+
+#include "flatTable.h"
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using json = nlohmann::json;
+
+// One TRAFFIC record per interval for the merged streams of several
+// sensors. Every sensor's traffic is counted per directed edge, from its
+// own TRAFFIC and TRAFFIC_PAGE records in the intervals they cover (exact,
+// and the records themselves are replaced by the unified ones) or else
+// from its packet records, weighted by their packet count and sample rate.
+// The choice is made per interval, so packets of a sensor counted before
+// its first TRAFFIC record, or in an interval whose record went missing,
+// still count. Like the sniffer's, the unified record lists every edge and
+// host; past `pageEntries`, the rest follow in TRAFFIC_PAGE rows, edges as
+// [src, dst, packets, bytes, sensors].
+//
+// Sensors whose captures overlap see the same packets, so an edge's
+// counts are not summed across sensors: the edge takes the counts of the
+// sensor that saw the most of it, and what the others saw on top is
+// reported as duplicates. Traffic split between sensors with no overlap
+// (asymmetric routes) is undercounted the same way.
+//
+// Intervals end in the merged stream, one interval late: the first record
+// two intervals on closes one, so a sensor's TRAFFIC record, which is
+// stamped with the end of its interval and follows the first packets of
+// the next, still finds it open. A record of an interval already closed
+// counts in the oldest open one. A sensor's TRAFFIC record belongs to the
+// interval holding its middle, so sensors should use the same interval.
+
+class FederatedTraffic {
+public:
+    using Emitter = std::function<void(const json &)>;
+
+    explicit FederatedTraffic(Emitter emitter, double intervalSeconds = 1, size_t pageEntries = 2000);
+
+    // Merged records in timestamp order. Returns false for the sensors'
+    // TRAFFIC and TRAFFIC_PAGE records, which the unified ones replace.
+    bool add(const json &record, const std::string &sensor);
+    // Close the open intervals
+    void flush();
+
+    uint64_t lateRecords() const { return late; }
+    uint64_t duplicatePackets() const { return duplicates; }
+
+private:
+    struct Counts {
+        uint64_t packets = 0;
+        uint64_t bytes = 0;
+    };
+
+    // One sensor's view of an edge in the open interval
+    struct SensorCounts {
+        uint16_t sensor = 0;
+        Counts fromPackets;
+        Counts fromTraffic;
+    };
+
+    struct HostCounts {
+        uint64_t packetsOut = 0;
+        uint64_t bytesOut = 0;
+        uint64_t packetsIn = 0;
+        uint64_t bytesIn = 0;
+    };
+
+    Emitter emitter;
+    double intervalSeconds;
+    size_t pageEntries; // hosts and edges per record
+
+    std::vector<std::string> sensorNames;
+    std::unordered_map<std::string, uint16_t> sensorIds;
+
+    struct Interval {
+        int64_t index = 0; // start / intervalSeconds
+        // (src << 32 | dst), addresses in network byte order -> counts by sensor
+        FlatTable<uint64_t, std::vector<SensorCounts>> edges;
+        std::vector<bool> fromTraffic; // by sensor: sent TRAFFIC counts for this interval
+    };
+
+    std::deque<Interval> intervals; // open, oldest first
+
+    uint64_t late = 0;
+    uint64_t duplicates = 0;
+
+    uint16_t sensorId(const std::string &sensor);
+    Interval &intervalFor(int64_t index);
+    void count(Interval &interval, uint32_t src, uint32_t dst, uint16_t sensor, bool fromTraffic, uint64_t packets,
+               uint64_t bytes);
+    void closeInterval(Interval &interval);
+};
+
+#endif // FEDERATEDTRAFFIC_H
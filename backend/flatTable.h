@@ -0,0 +1,129 @@
+#ifndef FLATTABLE_H
+#define FLATTABLE_H
+
+#include "hashing.h"
+#include <vector>
+#include <utility>
+
+// Open-addressing hash table with linear probing.
+// Keys and values live next to each other in one array, so a lookup is
+// usually a single cache line. Erase shifts the following entries back
+// instead of leaving tombstones, which keeps probe chains short in tables
+// with constant churn (sketch counters, flow entries).
+
+template <typename Key, typename Value, typename Hash = IntHash>
+class FlatTable {
+public:
+    explicit FlatTable(size_t capacity = 16) { reset(capacity); }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    Value *find(const Key &key) {
+        size_t i = home(key);
+        while (slots[i].used) {
+            if (slots[i].key == key) return &slots[i].value;
+            i = (i + 1) & mask;
+        }
+        return nullptr;
+    }
+
+    // Returns the value for `key`, inserting `value` first if the key is new
+    std::pair<Value *, bool> insert(const Key &key, const Value &value) {
+        if ((count + 1) * 4 > slots.size() * 3) grow();
+
+        size_t i = home(key);
+        while (slots[i].used) {
+            if (slots[i].key == key) return {&slots[i].value, false};
+            i = (i + 1) & mask;
+        }
+        slots[i].used = true;
+        slots[i].key = key;
+        slots[i].value = value;
+        count++;
+        return {&slots[i].value, true};
+    }
+
+    bool erase(const Key &key) {
+        size_t i = home(key);
+        while (slots[i].used) {
+            if (slots[i].key == key) {
+                removeAt(i);
+                return true;
+            }
+            i = (i + 1) & mask;
+        }
+        return false;
+    }
+
+    void clear() {
+        for (auto &slot : slots) slot.used = false;
+        count = 0;
+    }
+
+    template <typename F>
+    void forEach(F &&f) {
+        for (auto &slot : slots)
+            if (slot.used) f(slot.key, slot.value);
+    }
+
+    // Visit every entry; entries for which `f` returns true are erased
+    template <typename F>
+    void eraseIf(F &&f) {
+        for (size_t i = 0; i < slots.size();) {
+            if (slots[i].used && f(slots[i].key, slots[i].value)) {
+                removeAt(i); // the next entry may have moved into i
+            } else {
+                ++i;
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        Key key{};
+        Value value{};
+        bool used = false;
+    };
+
+    std::vector<Slot> slots;
+    size_t mask = 0;
+    size_t count = 0;
+    Hash hasher;
+
+    size_t home(const Key &key) const { return hasher(key) & mask; }
+
+    void reset(size_t capacity) {
+        size_t size = 8;
+        while (size < capacity * 4 / 3 + 1) size <<= 1;
+        slots.assign(size, Slot());
+        mask = size - 1;
+        count = 0;
+    }
+
+    void grow() {
+        std::vector<Slot> old;
+        old.swap(slots);
+        reset(old.size());
+        for (auto &slot : old)
+            if (slot.used) insert(slot.key, slot.value);
+    }
+
+    // Backward-shift deletion: pull later entries of the probe chain into the hole
+    void removeAt(size_t hole) {
+        size_t i = (hole + 1) & mask;
+        while (slots[i].used) {
+            size_t ideal = home(slots[i].key);
+            // Entry at i may move into the hole unless its home lies in (hole, i]
+            if (((i - ideal) & mask) >= ((i - hole) & mask)) {
+                slots[hole] = slots[i];
+                hole = i;
+            }
+            i = (i + 1) & mask;
+        }
+        slots[hole].used = false;
+        count--;
+    }
+};
+
+#endif // FLATTABLE_H
@@ -0,0 +1,240 @@
+#include "flowExporter.h"
+#include "hostPort.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const uint16_t TEMPLATE_ID = 256;
+
+// Information element (IPFIX) or field type (v9) and its length
+struct Field {
+    uint16_t type;
+    uint16_t length;
+};
+
+// RFC 7012 information elements
+const Field IPFIX_FIELDS[] = {
+    {8, 4},   // sourceIPv4Address
+    {12, 4},  // destinationIPv4Address
+    {7, 2},   // sourceTransportPort
+    {11, 2},  // destinationTransportPort
+    {4, 1},   // protocolIdentifier
+    {2, 8},   // packetDeltaCount
+    {1, 8},   // octetDeltaCount
+    {152, 8}, // flowStartMilliseconds
+    {153, 8}, // flowEndMilliseconds
+    {136, 1}, // flowEndReason
+};
+
+// RFC 3954 field types; v9 times are milliseconds of exporter uptime
+const Field V9_FIELDS[] = {
+    {8, 4},  // IPV4_SRC_ADDR
+    {12, 4}, // IPV4_DST_ADDR
+    {7, 2},  // L4_SRC_PORT
+    {11, 2}, // L4_DST_PORT
+    {4, 1},  // PROTOCOL
+    {2, 8},  // IN_PKTS
+    {1, 8},  // IN_BYTES
+    {22, 4}, // FIRST_SWITCHED
+    {21, 4}, // LAST_SWITCHED
+};
+
+void put8(vector<uint8_t> &out, uint8_t value) { out.push_back(value); }
+
+void put16(vector<uint8_t> &out, uint16_t value) {
+    out.push_back(value >> 8);
+    out.push_back(value & 0xff);
+}
+
+void put32(vector<uint8_t> &out, uint32_t value) {
+    put16(out, value >> 16);
+    put16(out, value & 0xffff);
+}
+
+void put64(vector<uint8_t> &out, uint64_t value) {
+    put32(out, uint32_t(value >> 32));
+    put32(out, uint32_t(value));
+}
+
+void set16(vector<uint8_t> &out, size_t at, uint16_t value) {
+    out[at] = value >> 8;
+    out[at + 1] = value & 0xff;
+}
+
+double wallClock() { return chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count(); }
+
+} // namespace
+
+FlowExporter::FlowExporter(Format format, size_t maxDatagram, size_t maxPending, int templateDatagrams,
+                           double templateSeconds, uint32_t domain)
+    : format(format), maxDatagram(maxDatagram), maxPending(max<size_t>(1, maxPending)),
+      templateDatagrams(templateDatagrams), templateSeconds(templateSeconds), domain(domain),
+      startTime(wallClock()) {}
+
+FlowExporter::~FlowExporter() {
+    if (fd >= 0) close(fd);
+}
+
+bool FlowExporter::open(const string &target, string &error) {
+    string host;
+    string port = format == IPFIX ? "4739" : "2055";
+    if (!splitHostPort(target, host, port)) {
+        error = "expected host, host:port or [address]:port";
+        return false;
+    }
+
+    struct addrinfo hints = {}, *result = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    int status = getaddrinfo(host.c_str(), port.c_str(), &hints, &result);
+    if (status != 0) {
+        error = gai_strerror(status);
+        return false;
+    }
+    address.assign(reinterpret_cast<uint8_t *>(result->ai_addr),
+                   reinterpret_cast<uint8_t *>(result->ai_addr) + result->ai_addrlen);
+    int family = result->ai_family;
+    freeaddrinfo(result);
+
+    fd = socket(family, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        error = strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+size_t FlowExporter::recordSize() const {
+    size_t size = 0;
+    if (format == IPFIX) {
+        for (const Field &field : IPFIX_FIELDS) size += field.length;
+    } else {
+        for (const Field &field : V9_FIELDS) size += field.length;
+    }
+    return size;
+}
+
+void FlowExporter::add(const FlowRecord &flow) {
+    // Room for the message header, a template set and the data set header (v9: and its padding)
+    size_t fieldCount = format == IPFIX ? size(IPFIX_FIELDS) : size(V9_FIELDS);
+    size_t overhead = (format == IPFIX ? 16 : 20 + 3) + 8 + 4 * fieldCount + 4;
+    if (overhead + body.size() + recordSize() > maxDatagram) closeDatagram();
+    encode(flow);
+    bodyRecords++;
+    records++;
+}
+
+void FlowExporter::encode(const FlowRecord &flow) {
+    const uint8_t *src = reinterpret_cast<const uint8_t *>(&flow.srcAddr);
+    const uint8_t *dst = reinterpret_cast<const uint8_t *>(&flow.dstAddr);
+    body.insert(body.end(), src, src + 4);
+    body.insert(body.end(), dst, dst + 4);
+    put16(body, flow.srcPort);
+    put16(body, flow.dstPort);
+    put8(body, flow.protocol);
+    put64(body, flow.packets);
+    put64(body, flow.bytes);
+    if (format == IPFIX) {
+        put64(body, uint64_t(flow.start * 1000));
+        put64(body, uint64_t(flow.end * 1000));
+        put8(body, flow.endReason);
+    } else {
+        put32(body, uint32_t(max(0.0, flow.start - startTime) * 1000));
+        put32(body, uint32_t(max(0.0, flow.end - startTime) * 1000));
+    }
+}
+
+void FlowExporter::closeDatagram() {
+    if (bodyRecords == 0) return;
+
+    double now = wallClock();
+    bool withTemplate = sinceTemplate < 0 || sinceTemplate + 1 >= templateDatagrams ||
+                        now - templateTime >= templateSeconds;
+
+    vector<uint8_t> datagram;
+    datagram.reserve(maxDatagram);
+    if (format == IPFIX) {
+        put16(datagram, 10);
+        put16(datagram, 0); // message length, below
+        put32(datagram, uint32_t(now));
+        put32(datagram, sequence);
+        put32(datagram, domain);
+    } else {
+        put16(datagram, 9);
+        put16(datagram, uint16_t(bodyRecords + (withTemplate ? 1 : 0)));
+        put32(datagram, uint32_t((now - startTime) * 1000));
+        put32(datagram, uint32_t(now));
+        put32(datagram, sequence);
+        put32(datagram, domain);
+    }
+
+    if (withTemplate) {
+        const Field *fields = format == IPFIX ? IPFIX_FIELDS : V9_FIELDS;
+        size_t fieldCount = format == IPFIX ? size(IPFIX_FIELDS) : size(V9_FIELDS);
+        put16(datagram, format == IPFIX ? 2 : 0); // template set id
+        put16(datagram, uint16_t(8 + 4 * fieldCount));
+        put16(datagram, TEMPLATE_ID);
+        put16(datagram, uint16_t(fieldCount));
+        for (size_t i = 0; i < fieldCount; ++i) {
+            put16(datagram, fields[i].type);
+            put16(datagram, fields[i].length);
+        }
+        sinceTemplate = 0;
+        templateTime = now;
+    } else {
+        sinceTemplate++;
+    }
+
+    size_t setStart = datagram.size();
+    put16(datagram, TEMPLATE_ID);
+    put16(datagram, 0); // set length, below
+    datagram.insert(datagram.end(), body.begin(), body.end());
+    if (format == NETFLOW_V9)
+        while ((datagram.size() - setStart) % 4) datagram.push_back(0); // v9 flowsets end on 32 bits
+    set16(datagram, setStart + 2, uint16_t(datagram.size() - setStart));
+
+    if (format == IPFIX) {
+        set16(datagram, 2, uint16_t(datagram.size()));
+        sequence += bodyRecords;
+    } else {
+        sequence++;
+    }
+    body.clear();
+    bodyRecords = 0;
+
+    if (pending.size() >= maxPending) {
+        pending.pop_front();
+        dropped++;
+    }
+    pending.push_back(std::move(datagram));
+}
+
+void FlowExporter::flush() {
+    closeDatagram();
+    retry();
+}
+
+void FlowExporter::retry() {
+    while (!pending.empty()) {
+        const vector<uint8_t> &datagram = pending.front();
+        ssize_t n = sendto(fd, datagram.data(), datagram.size(), MSG_DONTWAIT,
+                           reinterpret_cast<const struct sockaddr *>(address.data()), socklen_t(address.size()));
+        // A full socket buffer keeps the rest for the next flush or retry
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)) break;
+        if (n < 0) {
+            dropped++;
+        } else {
+            sent++;
+        }
+        pending.pop_front();
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef FLOWEXPORTER_H
+#define FLOWEXPORTER_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// One direction of a conversation between two flow records of it
+struct FlowRecord {
+    enum EndReason : uint8_t { IDLE_TIMEOUT = 1, ACTIVE_TIMEOUT = 2, END_OF_FLOW = 3, FORCED_END = 4 };
+
+    uint32_t srcAddr = 0; // network byte order
+    uint32_t dstAddr = 0;
+    uint16_t srcPort = 0;
+    uint16_t dstPort = 0;
+    uint8_t protocol = 0; // IANA protocol number
+    uint8_t endReason = IDLE_TIMEOUT;
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    double start = 0; // first and last packet, seconds since the epoch
+    double end = 0;
+};
+
+// Sends flow records to an IPFIX (RFC 7011) or NetFlow v9 (RFC 3954)
+// collector over UDP. Records are packed into datagrams of at most
+// `maxDatagram` bytes under one template, which goes out in the first
+// datagram and again every `templateDatagrams` datagrams or
+// `templateSeconds`, whichever comes first, since a UDP collector may
+// start late or lose it.
+//
+// The socket never blocks: datagrams the kernel will not take right away
+// wait in a queue of at most `maxPending`, and the oldest are dropped when
+// it is full, so a slow or absent collector costs records, never capture
+// time. The queue is retried on every tick, not only when new records end.
+
+class FlowExporter {
+public:
+    enum Format { IPFIX, NETFLOW_V9 };
+
+    explicit FlowExporter(Format format, size_t maxDatagram = 1400, size_t maxPending = 256,
+                          int templateDatagrams = 20, double templateSeconds = 30, uint32_t domain = 1);
+    ~FlowExporter();
+    FlowExporter(const FlowExporter &) = delete;
+    FlowExporter &operator=(const FlowExporter &) = delete;
+
+    // "host", "host:port" or "[address]:port"; the port defaults to 4739
+    // (IPFIX) or 2055 (v9)
+    bool open(const std::string &target, std::string &error);
+
+    void add(const FlowRecord &flow);
+    // Close the datagram being filled and send what the socket takes
+    void flush();
+    // Send the datagrams the socket would not take before
+    void retry();
+
+    uint64_t exportedRecords() const { return records; }
+    uint64_t sentDatagrams() const { return sent; }
+    uint64_t droppedDatagrams() const { return dropped; }
+
+private:
+    Format format;
+    size_t maxDatagram;
+    size_t maxPending;
+    int templateDatagrams;
+    double templateSeconds;
+    uint32_t domain;
+    double startTime;
+
+    int fd = -1;
+    std::vector<uint8_t> address; // sockaddr_in or sockaddr_in6 of the collector
+
+    std::vector<uint8_t> body;         // data records of the datagram being filled
+    uint32_t bodyRecords = 0;
+    std::deque<std::vector<uint8_t>> pending;
+
+    uint32_t sequence = 0;   // IPFIX: data records so far; v9: datagrams so far
+    int sinceTemplate = -1;  // datagrams since the last template, -1 before the first
+    double templateTime = 0;
+    uint64_t records = 0;
+    uint64_t sent = 0;
+    uint64_t dropped = 0;
+
+    size_t recordSize() const;
+    void encode(const FlowRecord &flow);
+    void closeDatagram();
+};
+
+#endif // FLOWEXPORTER_H
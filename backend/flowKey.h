@@ -0,0 +1,39 @@
+#ifndef FLOWKEY_H
+#define FLOWKEY_H
+
+#include "packetSniffer.h"
+#include "hashing.h"
+
+// Address/port pair of a conversation, the same for both directions:
+// endpoint A is the lower address (then port) of the two. Addresses stay in
+// network byte order, like in PacketRecord.
+struct FlowKey {
+    uint32_t addrA = 0;
+    uint32_t addrB = 0;
+    uint16_t portA = 0;
+    uint16_t portB = 0;
+
+    // Key of the packet's flow; `fromA` tells whether endpoint A sent it
+    static FlowKey of(const PacketRecord &packet, bool &fromA) {
+        fromA = packet.srcAddr < packet.dstAddr ||
+                (packet.srcAddr == packet.dstAddr && packet.srcPort <= packet.dstPort);
+        FlowKey key;
+        key.addrA = fromA ? packet.srcAddr : packet.dstAddr;
+        key.addrB = fromA ? packet.dstAddr : packet.srcAddr;
+        key.portA = fromA ? packet.srcPort : packet.dstPort;
+        key.portB = fromA ? packet.dstPort : packet.srcPort;
+        return key;
+    }
+
+    bool operator==(const FlowKey &other) const {
+        return addrA == other.addrA && addrB == other.addrB && portA == other.portA && portB == other.portB;
+    }
+};
+
+struct FlowKeyHash {
+    size_t operator()(const FlowKey &key) const {
+        return hashCombine(uint64_t(key.addrA) << 32 | key.addrB, uint32_t(key.portA) << 16 | key.portB);
+    }
+};
+
+#endif // FLOWKEY_H
@@ -0,0 +1,398 @@
+#include "flowShards.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+
+using namespace std;
+
+static string addrToString(uint32_t addr) {
+    char buf[INET_ADDRSTRLEN];
+    struct in_addr in;
+    in.s_addr = addr;
+    inet_ntop(AF_INET, &in, buf, sizeof(buf));
+    return buf;
+}
+
+FlowShards::FlowShards(Emitter emitter, int shardCount, double tickSeconds, size_t maxEntries, double idleSeconds,
+                       size_t pageEntries)
+    : emit(std::move(emitter)), tickSeconds(tickSeconds), maxEntries(maxEntries),
+      idleTicks(max<int64_t>(1, int64_t(ceil(idleSeconds / tickSeconds)))), pageEntries(max<size_t>(1, pageEntries)),
+      waiting(max(1, shardCount), nullptr) {
+    for (int i = 0; i < max(1, shardCount); ++i) {
+        shards.push_back(make_unique<Shard>());
+        Shard &shard = *shards.back();
+        shard.current = make_unique<Snapshot>();
+        shard.worker = thread(&FlowShards::run, this, ref(shard));
+    }
+}
+
+FlowShards::~FlowShards() {
+    if (!finished) stopWorkers();
+    for (auto &shard : shards) {
+        Snapshot *snapshot;
+        while (shard->snapshots.pop(snapshot)) delete snapshot;
+        for (Snapshot *left : shard->undelivered) delete left;
+    }
+    for (Snapshot *snapshot : waiting) delete snapshot;
+}
+
+void FlowShards::add(const PacketRecord &packet) {
+    int64_t tick = int64_t(floor(packet.timestamp / tickSeconds));
+    if (currentTick < 0) currentTick = tick;
+    if (tick > currentTick) {
+        closeTick(currentTick);
+        currentTick = tick;
+    }
+    // Late packets are counted in the open tick
+
+    Message message;
+    message.key = FlowKey::of(packet, message.fromA);
+    message.protocol = packet.protocol;
+    message.packets = packet.packets;
+    message.length = packet.length;
+    message.tick = currentTick;
+    message.timestamp = packet.timestamp;
+
+    // High bits pick the shard, the shard's tables index with the low ones
+    uint64_t hash = FlowKeyHash()(message.key);
+    push(*shards[(hash >> 32) % shards.size()], message);
+}
+
+void FlowShards::advance(double now) {
+    int64_t tick = int64_t(floor(now / tickSeconds));
+    if (currentTick >= 0 && tick > currentTick) {
+        closeTick(currentTick);
+        currentTick = tick;
+    }
+    collect();
+}
+
+void FlowShards::exportFlows(FlowHandler handler, double activeSeconds) {
+    flowHandler = std::move(handler);
+    this->activeSeconds = activeSeconds;
+}
+
+void FlowShards::finish() {
+    if (finished) return;
+    finished = true;
+    if (currentTick >= 0) {
+        Message marker;
+        marker.kind = Message::FINAL;
+        marker.tick = currentTick;
+        for (auto &shard : shards) push(*shard, marker);
+    }
+    stopWorkers();
+
+    // The workers are gone; the ticks they had no room for go in behind the rest
+    bool moved = true;
+    while (moved) {
+        moved = false;
+        for (auto &shard : shards) {
+            while (!shard->undelivered.empty() && shard->snapshots.push(shard->undelivered.front())) {
+                shard->undelivered.pop_front();
+                moved = true;
+            }
+        }
+        collect();
+    }
+}
+
+void FlowShards::stopWorkers() {
+    Message stop;
+    stop.kind = Message::STOP;
+    for (auto &shard : shards) push(*shard, stop);
+    for (auto &shard : shards) shard->worker.join();
+}
+
+double FlowShards::occupancy() const {
+    double fill = 0;
+    for (const auto &shard : shards)
+        fill = max(fill, double(shard->packets.size()) / shard->packets.capacity());
+    return fill;
+}
+
+void FlowShards::push(Shard &shard, const Message &message) {
+    if (shard.packets.push(message)) return;
+    // The worker is behind; wait for it rather than lose exact counts
+    stalls++;
+    while (!shard.packets.push(message)) this_thread::yield();
+}
+
+void FlowShards::closeTick(int64_t tick) {
+    Message marker;
+    marker.kind = Message::TICK;
+    marker.tick = tick;
+    for (auto &shard : shards) push(*shard, marker);
+    collect();
+}
+
+void FlowShards::collect() {
+    while (true) {
+        for (size_t i = 0; i < shards.size(); ++i)
+            if (!waiting[i] && !shards[i]->snapshots.pop(waiting[i])) return; // some shard is still counting
+        mergeAndEmit();
+    }
+}
+
+void FlowShards::mergeAndEmit() {
+    // Every shard delivers every tick in order, so the waiting snapshots are all of one tick
+    Snapshot &total = *waiting[0];
+    for (size_t i = 1; i < waiting.size(); ++i) {
+        Snapshot &part = *waiting[i];
+        total.packets += part.packets;
+        total.bytes += part.bytes;
+        total.untrackedPackets += part.untrackedPackets;
+        total.untrackedBytes += part.untrackedBytes;
+        total.activeFlows += part.activeFlows;
+        total.newFlows += part.newFlows;
+        total.expired.insert(total.expired.end(), part.expired.begin(), part.expired.end());
+        part.hosts.forEach([&](uint32_t addr, const HostCounts &counts) {
+            HostCounts &sum = *total.hosts.insert(addr, HostCounts()).first;
+            sum.packetsOut += counts.packetsOut;
+            sum.bytesOut += counts.bytesOut;
+            sum.packetsIn += counts.packetsIn;
+            sum.bytesIn += counts.bytesIn;
+        });
+        part.edges.forEach([&](uint64_t edge, const EdgeCounts &counts) {
+            EdgeCounts &sum = *total.edges.insert(edge, EdgeCounts()).first;
+            sum.packets += counts.packets;
+            sum.bytes += counts.bytes;
+        });
+    }
+
+    if (flowHandler && !total.expired.empty()) flowHandler(total.expired);
+
+    if (total.packets == 0) {
+        // Quiet tick, nothing to report
+        for (Snapshot *&snapshot : waiting) {
+            delete snapshot;
+            snapshot = nullptr;
+        }
+        return;
+    }
+
+    // Every tracked host and edge, busiest first by bytes
+    vector<pair<uint32_t, HostCounts>> hosts;
+    hosts.reserve(total.hosts.size());
+    total.hosts.forEach([&](uint32_t addr, const HostCounts &counts) { hosts.push_back({addr, counts}); });
+    sort(hosts.begin(), hosts.end(), [](const auto &a, const auto &b) {
+        return a.second.bytesIn + a.second.bytesOut > b.second.bytesIn + b.second.bytesOut;
+    });
+
+    vector<pair<uint64_t, EdgeCounts>> edges;
+    edges.reserve(total.edges.size());
+    total.edges.forEach([&](uint64_t edge, const EdgeCounts &counts) { edges.push_back({edge, counts}); });
+    sort(edges.begin(), edges.end(), [](const auto &a, const auto &b) { return a.second.bytes > b.second.bytes; });
+
+    // The rest follow in TRAFFIC_PAGE records, so no line grows without bound
+    size_t pages = max<size_t>(1, (max(hosts.size(), edges.size()) + pageEntries - 1) / pageEntries);
+
+    json record;
+    record["protocol"] = "TRAFFIC";
+    record["timestamp"] = (total.tick + 1) * tickSeconds;
+    record["interval"] = tickSeconds;
+    record["shards"] = shards.size();
+    record["packets"] = total.packets;
+    record["bytes"] = total.bytes;
+    record["flows"] = {{"active", total.activeFlows}, {"new", total.newFlows}};
+    record["untracked"] = {{"packets", total.untrackedPackets}, {"bytes", total.untrackedBytes}};
+    record["stalls"] = stalls;
+    record["pages"] = pages;
+
+    json hostList = json::array();
+    for (size_t i = 0; i < hosts.size() && i < pageEntries; ++i) {
+        const HostCounts &counts = hosts[i].second;
+        hostList.push_back({{"ip", addrToString(hosts[i].first)},
+                            {"packets_in", counts.packetsIn},
+                            {"packets_out", counts.packetsOut},
+                            {"bytes_in", counts.bytesIn},
+                            {"bytes_out", counts.bytesOut}});
+    }
+    json edgeList = json::array();
+    for (size_t i = 0; i < edges.size() && i < pageEntries; ++i) {
+        uint64_t edge = edges[i].first;
+        edgeList.push_back({{"src", addrToString(uint32_t(edge >> 32))},
+                            {"dst", addrToString(uint32_t(edge))},
+                            {"packets", edges[i].second.packets},
+                            {"bytes", edges[i].second.bytes}});
+    }
+    record["hosts"] = hostList;
+    record["edges"] = edgeList;
+    emit(record);
+
+    // Further pages list rows instead of objects, which cost a fifth as much to build
+    for (size_t page = 1; page < pages; ++page) {
+        json rest;
+        rest["protocol"] = "TRAFFIC_PAGE";
+        rest["timestamp"] = (total.tick + 1) * tickSeconds;
+        rest["interval"] = tickSeconds;
+        rest["page"] = page;
+        rest["pages"] = pages;
+        json hostRows = json::array();
+        for (size_t i = page * pageEntries; i < hosts.size() && i < (page + 1) * pageEntries; ++i) {
+            const HostCounts &counts = hosts[i].second;
+            hostRows.push_back(json::array({addrToString(hosts[i].first), counts.packetsIn, counts.packetsOut,
+                                            counts.bytesIn, counts.bytesOut}));
+        }
+        json edgeRows = json::array();
+        for (size_t i = page * pageEntries; i < edges.size() && i < (page + 1) * pageEntries; ++i) {
+            uint64_t edge = edges[i].first;
+            edgeRows.push_back(json::array({addrToString(uint32_t(edge >> 32)), addrToString(uint32_t(edge)),
+                                            edges[i].second.packets, edges[i].second.bytes}));
+        }
+        rest["hosts"] = hostRows;
+        rest["edges"] = edgeRows;
+        emit(rest);
+    }
+
+    for (Snapshot *&snapshot : waiting) {
+        delete snapshot;
+        snapshot = nullptr;
+    }
+}
+
+void FlowShards::run(Shard &shard) {
+    // Signals go to the capture thread, which leaves its loop and then
+    // finish()es and joins this one
+    sigset_t signals;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    int idle = 0;
+    Message message;
+    while (true) {
+        // Ticks the capture thread had no room for yet go first, in order
+        while (!shard.undelivered.empty() && shard.snapshots.push(shard.undelivered.front()))
+            shard.undelivered.pop_front();
+
+        if (!shard.packets.pop(message)) {
+            // Yield while traffic may just be pausing, then stop spinning
+            if (++idle < 64) {
+                this_thread::yield();
+            } else {
+                this_thread::sleep_for(chrono::microseconds(100));
+            }
+            continue;
+        }
+        idle = 0;
+
+        if (message.kind == Message::STOP) return;
+        if (message.kind == Message::TICK || message.kind == Message::FINAL) {
+            deliver(shard, message.tick, message.kind == Message::FINAL);
+        } else {
+            count(shard, message);
+        }
+    }
+}
+
+void FlowShards::count(Shard &shard, const Message &message) {
+    Snapshot &snapshot = *shard.current;
+    snapshot.packets += message.packets;
+    snapshot.bytes += message.length;
+
+    uint32_t src = message.fromA ? message.key.addrA : message.key.addrB;
+    uint32_t dst = message.fromA ? message.key.addrB : message.key.addrA;
+    bool untracked = false;
+
+    HostCounts *sender = snapshot.hosts.find(src);
+    if (!sender && snapshot.hosts.size() < maxEntries) sender = snapshot.hosts.insert(src, HostCounts()).first;
+    if (sender) {
+        sender->packetsOut += message.packets;
+        sender->bytesOut += message.length;
+    } else {
+        untracked = true;
+    }
+    HostCounts *receiver = snapshot.hosts.find(dst);
+    if (!receiver && snapshot.hosts.size() < maxEntries) receiver = snapshot.hosts.insert(dst, HostCounts()).first;
+    if (receiver) {
+        receiver->packetsIn += message.packets;
+        receiver->bytesIn += message.length;
+    } else {
+        untracked = true;
+    }
+
+    uint64_t edgeKey = uint64_t(src) << 32 | dst;
+    EdgeCounts *edge = snapshot.edges.find(edgeKey);
+    if (!edge && snapshot.edges.size() < maxEntries) edge = snapshot.edges.insert(edgeKey, EdgeCounts()).first;
+    if (edge) {
+        edge->packets += message.packets;
+        edge->bytes += message.length;
+    } else {
+        untracked = true;
+    }
+
+    if (untracked) {
+        snapshot.untrackedPackets += message.packets;
+        snapshot.untrackedBytes += message.length;
+    }
+
+    // Conversations live across ticks until they go idle
+    Flow *flow = shard.flows.find(message.key);
+    if (flow) {
+        if (flow->lastTick != message.tick) {
+            flow->lastTick = message.tick;
+            snapshot.activeFlows++;
+        }
+    } else if (shard.flows.size() < maxEntries * 4) {
+        flow = shard.flows.insert(message.key, Flow()).first;
+        flow->firstTick = flow->lastTick = message.tick;
+        flow->protocol = message.protocol;
+        snapshot.activeFlows++;
+        snapshot.newFlows++;
+    }
+
+    if (flow && flowHandler) {
+        if (flow->packets[0] + flow->packets[1] == 0) flow->start = message.timestamp;
+        flow->end = max(flow->end, message.timestamp);
+        int side = message.fromA ? 0 : 1;
+        flow->packets[side] += message.packets;
+        flow->bytes[side] += message.length;
+    }
+}
+
+void FlowShards::deliver(Shard &shard, int64_t tick, bool final) {
+    Snapshot *snapshot = shard.current.release();
+    snapshot->tick = tick;
+    shard.current = make_unique<Snapshot>();
+
+    int64_t cutoff = tick - idleTicks;
+    shard.flows.eraseIf([&](const FlowKey &key, Flow &flow) {
+        bool idle = final || flow.lastTick < cutoff;
+        if (flowHandler && flow.packets[0] + flow.packets[1] > 0) {
+            if (idle) {
+                endFlow(*snapshot, key, flow, final ? FlowRecord::FORCED_END : FlowRecord::IDLE_TIMEOUT);
+            } else if (flow.end - flow.start >= activeSeconds) {
+                endFlow(*snapshot, key, flow, FlowRecord::ACTIVE_TIMEOUT);
+            }
+        }
+        return idle;
+    });
+
+    if (!shard.undelivered.empty() || !shard.snapshots.push(snapshot)) shard.undelivered.push_back(snapshot);
+}
+
+void FlowShards::endFlow(Snapshot &snapshot, const FlowKey &key, Flow &flow, uint8_t reason) {
+    static const uint8_t protocolNumbers[] = {IPPROTO_TCP, IPPROTO_UDP, IPPROTO_ICMP, 255}; // 255: not decoded
+    for (int side = 0; side < 2; ++side) {
+        if (flow.packets[side] == 0) continue;
+        FlowRecord record;
+        record.srcAddr = side == 0 ? key.addrA : key.addrB;
+        record.dstAddr = side == 0 ? key.addrB : key.addrA;
+        record.srcPort = side == 0 ? key.portA : key.portB;
+        record.dstPort = side == 0 ? key.portB : key.portA;
+        record.protocol = protocolNumbers[flow.protocol & 3];
+        record.endReason = reason;
+        record.packets = flow.packets[side];
+        record.bytes = flow.bytes[side];
+        record.start = flow.start;
+        record.end = flow.end;
+        snapshot.expired.push_back(record);
+    }
+    flow.packets[0] = flow.packets[1] = 0;
+    flow.bytes[0] = flow.bytes[1] = 0;
+    flow.start = flow.end = 0;
+}
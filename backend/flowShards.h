@@ -0,0 +1,146 @@
+#ifndef FLOWSHARDS_H
+#define FLOWSHARDS_H
+
+#include "packetSniffer.h"
+#include "flatTable.h"
+#include "flowKey.h"
+#include "spscRing.h"
+#include "flowExporter.h"
+#include <functional>
+
+// Exact per-tick traffic counters (per host, per directed edge, per
+// conversation) aggregated on worker threads. Every packet is routed to
+// the shard owning its conversation, picked by a symmetric hash of the
+// FlowKey so both directions land on the same worker, and handed over
+// through that shard's single-producer ring. Each worker alone owns its
+// shard's tables, so no table is ever locked.
+//
+// Ticks are cut in the packet stream: when a packet (or advance()) crosses
+// a tick boundary, a marker goes into every ring behind the packets of the
+// tick, and each worker hands its tick tables back through a second ring
+// when it reaches the marker. Once all shards have delivered a tick, the
+// capture thread sums them (a host or edge can appear in several shards;
+// a conversation in only one) and emits one TRAFFIC record. It lists every
+// host and edge of the tick, busiest first; past `pageEntries` of either,
+// the rest follow in TRAFFIC_PAGE records numbered 1 to pages - 1, as rows:
+// hosts [ip, packets_in, packets_out, bytes_in, bytes_out] and edges
+// [src, dst, packets, bytes].
+//
+// A shard holds at most `maxEntries` hosts and edges per tick; traffic of
+// entries beyond that is still in the totals, under "untracked".
+//
+// With exportFlows(), conversations also keep per-direction packet and byte
+// counts. A worker ends a conversation's record when it goes idle, or after
+// `activeSeconds` while it stays busy, and the records travel back with the
+// tick. Conversations are keyed by addresses and ports alone, so a TCP and
+// a UDP conversation on the same ports share one record.
+
+class FlowShards {
+public:
+    using Emitter = std::function<void(const json &)>;
+    using FlowHandler = std::function<void(const std::vector<FlowRecord> &)>;
+
+    FlowShards(Emitter emitter, int shardCount, double tickSeconds = 1, size_t maxEntries = 16384,
+               double idleSeconds = 60, size_t pageEntries = 2000);
+    ~FlowShards();
+    FlowShards(const FlowShards &) = delete;
+    FlowShards &operator=(const FlowShards &) = delete;
+
+    // Capture thread only
+    void add(const PacketRecord &packet);
+    // Close ticks that ended by `now` even without packets, and emit the finished ones
+    void advance(double now);
+    // Hand every conversation record that ends to `handler`; call before the first add()
+    void exportFlows(FlowHandler handler, double activeSeconds);
+    // Close the open tick, end every conversation record and stop the workers
+    void finish();
+
+    int shardCount() const { return int(shards.size()); }
+    // Largest fill of the packet rings, 0 to 1
+    double occupancy() const;
+
+private:
+    struct Message {
+        enum Kind : uint8_t { PACKET, TICK, FINAL, STOP }; // FINAL: the last tick, ending every conversation
+        Kind kind = PACKET;
+        bool fromA = false; // endpoint A of the key sent the packet
+        uint8_t protocol = 0;
+        uint32_t packets = 0;
+        uint32_t length = 0;
+        FlowKey key;
+        int64_t tick = 0;   // PACKET: the tick it counts in; TICK: the tick that just ended
+        double timestamp = 0;
+    };
+
+    struct HostCounts {
+        uint64_t packetsOut = 0;
+        uint64_t bytesOut = 0;
+        uint64_t packetsIn = 0;
+        uint64_t bytesIn = 0;
+    };
+
+    struct EdgeCounts {
+        uint64_t packets = 0;
+        uint64_t bytes = 0;
+    };
+
+    struct Flow {
+        int64_t firstTick = 0;
+        int64_t lastTick = 0;
+        // Exported flows only: counts since the last record, [0] sent by endpoint A
+        uint8_t protocol = 0;
+        double start = 0;
+        double end = 0;
+        uint64_t packets[2] = {};
+        uint64_t bytes[2] = {};
+    };
+
+    // One shard's counters for one tick, handed from the worker to the capture thread
+    struct Snapshot {
+        int64_t tick = 0;
+        uint64_t packets = 0;
+        uint64_t bytes = 0;
+        uint64_t untrackedPackets = 0;
+        uint64_t untrackedBytes = 0;
+        uint64_t activeFlows = 0;
+        uint64_t newFlows = 0;
+        FlatTable<uint32_t, HostCounts> hosts;
+        FlatTable<uint64_t, EdgeCounts> edges; // src << 32 | dst
+        std::vector<FlowRecord> expired;
+    };
+
+    struct Shard {
+        SpscRing<Message> packets{65536};
+        SpscRing<Snapshot *> snapshots{64};
+        std::thread worker;
+        // Worker-owned from here on
+        std::unique_ptr<Snapshot> current;
+        FlatTable<FlowKey, Flow, FlowKeyHash> flows;
+        std::deque<Snapshot *> undelivered; // finished ticks that did not fit the ring yet
+    };
+
+    Emitter emit;
+    double tickSeconds;
+    size_t maxEntries;
+    int64_t idleTicks;
+    size_t pageEntries; // hosts and edges per record
+    std::vector<std::unique_ptr<Shard>> shards;
+    int64_t currentTick = -1;
+    std::vector<Snapshot *> waiting; // per shard, the oldest tick it has delivered and not yet merged
+    uint64_t stalls = 0;             // pushes that found a ring full and had to wait
+    FlowHandler flowHandler;
+    double activeSeconds = 0;        // read by the workers; set before the first message
+    bool finished = false;
+
+    void push(Shard &shard, const Message &message);
+    void closeTick(int64_t tick);
+    void collect();
+    void mergeAndEmit();
+    void run(Shard &shard);
+    void count(Shard &shard, const Message &message);
+    void deliver(Shard &shard, int64_t tick, bool final);
+    void endFlow(Snapshot &snapshot, const FlowKey &key, Flow &flow, uint8_t reason);
+    void stopWorkers();
+};
+
+#endif // FLOWSHARDS_H
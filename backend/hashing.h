@@ -0,0 +1,31 @@
+#ifndef HASHING_H
+#define HASHING_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Hash helpers for the fixed-size tables and sketches.
+// Keys are small integers (addresses, ports, packed tuples), so a strong
+// 64-bit finalizer is enough and much cheaper than std::hash on strings.
+
+inline uint64_t mix64(uint64_t x) {
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+inline uint64_t hashCombine(uint64_t seed, uint64_t value) {
+    return mix64(seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+}
+
+// Default hasher for integer keys
+struct IntHash {
+    template <typename Key>
+    size_t operator()(const Key &key) const { return mix64(static_cast<uint64_t>(key)); }
+};
+
+#endif // HASHING_H
@@ -0,0 +1,202 @@
+#include "heavyHitters.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <arpa/inet.h>
+
+using namespace std;
+
+static string addrToString(uint32_t addr) {
+    char buf[INET_ADDRSTRLEN];
+    struct in_addr in;
+    in.s_addr = addr;
+    inet_ntop(AF_INET, &in, buf, sizeof(buf));
+    return buf;
+}
+
+template <typename Key>
+SpaceSaving<Key>::SpaceSaving(size_t capacity) : capacity(capacity), index(capacity) {
+    entries.reserve(capacity);
+    heap.reserve(capacity);
+    heapPos.reserve(capacity);
+}
+
+template <typename Key>
+void SpaceSaving<Key>::add(Key key, uint64_t weight) {
+    if (uint32_t *slot = index.find(key)) {
+        entries[*slot].count += weight;
+        siftDown(heapPos[*slot]);
+        return;
+    }
+
+    if (entries.size() < capacity) {
+        uint32_t slot = entries.size();
+        entries.push_back({key, weight, 0});
+        heap.push_back(slot);
+        heapPos.push_back(heap.size() - 1);
+        index.insert(key, slot);
+        siftUp(heap.size() - 1);
+        return;
+    }
+
+    // Take over the smallest counter; its count becomes our error bound
+    uint32_t slot = heap[0];
+    Counter &counter = entries[slot];
+    index.erase(counter.key);
+    counter.key = key;
+    counter.error = counter.count;
+    counter.count += weight;
+    index.insert(key, slot);
+    siftDown(0);
+}
+
+template <typename Key>
+void SpaceSaving<Key>::clear() {
+    entries.clear();
+    heap.clear();
+    heapPos.clear();
+    index.clear();
+}
+
+template <typename Key>
+void SpaceSaving<Key>::swapHeap(size_t a, size_t b) {
+    swap(heap[a], heap[b]);
+    heapPos[heap[a]] = a;
+    heapPos[heap[b]] = b;
+}
+
+template <typename Key>
+void SpaceSaving<Key>::siftUp(size_t pos) {
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (entries[heap[parent]].count <= entries[heap[pos]].count) break;
+        swapHeap(parent, pos);
+        pos = parent;
+    }
+}
+
+template <typename Key>
+void SpaceSaving<Key>::siftDown(size_t pos) {
+    while (true) {
+        size_t smallest = pos;
+        size_t left = 2 * pos + 1, right = left + 1;
+        if (left < heap.size() && entries[heap[left]].count < entries[heap[smallest]].count) smallest = left;
+        if (right < heap.size() && entries[heap[right]].count < entries[heap[smallest]].count) smallest = right;
+        if (smallest == pos) break;
+        swapHeap(pos, smallest);
+        pos = smallest;
+    }
+}
+
+template class SpaceSaving<uint64_t>;
+
+HeavyHitters::HeavyHitters(Emitter emitter, size_t topN, double paneSeconds, int paneCount, size_t capacity)
+    : emit(std::move(emitter)), topN(topN), paneSeconds(paneSeconds), panes(max(1, paneCount)) {
+    for (auto &pane : panes)
+        pane.sketches.assign(DIMENSIONS * 2, SpaceSaving<uint64_t>(capacity));
+}
+
+void HeavyHitters::add(const PacketRecord &packet) {
+    int64_t index = static_cast<int64_t>(floor(packet.timestamp / paneSeconds));
+    if (currentIndex < 0) {
+        currentIndex = index;
+    } else if (index > currentIndex) {
+        publish(currentIndex);
+        currentIndex = index;
+    }
+    // Late packets are counted in the open pane
+
+    Pane &pane = panes[currentIndex % panes.size()];
+    if (pane.index != currentIndex) {
+        for (auto &summary : pane.sketches) summary.clear();
+        pane.index = currentIndex;
+    }
+
+    uint64_t count = packet.packets;
+    uint64_t bytes = packet.length;
+    sketch(pane, SRC, false).add(packet.srcAddr, count);
+    sketch(pane, SRC, true).add(packet.srcAddr, bytes);
+    sketch(pane, DST, false).add(packet.dstAddr, count);
+    sketch(pane, DST, true).add(packet.dstAddr, bytes);
+
+    uint64_t edge = uint64_t(packet.srcAddr) << 32 | packet.dstAddr;
+    sketch(pane, EDGE, false).add(edge, count);
+    sketch(pane, EDGE, true).add(edge, bytes);
+
+    if (packet.protocol == PacketRecord::TCP || packet.protocol == PacketRecord::UDP) {
+        // The lower port of the pair is usually the service, whichever way the packet goes;
+        // flow counts only know the destination port
+        uint16_t service = packet.srcPort ? min(packet.srcPort, packet.dstPort) : packet.dstPort;
+        uint64_t port = uint64_t(packet.protocol) << 16 | service;
+        sketch(pane, PORT, false).add(port, count);
+        sketch(pane, PORT, true).add(port, bytes);
+    }
+}
+
+vector<TopEntry> HeavyHitters::top(Dimension dimension, bool bytes, int64_t lastIndex) {
+    // Merge the summaries of every pane still inside the window
+    FlatTable<uint64_t, TopEntry> merged(panes.size() * 64);
+    int64_t firstIndex = lastIndex - static_cast<int64_t>(panes.size()) + 1;
+
+    for (auto &pane : panes) {
+        if (pane.index < firstIndex || pane.index > lastIndex) continue;
+        for (const auto &counter : sketch(pane, dimension, bytes).counters()) {
+            TopEntry *entry = merged.insert(counter.key, {counter.key, 0, 0}).first;
+            entry->value += counter.count;
+            entry->error += counter.error;
+        }
+    }
+
+    vector<TopEntry> result;
+    result.reserve(merged.size());
+    merged.forEach([&](uint64_t, const TopEntry &entry) { result.push_back(entry); });
+
+    size_t n = min(topN, result.size());
+    partial_sort(result.begin(), result.begin() + n, result.end(),
+                 [](const TopEntry &a, const TopEntry &b) { return a.value > b.value; });
+    result.resize(n);
+    return result;
+}
+
+void HeavyHitters::publish(int64_t lastIndex) {
+    static const char *const PROTOCOL_NAMES[] = {"TCP", "UDP", "ICMP", "Other"};
+    static const char *const DIMENSION_NAMES[] = {"src", "dst", "ports", "edges"};
+
+    json record;
+    record["protocol"] = "TOP_TALKERS";
+    record["timestamp"] = (lastIndex + 1) * paneSeconds;
+    record["window"] = panes.size() * paneSeconds;
+
+    vector<string> topDestinations;
+
+    for (int d = 0; d < DIMENSIONS; ++d) {
+        Dimension dimension = static_cast<Dimension>(d);
+        json byMetric;
+
+        for (bool bytes : {false, true}) {
+            json entries = json::array();
+            for (const auto &entry : top(dimension, bytes, lastIndex)) {
+                json item;
+                if (dimension == EDGE) {
+                    item["src"] = addrToString(entry.key >> 32);
+                    item["dst"] = addrToString(entry.key & 0xFFFFFFFF);
+                } else if (dimension == PORT) {
+                    item["proto"] = PROTOCOL_NAMES[(entry.key >> 16) & 0x3];
+                    item["port"] = entry.key & 0xFFFF;
+                } else {
+                    item["ip"] = addrToString(entry.key);
+                }
+                item["value"] = entry.value;
+                if (entry.error) item["error"] = entry.error;
+                entries.push_back(item);
+
+                if (dimension == DST && !bytes) topDestinations.push_back(item["ip"]);
+            }
+            byMetric[bytes ? "bytes" : "packets"] = entries;
+        }
+        record[DIMENSION_NAMES[d]] = byMetric;
+    }
+
+    emit(record);
+    if (onTopDestinations) onTopDestinations(topDestinations);
+}
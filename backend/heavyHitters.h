@@ -0,0 +1,87 @@
+#ifndef HEAVYHITTERS_H
+#define HEAVYHITTERS_H
+
+#include "packetSniffer.h"
+#include "flatTable.h"
+#include <functional>
+
+// Top talkers over the last minute with fixed memory.
+// Each key space (source, destination, port, edge) and metric (packets,
+// bytes) has a Space-Saving summary per time pane. A summary holds a fixed
+// number of counters; a new key takes over the smallest one, so heavy keys
+// are never lost and the overestimate is bounded by the evicted count.
+// At every pane boundary the panes of the window are merged and the top N
+// keys are published.
+
+// Space-Saving summary over integer keys
+template <typename Key>
+class SpaceSaving {
+public:
+    struct Counter {
+        Key key{};
+        uint64_t count = 0;
+        uint64_t error = 0; // count inherited from the evicted key, upper bound of the overestimate
+    };
+
+    explicit SpaceSaving(size_t capacity = 256);
+
+    void add(Key key, uint64_t weight);
+    void clear();
+    const std::vector<Counter> &counters() const { return entries; }
+
+private:
+    size_t capacity;
+    std::vector<Counter> entries;
+    std::vector<uint32_t> heap;     // counter indices, min-heap on count
+    std::vector<uint32_t> heapPos;  // counter index -> position in heap
+    FlatTable<Key, uint32_t> index; // key -> counter index
+
+    void siftUp(size_t pos);
+    void siftDown(size_t pos);
+    void swapHeap(size_t a, size_t b);
+};
+
+struct TopEntry {
+    uint64_t key;
+    uint64_t value;
+    uint64_t error;
+};
+
+class HeavyHitters {
+public:
+    using Emitter = std::function<void(const json &)>;
+    // Top destinations by packets, strongest first, after every publish
+    using TopDestinations = std::function<void(const std::vector<std::string> &)>;
+
+    HeavyHitters(Emitter emitter, size_t topN = 10, double paneSeconds = 5, int panes = 12,
+                 size_t capacity = 256);
+
+    void setTopDestinationsCallback(TopDestinations callback) { onTopDestinations = std::move(callback); }
+
+    void add(const PacketRecord &packet);
+
+private:
+    // Key spaces; each is tracked by packets and by bytes
+    enum Dimension { SRC = 0, DST, PORT, EDGE, DIMENSIONS };
+
+    struct Pane {
+        int64_t index = -1;
+        std::vector<SpaceSaving<uint64_t>> sketches; // DIMENSIONS * 2, packets then bytes
+    };
+
+    Emitter emit;
+    TopDestinations onTopDestinations;
+    size_t topN;
+    double paneSeconds;
+    std::vector<Pane> panes; // ring, pane i lives at i % panes.size()
+    int64_t currentIndex = -1;
+
+    SpaceSaving<uint64_t> &sketch(Pane &pane, Dimension dimension, bool bytes) {
+        return pane.sketches[dimension * 2 + (bytes ? 1 : 0)];
+    }
+
+    void publish(int64_t lastIndex);
+    std::vector<TopEntry> top(Dimension dimension, bool bytes, int64_t lastIndex);
+};
+
+#endif // HEAVYHITTERS_H
@@ -0,0 +1,102 @@
+#include "histogram.h"
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+Histogram::Histogram() {
+    for (auto &count : counts) count.store(0, memory_order_relaxed);
+}
+
+int Histogram::bucketOf(uint64_t value) {
+    if (value < SUB_BUCKETS) return static_cast<int>(value);
+
+    int exponent = 63 - __builtin_clzll(value);
+    if (exponent >= MAX_EXPONENT) return BUCKETS - 1;
+
+    int sub = static_cast<int>(value >> (exponent - SUB_BITS)) - SUB_BUCKETS;
+    return (exponent - SUB_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t Histogram::lowerBound(int bucket) {
+    if (bucket < SUB_BUCKETS) return bucket;
+    int exponent = bucket / SUB_BUCKETS + SUB_BITS - 1;
+    uint64_t sub = bucket % SUB_BUCKETS;
+    return (SUB_BUCKETS + sub) << (exponent - SUB_BITS);
+}
+
+uint64_t Histogram::upperBound(int bucket) {
+    if (bucket < SUB_BUCKETS) return bucket;
+    int exponent = bucket / SUB_BUCKETS + SUB_BITS - 1;
+    return lowerBound(bucket) + (uint64_t(1) << (exponent - SUB_BITS)) - 1;
+}
+
+void Histogram::merge(const Histogram &other) {
+    for (int i = 0; i < BUCKETS; ++i) {
+        uint64_t count = other.counts[i].load(memory_order_relaxed);
+        if (count) counts[i].fetch_add(count, memory_order_relaxed);
+    }
+}
+
+HistogramSnapshot Histogram::snapshot() const {
+    HistogramSnapshot result;
+    for (int i = 0; i < BUCKETS; ++i) result.counts[i] = counts[i].load(memory_order_relaxed);
+    return result;
+}
+
+HistogramSnapshot Histogram::snapshotAndReset() {
+    HistogramSnapshot result;
+    for (int i = 0; i < BUCKETS; ++i) result.counts[i] = counts[i].exchange(0, memory_order_relaxed);
+    return result;
+}
+
+uint64_t HistogramSnapshot::total() const {
+    uint64_t sum = 0;
+    for (uint64_t count : counts) sum += count;
+    return sum;
+}
+
+// Values inside a bucket are reported as its midpoint
+static double bucketValue(int bucket) {
+    return (Histogram::lowerBound(bucket) + Histogram::upperBound(bucket)) / 2.0;
+}
+
+double HistogramSnapshot::percentile(double q) const {
+    uint64_t n = total();
+    if (n == 0) return 0;
+
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(ceil(q * n)));
+    uint64_t seen = 0;
+    for (int i = 0; i < Histogram::BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) return bucketValue(i);
+    }
+    return bucketValue(Histogram::BUCKETS - 1);
+}
+
+double HistogramSnapshot::mean() const {
+    double sum = 0;
+    uint64_t n = 0;
+    for (int i = 0; i < Histogram::BUCKETS; ++i) {
+        if (!counts[i]) continue;
+        sum += counts[i] * bucketValue(i);
+        n += counts[i];
+    }
+    return n ? sum / n : 0;
+}
+
+uint64_t HistogramSnapshot::min() const {
+    for (int i = 0; i < Histogram::BUCKETS; ++i)
+        if (counts[i]) return Histogram::lowerBound(i);
+    return 0;
+}
+
+uint64_t HistogramSnapshot::max() const {
+    for (int i = Histogram::BUCKETS - 1; i >= 0; --i)
+        if (counts[i]) return Histogram::upperBound(i);
+    return 0;
+}
+
+void HistogramSnapshot::merge(const HistogramSnapshot &other) {
+    for (int i = 0; i < Histogram::BUCKETS; ++i) counts[i] += other.counts[i];
+}
@@ -0,0 +1,57 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Log-linear (HDR style) histogram of non-negative integer values.
+// Every power of two is split into 2^SUB_BITS equal buckets, so any
+// recorded value is known to within 1/16 (6.25%) of itself, from 0 up to
+// 2^MAX_EXPONENT, in under 600 buckets. Buckets are relaxed atomics: one
+// thread can record while another snapshots, and histograms filled by
+// different threads merge by adding bucket counts.
+
+class HistogramSnapshot;
+
+class Histogram {
+public:
+    static const int SUB_BITS = 4;
+    static const int MAX_EXPONENT = 40; // larger values land in the last bucket
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int BUCKETS = (MAX_EXPONENT - SUB_BITS + 1) * SUB_BUCKETS;
+
+    Histogram();
+
+    void record(uint64_t value, uint64_t count = 1) {
+        counts[bucketOf(value)].fetch_add(count, std::memory_order_relaxed);
+    }
+    void merge(const Histogram &other);
+
+    HistogramSnapshot snapshot() const;
+    HistogramSnapshot snapshotAndReset(); // counts since the previous reset
+
+    static int bucketOf(uint64_t value);
+    static uint64_t lowerBound(int bucket);
+    static uint64_t upperBound(int bucket); // inclusive
+
+private:
+    std::atomic<uint64_t> counts[BUCKETS];
+};
+
+// Plain copy of a histogram's buckets for percentile queries
+class HistogramSnapshot {
+public:
+    std::vector<uint64_t> counts = std::vector<uint64_t>(Histogram::BUCKETS, 0);
+
+    uint64_t total() const;
+    // Smallest value v such that a fraction q of the recorded values is <= v
+    // (to bucket precision); 0 when empty
+    double percentile(double q) const;
+    double mean() const;
+    uint64_t min() const;
+    uint64_t max() const;
+    void merge(const HistogramSnapshot &other);
+};
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,33 @@
+#ifndef HOSTPORT_H
+#define HOSTPORT_H
+
+#include <string>
+
+// Splits a "host", "host:port", "[address]" or "[address]:port" target.
+// An IPv6 address needs the brackets to carry a port; without them its
+// colons are its own and the whole target is the host. `port` is left as
+// it is when the target has none, so callers set the default first.
+// Returns false for an empty host or a malformed bracket.
+inline bool splitHostPort(const std::string &target, std::string &host, std::string &port) {
+    if (!target.empty() && target[0] == '[') {
+        size_t close = target.find(']');
+        if (close == std::string::npos) return false;
+        host = target.substr(1, close - 1);
+        if (close + 1 < target.size()) {
+            if (target[close + 1] != ':' || close + 2 == target.size()) return false;
+            port = target.substr(close + 2);
+        }
+        return !host.empty();
+    }
+
+    size_t colon = target.find(':');
+    if (colon != std::string::npos && target.find(':', colon + 1) == std::string::npos) {
+        host = target.substr(0, colon);
+        port = target.substr(colon + 1);
+        return !host.empty() && !port.empty();
+    }
+    host = target;
+    return !host.empty();
+}
+
+#endif // HOSTPORT_H
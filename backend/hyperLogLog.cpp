@@ -0,0 +1,94 @@
+#include "hyperLogLog.h"
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+HyperLogLog::HyperLogLog(int precision)
+    : bits(min(max(precision, 4), 16)), registers(size_t(1) << bits, 0) {}
+
+bool HyperLogLog::add(uint64_t hash) {
+    size_t index = hash >> (64 - bits);
+    uint64_t rest = hash << bits;
+    uint8_t rank = rest ? __builtin_clzll(rest) + 1 : 64 - bits + 1;
+    if (rank <= registers[index]) return false;
+    registers[index] = rank;
+    return true;
+}
+
+double HyperLogLog::estimate() const {
+    double m = registers.size();
+    double sum = 0;
+    size_t zeros = 0;
+    for (uint8_t value : registers) {
+        sum += ldexp(1.0, -value);
+        if (value == 0) zeros++;
+    }
+
+    double alpha = 0.7213 / (1 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+    // Linear counting is more accurate while many registers are still empty
+    if (estimate <= 2.5 * m && zeros > 0) estimate = m * log(m / zeros);
+    return estimate;
+}
+
+void HyperLogLog::merge(const HyperLogLog &other) {
+    if (other.bits != bits) return;
+    for (size_t i = 0; i < registers.size(); ++i)
+        registers[i] = max(registers[i], other.registers[i]);
+}
+
+void HyperLogLog::clear() {
+    fill(registers.begin(), registers.end(), 0);
+}
+
+unique_ptr<HyperLogLog> SketchPool::take() {
+    if (live >= limit) return nullptr;
+    live++;
+    if (spare.empty()) return make_unique<HyperLogLog>(precision);
+
+    unique_ptr<HyperLogLog> sketch = std::move(spare.back());
+    spare.pop_back();
+    return sketch;
+}
+
+void SketchPool::give(unique_ptr<HyperLogLog> sketch) {
+    if (!sketch) return;
+    sketch->clear();
+    spare.push_back(std::move(sketch));
+    live--;
+}
+
+bool DistinctCount::add(uint64_t hash, SketchPool &pool) {
+    if (sketch) return sketch->add(hash);
+
+    for (int i = 0; i < smallCount; ++i)
+        if (small[i] == hash) return false;
+
+    if (smallCount < SMALL_LIMIT) {
+        small[smallCount++] = hash;
+        return true;
+    }
+    if (!promote(pool)) {
+        full = true;
+        return false;
+    }
+    return sketch->add(hash);
+}
+
+double DistinctCount::estimate() const {
+    return sketch ? sketch->estimate() : smallCount;
+}
+
+bool DistinctCount::promote(SketchPool &pool) {
+    sketch = pool.take();
+    if (!sketch) return false;
+    for (int i = 0; i < smallCount; ++i) sketch->add(small[i]);
+    return true;
+}
+
+void DistinctCount::release(SketchPool &pool) {
+    pool.give(std::move(sketch));
+    smallCount = 0;
+    full = false;
+}
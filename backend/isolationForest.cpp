@@ -0,0 +1,155 @@
+#include "isolationForest.h"
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace std;
+
+static const char MAGIC[4] = {'N', 'V', 'I', 'F'};
+static const uint16_t VERSION = 1;
+
+namespace {
+
+// Bounds-checked cursor over the file contents (little endian, like the exporter)
+struct Reader {
+    const vector<char> &data;
+    size_t pos = 0;
+
+    bool bytes(void *out, size_t size) {
+        if (size > data.size() - pos) return false;
+        memcpy(out, data.data() + pos, size);
+        pos += size;
+        return true;
+    }
+
+    template <typename T>
+    bool value(T &out) { return bytes(&out, sizeof(T)); }
+
+    template <typename T>
+    bool array(vector<T> &out, size_t count) {
+        if (count > (data.size() - pos) / sizeof(T)) return false;
+        out.resize(count);
+        return bytes(out.data(), count * sizeof(T));
+    }
+};
+
+} // namespace
+
+bool IsolationForest::load(const string &path) {
+    ifstream file(path, ios::binary);
+    if (!file.is_open()) {
+        cerr << "⚠️  Could not open anomaly model " << path << "\n";
+        return false;
+    }
+    vector<char> data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    Reader in{data};
+
+    auto fail = [&](const char *reason) {
+        cerr << "⚠️  Anomaly model " << path << ": " << reason << "\n";
+        names.clear();
+        trees.clear();
+        return false;
+    };
+
+    char magic[4];
+    uint16_t version, featureTotal;
+    uint32_t treeTotal;
+    if (!in.bytes(magic, sizeof(magic)) || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+        return fail("not an exported isolation forest (run export_model.py)");
+    if (!in.value(version) || version != VERSION) return fail("unsupported format version");
+    if (!in.value(featureTotal) || !in.value(treeTotal) || !in.value(pathNorm) || !in.value(offset))
+        return fail("truncated header");
+    if (featureTotal == 0 || treeTotal == 0 || !(pathNorm > 0)) return fail("empty model");
+
+    names.clear();
+    for (uint16_t i = 0; i < featureTotal; ++i) {
+        uint8_t length;
+        string name;
+        if (!in.value(length)) return fail("truncated feature names");
+        name.resize(length);
+        if (!in.bytes(&name[0], length)) return fail("truncated feature names");
+        names.push_back(name);
+    }
+    if (!in.array(center, featureTotal) || !in.array(scale, featureTotal)) return fail("truncated scaler");
+    for (double &s : scale)
+        if (s == 0) s = 1; // RobustScaler leaves constant features unscaled
+
+    trees.clear();
+    feature.clear();
+    threshold.clear();
+    child.clear();
+    leafDepth.clear();
+
+    vector<uint16_t> treeFeature;
+    vector<float> treeThreshold, treeLeafDepth;
+    vector<uint32_t> treeChild;
+    for (uint32_t t = 0; t < treeTotal; ++t) {
+        uint32_t nodes;
+        uint16_t depth;
+        if (!in.value(nodes) || !in.value(depth) || nodes == 0) return fail("truncated tree");
+        if (!in.array(treeFeature, nodes) || !in.array(treeThreshold, nodes) ||
+            !in.array(treeChild, nodes) || !in.array(treeLeafDepth, nodes))
+            return fail("truncated tree");
+
+        // Every step has to stay inside this tree, whatever the input
+        uint32_t base = feature.size();
+        for (uint32_t n = 0; n < nodes; ++n) {
+            bool leaf = treeThreshold[n] == numeric_limits<float>::infinity();
+            if (treeFeature[n] >= featureTotal) return fail("split on an unknown feature");
+            if (leaf ? treeChild[n] != n : treeChild[n] + 1 >= nodes || treeChild[n] <= n)
+                return fail("corrupt node links");
+            treeChild[n] += base;
+        }
+
+        trees.push_back({base, depth});
+        feature.insert(feature.end(), treeFeature.begin(), treeFeature.end());
+        threshold.insert(threshold.end(), treeThreshold.begin(), treeThreshold.end());
+        child.insert(child.end(), treeChild.begin(), treeChild.end());
+        leafDepth.insert(leafDepth.end(), treeLeafDepth.begin(), treeLeafDepth.end());
+    }
+    if (in.pos != data.size()) return fail("trailing data");
+
+    return true;
+}
+
+void IsolationForest::score(const double *rows, size_t count, double *scores) const {
+    size_t features = featureCount();
+    vector<float> block(features * BLOCK, 0.0f); // feature-major: block[f * BLOCK + sample]
+
+    for (size_t first = 0; first < count; first += BLOCK) {
+        size_t n = min<size_t>(BLOCK, count - first);
+        for (size_t s = 0; s < n; ++s) {
+            const double *row = rows + (first + s) * features;
+            // Scale in double like sklearn, then compare in float like its trees
+            for (size_t f = 0; f < features; ++f)
+                block[f * BLOCK + s] = static_cast<float>((row[f] - center[f]) / scale[f]);
+        }
+        scoreBlock(block.data(), scores + first, n);
+    }
+}
+
+void IsolationForest::scoreBlock(const float *block, double *scores, size_t count) const {
+    const uint16_t *nodeFeature = feature.data();
+    const float *nodeThreshold = threshold.data();
+    const uint32_t *nodeChild = child.data();
+
+    double depths[BLOCK] = {};
+    for (const Tree &tree : trees) {
+        uint32_t node[BLOCK];
+        for (int s = 0; s < BLOCK; ++s) node[s] = tree.root;
+
+        for (int d = 0; d < tree.depth; ++d) {
+            for (int s = 0; s < BLOCK; ++s) {
+                uint32_t n = node[s];
+                node[s] = nodeChild[n] + (block[nodeFeature[n] * BLOCK + s] > nodeThreshold[n]);
+            }
+        }
+        for (int s = 0; s < BLOCK; ++s) depths[s] += leafDepth[node[s]];
+    }
+
+    double norm = trees.size() * pathNorm;
+    for (size_t s = 0; s < count; ++s) scores[s] = -exp2(-depths[s] / norm);
+}
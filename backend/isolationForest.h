@@ -0,0 +1,55 @@
+#ifndef ISOLATIONFOREST_H
+#define ISOLATIONFOREST_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Native scorer for the isolation forest trained by train_model.py, read
+// from the flat file written by export_model.py. The nodes of all trees
+// share structure-of-arrays tables laid out breadth first: the two children
+// of a node are adjacent and leaves point at themselves. Samples are scored
+// BLOCK at a time; the block walks each tree in lockstep for the tree's
+// depth with next = child + (x > threshold), a branch-free loop the compiler
+// can turn into gathers and compares across the samples of the block.
+
+class IsolationForest {
+public:
+    static const int BLOCK = 8;
+
+    // False, with the reason on stderr, if the file is missing or malformed
+    bool load(const std::string &path);
+
+    size_t featureCount() const { return names.size(); }
+    const std::vector<std::string> &featureNames() const { return names; }
+    size_t treeCount() const { return trees.size(); }
+
+    // rows: `count` samples of featureCount() raw (unscaled) values in model order.
+    // Writes sklearn's score_samples(): the lower, the more abnormal.
+    void score(const double *rows, size_t count, double *scores) const;
+    // sklearn's decision_function(): negative for outliers
+    double decision(double score) const { return score - offset; }
+
+private:
+    struct Tree {
+        uint32_t root;
+        uint16_t depth;
+    };
+
+    std::vector<std::string> names;
+    std::vector<double> center; // RobustScaler
+    std::vector<double> scale;
+    double pathNorm = 1;        // average path length for the training sample size
+    double offset = 0;
+    std::vector<Tree> trees;
+
+    // Node tables of all trees
+    std::vector<uint16_t> feature;
+    std::vector<float> threshold;  // +inf at leaves
+    std::vector<uint32_t> child;   // left child, right is child + 1; leaves point to themselves
+    std::vector<float> leafDepth;  // depth plus expected remaining path length
+
+    void scoreBlock(const float *block, double *scores, size_t count) const;
+};
+
+#endif // ISOLATIONFOREST_H
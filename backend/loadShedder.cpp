@@ -0,0 +1,62 @@
+#include "loadShedder.h"
+#include <algorithm>
+
+using namespace std;
+
+LoadShedder::LoadShedder(Emitter emitter, uint32_t maxRate, double high, double low, double windowSeconds,
+                         double holdSeconds)
+    : emit(std::move(emitter)), maxLevel(0), high(high), low(low), windowSeconds(windowSeconds),
+      holdSeconds(holdSeconds) {
+    while (maxLevel < 31 && (2u << maxLevel) <= maxRate) maxLevel++;
+}
+
+void LoadShedder::update(double now, double ringOccupancy, uint64_t kernelDrops) {
+    if (windowStart < 0) {
+        windowStart = now;
+        busySeconds = 0;
+        drops = kernelDrops;
+        return;
+    }
+
+    double elapsed = now - windowStart;
+    double current = max(elapsed > 0 ? busySeconds / elapsed : 0, ringOccupancy);
+    // Drops mean the kernel ring already overflowed, whatever the estimate says
+    uint64_t newDrops = kernelDrops > drops ? kernelDrops - drops : 0;
+    if (newDrops > 0) current = 1;
+    drops = kernelDrops;
+    windowStart = now;
+    busySeconds = 0;
+
+    // Up fast on a real spike, down only after a calm spell
+    load = current > load ? current : 0.5 * load + 0.5 * current;
+    if (load > high) {
+        calmSince = -1;
+        if (level <= maxLevel) setLevel(level + 1, now, ringOccupancy, newDrops);
+    } else if (load < low && level > 0) {
+        if (calmSince < 0) calmSince = now;
+        if (now - calmSince >= holdSeconds) {
+            calmSince = now;
+            setLevel(level - 1, now, ringOccupancy, newDrops);
+        }
+    } else {
+        calmSince = -1;
+    }
+}
+
+void LoadShedder::setLevel(int newLevel, double now, double ringOccupancy, uint64_t newDrops) {
+    level = newLevel;
+    skip = 1;
+
+    const char *names[] = {"full", "sampled", "counters"};
+    json record;
+    record["protocol"] = "SAMPLING";
+    record["timestamp"] = now;
+    record["mode"] = names[mode()];
+    record["sample_rate"] = rate();
+    record["load"] = load;
+    record["ring_occupancy"] = ringOccupancy;
+    record["kernel_drops"] = newDrops;
+    record["shed"] = shed;
+    emit(record);
+    shed = 0;
+}
@@ -0,0 +1,82 @@
+#ifndef LOADSHEDDER_H
+#define LOADSHEDDER_H
+
+#include "packetSniffer.h"
+#include <functional>
+
+// Controlled sampling in place of random kernel drops. The capture thread
+// reports the time it spends on frames, and once per window the shedder
+// turns that into a load (busy time over wall time) next to the fill of the
+// counter shards' rings; any new kernel drop counts as full load. The
+// smoothed load moves a level up or down:
+//
+//   level 0         full: every packet gets a record and runs every stage
+//   level 1 .. k    sampled: 1 in 2, 4 ... maxRate packets does, chosen
+//                   with random gaps so periodic traffic is not aliased
+//   level k + 1     counters only: no per-packet records at all
+//
+// Going up takes one window above `high`; going down needs `holdSeconds`
+// below `low`, so the levels do not flap. The sharded counters, the rules,
+// fan-out, TCP metrics, TLS, DNS and prefix tagging see every packet in
+// every mode, which keeps the TRAFFIC totals exact and their records as
+// they would be unsampled. Each level change is announced in a SAMPLING
+// record.
+
+class LoadShedder {
+public:
+    using Emitter = std::function<void(const json &)>;
+    enum Mode { FULL, SAMPLED, COUNTERS };
+
+    LoadShedder(Emitter emitter, uint32_t maxRate = 256, double high = 0.8, double low = 0.4,
+                double windowSeconds = 0.1, double holdSeconds = 2);
+
+    // Capture thread: seconds just spent on frames
+    void busy(double seconds) { busySeconds += seconds; }
+    // Whether a window has ended by `now` and update() should run
+    bool due(double now) const { return now - windowStart >= windowSeconds; }
+    // Close the window: ring fill 0 to 1, total kernel drops so far
+    void update(double now, double ringOccupancy, uint64_t kernelDrops);
+
+    // Per packet: whether it gets a full record; it then stands for rate() packets
+    bool sample() {
+        if (level == 0) return true;
+        if (level > maxLevel || --skip > 0) {
+            shed++;
+            return false;
+        }
+        skip = 1 + uint32_t(nextRandom() % (2 * uint64_t(rate()) - 1)); // gaps average rate()
+        return true;
+    }
+
+    Mode mode() const { return level == 0 ? FULL : level > maxLevel ? COUNTERS : SAMPLED; }
+    // Packets per record; 0 when no records are made
+    uint32_t rate() const { return level > maxLevel ? 0 : 1u << level; }
+
+private:
+    Emitter emit;
+    int maxLevel;
+    double high;
+    double low;
+    double windowSeconds;
+    double holdSeconds;
+
+    int level = 0;
+    uint32_t skip = 1;
+    uint64_t random = 0x9e3779b97f4a7c15ULL;
+    double windowStart = -1;
+    double busySeconds = 0;
+    double load = 0;       // smoothed over windows
+    double calmSince = -1; // since when the load has stayed below `low`
+    uint64_t drops = 0;    // kernel drops at the last window
+    uint64_t shed = 0;     // packets without a record since the last SAMPLING record
+
+    uint64_t nextRandom() {
+        random ^= random << 13;
+        random ^= random >> 7;
+        random ^= random << 17;
+        return random;
+    }
+    void setLevel(int newLevel, double now, double ringOccupancy, uint64_t newDrops);
+};
+
+#endif // LOADSHEDDER_H
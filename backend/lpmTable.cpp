@@ -0,0 +1,357 @@
+#include "lpmTable.h"
+#include "hashing.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static const char IMAGE_MAGIC[8] = {'N', 'V', 'L', 'P', 'M', 'I', 'M', 'G'};
+static const uint32_t IMAGE_VERSION = 1;
+static const size_t ROOT_SLOTS = 65536;
+static const size_t CHUNK_SLOTS = 256;
+static const uint32_t MAX_NODES = 1u << 31; // node references are 31 bits
+
+struct LpmTable::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t nodeCount;
+    uint32_t valueCount;
+    uint32_t tagCount;
+    uint32_t stringBytes;
+    uint32_t unused;
+    int64_t sourceMtime;
+    uint64_t sourceSize;
+    // Followed by root4[ROOT_SLOTS], root6[ROOT_SLOTS], nodes[nodeCount],
+    // values[valueCount], tags[tagCount] and stringBytes of NUL-terminated strings
+};
+
+namespace {
+
+struct Prefix {
+    bool v6;
+    uint8_t key[16];
+    int length;
+    uint32_t tag; // 1-based tag index
+};
+
+// Tries of both families share one slot array: the IPv4 root, the IPv6
+// root, then the chunks that become nodes, all 256 slots wide until
+// the image is written
+struct Builder {
+    static constexpr uint32_t CHUNK = 0x80000000;
+
+    vector<uint32_t> slots = vector<uint32_t>(2 * ROOT_SLOTS, 0);
+
+    static size_t chunkStart(uint32_t slot) { return 2 * ROOT_SLOTS + size_t(slot & ~CHUNK) * CHUNK_SLOTS; }
+    size_t chunkCount() const { return (slots.size() - 2 * ROOT_SLOTS) / CHUNK_SLOTS; }
+
+    // Set `count` slots from `pos` to `value`, down through their chunks.
+    // Prefixes go in shortest first, so whatever is overwritten is less specific.
+    void cover(size_t pos, size_t count, uint32_t value) {
+        for (size_t i = pos; i < pos + count; ++i) {
+            if (slots[i] & CHUNK)
+                cover(chunkStart(slots[i]), CHUNK_SLOTS, value);
+            else
+                slots[i] = value;
+        }
+    }
+
+    bool insert(const Prefix &prefix) {
+        size_t base = prefix.v6 ? ROOT_SLOTS : 0;
+        size_t index = size_t(prefix.key[0]) << 8 | prefix.key[1];
+        int stride = 16;
+        int consumed = 0;
+        int next = 2;
+        while (prefix.length - consumed > stride) {
+            if (!(slots[base + index] & CHUNK)) {
+                if (chunkCount() >= MAX_NODES) return false;
+                uint32_t inherited = slots[base + index]; // pushed down into the new chunk
+                slots[base + index] = uint32_t(chunkCount()) | CHUNK;
+                slots.resize(slots.size() + CHUNK_SLOTS, inherited);
+            }
+            base = chunkStart(slots[base + index]);
+            consumed += stride;
+            stride = 8;
+            index = prefix.key[next++];
+        }
+        // Host bits are zero, so `index` is the first slot of the prefix's range
+        cover(base + index, size_t(1) << (stride - (prefix.length - consumed)), prefix.tag);
+        return true;
+    }
+};
+
+// "10.0.0.0/8" -> family, key with the host bits cleared and canonical text
+bool parsePrefix(const string &text, Prefix &prefix, string &canonical) {
+    size_t slash = text.find('/');
+    if (slash == string::npos) return false;
+    string address = text.substr(0, slash);
+    char *end;
+    long length = strtol(text.c_str() + slash + 1, &end, 10);
+    if (*end != '\0' || end == text.c_str() + slash + 1) return false;
+
+    memset(prefix.key, 0, sizeof(prefix.key));
+    prefix.v6 = address.find(':') != string::npos;
+    if (inet_pton(prefix.v6 ? AF_INET6 : AF_INET, address.c_str(), prefix.key) != 1) return false;
+    if (length < 0 || length > (prefix.v6 ? 128 : 32)) return false;
+    prefix.length = int(length);
+
+    for (int bit = prefix.length; bit < 128; ++bit) prefix.key[bit / 8] &= ~(0x80 >> (bit % 8));
+    char buf[INET6_ADDRSTRLEN];
+    inet_ntop(prefix.v6 ? AF_INET6 : AF_INET, prefix.key, buf, sizeof(buf));
+    canonical = string(buf) + "/" + to_string(prefix.length);
+    return true;
+}
+
+bool parseAsn(const string &text, uint32_t &asn) {
+    if (text == "-") {
+        asn = 0;
+        return true;
+    }
+    const char *digits = text.c_str();
+    if ((digits[0] == 'A' || digits[0] == 'a') && (digits[1] == 'S' || digits[1] == 's')) digits += 2;
+    char *end;
+    unsigned long value = strtoul(digits, &end, 10);
+    if (*end != '\0' || end == digits || value > 0xffffffffUL) return false;
+    asn = uint32_t(value);
+    return true;
+}
+
+uint32_t hashString(const string &text) {
+    uint64_t hash = 0;
+    for (unsigned char c : text) hash = hashCombine(hash, c);
+    return uint32_t(hash);
+}
+
+template <typename T>
+void append(vector<char> &out, const T *data, size_t count) {
+    const char *bytes = reinterpret_cast<const char *>(data);
+    out.insert(out.end(), bytes, bytes + count * sizeof(T));
+}
+
+} // namespace
+
+bool LpmTable::compile(const string &sourcePath, const string &imagePath, string &error) {
+    ifstream file(sourcePath);
+    struct stat info;
+    if (!file.is_open() || stat(sourcePath.c_str(), &info) != 0) {
+        error = "cannot read " + sourcePath;
+        return false;
+    }
+
+    vector<Prefix> prefixes;
+    vector<PrefixTag> tags;
+    string strings(1, '\0');
+    std::map<string, uint32_t> sites; // LpmTable::map hides the container
+    auto intern = [&](const string &text) {
+        uint32_t offset = uint32_t(strings.size());
+        strings += text;
+        strings += '\0';
+        return offset;
+    };
+
+    int lineNumber = 0;
+    string line;
+    while (getline(file, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        istringstream fields(line);
+        string prefixText, asnText = "-", site = "-";
+        if (!(fields >> prefixText)) continue;
+        fields >> asnText >> site;
+
+        Prefix prefix;
+        string canonical;
+        PrefixTag tag;
+        if (!parsePrefix(prefixText, prefix, canonical)) {
+            cerr << "⚠️  " << sourcePath << ":" << lineNumber << ": bad prefix '" << prefixText << "'\n";
+            continue;
+        }
+        if (!parseAsn(asnText, tag.asn)) {
+            cerr << "⚠️  " << sourcePath << ":" << lineNumber << ": bad ASN '" << asnText << "'\n";
+            continue;
+        }
+        if (site == "-") site.clear();
+
+        tag.prefix = intern(canonical);
+        auto known = sites.find(site);
+        tag.site = site.empty() ? 0 : known != sites.end() ? known->second : (sites[site] = intern(site));
+        tag.hash = uint32_t(hashCombine(hashCombine(hashString(canonical), tag.asn), hashString(site))) | 1;
+        tags.push_back(tag);
+        prefix.tag = uint32_t(tags.size());
+        prefixes.push_back(prefix);
+    }
+
+    // Shortest first, so longer prefixes overwrite the ranges they refine;
+    // among duplicates the last line wins
+    stable_sort(prefixes.begin(), prefixes.end(),
+                [](const Prefix &a, const Prefix &b) { return a.length < b.length; });
+    Builder builder;
+    for (const Prefix &prefix : prefixes) {
+        if (!builder.insert(prefix)) {
+            error = "too many prefixes";
+            return false;
+        }
+    }
+
+    // Chunk k becomes node k, keeping only the first value of every run
+    vector<Node> nodes(builder.chunkCount());
+    vector<uint32_t> values;
+    for (size_t k = 0; k < nodes.size(); ++k) {
+        const uint32_t *chunk = &builder.slots[Builder::chunkStart(uint32_t(k))];
+        Node &node = nodes[k];
+        memset(&node, 0, sizeof(node));
+        node.base = uint32_t(values.size());
+        for (size_t i = 0; i < CHUNK_SLOTS; ++i) {
+            if (i % 64 == 0 && i > 0) node.before[i / 64] = uint16_t(values.size() - node.base);
+            if (i == 0 || chunk[i] != chunk[i - 1]) {
+                node.runs[i / 64] |= 1ULL << (i % 64);
+                values.push_back(chunk[i]);
+            }
+        }
+    }
+    if (values.size() > 0xffffffffULL) {
+        error = "too many prefixes";
+        return false;
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    header.version = IMAGE_VERSION;
+    header.nodeCount = uint32_t(nodes.size());
+    header.valueCount = uint32_t(values.size());
+    header.tagCount = uint32_t(tags.size());
+    header.stringBytes = uint32_t(strings.size());
+    header.sourceMtime = int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    header.sourceSize = uint64_t(info.st_size);
+
+    vector<char> image;
+    image.reserve(sizeof(Header) + 2 * ROOT_SLOTS * 4 + nodes.size() * sizeof(Node) + values.size() * 4 +
+                  tags.size() * sizeof(PrefixTag) + strings.size());
+    append(image, &header, 1);
+    append(image, builder.slots.data(), 2 * ROOT_SLOTS);
+    append(image, nodes.data(), nodes.size());
+    append(image, values.data(), values.size());
+    append(image, tags.data(), tags.size());
+    append(image, strings.data(), strings.size());
+
+    // A running sniffer may have the old image mapped; renaming leaves its pages intact
+    string tmpPath = imagePath + ".tmp";
+    {
+        ofstream out(tmpPath, ios::binary | ios::trunc);
+        if (!out.is_open()) {
+            error = "cannot write " + tmpPath;
+            return false;
+        }
+        out.write(image.data(), image.size());
+        if (!out) {
+            error = "cannot write " + tmpPath;
+            return false;
+        }
+    }
+    if (rename(tmpPath.c_str(), imagePath.c_str()) != 0) {
+        error = "cannot rename " + tmpPath + " to " + imagePath;
+        return false;
+    }
+    return true;
+}
+
+unique_ptr<LpmTable> LpmTable::map(const string &imagePath, string &error) {
+    int fd = open(imagePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + imagePath;
+        return nullptr;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(Header)) {
+        close(fd);
+        error = imagePath + " is not a prefix image";
+        return nullptr;
+    }
+    size_t length = size_t(info.st_size);
+    void *base = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        error = "cannot map " + imagePath;
+        return nullptr;
+    }
+
+    unique_ptr<LpmTable> table(new LpmTable());
+    table->base = base;
+    table->length = length;
+
+    const Header *header = static_cast<const Header *>(base);
+    if (memcmp(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 || header->version != IMAGE_VERSION) {
+        error = imagePath + " is not a prefix image";
+        return nullptr;
+    }
+    size_t expected = sizeof(Header) + 2 * ROOT_SLOTS * 4 + size_t(header->nodeCount) * sizeof(Node) +
+                      size_t(header->valueCount) * 4 + size_t(header->tagCount) * sizeof(PrefixTag) + header->stringBytes;
+    if (expected != length || header->nodeCount > MAX_NODES || header->stringBytes == 0) {
+        error = imagePath + " is truncated";
+        return nullptr;
+    }
+
+    const char *bytes = static_cast<const char *>(base);
+    table->header = header;
+    table->root4 = reinterpret_cast<const uint32_t *>(bytes + sizeof(Header));
+    table->root6 = table->root4 + ROOT_SLOTS;
+    table->nodes = reinterpret_cast<const Node *>(table->root6 + ROOT_SLOTS);
+    table->values = reinterpret_cast<const uint32_t *>(table->nodes + header->nodeCount);
+    table->tags = reinterpret_cast<const PrefixTag *>(table->values + header->valueCount);
+    table->strings = reinterpret_cast<const char *>(table->tags + header->tagCount);
+
+    // Lookups trust the image, so check every reference in it once here
+    auto validSlot = [&](uint32_t slot) {
+        return slot & NODE ? (slot & ~NODE) < header->nodeCount : slot <= header->tagCount;
+    };
+    bool valid = true;
+    for (size_t i = 0; i < 2 * ROOT_SLOTS; ++i) valid &= validSlot(table->root4[i]);
+    for (size_t i = 0; i < header->valueCount; ++i) valid &= validSlot(table->values[i]);
+    for (uint32_t k = 0; k < header->nodeCount && valid; ++k) {
+        const Node &node = table->nodes[k];
+        size_t runs = 0;
+        for (int word = 0; word < 4; ++word) {
+            valid &= node.before[word] == runs;
+            runs += __builtin_popcountll(node.runs[word]);
+        }
+        valid &= (node.runs[0] & 1) && size_t(node.base) + runs <= header->valueCount;
+    }
+    if (!valid) {
+        error = imagePath + " is corrupt";
+        return nullptr;
+    }
+    for (uint32_t i = 0; i < header->tagCount; ++i) {
+        const PrefixTag &tag = table->tags[i];
+        if (tag.prefix >= header->stringBytes || tag.site >= header->stringBytes) {
+            error = imagePath + " is corrupt";
+            return nullptr;
+        }
+    }
+    if (table->strings[header->stringBytes - 1] != '\0') {
+        error = imagePath + " is corrupt";
+        return nullptr;
+    }
+
+    // The roots are hit on every lookup; fault them in now rather than on the decode path
+    madvise(base, sizeof(Header) + 2 * ROOT_SLOTS * 4, MADV_WILLNEED);
+    return table;
+}
+
+LpmTable::~LpmTable() {
+    if (base) munmap(base, length);
+}
+
+size_t LpmTable::prefixCount() const { return header->tagCount; }
+size_t LpmTable::nodeCount() const { return header->nodeCount; }
+int64_t LpmTable::sourceMtime() const { return header->sourceMtime; }
+uint64_t LpmTable::sourceSize() const { return header->sourceSize; }
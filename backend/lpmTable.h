@@ -0,0 +1,115 @@
+#ifndef LPMTABLE_H
+#define LPMTABLE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <arpa/inet.h>
+
+// Longest-prefix match over a local list of IPv4 and IPv6 prefixes, each
+// tagged with an ASN and a site. The list is compiled into a flat image file
+// that is memory-mapped read-only, so a restart maps the compiled tables
+// instead of rebuilding them and the kernel shares their pages.
+//
+// Each family is a multibit trie with a 16-bit first stride and 8-bit
+// strides below (16-8-8 for IPv4), with prefixes pushed down to the leaves:
+// a slot holds either the tag of the longest prefix covering it or a
+// reference to a node one level down. The roots are plain 65536-slot
+// arrays. Below them, as in poptrie, a node stores its 256 slots as runs:
+// a bitmap marks where a new value starts and only those values are kept,
+// so a slot is found by counting the bits up to it. A node that refines a
+// few prefixes of a /16 takes tens of bytes instead of a kilobyte, and an
+// IPv4 lookup is at most three dependent steps (DIR-24-8's first table
+// alone would be 32 MB).
+//
+// Prefix list lines are `<prefix>/<length> [asn] [site]`:
+//
+//   10.20.0.0/16    AS64512   lab
+//   2001:db8::/32   -         branch
+//
+// with `-` for a missing column and `#` starting a comment.
+
+struct PrefixTag {
+    uint32_t asn;    // 0 if none
+    uint32_t prefix; // offsets into the string pool, 0 is the empty string
+    uint32_t site;
+    uint32_t hash;   // of prefix, ASN and site, never 0; equal tags hash equal across images
+};
+
+class LpmTable {
+public:
+    ~LpmTable();
+    LpmTable(const LpmTable &) = delete;
+    LpmTable &operator=(const LpmTable &) = delete;
+
+    // Compile a prefix list into an image (written to a temporary file and
+    // renamed into place). Bad lines are reported on stderr and skipped;
+    // false with the reason in `error` if nothing could be written.
+    static bool compile(const std::string &sourcePath, const std::string &imagePath, std::string &error);
+    // Map a compiled image; nullptr with the reason in `error`
+    static std::unique_ptr<LpmTable> map(const std::string &imagePath, std::string &error);
+
+    // Tag of the longest prefix containing `addr` (network byte order), nullptr if none
+    const PrefixTag *lookup(uint32_t addr) const;
+    const PrefixTag *lookup6(const uint8_t addr[16]) const;
+
+    const char *text(uint32_t offset) const { return strings + offset; }
+    size_t prefixCount() const;
+    size_t nodeCount() const;
+    size_t imageBytes() const { return length; }
+    // Modification time (ns) and size of the prefix list the image was compiled from
+    int64_t sourceMtime() const;
+    uint64_t sourceSize() const;
+
+private:
+    static constexpr uint32_t NODE = 0x80000000; // slot refers to a node, not a tag
+
+    struct Header;
+
+    // 256 slots stored as runs: bit i of the bitmap is set where slot i
+    // differs from slot i - 1 (always for slot 0), and values[base + k] is
+    // the value of run k
+    struct Node {
+        uint64_t runs[4];
+        uint16_t before[4]; // runs starting in the earlier bitmap words
+        uint32_t base;
+        uint32_t unused;
+    };
+
+    uint32_t step(uint32_t slot, uint8_t byte) const {
+        const Node &node = nodes[slot & ~NODE];
+        int word = byte >> 6;
+        uint64_t upTo = node.runs[word] & ((2ULL << (byte & 63)) - 1);
+        return values[node.base + node.before[word] + __builtin_popcountll(upTo) - 1];
+    }
+
+    void *base = nullptr;
+    size_t length = 0;
+    const Header *header = nullptr;
+    const uint32_t *root4 = nullptr;
+    const uint32_t *root6 = nullptr;
+    const Node *nodes = nullptr;
+    const uint32_t *values = nullptr;
+    const PrefixTag *tags = nullptr;
+    const char *strings = nullptr;
+
+    LpmTable() = default;
+};
+
+inline const PrefixTag *LpmTable::lookup(uint32_t addr) const {
+    uint32_t a = ntohl(addr);
+    uint32_t slot = root4[a >> 16];
+    if (slot & NODE) {
+        slot = step(slot, a >> 8 & 0xff);
+        if (slot & NODE) slot = step(slot, a & 0xff);
+    }
+    return slot ? &tags[slot - 1] : nullptr;
+}
+
+inline const PrefixTag *LpmTable::lookup6(const uint8_t addr[16]) const {
+    uint32_t slot = root6[addr[0] << 8 | addr[1]];
+    for (int i = 2; i < 16 && (slot & NODE); ++i) slot = step(slot, addr[i]);
+    return slot ? &tags[slot - 1] : nullptr;
+}
+
+#endif // LPMTABLE_H
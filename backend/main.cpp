@@ -1,41 +1,343 @@
 #include "packetSniffer.h"
+#include "hostPort.h"
 #include <iostream>
 #include <signal.h>
 #include <cstdlib>
+#include <sstream>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 using namespace std;
 
 PacketSniffer *globalSniffer = nullptr;
 
+// Only ends the capture loop: main emits what is still open and saves on
+// the way out. A second signal ends the process at once.
 void signalHandler(int signum) {
-    cerr << "\n🛑 Interrupt signal (" << signum << ") received.\n";
+    static const char message[] = "\n🛑 Interrupt signal received, stopping...\n";
+    ssize_t written = write(STDERR_FILENO, message, sizeof(message) - 1);
+    (void)written;
+    signal(signum, SIG_DFL);
     if (globalSniffer) {
         globalSniffer->stop();
     }
-    exit(signum);
+}
+
+static void printUsage(const char *program) {
+    cerr << "Usage: " << program << " <interface[,interface...]> [options]\n";
+    cerr << "Options:\n";
+    cerr << "  --monitor <ip[,ip...]>     Continuously monitor the paths to these destinations\n";
+    cerr << "  --monitor-interval <sec>   Seconds between monitoring rounds (default 5)\n";
+    cerr << "  --monitor-top <n>          Also monitor the n heaviest destinations of every top talkers report\n";
+    cerr << "  --trace-cache <file>       Traceroute cache file (default packets/traceroute_cache.bin)\n";
+    cerr << "  --trace-cache-age <sec>    Age after which cached paths are re-traced (default 3600)\n";
+    cerr << "  --no-trace-cache           Do not load or save the traceroute cache\n";
+    cerr << "  --feature-window <sec>     Tumbling window for FEATURES records (default 0.2)\n";
+    cerr << "  --feature-slide <n>        Windows per sliding window, 0 to disable (default 5)\n";
+    cerr << "  --features-csv <file>      Also write window features as network_features.csv rows\n";
+    cerr << "  --no-features              Do not compute window features\n";
+    cerr << "  --anomaly-model <file>     Isolation forest from export_model.py (default models/isolation_forest.bin)\n";
+    cerr << "  --no-anomaly-model         Do not score windows\n";
+    cerr << "  --top-talkers <n>          Entries per TOP_TALKERS list, 0 to disable (default 10)\n";
+    cerr << "  --fanout-window <sec>      Window for distinct port/peer counts (default 10)\n";
+    cerr << "  --fanout-ports <n>         Distinct ports per address that raise a FANOUT alert (default 100)\n";
+    cerr << "  --fanout-peers <n>         Distinct peers per address that raise a FANOUT alert (default 100)\n";
+    cerr << "  --no-fanout                Do not track fan-out\n";
+    cerr << "  --histogram-interval <sec> Seconds between HISTOGRAMS records (default 5)\n";
+    cerr << "  --no-histograms            Do not keep size / inter-arrival histograms\n";
+    cerr << "  --change-interval <sec>    Rate sample length for CHANGE alerts (default 1)\n";
+    cerr << "  --change-threshold <sd>    CUSUM level that raises a CHANGE alert (default 8)\n";
+    cerr << "  --change-min-pps <n>       Packet rate below which hosts raise no CHANGE alerts (default 20)\n";
+    cerr << "  --no-change-detection      Do not watch per-host rates\n";
+    cerr << "  --rules <file>             Raise RULE alerts from the rules in this file\n";
+    cerr << "  --tcp-interval <sec>       Seconds between TCP_METRICS records (default 5)\n";
+    cerr << "  --no-tcp-metrics           Do not measure TCP connections\n";
+    cerr << "  --no-tls                   Do not look for TLS ClientHellos (SNI, JA3)\n";
+    cerr << "  --no-dns                   Do not name addresses from observed DNS responses\n";
+    cerr << "  --prefixes <file>          Tag addresses with subnet, ASN and site from this prefix list\n";
+    cerr << "  --xdp                      Count flows in the kernel with XDP instead of capturing packets\n";
+    cerr << "  --xdp-interval <sec>       Seconds between reads of the XDP flow counters (default 1)\n";
+    cerr << "  --xdp-flows <n>            Flows the XDP map holds between reads (default 65536)\n";
+    cerr << "  --ring                     Capture through a memory-mapped TPACKET_V3 ring, decoding a block at a time\n";
+    cerr << "  --shards <n>               Worker threads for exact TRAFFIC counters (default 0, off)\n";
+    cerr << "  --traffic-interval <sec>   Seconds per TRAFFIC record (default 1)\n";
+    cerr << "  --shed                     Sample, then stop per-packet records when capture falls behind\n";
+    cerr << "  --shed-max-rate <n>        Sparsest sampling before counters only, 1 in n (default 256)\n";
+    cerr << "  --export <host[:port]>     Send flow records to an IPFIX / NetFlow v9 collector\n";
+    cerr << "  --export-format <fmt>      ipfix (default, port 4739) or v9 (port 2055)\n";
+    cerr << "  --export-idle <sec>        Seconds without packets that end a flow record (default 15)\n";
+    cerr << "  --export-active <sec>      Seconds after which a busy flow's record is sent (default 60)\n";
+    cerr << "  --read <file.pcap>         Replay a capture file, named by the interface argument, then exit\n";
+    cerr << "  --send <host[:port]>       Write records to a record_collector over TCP, not stdout (port 9700; IPv6 as [addr]:port)\n";
+    cerr << "  --sensor <name>            Name this sniffer to the collector (default host/interface)\n";
+    cerr << "Example: " << program << " eth0 --monitor 8.8.8.8,1.1.1.1\n";
+}
+
+// Records go to the collector through stdout, which becomes the connection
+static bool sendToCollector(const string &target, string &error) {
+    string host;
+    string port = "9700";
+    if (!splitHostPort(target, host, port)) {
+        error = "expected host, host:port or [address]:port";
+        return false;
+    }
+
+    struct addrinfo hints = {}, *result = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int status = getaddrinfo(host.c_str(), port.c_str(), &hints, &result);
+    if (status != 0) {
+        error = gai_strerror(status);
+        return false;
+    }
+    int fd = -1;
+    for (struct addrinfo *address = result; address && fd < 0; address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd >= 0 && connect(fd, address->ai_addr, address->ai_addrlen) < 0) {
+            error = strerror(errno);
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(result);
+    if (fd < 0) return false;
+
+    cout.flush();
+    if (dup2(fd, STDOUT_FILENO) < 0) {
+        error = strerror(errno);
+        close(fd);
+        return false;
+    }
+    close(fd);
+    return true;
+}
+
+static vector<string> splitList(const string &value) {
+    vector<string> items;
+    stringstream stream(value);
+    string item;
+    while (getline(stream, item, ','))
+        if (!item.empty()) items.push_back(item);
+    return items;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        cerr << "Usage: " << argv[0] << " <interface>\n";
-        cerr << "Example: " << argv[0] << " eth0\n";
+    if (argc < 2) {
+        printUsage(argv[0]);
         return 1;
     }
 
-    string interface = argv[1];
-    
+    SnifferConfig config;
+    // Several interfaces are captured together: eth0,eth1
+    for (const auto &name : splitList(argv[1]))
+        if (find(config.interfaces.begin(), config.interfaces.end(), name) == config.interfaces.end())
+            config.interfaces.push_back(name);
+    if (config.interfaces.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    string sendTarget;
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--monitor" && hasValue) {
+            for (const auto &target : splitList(argv[++i]))
+                config.monitorTargets.push_back(target);
+        } else if (arg == "--monitor-interval" && hasValue) {
+            config.monitorInterval = max(1, atoi(argv[++i]));
+        } else if (arg == "--monitor-top" && hasValue) {
+            config.monitorTop = max(0, atoi(argv[++i]));
+        } else if (arg == "--trace-cache" && hasValue) {
+            config.traceCachePath = argv[++i];
+        } else if (arg == "--trace-cache-age" && hasValue) {
+            config.traceCacheMaxAge = max(0, atoi(argv[++i]));
+        } else if (arg == "--no-trace-cache") {
+            config.traceCachePath.clear();
+        } else if (arg == "--feature-window" && hasValue) {
+            config.featureWindow = atof(argv[++i]);
+            if (config.featureWindow <= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--feature-slide" && hasValue) {
+            config.featureSlidingPanes = max(0, atoi(argv[++i]));
+        } else if (arg == "--features-csv" && hasValue) {
+            config.featuresCsvPath = argv[++i];
+        } else if (arg == "--no-features") {
+            config.features = false;
+        } else if (arg == "--anomaly-model" && hasValue) {
+            config.anomalyModelPath = argv[++i];
+        } else if (arg == "--no-anomaly-model") {
+            config.anomalyModelPath.clear();
+        } else if (arg == "--top-talkers" && hasValue) {
+            config.topTalkers = max(0, atoi(argv[++i]));
+        } else if (arg == "--fanout-window" && hasValue) {
+            config.fanoutWindow = atof(argv[++i]);
+            if (config.fanoutWindow <= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--fanout-ports" && hasValue) {
+            config.fanoutPorts = max(0.0, atof(argv[++i]));
+        } else if (arg == "--fanout-peers" && hasValue) {
+            config.fanoutPeers = max(0.0, atof(argv[++i]));
+        } else if (arg == "--no-fanout") {
+            config.fanout = false;
+        } else if (arg == "--histogram-interval" && hasValue) {
+            config.histogramInterval = atof(argv[++i]);
+            if (config.histogramInterval <= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--no-histograms") {
+            config.histograms = false;
+        } else if (arg == "--change-interval" && hasValue) {
+            config.changeInterval = atof(argv[++i]);
+            if (config.changeInterval <= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--change-threshold" && hasValue) {
+            config.changeThreshold = atof(argv[++i]);
+            if (config.changeThreshold <= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--change-min-pps" && hasValue) {
+            config.changeMinRate = max(0.0, atof(argv[++i]));
+        } else if (arg == "--no-change-detection") {
+            config.changeDetection = false;
+        } else if (arg == "--rules" && hasValue) {
+            config.rulesPath = argv[++i];
+        } else if (arg == "--tcp-interval" && hasValue) {
+            config.tcpReportInterval = atof(argv[++i]);
+            if (config.tcpReportInterval <= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--no-tcp-metrics") {
+            config.tcpMetrics = false;
+        } else if (arg == "--no-tls") {
+            config.tlsInspection = false;
+        } else if (arg == "--no-dns") {
+            config.dnsSnooping = false;
+        } else if (arg == "--prefixes" && hasValue) {
+            config.prefixFile = argv[++i];
+        } else if (arg == "--xdp") {
+            config.xdp = true;
+        } else if (arg == "--xdp-interval" && hasValue) {
+            config.xdpInterval = atof(argv[++i]);
+            if (config.xdpInterval <= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--xdp-flows" && hasValue) {
+            config.xdpMaxFlows = strtoul(argv[++i], nullptr, 10);
+            if (config.xdpMaxFlows == 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--ring") {
+            config.ring = true;
+        } else if (arg == "--shards" && hasValue) {
+            config.shards = atoi(argv[++i]);
+            if (config.shards < 1 || config.shards > 64) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--traffic-interval" && hasValue) {
+            config.trafficInterval = atof(argv[++i]);
+            if (config.trafficInterval <= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--shed") {
+            config.shedding = true;
+        } else if (arg == "--shed-max-rate" && hasValue) {
+            config.shedMaxRate = strtoul(argv[++i], nullptr, 10);
+            if (config.shedMaxRate < 2) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--export" && hasValue) {
+            config.exportTarget = argv[++i];
+        } else if (arg == "--export-format" && hasValue) {
+            config.exportFormat = argv[++i];
+            if (config.exportFormat != "ipfix" && config.exportFormat != "v9") {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--export-idle" && hasValue) {
+            config.exportIdle = atof(argv[++i]);
+            if (config.exportIdle <= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--export-active" && hasValue) {
+            config.exportActive = atof(argv[++i]);
+            if (config.exportActive <= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--read" && hasValue) {
+            config.readFile = argv[++i];
+        } else if (arg == "--send" && hasValue) {
+            sendTarget = argv[++i];
+        } else if (arg == "--sensor" && hasValue) {
+            config.sensor = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    // A replay is one file, named by one interface
+    if (!config.readFile.empty() && (config.xdp || config.ring || config.interfaces.size() > 1)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    // XDP captures no frames for a ring to hold
+    if (config.xdp && config.ring) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (!sendTarget.empty()) {
+        if (config.sensor.empty()) {
+            char host[256] = {};
+            gethostname(host, sizeof(host) - 1);
+            config.sensor = string(host) + "/" + argv[1];
+        }
+        // A collector that goes away fails the next write instead of killing the sniffer
+        signal(SIGPIPE, SIG_IGN);
+        string error;
+        if (!sendToCollector(sendTarget, error)) {
+            cerr << "❌ Cannot reach the collector at " << sendTarget << ": " << error << "\n";
+            return 1;
+        }
+        cerr << "📡 Sending records to " << sendTarget << " as " << config.sensor << endl;
+    }
+
     // ALL status messages to stderr
     cerr << "🚀 Starting network packet sniffer..." << endl;
     cerr << "📁 Output will be saved to packets/ directory" << endl;
 
-    PacketSniffer sniffer(interface);
+    PacketSniffer sniffer(config);
     globalSniffer = &sniffer;
 
     // Set up signal handler
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
 
-    if (!sniffer.start()) {
+    bool started = sniffer.start();
+    sniffer.finish();
+    globalSniffer = nullptr;
+    if (!started) {
         cerr << "❌ Failed to start packet sniffer\n";
         return 1;
     }
@@ -198,55 +198,63 @@ class SimpleMaliciousDetector:
     
     def predict_packet(self, packet_size, duration, dst_port, protocol, syn_flag=0):
         """Predict if a packet is malicious"""
+        return self.predict_packets([(packet_size, duration, dst_port, protocol, syn_flag)])[0]
+    
+    def predict_packets(self, packets):
+        """Predict a batch of (packet_size, duration, dst_port, protocol, syn_flag) tuples
+        with one scaler and forest pass; results are in input order"""
         if not self.is_trained:
             raise ValueError("Model not trained! Please load a trained model first.")
+        if not packets:
+            return []
         
         # Generate all features
-        generated_features = self._generate_comprehensive_features(
-            packet_size, duration, dst_port, protocol, syn_flag
-        )
+        generated = [self._generate_comprehensive_features(*packet) for packet in packets]
         
-        # Create feature vector
-        feature_vector = np.zeros(len(self.feature_names))
+        # Create feature matrix, one row per packet
+        feature_matrix = np.zeros((len(packets), len(self.feature_names)))
         
         for i, feature_name in enumerate(self.feature_names):
-            if feature_name in generated_features:
-                feature_vector[i] = generated_features[feature_name]
+            if feature_name in self.training_stats:
+                default = self.training_stats[feature_name]['median']
             else:
-                if feature_name in self.training_stats:
-                    feature_vector[i] = self.training_stats[feature_name]['median']
-                else:
-                    feature_vector[i] = 0
+                default = 0
+            for row, features in enumerate(generated):
+                feature_matrix[row, i] = features.get(feature_name, default)
         
         # Scale and predict
-        feature_vector_scaled = self.scaler.transform(feature_vector.reshape(1, -1))
-        prediction = self.isolation_forest.predict(feature_vector_scaled)[0]
-        anomaly_score = self.isolation_forest.score_samples(feature_vector_scaled)[0]
-        
-        is_malicious = prediction == -1
-        
-        # Determine attack type if malicious
-        attack_type = "None"
-        if is_malicious:
-            attack_type = self._classify_attack_type(generated_features)
-        
-        # Risk level assessment
-        if abs(anomaly_score) > 0.3:
-            risk_level = "CRITICAL"
-        elif abs(anomaly_score) > 0.15:
-            risk_level = "HIGH"
-        elif abs(anomaly_score) > 0.05:
-            risk_level = "MEDIUM"
-        else:
-            risk_level = "LOW"
-        
-        return {
-            'is_malicious': bool(is_malicious),
-            'anomaly_score': float(anomaly_score),
-            'risk_level': risk_level,
-            'attack_type': attack_type,
-            'prediction_confidence': 'High' if abs(anomaly_score) > 0.1 else 'Medium'
-        }
+        feature_matrix_scaled = self.scaler.transform(feature_matrix)
+        predictions = self.isolation_forest.predict(feature_matrix_scaled)
+        anomaly_scores = self.isolation_forest.score_samples(feature_matrix_scaled)
+        
+        results = []
+        for features, prediction, anomaly_score in zip(generated, predictions, anomaly_scores):
+            is_malicious = prediction == -1
+            
+            # Determine attack type if malicious
+            attack_type = "None"
+            if is_malicious:
+                attack_type = self._classify_attack_type(features)
+            
+            # Risk level assessment
+            if abs(anomaly_score) > 0.3:
+                risk_level = "CRITICAL"
+            elif abs(anomaly_score) > 0.15:
+                risk_level = "HIGH"
+            elif abs(anomaly_score) > 0.05:
+                risk_level = "MEDIUM"
+            else:
+                risk_level = "LOW"
+            
+            results.append({
+                'is_malicious': bool(is_malicious),
+                'anomaly_score': float(anomaly_score),
+                'risk_level': risk_level,
+                'attack_type': attack_type,
+                'prediction_confidence': 'High' if abs(anomaly_score) > 0.1 else 'Medium'
+            })
+        
+        return results
 
 
 def load_model(model_path='models/malicious_packet_model.pkl'):
@@ -274,6 +282,31 @@ def load_model(model_path='models/malicious_packet_model.pkl'):
         return False
 
 
+def _validate_packet(packet_data):
+    """Return (arguments, None) for predict_packet, or (None, error message)"""
+    try:
+        packet_size = float(packet_data.get('packet_size', 0))
+        duration = float(packet_data.get('duration', 0))
+        dst_port = int(packet_data.get('dst_port', 0))
+        protocol = int(packet_data.get('protocol', 0))
+        syn_flag = int(packet_data.get('syn_flag', 0))
+    except (TypeError, ValueError) as e:
+        return None, f"Invalid field type: {str(e)}"
+    
+    if packet_size <= 0:
+        return None, "packet_size must be positive"
+    if duration <= 0:
+        return None, "duration must be positive"
+    if not 1 <= dst_port <= 65535:
+        return None, "dst_port must be between 1 and 65535"
+    if protocol not in [1, 6, 17]:
+        return None, "protocol must be 1 (ICMP), 6 (TCP), or 17 (UDP)"
+    if syn_flag not in [0, 1]:
+        return None, "syn_flag must be 0 or 1"
+    
+    return (packet_size, duration, dst_port, protocol, syn_flag), None
+
+
 def predict_malicious_packet(packet_data):
     """
     Predict if a network packet is malicious
@@ -289,45 +322,47 @@ def predict_malicious_packet(packet_data):
     Returns:
         dict: Prediction results
     """
+    return predict_malicious_packets([packet_data])[0]
+
+
+def predict_malicious_packets(packet_list):
+    """
+    Predict a batch of packets (dicts as for predict_malicious_packet) in one
+    model pass. Returns one result per packet, in order; invalid packets get
+    an error result without failing the rest of the batch.
+    """
     global _detector, _model_loaded
     
     if not _model_loaded or _detector is None:
-        return {
+        return [{
             "status": "error",
             "message": "Model not loaded. Please ensure the model file exists."
-        }
+        } for _ in packet_list]
+    
+    results = [None] * len(packet_list)
+    valid_rows = []
+    valid_args = []
+    for row, packet_data in enumerate(packet_list):
+        args, error = _validate_packet(packet_data)
+        if error:
+            results[row] = {"status": "error", "message": error}
+        else:
+            valid_rows.append(row)
+            valid_args.append(args)
     
     try:
-        # Extract parameters
-        packet_size = float(packet_data.get('packet_size', 0))
-        duration = float(packet_data.get('duration', 0))
-        dst_port = int(packet_data.get('dst_port', 0))
-        protocol = int(packet_data.get('protocol', 0))
-        syn_flag = int(packet_data.get('syn_flag', 0))
-        
-        # Validate inputs
-        if packet_size <= 0:
-            return {"status": "error", "message": "packet_size must be positive"}
-        if duration <= 0:
-            return {"status": "error", "message": "duration must be positive"}
-        if not 1 <= dst_port <= 65535:
-            return {"status": "error", "message": "dst_port must be between 1 and 65535"}
-        if protocol not in [1, 6, 17]:
-            return {"status": "error", "message": "protocol must be 1 (ICMP), 6 (TCP), or 17 (UDP)"}
-        if syn_flag not in [0, 1]:
-            return {"status": "error", "message": "syn_flag must be 0 or 1"}
-        
-        # Make prediction
-        result = _detector.predict_packet(packet_size, duration, dst_port, protocol, syn_flag)
-        result['status'] = 'success'
-        
-        return result
-        
+        # Make predictions
+        for row, result in zip(valid_rows, _detector.predict_packets(valid_args)):
+            result['status'] = 'success'
+            results[row] = result
     except Exception as e:
-        return {
-            "status": "error",
-            "message": f"Prediction failed: {str(e)}"
-        }
+        for row in valid_rows:
+            results[row] = {
+                "status": "error",
+                "message": f"Prediction failed: {str(e)}"
+            }
+    
+    return results
 
 
 # For testing this module independently
@@ -0,0 +1,144 @@
+#include "md5.h"
+#include <cstring>
+
+static inline uint32_t rotateLeft(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+// One step of each round: a = b + ((a + f(b, c, d) + m + k) <<< s)
+#define STEP(f, a, b, c, d, m, k, s) a = b + rotateLeft(a + f(b, c, d) + m + k, s)
+#define ROUND_F(b, c, d) (d ^ (b & (c ^ d)))
+#define ROUND_G(b, c, d) (c ^ (d & (b ^ c)))
+#define ROUND_H(b, c, d) (b ^ c ^ d)
+#define ROUND_I(b, c, d) (c ^ (b | ~d))
+
+Md5::Md5() {
+    state[0] = 0x67452301;
+    state[1] = 0xefcdab89;
+    state[2] = 0x98badcfe;
+    state[3] = 0x10325476;
+}
+
+void Md5::transform(const uint8_t block[64]) {
+    uint32_t m[16];
+    for (int i = 0; i < 16; ++i)
+        m[i] = uint32_t(block[i * 4]) | uint32_t(block[i * 4 + 1]) << 8 | uint32_t(block[i * 4 + 2]) << 16 |
+               uint32_t(block[i * 4 + 3]) << 24;
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+
+    STEP(ROUND_F, a, b, c, d, m[0], 0xd76aa478, 7);
+    STEP(ROUND_F, d, a, b, c, m[1], 0xe8c7b756, 12);
+    STEP(ROUND_F, c, d, a, b, m[2], 0x242070db, 17);
+    STEP(ROUND_F, b, c, d, a, m[3], 0xc1bdceee, 22);
+    STEP(ROUND_F, a, b, c, d, m[4], 0xf57c0faf, 7);
+    STEP(ROUND_F, d, a, b, c, m[5], 0x4787c62a, 12);
+    STEP(ROUND_F, c, d, a, b, m[6], 0xa8304613, 17);
+    STEP(ROUND_F, b, c, d, a, m[7], 0xfd469501, 22);
+    STEP(ROUND_F, a, b, c, d, m[8], 0x698098d8, 7);
+    STEP(ROUND_F, d, a, b, c, m[9], 0x8b44f7af, 12);
+    STEP(ROUND_F, c, d, a, b, m[10], 0xffff5bb1, 17);
+    STEP(ROUND_F, b, c, d, a, m[11], 0x895cd7be, 22);
+    STEP(ROUND_F, a, b, c, d, m[12], 0x6b901122, 7);
+    STEP(ROUND_F, d, a, b, c, m[13], 0xfd987193, 12);
+    STEP(ROUND_F, c, d, a, b, m[14], 0xa679438e, 17);
+    STEP(ROUND_F, b, c, d, a, m[15], 0x49b40821, 22);
+
+    STEP(ROUND_G, a, b, c, d, m[1], 0xf61e2562, 5);
+    STEP(ROUND_G, d, a, b, c, m[6], 0xc040b340, 9);
+    STEP(ROUND_G, c, d, a, b, m[11], 0x265e5a51, 14);
+    STEP(ROUND_G, b, c, d, a, m[0], 0xe9b6c7aa, 20);
+    STEP(ROUND_G, a, b, c, d, m[5], 0xd62f105d, 5);
+    STEP(ROUND_G, d, a, b, c, m[10], 0x02441453, 9);
+    STEP(ROUND_G, c, d, a, b, m[15], 0xd8a1e681, 14);
+    STEP(ROUND_G, b, c, d, a, m[4], 0xe7d3fbc8, 20);
+    STEP(ROUND_G, a, b, c, d, m[9], 0x21e1cde6, 5);
+    STEP(ROUND_G, d, a, b, c, m[14], 0xc33707d6, 9);
+    STEP(ROUND_G, c, d, a, b, m[3], 0xf4d50d87, 14);
+    STEP(ROUND_G, b, c, d, a, m[8], 0x455a14ed, 20);
+    STEP(ROUND_G, a, b, c, d, m[13], 0xa9e3e905, 5);
+    STEP(ROUND_G, d, a, b, c, m[2], 0xfcefa3f8, 9);
+    STEP(ROUND_G, c, d, a, b, m[7], 0x676f02d9, 14);
+    STEP(ROUND_G, b, c, d, a, m[12], 0x8d2a4c8a, 20);
+
+    STEP(ROUND_H, a, b, c, d, m[5], 0xfffa3942, 4);
+    STEP(ROUND_H, d, a, b, c, m[8], 0x8771f681, 11);
+    STEP(ROUND_H, c, d, a, b, m[11], 0x6d9d6122, 16);
+    STEP(ROUND_H, b, c, d, a, m[14], 0xfde5380c, 23);
+    STEP(ROUND_H, a, b, c, d, m[1], 0xa4beea44, 4);
+    STEP(ROUND_H, d, a, b, c, m[4], 0x4bdecfa9, 11);
+    STEP(ROUND_H, c, d, a, b, m[7], 0xf6bb4b60, 16);
+    STEP(ROUND_H, b, c, d, a, m[10], 0xbebfbc70, 23);
+    STEP(ROUND_H, a, b, c, d, m[13], 0x289b7ec6, 4);
+    STEP(ROUND_H, d, a, b, c, m[0], 0xeaa127fa, 11);
+    STEP(ROUND_H, c, d, a, b, m[3], 0xd4ef3085, 16);
+    STEP(ROUND_H, b, c, d, a, m[6], 0x04881d05, 23);
+    STEP(ROUND_H, a, b, c, d, m[9], 0xd9d4d039, 4);
+    STEP(ROUND_H, d, a, b, c, m[12], 0xe6db99e5, 11);
+    STEP(ROUND_H, c, d, a, b, m[15], 0x1fa27cf8, 16);
+    STEP(ROUND_H, b, c, d, a, m[2], 0xc4ac5665, 23);
+
+    STEP(ROUND_I, a, b, c, d, m[0], 0xf4292244, 6);
+    STEP(ROUND_I, d, a, b, c, m[7], 0x432aff97, 10);
+    STEP(ROUND_I, c, d, a, b, m[14], 0xab9423a7, 15);
+    STEP(ROUND_I, b, c, d, a, m[5], 0xfc93a039, 21);
+    STEP(ROUND_I, a, b, c, d, m[12], 0x655b59c3, 6);
+    STEP(ROUND_I, d, a, b, c, m[3], 0x8f0ccc92, 10);
+    STEP(ROUND_I, c, d, a, b, m[10], 0xffeff47d, 15);
+    STEP(ROUND_I, b, c, d, a, m[1], 0x85845dd1, 21);
+    STEP(ROUND_I, a, b, c, d, m[8], 0x6fa87e4f, 6);
+    STEP(ROUND_I, d, a, b, c, m[15], 0xfe2ce6e0, 10);
+    STEP(ROUND_I, c, d, a, b, m[6], 0xa3014314, 15);
+    STEP(ROUND_I, b, c, d, a, m[13], 0x4e0811a1, 21);
+    STEP(ROUND_I, a, b, c, d, m[4], 0xf7537e82, 6);
+    STEP(ROUND_I, d, a, b, c, m[11], 0xbd3af235, 10);
+    STEP(ROUND_I, c, d, a, b, m[2], 0x2ad7d2bb, 15);
+    STEP(ROUND_I, b, c, d, a, m[9], 0xeb86d391, 21);
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+void Md5::update(const void *data, size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    size_t used = length & 63;
+    length += size;
+
+    if (used > 0) {
+        size_t take = size < 64 - used ? size : 64 - used;
+        memcpy(buffer + used, bytes, take);
+        bytes += take;
+        size -= take;
+        if (used + take < 64) return;
+        transform(buffer);
+    }
+    for (; size >= 64; bytes += 64, size -= 64) transform(bytes);
+    memcpy(buffer, bytes, size);
+}
+
+void Md5::finish(uint8_t digest[16]) {
+    uint64_t bits = length * 8;
+    static const uint8_t PADDING[64] = {0x80};
+    size_t used = length & 63;
+    update(PADDING, used < 56 ? 56 - used : 120 - used);
+
+    uint8_t encoded[8];
+    for (int i = 0; i < 8; ++i) encoded[i] = uint8_t(bits >> (8 * i));
+    update(encoded, 8);
+
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j) digest[i * 4 + j] = uint8_t(state[i] >> (8 * j));
+}
+
+void Md5::finishHex(char hex[33]) {
+    static const char DIGITS[] = "0123456789abcdef";
+    uint8_t digest[16];
+    finish(digest);
+    for (int i = 0; i < 16; ++i) {
+        hex[i * 2] = DIGITS[digest[i] >> 4];
+        hex[i * 2 + 1] = DIGITS[digest[i] & 15];
+    }
+    hex[32] = '\0';
+}
@@ -0,0 +1,27 @@
+#ifndef MD5_H
+#define MD5_H
+
+#include <cstddef>
+#include <cstdint>
+
+// MD5 (RFC 1321), only for fingerprints such as JA3 that are defined as
+// MD5 digests. Not for anything that needs a secure hash.
+
+class Md5 {
+public:
+    Md5();
+
+    void update(const void *data, size_t length);
+    void finish(uint8_t digest[16]);
+    // Lowercase hex digest with a terminating NUL
+    void finishHex(char hex[33]);
+
+private:
+    uint32_t state[4];
+    uint64_t length = 0;   // bytes so far
+    uint8_t buffer[64];
+
+    void transform(const uint8_t block[64]);
+};
+
+#endif // MD5_H
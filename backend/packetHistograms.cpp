@@ -0,0 +1,92 @@
+#include "packetHistograms.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+static const char *const CLASS_NAMES[] = {"all", "tcp", "udp", "icmp", "other", "web", "dns", "ssh"};
+
+static double round2(double value) {
+    return std::round(value * 100.0) / 100.0;
+}
+
+static PacketHistograms::TrafficClass serviceClass(const PacketRecord &packet) {
+    if (packet.protocol != PacketRecord::TCP && packet.protocol != PacketRecord::UDP) return PacketHistograms::CLASS_COUNT;
+
+    for (uint16_t port : {packet.srcPort, packet.dstPort}) {
+        switch (port) {
+        case 80: case 443: case 8080: case 8443:
+            return PacketHistograms::WEB;
+        case 53:
+            return PacketHistograms::DNS;
+        case 22:
+            return PacketHistograms::SSH;
+        }
+    }
+    return PacketHistograms::CLASS_COUNT;
+}
+
+static json summarize(const HistogramSnapshot &snapshot) {
+    json summary;
+    summary["p50"] = round2(snapshot.percentile(0.5));
+    summary["p90"] = round2(snapshot.percentile(0.9));
+    summary["p99"] = round2(snapshot.percentile(0.99));
+    summary["p999"] = round2(snapshot.percentile(0.999));
+    summary["min"] = snapshot.min();
+    summary["max"] = snapshot.max();
+    summary["mean"] = round2(snapshot.mean());
+    return summary;
+}
+
+PacketHistograms::PacketHistograms(Emitter emitter, double tickSeconds)
+    : emit(std::move(emitter)), tickSeconds(tickSeconds) {}
+
+void PacketHistograms::add(const PacketRecord &packet) {
+    int64_t index = static_cast<int64_t>(floor(packet.timestamp / tickSeconds));
+    if (tickIndex < 0) {
+        tickIndex = index;
+    } else if (index > tickIndex) {
+        publish(tickIndex);
+        tickIndex = index;
+    }
+
+    record(ALL, packet);
+    record(static_cast<TrafficClass>(TCP + packet.protocol), packet); // same order as PacketRecord::Protocol
+
+    TrafficClass service = serviceClass(packet);
+    if (service != CLASS_COUNT) record(service, packet);
+}
+
+void PacketHistograms::record(TrafficClass trafficClass, const PacketRecord &packet) {
+    uint32_t count = max(packet.packets, 1u);
+    lengths[trafficClass].record(packet.length / count, count);
+
+    double &last = lastSeen[trafficClass];
+    if (last > 0 && packet.timestamp >= last)
+        interArrivals[trafficClass].record(static_cast<uint64_t>((packet.timestamp - last) * 1e6 / count), count);
+    last = packet.timestamp;
+}
+
+void PacketHistograms::publish(int64_t index) {
+    json classes;
+    for (int i = 0; i < CLASS_COUNT; ++i) {
+        HistogramSnapshot length = lengths[i].snapshotAndReset();
+        HistogramSnapshot interArrival = interArrivals[i].snapshotAndReset();
+        uint64_t packets = length.total();
+        if (packets == 0) continue;
+
+        json entry;
+        entry["packets"] = packets;
+        entry["length"] = summarize(length);
+        if (interArrival.total() > 0) entry["interarrival_us"] = summarize(interArrival);
+        classes[CLASS_NAMES[i]] = entry;
+    }
+    if (classes.empty()) return;
+
+    json record;
+    record["protocol"] = "HISTOGRAMS";
+    record["timestamp"] = (index + 1) * tickSeconds;
+    record["interval"] = tickSeconds;
+    record["classes"] = classes;
+    emit(record);
+}
@@ -0,0 +1,37 @@
+#ifndef PACKETHISTOGRAMS_H
+#define PACKETHISTOGRAMS_H
+
+#include "packetSniffer.h"
+#include "histogram.h"
+#include <functional>
+
+// Packet length and inter-arrival time distributions, for all traffic and
+// per protocol / service class. Every tick the histograms are snapshotted
+// and reset, and a HISTOGRAMS record with their percentiles goes out.
+// A record standing for several packets counts each of them at its mean
+// length, spread evenly over the time since the previous one.
+
+class PacketHistograms {
+public:
+    using Emitter = std::function<void(const json &)>;
+
+    enum TrafficClass { ALL = 0, TCP, UDP, ICMP, OTHER, WEB, DNS, SSH, CLASS_COUNT };
+
+    PacketHistograms(Emitter emitter, double tickSeconds = 5);
+
+    void add(const PacketRecord &packet);
+
+private:
+    Emitter emit;
+    double tickSeconds;
+    int64_t tickIndex = -1;
+
+    Histogram lengths[CLASS_COUNT];        // bytes
+    Histogram interArrivals[CLASS_COUNT];  // microseconds
+    double lastSeen[CLASS_COUNT] = {};     // timestamp of the previous packet per class
+
+    void record(TrafficClass trafficClass, const PacketRecord &packet);
+    void publish(int64_t index);
+};
+
+#endif // PACKETHISTOGRAMS_H
@@ -0,0 +1,127 @@
+#include "packetRing.h"
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+using namespace std;
+
+// Frame slots only bound the ring's accounting in V3, where frames are
+// packed into blocks at their own length
+static const uint32_t FRAME_SIZE = 2048;
+
+PacketRing::~PacketRing() {
+    if (ring) munmap(ring, ringSize);
+    if (sockfd >= 0) close(sockfd);
+}
+
+bool PacketRing::open(const string &interface, string &error, uint32_t size, uint32_t count, uint32_t timeoutMs) {
+    unsigned int ifindex = if_nametoindex(interface.c_str());
+    if (ifindex == 0) {
+        error = "no interface " + interface;
+        return false;
+    }
+
+    sockfd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (sockfd < 0) {
+        error = string("socket: ") + strerror(errno);
+        return false;
+    }
+
+    int version = TPACKET_V3;
+    if (setsockopt(sockfd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+        error = string("TPACKET_V3: ") + strerror(errno);
+        return false;
+    }
+
+    struct tpacket_req3 req = {};
+    req.tp_block_size = size;
+    req.tp_block_nr = count;
+    req.tp_frame_size = FRAME_SIZE;
+    req.tp_frame_nr = uint64_t(size) * count / FRAME_SIZE;
+    req.tp_retire_blk_tov = timeoutMs;
+    if (setsockopt(sockfd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+        error = string("ring of ") + to_string(count) + " x " + to_string(size) + " bytes: " + strerror(errno);
+        return false;
+    }
+
+    ringSize = size_t(size) * count;
+    void *mapped = mmap(nullptr, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, sockfd, 0);
+    if (mapped == MAP_FAILED) {
+        error = string("ring mmap: ") + strerror(errno);
+        ringSize = 0;
+        return false;
+    }
+    ring = static_cast<uint8_t *>(mapped);
+    blockSize = size;
+    blockCount = count;
+
+    struct sockaddr_ll addr = {};
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(ETH_P_ALL);
+    addr.sll_ifindex = ifindex;
+    if (bind(sockfd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+        error = string("bind to ") + interface + ": " + strerror(errno);
+        return false;
+    }
+
+    // Dropped by the kernel when the socket closes
+    struct packet_mreq membership = {};
+    membership.mr_ifindex = ifindex;
+    membership.mr_type = PACKET_MR_PROMISC;
+    if (setsockopt(sockfd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &membership, sizeof(membership)) < 0) {
+        error = string("promiscuous mode on ") + interface + ": " + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool PacketRing::next(vector<DecodedFrame> &frames) {
+    if (holding) release();
+
+    uint8_t *base = ring + size_t(current) * blockSize;
+    auto *block = reinterpret_cast<struct tpacket_block_desc *>(base);
+    if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) return false;
+    holding = true;
+
+    uint32_t count = block->hdr.bh1.num_pkts;
+    offsets.resize(count);
+    caplens.resize(count);
+    lens.resize(count);
+    timestamps.resize(count);
+
+    uint32_t at = block->hdr.bh1.offset_to_first_pkt;
+    for (uint32_t i = 0; i < count; ++i) {
+        auto *header = reinterpret_cast<const struct tpacket3_hdr *>(base + at);
+        offsets[i] = at + header->tp_mac;
+        caplens[i] = header->tp_snaplen;
+        lens[i] = header->tp_len;
+        timestamps[i] = header->tp_sec + header->tp_nsec / 1e9;
+        at += header->tp_next_offset;
+    }
+
+    frames.resize(count);
+    BatchDecoder::decode(base, offsets.data(), caplens.data(), lens.data(), timestamps.data(), count, frames.data());
+    return true;
+}
+
+void PacketRing::release() {
+    if (!holding) return;
+    auto *block = reinterpret_cast<struct tpacket_block_desc *>(ring + size_t(current) * blockSize);
+    __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    current = (current + 1) % blockCount;
+    holding = false;
+}
+
+uint64_t PacketRing::drops() {
+    // Reading the counters resets them
+    struct tpacket_stats_v3 stats = {};
+    socklen_t length = sizeof(stats);
+    if (getsockopt(sockfd, SOL_PACKET, PACKET_STATISTICS, &stats, &length) == 0) dropped += stats.tp_drops;
+    return dropped;
+}
@@ -0,0 +1,62 @@
+#ifndef PACKETRING_H
+#define PACKETRING_H
+
+#include "batchDecoder.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Capture through a TPACKET_V3 ring mapped from an AF_PACKET socket, in
+// place of libpcap. The kernel fills whole blocks of frames and hands each
+// block over at once; its frames stay where they are until the block is
+// given back, so a block is decoded in one BatchDecoder::decode() call
+// (8 frames per gather group on AVX2) and the records are processed
+// straight out of the ring, payloads included.
+//
+// A block is handed over when it is full or when it has waited
+// `blockTimeoutMs`, so a quiet link still delivers its frames promptly.
+// Needs CAP_NET_RAW (or root). The interface is put in promiscuous mode
+// for as long as the socket is open, as libpcap does.
+
+class PacketRing {
+public:
+    PacketRing() = default;
+    ~PacketRing();
+    PacketRing(const PacketRing &) = delete;
+    PacketRing &operator=(const PacketRing &) = delete;
+
+    // Open the socket, map the ring and bind it to `interface`; false with the reason in `error`
+    bool open(const std::string &interface, std::string &error, uint32_t blockSize = 1 << 20,
+              uint32_t blockCount = 64, uint32_t blockTimeoutMs = 100);
+
+    // For poll(): readable when the next block is ready
+    int fd() const { return sockfd; }
+
+    // Decode the frames of the next block the kernel has filled into
+    // `frames`; false if it has none ready. Payloads point into the ring,
+    // so the frames are good until release().
+    bool next(std::vector<DecodedFrame> &frames);
+    // Give the block from next() back to the kernel
+    void release();
+
+    // Frames the kernel dropped for lack of a free block, since open()
+    uint64_t drops();
+
+private:
+    int sockfd = -1;
+    uint8_t *ring = nullptr;
+    size_t ringSize = 0;
+    uint32_t blockSize = 0;
+    uint32_t blockCount = 0;
+    uint32_t current = 0; // next block to read
+    bool holding = false; // `current` was handed out by next() and not released yet
+    uint64_t dropped = 0;
+
+    // Per-block decode arguments, kept between blocks
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> caplens;
+    std::vector<uint32_t> lens;
+    std::vector<double> timestamps;
+};
+
+#endif // PACKETRING_H
@@ -7,10 +7,15 @@
 #include <nlohmann/json.hpp> // or nlohmann/json.hpp depending on your JSON library
 #include <set>
 #include <queue>
+#include <deque>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <map>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include "rttEstimator.h"
 
 using json = nlohmann::json; // Adjust based on your JSON library
 
@@ -26,6 +31,33 @@ struct Hop {
     std::vector<HopResponse> responses;
 };
 
+// Decoded header fields of a captured IPv4 packet, shared by the analysis stages
+struct PacketRecord {
+    enum Protocol : uint8_t { TCP = 0, UDP = 1, ICMP = 2, OTHER = 3 };
+    static const uint8_t FLAG_FIN = 0x01;
+    static const uint8_t FLAG_SYN = 0x02;
+    static const uint8_t FLAG_RST = 0x04;
+    static const uint8_t FLAG_PSH = 0x08;
+    static const uint8_t FLAG_ACK = 0x10;
+    static const uint8_t FLAG_URG = 0x20;
+
+    double timestamp = 0;
+    uint32_t srcAddr = 0; // network byte order
+    uint32_t dstAddr = 0;
+    uint32_t length = 0;
+    Protocol protocol = OTHER;
+    uint16_t srcPort = 0; // TCP/UDP only
+    uint16_t dstPort = 0;
+    uint8_t tcpFlags = 0; // FLAG_* bits
+    uint32_t tcpSeq = 0;  // TCP only, host byte order
+    uint32_t tcpAck = 0;
+    uint16_t tcpWindow = 0;     // as sent, without the window scale
+    uint16_t payloadLength = 0; // TCP/UDP payload bytes, from the IP total length
+    const uint8_t *payload = nullptr; // the captured part of the payload, only valid during add()
+    uint32_t payloadCaptured = 0;
+    uint32_t packets = 1; // more than 1 for in-kernel flow counts and sampled packets, `length` is then their total
+};
+
 // Traceroute task for thread pool
 struct TracerouteTask {
     std::string dstIP;
@@ -36,6 +68,9 @@ private:
     std::string target;
     int maxHops;
     int timeout;
+    uint16_t ident; // ICMP echo id, unique per instance so concurrent tracers ignore each other
+    PrefixRttTable *prefixRtts; // optional, shared across traces
+    int probesSent = 0;
 
     struct ProbeResult {
         bool success;
@@ -43,22 +78,102 @@ private:
         std::string responseIP;
     };
 
-    ProbeResult sendProbe(int sockfd, const struct sockaddr_in &targetAddr, int ttl, int probeNum);
+    ProbeResult sendProbe(int sockfd, const struct sockaddr_in &targetAddr, int ttl, int probeNum, double waitMs);
     Hop processProbesForHop(int ttl, const std::vector<ProbeResult> &probes);
-    unsigned short checksum(unsigned short *buf, int len);
 
 public:
-    Traceroute(const std::string &targetHost, int maxHops = 30, int timeout = 1000);
+    Traceroute(const std::string &targetHost, int maxHops = 30, int timeout = 1000,
+               PrefixRttTable *prefixRtts = nullptr);
     std::vector<Hop> performTrace();
+    int probeCount() const { return probesSent; } // probes put on the wire by this instance
+
+    static unsigned short checksum(unsigned short *buf, int len);
+    static uint16_t allocateIdent();
+    // Match an ICMP echo reply / time exceeded datagram against our echo id
+    static bool matchReply(const char *buffer, ssize_t len, uint16_t ident, uint16_t &sequence, bool &echoReply);
 };
 
+// Runtime options parsed from the command line
+struct SnifferConfig {
+    std::vector<std::string> interfaces;     // captured together, records say which one they came from
+    std::vector<std::string> monitorTargets; // destinations for continuous path monitoring
+    int monitorInterval = 5;                 // seconds between monitoring rounds
+    int monitorTop = 0;                      // heaviest destinations of each TOP_TALKERS report added to monitoring
+    std::string traceCachePath = "packets/traceroute_cache.bin"; // empty disables the cache
+    int traceCacheMaxAge = 3600;             // seconds before a cached path is re-traced
+    bool features = true;                    // emit FEATURES records for every window
+    double featureWindow = 0.2;              // tumbling window, seconds (dataExtracter.py uses 0.2)
+    int featureSlidingPanes = 5;             // tumbling windows per sliding window, 0 disables it
+    std::string featuresCsvPath;             // also write tumbling windows as network_features.csv rows
+    std::string anomalyModelPath = "models/isolation_forest.bin"; // export_model.py output, empty disables scoring
+    int topTalkers = 10;                     // entries per TOP_TALKERS list, 0 disables tracking
+    bool fanout = true;                      // FANOUT alerts for scans and fan-out
+    double fanoutWindow = 10;                // seconds per fan-out window
+    double fanoutPorts = 100;                // distinct ports per address and window that raise an alert
+    double fanoutPeers = 100;                // distinct peers per address and window that raise an alert
+    bool histograms = true;                  // HISTOGRAMS records with size / inter-arrival percentiles
+    double histogramInterval = 5;            // seconds between HISTOGRAMS records
+    bool changeDetection = true;             // CHANGE alerts for per-host rate shifts
+    double changeInterval = 1;               // seconds per rate sample
+    double changeThreshold = 8;              // CUSUM alarm level, in standard deviations
+    double changeMinRate = 20;               // packets per second below which hosts raise no alerts
+    std::string rulesPath;                   // alert rules run on every packet, empty disables them
+    bool tcpMetrics = true;                  // TCP_METRICS records with passive per-connection RTT and health
+    double tcpReportInterval = 5;            // seconds between TCP_METRICS records
+    bool tlsInspection = true;               // TLS records with the SNI and JA3 of every ClientHello
+    bool dnsSnooping = true;                 // DNS_BINDING records naming addresses from observed DNS answers
+    std::string prefixFile;                  // prefix list for NODE_TAG subnet / ASN / site tags, empty disables them
+    bool xdp = false;                        // count flows in the kernel with XDP instead of capturing packets
+    double xdpInterval = 1;                  // seconds between drains of the in-kernel flow counters
+    uint32_t xdpMaxFlows = 65536;            // flows the kernel map holds between drains
+    bool ring = false;                       // capture through a TPACKET_V3 ring and decode frames a block at a time
+    int shards = 0;                          // worker threads for exact TRAFFIC counters, 0 disables them
+    double trafficInterval = 1;              // seconds per TRAFFIC record
+    bool shedding = false;                   // sample, then drop per-packet records when the capture falls behind
+    uint32_t shedMaxRate = 256;              // sparsest sampling, 1 in this many, before counters only
+    std::string exportTarget;                // IPFIX / NetFlow v9 collector, host[:port], empty disables export
+    std::string exportFormat = "ipfix";      // "ipfix" or "v9"
+    double exportIdle = 15;                  // seconds without packets that end a flow record
+    double exportActive = 60;                // seconds after which a busy flow's record is sent anyway
+    std::string readFile;                    // replay this capture file instead of listening, as fast as it reads
+    std::string sensor;                      // name announced in a HELLO record first, for record_collector
+};
+
+class PathMonitor;
+class TraceCache;
+class RouteTrie;
+class WindowFeatures;
+class IsolationForest;
+class HeavyHitters;
+class FanoutTracker;
+class PacketHistograms;
+class ChangeDetector;
+class RuleEngine;
+class TcpMetrics;
+class TlsInspector;
+class DnsSnooper;
+class PrefixTagger;
+class XdpFlowCounter;
+class PacketRing;
+class FlowShards;
+class LoadShedder;
+class FlowExporter;
+struct DecodedFrame;
+
 class PacketSniffer {
 private:
     static const int MAX_CONCURRENT_TRACES = 4;
     
-    std::string interface;
-    pcap_t *handle;
+    SnifferConfig config;
     char errbuf[PCAP_ERRBUF_SIZE];
+
+    // One libpcap handle, and so one kernel ring, per interface
+    struct Capture {
+        std::string interface;
+        pcap_t *handle;
+    };
+    std::vector<Capture> captures;
+    const std::string *captureInterface = nullptr; // where the frame being processed came from
     
     // Packet storage
     json packets;
@@ -68,25 +183,99 @@ private:
     
     // Traceroute thread pool
     std::vector<std::thread> tracerThreads;
-    std::queue<TracerouteTask> taskQueue;
+    std::deque<TracerouteTask> taskQueue; // top talkers jump to the front
     std::mutex queueMutex;
     std::condition_variable queueCV;
     bool stopTracerThreads = false;
     std::set<std::string> tracedIPs;
+    PrefixRttTable prefixRtts;
+    std::unique_ptr<TraceCache> traceCache;
+    std::unique_ptr<RouteTrie> routeTrie; // traced paths with shared prefixes stored once
+
+    // Continuous path monitoring
+    std::unique_ptr<PathMonitor> pathMonitor;
+
+    // Per-window feature vectors for the anomaly model
+    std::unique_ptr<IsolationForest> anomalyModel; // outlives windowFeatures, which scores with it
+    std::unique_ptr<WindowFeatures> windowFeatures;
+
+    // Top sources, destinations, ports and edges over the last minute
+    std::unique_ptr<HeavyHitters> heavyHitters;
+
+    // Distinct ports and peers per address, for scan and fan-out alerts
+    std::unique_ptr<FanoutTracker> fanoutTracker;
+
+    // Packet size and inter-arrival distributions per traffic class
+    std::unique_ptr<PacketHistograms> packetHistograms;
+
+    // EWMA / CUSUM rate change points per source and destination
+    std::unique_ptr<ChangeDetector> changeDetector;
+
+    // Operator-defined RULE alerts, compiled from config.rulesPath
+    std::unique_ptr<RuleEngine> ruleEngine;
+
+    // Handshake RTTs, retransmissions and zero windows of every TCP connection
+    std::unique_ptr<TcpMetrics> tcpMetrics;
+
+    // SNI and JA3 fingerprints from TLS ClientHellos
+    std::unique_ptr<TlsInspector> tlsInspector;
+
+    // Address -> name bindings from the DNS responses on the wire
+    std::unique_ptr<DnsSnooper> dnsSnooper;
+
+    // Subnet, ASN and site of every address from a local prefix list, reloaded when it changes
+    std::unique_ptr<PrefixTagger> prefixTagger;
+
+    // Per-flow packet and byte counts from an XDP program, in place of pcap
+    std::vector<std::unique_ptr<XdpFlowCounter>> xdpCounters; // one per interface
+
+    // Memory-mapped capture rings, in place of libpcap, decoded block by block
+    std::vector<std::unique_ptr<PacketRing>> rings; // one per interface
+
+    // Exact host, edge and conversation counters kept on worker threads
+    std::unique_ptr<FlowShards> flowShards;
+
+    // Sampling level of per-packet records under load
+    std::unique_ptr<LoadShedder> loadShedder;
+    // Capture thread time is measured over groups of frames, not each one
+    static const int BUSY_FRAMES = 16;
+    int busyFrames = 0;
+    std::chrono::steady_clock::time_point busyStart;
+
+    // IPFIX / NetFlow v9 records of the conversations the shards expire
+    std::unique_ptr<FlowExporter> flowExporter;
+    std::atomic<bool> stopping{false};
+
+    // stdout is shared by the capture, tracer and monitor threads
+    std::mutex outputMutex;
+    bool outputClosed = false; // under outputMutex
     
-    void processPacket(const struct pcap_pkthdr *header, const u_char *packet);
+    void processCaptured(const DecodedFrame &frame);
+    void accountBusy();
+    void processFrame(const DecodedFrame &frame);
+    void updateShedding(double now);
+    bool runXdp();
+    bool runRing();
+    bool runReplay();
+    void processFlowCounts(XdpFlowCounter &counter, const std::string &interface, double timestamp);
     void saveToFile();
     void runTracerouteAsync(const std::string &dstIP);
+    void prioritizeTraces(const std::vector<std::string> &dstIPs);
     void tracerThreadFunc();
+    void replayTraceCache();
+    void emitRecord(const json &record);
     
     static void packetHandler(u_char *userData, const struct pcap_pkthdr *header, const u_char *packet);
 
 public:
-    PacketSniffer(const std::string &interfaceName);
+    PacketSniffer(const SnifferConfig &snifferConfig);
     ~PacketSniffer();
     
     bool start();
+    // Ends the capture loop; safe to call from a signal handler
     void stop();
+    // Emits what is still open once start() has returned, on its thread
+    void finish();
 };
 
 #endif // PACKETSNIFFER_H
\ No newline at end of file
@@ -0,0 +1,317 @@
+#include "pathMonitor.h"
+#include <iostream>
+#include <arpa/inet.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <csignal>
+#include <pthread.h>
+
+using namespace std;
+
+static const int DEFAULT_MONITOR_HOPS = 20;
+static const float RTT_GAIN = 1.0f / 8;    // same gains as TCP's SRTT
+static const float JITTER_GAIN = 1.0f / 16; // RFC 3550
+static const float LOSS_GAIN = 1.0f / 8;
+
+static double round2(double value) {
+    return std::round(value * 100.0) / 100.0;
+}
+
+static string addrToString(uint32_t addr) {
+    char buf[INET_ADDRSTRLEN];
+    struct in_addr in;
+    in.s_addr = addr;
+    inet_ntop(AF_INET, &in, buf, sizeof(buf));
+    return buf;
+}
+
+PathMonitor::PathMonitor(Emitter emitter, int intervalSec, int timeoutMs)
+    : emit(std::move(emitter)), interval(intervalSec), timeout(timeoutMs),
+      ident(Traceroute::allocateIdent()) {}
+
+PathMonitor::~PathMonitor() {
+    stop();
+}
+
+bool PathMonitor::addDestination(const std::string &ip) {
+    struct in_addr addr;
+    if (inet_aton(ip.c_str(), &addr) == 0) return false;
+
+    lock_guard<mutex> lock(pathsMutex);
+    if (paths.size() >= MAX_MONITORED_PATHS) return false;
+    for (const auto &path : paths)
+        if (path->dst == addr.s_addr) return false;
+
+    auto path = make_unique<MonitoredPath>();
+    path->dst = addr.s_addr;
+    path->hopCount = DEFAULT_MONITOR_HOPS;
+    paths.push_back(std::move(path));
+    return true;
+}
+
+void PathMonitor::start() {
+    if (monitorThread.joinable()) return;
+    stopping = false;
+    monitorThread = thread(&PathMonitor::monitorThreadFunc, this);
+}
+
+void PathMonitor::stop() {
+    {
+        lock_guard<mutex> lock(pathsMutex);
+        stopping = true;
+    }
+    wakeCV.notify_all();
+    if (monitorThread.joinable()) monitorThread.join();
+}
+
+void PathMonitor::monitorThreadFunc() {
+    // Signals go to the capture thread, so they break its pcap loop
+    sigset_t signals;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    int sockfd = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+    if (sockfd < 0) {
+        cerr << "[MONITOR ERROR] Failed to create raw socket (need root privileges)\n";
+        return;
+    }
+
+    while (!stopping) {
+        auto cycleStart = chrono::steady_clock::now();
+
+        // Paths are only ever appended, and only this thread touches their stats
+        vector<MonitoredPath *> roundPaths;
+        long probes = 0;
+        {
+            lock_guard<mutex> lock(pathsMutex);
+            for (const auto &path : paths) {
+                roundPaths.push_back(path.get());
+                probes += path->hopCount;
+            }
+        }
+        // The round's probes are spread over the interval less the last
+        // probe's timeout, so the round ends about when the next one is due
+        long budget = max(interval * 1000000L / 2, interval * 1000000L - timeout * 1000L);
+        auto spacing = chrono::microseconds(budget / max(1L, probes));
+
+        if (!roundPaths.empty()) probeRound(sockfd, roundPaths, spacing);
+
+        unique_lock<mutex> lock(pathsMutex);
+        wakeCV.wait_until(lock, cycleStart + chrono::seconds(interval), [this] { return stopping.load(); });
+    }
+
+    close(sockfd);
+}
+
+void PathMonitor::probeRound(int sockfd, const vector<MonitoredPath *> &roundPaths, chrono::microseconds spacing) {
+    using Clock = chrono::steady_clock;
+
+    // Sequence layout: round (2 bits) | path (9 bits) | ttl - 1 (5 bits).
+    // A round only ends once its last probe has timed out, so two bits are
+    // enough to tell a straggler from an earlier round
+    static_assert(MAX_MONITORED_PATHS <= 1 << 9 && MAX_MONITOR_HOPS <= 1 << 5, "sequence fields too narrow");
+    uint16_t roundBits = (round++ & 0x3) << 14;
+
+    struct Probing {
+        array<Clock::time_point, MAX_MONITOR_HOPS> sentAt;
+        array<bool, MAX_MONITOR_HOPS> answered;
+        int reachedAt = 0;
+        int outstanding = 0;
+        bool allSent = false;
+        bool done = false;
+        Clock::time_point deadline; // the last probe's timeout
+    };
+    vector<Probing> state(roundPaths.size());
+    auto probeTimeout = chrono::milliseconds(timeout);
+
+    // Path by path, so a router shared by many paths sees their probes
+    // spread over the round. Paths finish in the order they were probed,
+    // each once its probes are answered or timed out, while later paths
+    // are still being probed.
+    size_t nextPath = 0;
+    int nextTtl = 1;
+    size_t finished = 0; // paths before this one are done
+    auto nextSend = Clock::now();
+    while (!stopping) {
+        auto now = Clock::now();
+        while (finished < roundPaths.size()) {
+            Probing &probing = state[finished];
+            if (!probing.allSent || (probing.outstanding > 0 && now < probing.deadline)) break;
+            finishPath(*roundPaths[finished], probing.answered, probing.reachedAt);
+            probing.done = true;
+            finished++;
+        }
+        if (finished == roundPaths.size()) break;
+
+        if (nextPath < roundPaths.size() && now >= nextSend) {
+            size_t index = nextPath;
+            int ttl = nextTtl;
+            Probing &probing = state[index];
+            if (ttl == 1) probing.answered.fill(true); // untouched TTLs are never counted as lost
+            if (++nextTtl > roundPaths[index]->hopCount) {
+                nextPath++;
+                nextTtl = 1;
+                probing.allSent = true;
+                probing.deadline = now + probeTimeout;
+            }
+            nextSend += spacing; // on schedule, not after each wake-up's slack
+            if (setsockopt(sockfd, IPPROTO_IP, IP_TTL, &ttl, sizeof(ttl)) < 0) continue;
+
+            struct icmphdr icmp;
+            memset(&icmp, 0, sizeof(icmp));
+            icmp.type = ICMP_ECHO;
+            icmp.un.echo.id = ident;
+            icmp.un.echo.sequence = roundBits | (index << 5) | (ttl - 1);
+            icmp.checksum = Traceroute::checksum((unsigned short *)&icmp, sizeof(icmp));
+
+            struct sockaddr_in targetAddr;
+            memset(&targetAddr, 0, sizeof(targetAddr));
+            targetAddr.sin_family = AF_INET;
+            targetAddr.sin_addr.s_addr = roundPaths[index]->dst;
+
+            probing.sentAt[ttl - 1] = Clock::now();
+            if (sendto(sockfd, &icmp, sizeof(icmp), 0, (struct sockaddr *)&targetAddr, sizeof(targetAddr)) < 0)
+                continue;
+
+            probing.answered[ttl - 1] = false;
+            probing.outstanding++;
+            continue;
+        }
+
+        // Wake for the next send or the oldest unfinished path's deadline
+        auto wakeAt = nextPath < roundPaths.size() ? nextSend : Clock::time_point::max();
+        if (state[finished].allSent) wakeAt = min(wakeAt, state[finished].deadline);
+        auto remaining = max(0L, long(chrono::duration_cast<chrono::microseconds>(wakeAt - now).count()));
+        fd_set readfds;
+        struct timeval tv;
+        tv.tv_sec = remaining / 1000000;
+        tv.tv_usec = remaining % 1000000;
+        FD_ZERO(&readfds);
+        FD_SET(sockfd, &readfds);
+        if (select(sockfd + 1, &readfds, nullptr, nullptr, &tv) <= 0) continue;
+
+        char buffer[1024];
+        struct sockaddr_in fromAddr;
+        socklen_t fromLen = sizeof(fromAddr);
+        ssize_t bytesReceived = recvfrom(sockfd, buffer, sizeof(buffer), 0, (struct sockaddr *)&fromAddr, &fromLen);
+        auto receivedAt = Clock::now();
+
+        uint16_t sequence;
+        bool echoReply;
+        if (bytesReceived <= 0 || !Traceroute::matchReply(buffer, bytesReceived, ident, sequence, echoReply)) continue;
+        if ((sequence & 0xC000) != roundBits) continue; // late reply from an earlier round
+
+        size_t index = (sequence >> 5) & 0x1FF;
+        int ttl = (sequence & 0x1F) + 1;
+        if (index >= roundPaths.size() || state[index].done || ttl > roundPaths[index]->hopCount) continue;
+        Probing &probing = state[index];
+        // Answers past their own probe's timeout count as lost, as they would have in a shorter round
+        if (probing.answered[ttl - 1] || receivedAt - probing.sentAt[ttl - 1] > probeTimeout) continue;
+
+        probing.answered[ttl - 1] = true;
+        probing.outstanding--;
+
+        double rtt = chrono::duration_cast<chrono::microseconds>(receivedAt - probing.sentAt[ttl - 1]).count() / 1000.0;
+        updateHop(roundPaths[index]->hops[ttl - 1], fromAddr.sin_addr.s_addr, rtt);
+
+        if (echoReply && (probing.reachedAt == 0 || ttl < probing.reachedAt)) probing.reachedAt = ttl;
+    }
+    // Stopped halfway: the unanswered probes of unfinished paths say nothing about them
+}
+
+// A path's probes of this round are all answered or timed out
+void PathMonitor::finishPath(MonitoredPath &path, const array<bool, MAX_MONITOR_HOPS> &answered, int reachedAt) {
+    int limit = reachedAt ? reachedAt : path.hopCount;
+    for (int ttl = 1; ttl <= limit; ++ttl)
+        if (!answered[ttl - 1]) updateHop(path.hops[ttl - 1], 0, -1.0);
+
+    // Follow the path length: stop at the target, grow while it stays silent
+    if (reachedAt) {
+        for (int ttl = reachedAt + 1; ttl <= path.hopCount; ++ttl) {
+            path.hops[ttl - 1] = HopStats();
+            path.reported[ttl - 1] = HopStats();
+        }
+        path.hopCount = reachedAt;
+    } else if (path.hopCount < MAX_MONITOR_HOPS) {
+        path.hopCount = min(MAX_MONITOR_HOPS, path.hopCount + 2);
+    }
+    emitChanges(path);
+}
+
+void PathMonitor::updateHop(HopStats &hop, uint32_t addr, double rtt) {
+    hop.sent++;
+
+    if (rtt < 0) {
+        hop.loss += (1.0f - hop.loss) * LOSS_GAIN;
+        return;
+    }
+    hop.loss -= hop.loss * LOSS_GAIN;
+
+    float sample = static_cast<float>(rtt);
+    if (hop.addr != addr) {
+        // Route change: statistics of the previous router no longer apply
+        hop.addr = addr;
+        hop.received = 0;
+    }
+
+    if (hop.received++ == 0) {
+        hop.min = hop.max = hop.avg = sample;
+        hop.jitter = 0;
+    } else {
+        hop.min = min(hop.min, sample);
+        hop.max = max(hop.max, sample);
+        hop.avg += (sample - hop.avg) * RTT_GAIN;
+        hop.jitter += (fabs(sample - hop.last) - hop.jitter) * JITTER_GAIN;
+    }
+    hop.last = sample;
+}
+
+bool PathMonitor::hopChanged(const HopStats &current, const HopStats &reported) const {
+    if (current.sent == 0) return false;
+    if (reported.sent == 0) return current.received > 0 || current.loss >= lossThreshold;
+    if (current.addr != reported.addr) return true;
+    if (fabs(current.loss - reported.loss) >= lossThreshold) return true;
+    if (current.received == 0) return false;
+
+    double rttThreshold = max(rttThresholdMs, rttThresholdFraction * reported.avg);
+    return fabs(current.avg - reported.avg) > rttThreshold ||
+           fabs(current.jitter - reported.jitter) > rttThreshold;
+}
+
+void PathMonitor::emitChanges(MonitoredPath &path) {
+    json changed = json::array();
+
+    for (int i = 0; i < path.hopCount; ++i) {
+        HopStats &hop = path.hops[i];
+        if (!hopChanged(hop, path.reported[i])) continue;
+
+        json hopData;
+        hopData["ttl"] = i + 1;
+        hopData["ip"] = hop.addr ? addrToString(hop.addr) : "*";
+        hopData["loss"] = round2(hop.loss);
+        if (hop.received > 0) {
+            hopData["last"] = round2(hop.last);
+            hopData["min"] = round2(hop.min);
+            hopData["avg"] = round2(hop.avg);
+            hopData["max"] = round2(hop.max);
+            hopData["jitter"] = round2(hop.jitter);
+        }
+        changed.push_back(hopData);
+        path.reported[i] = hop;
+    }
+
+    if (changed.empty()) return;
+
+    json update;
+    update["protocol"] = "PATH_UPDATE";
+    update["dst_ip"] = addrToString(path.dst);
+    update["timestamp"] = time(nullptr);
+    update["hop_count"] = path.hopCount;
+    update["hops"] = changed;
+    emit(update);
+}
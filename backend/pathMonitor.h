@@ -0,0 +1,81 @@
+#ifndef PATHMONITOR_H
+#define PATHMONITOR_H
+
+#include "packetSniffer.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <netinet/in.h>
+
+// Continuous mtr-style monitoring of a set of destinations.
+// Every round sends one probe per TTL to each destination and folds the
+// answers into fixed-size per-hop statistics. Probes are paced across the
+// round rather than sent in one burst, so routers' ICMP rate limits do not
+// show up as loss, and a path is wrapped up as soon as its own probes have
+// timed out while later paths are probed, so a round of hundreds of paths
+// still fits its interval. Only hops whose address or statistics moved past a
+// threshold are emitted.
+
+static const int MAX_MONITOR_HOPS = 30;
+static const int MAX_MONITORED_PATHS = 512;
+
+struct HopStats {
+    uint32_t addr = 0;   // network byte order, 0 = never answered
+    uint32_t sent = 0;
+    uint32_t received = 0;
+    float last = 0;      // ms
+    float min = 0;
+    float max = 0;
+    float avg = 0;       // EWMA, follows trends instead of the whole history
+    float jitter = 0;    // RFC 3550 style smoothed |delta|
+    float loss = 0;      // EWMA of unanswered probes, 0..1
+};
+
+struct MonitoredPath {
+    uint32_t dst = 0;    // network byte order
+    int hopCount = MAX_MONITOR_HOPS; // probed TTL range, shrinks once the target answers
+    std::array<HopStats, MAX_MONITOR_HOPS> hops;
+    std::array<HopStats, MAX_MONITOR_HOPS> reported; // state at last emission
+};
+
+class PathMonitor {
+public:
+    using Emitter = std::function<void(const json &)>;
+
+    PathMonitor(Emitter emitter, int intervalSec = 5, int timeoutMs = 1000);
+    ~PathMonitor();
+
+    // Any thread; false for invalid or duplicate addresses and past MAX_MONITORED_PATHS
+    bool addDestination(const std::string &ip);
+    void start();
+    void stop();
+
+private:
+    Emitter emit;
+    int interval;
+    int timeout;
+    // Thresholds that decide whether a hop is worth re-emitting
+    double rttThresholdMs = 5.0;
+    double rttThresholdFraction = 0.2;
+    double lossThreshold = 0.05;
+
+    uint16_t ident;
+    uint8_t round = 0;
+
+    std::vector<std::unique_ptr<MonitoredPath>> paths;
+    std::mutex pathsMutex;
+    std::condition_variable wakeCV;
+    std::atomic<bool> stopping{false};
+    std::thread monitorThread;
+
+    void monitorThreadFunc();
+    void probeRound(int sockfd, const std::vector<MonitoredPath *> &roundPaths, std::chrono::microseconds spacing);
+    void finishPath(MonitoredPath &path, const std::array<bool, MAX_MONITOR_HOPS> &answered, int reachedAt);
+    void updateHop(HopStats &hop, uint32_t addr, double rtt);
+    bool hopChanged(const HopStats &current, const HopStats &reported) const;
+    void emitChanges(MonitoredPath &path);
+};
+
+#endif // PATHMONITOR_H
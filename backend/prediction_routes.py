@@ -1,5 +1,5 @@
 from flask import Blueprint, request, jsonify
-from malicious_predictor import predict_malicious_packet, load_model
+from malicious_predictor import predict_malicious_packet, predict_malicious_packets, load_model
 
 # Create a Blueprint for prediction routes
 prediction_bp = Blueprint('prediction', __name__)
@@ -7,6 +7,9 @@ prediction_bp = Blueprint('prediction', __name__)
 # Global variable to track model loading status
 malicious_model_loaded = False
 
+# Largest batch accepted by /predict/malicious-packets/batch
+MAX_BATCH_SIZE = 256
+
 def initialize_model():
     """Initialize the malicious packet detection model"""
     global malicious_model_loaded
@@ -17,6 +20,19 @@ def initialize_model():
         print("[SUCCESS] Malicious packet detection model loaded successfully")
     return malicious_model_loaded
 
+def serializable_prediction(result):
+    """Convert numpy/bool types to Python native types for JSON serialization"""
+    if result.get('status') != 'success':
+        return result
+    return {
+        'status': str(result.get('status', 'success')),
+        'is_malicious': bool(result.get('is_malicious', False)),
+        'anomaly_score': float(result.get('anomaly_score', 0.0)),
+        'risk_level': str(result.get('risk_level', 'UNKNOWN')),
+        'attack_type': str(result.get('attack_type', 'None')),
+        'prediction_confidence': str(result.get('prediction_confidence', 'Low'))
+    }
+
 @prediction_bp.route('/predict/malicious-packet', methods=['POST'])
 def predict_malicious_packet_endpoint():
     """
@@ -121,18 +137,7 @@ def predict_malicious_packet_endpoint():
         # Call the prediction function
         result = predict_malicious_packet(data)
         
-        # Convert numpy/bool types to Python native types for JSON serialization
-        if result.get('status') == 'success':
-            serializable_result = {
-                'status': str(result.get('status', 'success')),
-                'is_malicious': bool(result.get('is_malicious', False)),
-                'anomaly_score': float(result.get('anomaly_score', 0.0)),
-                'risk_level': str(result.get('risk_level', 'UNKNOWN')),
-                'attack_type': str(result.get('attack_type', 'None')),
-                'prediction_confidence': str(result.get('prediction_confidence', 'Low'))
-            }
-        else:
-            serializable_result = result
+        serializable_result = serializable_prediction(result)
         
         # Log the prediction
         print(f"[PREDICTION] Packet: size={packet_size}, duration={duration}, "
@@ -151,6 +156,85 @@ def predict_malicious_packet_endpoint():
         }), 500
 
 
+@prediction_bp.route('/predict/malicious-packets/batch', methods=['POST'])
+def predict_malicious_packets_endpoint():
+    """
+    Predict a batch of packets in one model pass
+    
+    Expected JSON payload:
+    {
+        "packets": [
+            {"id": "42", "packet_size": 500, "duration": 2.5, "dst_port": 80, "protocol": 6, "syn_flag": 0},
+            ...
+        ]
+    }
+    
+    "id" is an optional correlation id, echoed back with the packet's result.
+    Results come back in request order; a packet that fails validation gets
+    "status": "error" without failing the rest of the batch.
+    
+    Returns:
+    {
+        "status": "success",
+        "count": 1,
+        "results": [
+            {"id": "42", "status": "success", "is_malicious": false, "anomaly_score": -0.42, ...}
+        ]
+    }
+    """
+    if not request.is_json:
+        return jsonify({
+            "status": "error",
+            "error": "Content-Type must be application/json"
+        }), 400
+    
+    if not malicious_model_loaded:
+        return jsonify({
+            "status": "error",
+            "error": "Malicious packet detection model not available",
+            "message": "Please ensure the model file exists at models/malicious_packet_model.pkl"
+        }), 503
+    
+    data = request.get_json(silent=True) or {}
+    packets = data.get('packets')
+    if not isinstance(packets, list) or not all(isinstance(p, dict) for p in packets):
+        return jsonify({
+            "status": "error",
+            "error": "Expected a 'packets' array of packet objects"
+        }), 400
+    
+    if len(packets) > MAX_BATCH_SIZE:
+        return jsonify({
+            "status": "error",
+            "error": f"Batch too large: {len(packets)} packets, at most {MAX_BATCH_SIZE}"
+        }), 413
+    
+    try:
+        results = []
+        for packet, result in zip(packets, predict_malicious_packets(packets)):
+            result = serializable_prediction(result)
+            if 'id' in packet:
+                result['id'] = packet['id']
+            results.append(result)
+        
+        malicious = sum(1 for result in results if result.get('is_malicious'))
+        print(f"[PREDICTION] Batch of {len(results)} packets -> {malicious} malicious")
+        
+        return jsonify({
+            "status": "success",
+            "count": len(results),
+            "results": results
+        }), 200
+        
+    except Exception as e:
+        print(f"[ERROR] Batch prediction failed: {str(e)}")
+        return jsonify({
+            "status": "error",
+            "error": "Prediction failed",
+            "message": str(e)
+        }), 500
+
+
 @prediction_bp.route('/predict/health', methods=['GET'])
 def health_check():
     """Health check endpoint for prediction service"""
@@ -160,6 +244,7 @@ def health_check():
         "model_loaded": malicious_model_loaded,
         "endpoints": {
             "/predict/malicious-packet": "POST - Detect malicious network packets",
+            "/predict/malicious-packets/batch": f"POST - Detect up to {MAX_BATCH_SIZE} packets per request, results keyed by id",
             "/predict/health": "GET - Check prediction service health"
         }
     }), 200
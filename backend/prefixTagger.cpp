@@ -0,0 +1,131 @@
+#include "prefixTagger.h"
+#include <iostream>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <csignal>
+#include <pthread.h>
+
+using namespace std;
+
+static string addrToString(uint32_t addr) {
+    char buf[INET_ADDRSTRLEN];
+    struct in_addr in;
+    in.s_addr = addr;
+    inet_ntop(AF_INET, &in, buf, sizeof(buf));
+    return buf;
+}
+
+// Modification time (ns) and size identify a version of the prefix list
+static bool sourceVersion(const string &path, int64_t &mtime, uint64_t &size) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) return false;
+    mtime = int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    size = uint64_t(info.st_size);
+    return true;
+}
+
+PrefixTagger::PrefixTagger(Emitter emitter, const string &sourcePath, size_t maxAddresses)
+    : emit(std::move(emitter)), sourcePath(sourcePath), imagePath(sourcePath + ".lpm"), maxAddresses(maxAddresses) {}
+
+PrefixTagger::~PrefixTagger() {
+    if (builder.joinable()) builder.join();
+}
+
+bool PrefixTagger::load() {
+    sourceVersion(sourcePath, attemptedMtime, attemptedSize);
+    current = compileAndMap(true);
+    if (!current) return false;
+    cerr << "🗺️  Tagging addresses from " << current->prefixCount() << " prefixes in " << sourcePath << " ("
+         << current->imageBytes() / 1024 << " KB mapped)\n";
+    return true;
+}
+
+unique_ptr<LpmTable> PrefixTagger::compileAndMap(bool reuseImage) {
+    string error;
+    int64_t mtime = 0;
+    uint64_t size = 0;
+    bool haveSource = sourceVersion(sourcePath, mtime, size);
+
+    // An image compiled from this very version of the list needs no rebuild
+    if (reuseImage) {
+        unique_ptr<LpmTable> table = LpmTable::map(imagePath, error);
+        if (table && (!haveSource || (table->sourceMtime() == mtime && table->sourceSize() == size))) return table;
+    }
+
+    if (!LpmTable::compile(sourcePath, imagePath, error)) {
+        cerr << "⚠️  Prefix list: " << error << "\n";
+        return nullptr;
+    }
+    unique_ptr<LpmTable> table = LpmTable::map(imagePath, error);
+    if (!table) cerr << "⚠️  Prefix list: " << error << "\n";
+    return table;
+}
+
+void PrefixTagger::add(const PacketRecord &packet) {
+    if (ready.load(memory_order_acquire)) {
+        // Nothing else reads `current`, so the old table can go right away
+        current = std::move(next);
+        ready.store(false, memory_order_release);
+        cerr << "🗺️  Reloaded " << current->prefixCount() << " prefixes from " << sourcePath << "\n";
+    }
+    if (packet.timestamp >= nextCheck) {
+        nextCheck = packet.timestamp + CHECK_INTERVAL;
+        checkForChanges();
+    }
+    if (!current) return;
+
+    tag(packet.srcAddr, packet.timestamp);
+    tag(packet.dstAddr, packet.timestamp);
+}
+
+void PrefixTagger::checkForChanges() {
+    // One compile at a time, and none while a finished one waits to be swapped in
+    if (building.load(memory_order_acquire) || ready.load(memory_order_acquire)) return;
+
+    int64_t mtime = 0;
+    uint64_t size = 0;
+    if (!sourceVersion(sourcePath, mtime, size) || (mtime == attemptedMtime && size == attemptedSize)) return;
+    attemptedMtime = mtime;
+    attemptedSize = size;
+
+    if (builder.joinable()) builder.join();
+    building.store(true, memory_order_release);
+    builder = thread([this]() {
+        // Signals go to the capture thread, so they break its pcap loop
+        sigset_t signals;
+        sigfillset(&signals);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        unique_ptr<LpmTable> table = compileAndMap(false);
+        if (table) {
+            next = std::move(table);
+            ready.store(true, memory_order_release);
+        }
+        building.store(false, memory_order_release);
+    });
+}
+
+void PrefixTagger::tag(uint32_t addr, double timestamp) {
+    const PrefixTag *match = current->lookup(addr);
+    uint32_t hash = match ? match->hash : 0;
+
+    if (announced.size() >= maxAddresses) announced.clear(); // start over rather than grow
+    auto entry = announced.insert(addr, hash);
+    if (entry.second ? hash == 0 : *entry.first == hash) return;
+    *entry.first = hash;
+
+    json record;
+    record["protocol"] = "NODE_TAG";
+    record["ip"] = addrToString(addr);
+    record["timestamp"] = timestamp;
+    if (match) {
+        record["subnet"] = current->text(match->prefix);
+        record["asn"] = match->asn ? json(match->asn) : json(nullptr);
+        record["site"] = match->site ? json(current->text(match->site)) : json(nullptr);
+    } else {
+        // A reload dropped the prefix this address was tagged with
+        record["subnet"] = nullptr;
+        record["asn"] = nullptr;
+        record["site"] = nullptr;
+    }
+    emit(record);
+}
@@ -0,0 +1,57 @@
+#ifndef PREFIXTAGGER_H
+#define PREFIXTAGGER_H
+
+#include "packetSniffer.h"
+#include "flatTable.h"
+#include "lpmTable.h"
+#include <atomic>
+#include <functional>
+#include <thread>
+
+// Tags every address the sniffer sees with the subnet, ASN and site of its
+// longest matching prefix in a local prefix list (format in lpmTable.h).
+// A NODE_TAG record goes out the first time an address matches, and again
+// if a reload changes its tag. The list is compiled to `<file>.lpm` next to
+// it and mapped. The file is checked for changes every few seconds; a new
+// version is compiled and mapped by a background thread and swapped in by
+// the capture thread between two packets, so lookups never wait on a reload
+// and always see one complete table.
+
+class PrefixTagger {
+public:
+    using Emitter = std::function<void(const json &)>;
+
+    PrefixTagger(Emitter emitter, const std::string &sourcePath, size_t maxAddresses = 262144);
+    ~PrefixTagger();
+
+    // Map the compiled list, compiling it first if it is missing or older
+    // than the list; false, with the reason on stderr, if neither works
+    bool load();
+    void add(const PacketRecord &packet);
+
+    const LpmTable *table() const { return current.get(); }
+
+private:
+    static constexpr double CHECK_INTERVAL = 2; // seconds between looks at the list's mtime
+
+    Emitter emit;
+    std::string sourcePath;
+    std::string imagePath;
+    size_t maxAddresses;
+    std::unique_ptr<LpmTable> current;
+    FlatTable<uint32_t, uint32_t> announced; // address -> hash of the tag last sent, 0 for none
+    double nextCheck = 0;
+    int64_t attemptedMtime = 0;  // version of the list last compiled, successfully or not
+    uint64_t attemptedSize = 0;
+
+    std::thread builder;
+    std::atomic<bool> building{false};
+    std::atomic<bool> ready{false}; // `next` holds a table for the capture thread
+    std::unique_ptr<LpmTable> next;
+
+    std::unique_ptr<LpmTable> compileAndMap(bool reuseImage);
+    void checkForChanges();
+    void tag(uint32_t addr, double timestamp);
+};
+
+#endif // PREFIXTAGGER_H
@@ -0,0 +1,117 @@
+#include "routeTrie.h"
+#include <arpa/inet.h>
+#include <cmath>
+
+using namespace std;
+
+RouteTrie::RouteTrie(size_t maxNodes) : maxNodes(maxNodes) {
+    clear();
+}
+
+void RouteTrie::clear() {
+    children.clear();
+    nodeCount = 1; // root: this host
+}
+
+size_t RouteTrie::size() {
+    lock_guard<mutex> lock(trieMutex);
+    return nodeCount;
+}
+
+void RouteTrie::insert(const vector<Hop> &hops, const function<void(const RouteAttachment &)> &report) {
+    // One representative per TTL: the first router that answered
+    vector<RouteNode> path;
+    for (const auto &hop : hops) {
+        RouteNode node;
+        node.ttl = static_cast<uint8_t>(hop.ttl);
+        for (const auto &response : hop.responses) {
+            struct in_addr addr;
+            if (response.ip == "*" || inet_aton(response.ip.c_str(), &addr) == 0) continue;
+
+            double sum = 0;
+            int answered = 0;
+            for (double rtt : response.rtts) {
+                if (rtt > 0) {
+                    sum += rtt;
+                    answered++;
+                }
+            }
+            node.addr = addr.s_addr;
+            node.rtt = answered ? sum / answered : 0;
+            break;
+        }
+        path.push_back(node);
+    }
+
+    RouteAttachment attachment;
+    lock_guard<mutex> lock(trieMutex);
+
+    // Count the nodes this path would add; start over when they do not fit
+    size_t shared = 0;
+    for (uint32_t current = ROOT; shared < path.size(); ++shared) {
+        auto it = children.find((static_cast<uint64_t>(current) << 32) | path[shared].addr);
+        if (it == children.end()) break;
+        current = it->second;
+    }
+    if (nodeCount + (path.size() - shared) > maxNodes) {
+        clear();
+        attachment.reset = true;
+    }
+
+    uint32_t current = ROOT;
+    bool diverged = false;
+    for (auto &node : path) {
+        uint64_t key = (static_cast<uint64_t>(current) << 32) | node.addr;
+        auto it = diverged ? children.end() : children.find(key);
+        if (it != children.end()) {
+            current = it->second;
+            continue;
+        }
+
+        if (!diverged) {
+            attachment.attachAt = current;
+            diverged = true;
+        }
+        node.id = nextId++;
+        node.parent = current;
+        nodeCount++;
+        children.emplace(key, node.id);
+        attachment.added.push_back(node);
+        current = node.id;
+    }
+
+    if (!diverged) attachment.attachAt = current;
+    attachment.leaf = current;
+    report(attachment);
+}
+
+json RouteTrie::toJson(const string &dstIP, const RouteAttachment &attachment, time_t timestamp) {
+    json route;
+    route["protocol"] = "ROUTE";
+    route["dst_ip"] = dstIP;
+    route["timestamp"] = timestamp;
+    if (attachment.reset) route["reset"] = true;
+    route["attach"] = attachment.attachAt;
+    route["leaf"] = attachment.leaf;
+
+    // Each node's parent is the node before it (the first one hangs from "attach")
+    json nodesArray = json::array();
+    for (const auto &node : attachment.added) {
+        json nodeData;
+        nodeData["id"] = node.id;
+        nodeData["ttl"] = node.ttl;
+        if (node.addr) {
+            char buf[INET_ADDRSTRLEN];
+            struct in_addr in;
+            in.s_addr = node.addr;
+            inet_ntop(AF_INET, &in, buf, sizeof(buf));
+            nodeData["ip"] = buf;
+            nodeData["rtt"] = std::round(node.rtt * 100.0) / 100.0;
+        } else {
+            nodeData["ip"] = "*";
+        }
+        nodesArray.push_back(nodeData);
+    }
+    route["nodes"] = nodesArray;
+    return route;
+}
@@ -0,0 +1,54 @@
+#ifndef ROUTETRIE_H
+#define ROUTETRIE_H
+
+#include "packetSniffer.h"
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+// Traced paths kept as a tree rooted at this host. A hop shared by many
+// paths is stored once; a new trace only adds the suffix that was not known
+// yet, and is reported as "attach these nodes below node X".
+
+struct RouteNode {
+    uint32_t id = 0;
+    uint32_t parent = 0;
+    uint32_t addr = 0; // network byte order, 0 = hop did not answer
+    uint8_t ttl = 0;
+    float rtt = 0;     // average RTT when the node was discovered
+};
+
+struct RouteAttachment {
+    bool reset = false;          // trie was full and started over; consumers drop their copy
+    uint32_t attachAt = 0;       // existing node the new suffix hangs from
+    uint32_t leaf = 0;           // last node of the path
+    std::vector<RouteNode> added;
+};
+
+class RouteTrie {
+public:
+    static const uint32_t ROOT = 0;
+
+    explicit RouteTrie(size_t maxNodes = 65536);
+
+    // Adds a traced path and hands what it attached to `report` before the
+    // trie lock is released, so reports go out in the order they were made
+    // and a record never names a node that an earlier record has not sent.
+    void insert(const std::vector<Hop> &hops, const std::function<void(const RouteAttachment &)> &report);
+    size_t size();
+
+    static json toJson(const std::string &dstIP, const RouteAttachment &attachment, time_t timestamp);
+
+private:
+    size_t maxNodes;
+    size_t nodeCount = 0;
+    // Ids are not reused after a reset, so a consumer still holding an old
+    // id (a path's leaf) finds nothing rather than a different hop
+    uint32_t nextId = ROOT + 1;
+    std::unordered_map<uint64_t, uint32_t> children; // (parent id, addr) -> child id
+    std::mutex trieMutex;
+
+    void clear();
+};
+
+#endif // ROUTETRIE_H
@@ -0,0 +1,60 @@
+#include "rttEstimator.h"
+#include <algorithm>
+#include <cmath>
+#include <arpa/inet.h>
+
+using namespace std;
+
+void RttEstimator::addSample(double rtt) {
+    if (samples++ == 0) {
+        srtt = rtt;
+        rttvar = rtt / 2;
+        return;
+    }
+    rttvar = 0.75 * rttvar + 0.25 * fabs(srtt - rtt);
+    srtt = 0.875 * srtt + 0.125 * rtt;
+}
+
+double RttEstimator::timeout(double minMs, double maxMs, double fallback) const {
+    if (samples == 0) return fallback;
+    return min(maxMs, max(minMs, srtt + 4 * rttvar));
+}
+
+uint64_t PrefixRttTable::makeKey(uint32_t dstAddr, int ttl) {
+    uint32_t prefix = ntohl(dstAddr) & 0xFFFFFF00;
+    return (static_cast<uint64_t>(prefix) << 8) | static_cast<uint8_t>(ttl);
+}
+
+bool PrefixRttTable::lookup(uint32_t dstAddr, int ttl, PrefixHopState &state) {
+    lock_guard<mutex> lock(tableMutex);
+    auto it = entries.find(makeKey(dstAddr, ttl));
+    if (it == entries.end()) return false;
+    recency.splice(recency.begin(), recency, it->second.recent);
+    state = it->second.state;
+    return true;
+}
+
+void PrefixRttTable::update(uint32_t dstAddr, int ttl, const RttEstimator &traceRtt, bool answered) {
+    lock_guard<mutex> lock(tableMutex);
+
+    uint64_t key = makeKey(dstAddr, ttl);
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        if (entries.size() >= MAX_ENTRIES) {
+            entries.erase(recency.back());
+            recency.pop_back();
+        }
+        recency.push_front(key);
+        it = entries.emplace(key, Entry{PrefixHopState(), recency.begin()}).first;
+    } else {
+        recency.splice(recency.begin(), recency, it->second.recent);
+    }
+
+    PrefixHopState &state = it->second.state;
+    if (answered) {
+        state.rtt.addSample(traceRtt.srtt);
+        state.silentTraces = 0;
+    } else if (state.silentTraces < 255) {
+        state.silentTraces++;
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef RTTESTIMATOR_H
+#define RTTESTIMATOR_H
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+// Smoothed RTT estimator in the style of TCP (RFC 6298), all values in ms
+struct RttEstimator {
+    double srtt = 0;
+    double rttvar = 0;
+    int samples = 0;
+
+    void addSample(double rtt);
+    // Retransmission-style timeout, or fallback when nothing was measured yet
+    double timeout(double minMs, double maxMs, double fallback) const;
+};
+
+// What earlier traces learned about one TTL towards a destination prefix
+struct PrefixHopState {
+    RttEstimator rtt;
+    uint8_t silentTraces = 0; // consecutive traces in which this hop never answered
+};
+
+// RTT estimates per (destination /24, ttl), shared by all tracer threads so a
+// new trace starts with deadlines learned from earlier traces to the same network.
+// A full table forgets the entry used least recently.
+class PrefixRttTable {
+public:
+    static const size_t MAX_ENTRIES = 16384;
+
+    bool lookup(uint32_t dstAddr, int ttl, PrefixHopState &state);
+    void update(uint32_t dstAddr, int ttl, const RttEstimator &traceRtt, bool answered);
+
+private:
+    struct Entry {
+        PrefixHopState state;
+        std::list<uint64_t>::iterator recent; // position in `recency`
+    };
+
+    std::unordered_map<uint64_t, Entry> entries;
+    std::list<uint64_t> recency; // keys, most recently used first
+    std::mutex tableMutex;
+
+    static uint64_t makeKey(uint32_t dstAddr, int ttl);
+};
+
+#endif // RTTESTIMATOR_H
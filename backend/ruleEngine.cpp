@@ -0,0 +1,699 @@
+#include "ruleEngine.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <arpa/inet.h>
+
+using namespace std;
+
+static string addrToString(uint32_t addr) {
+    char buf[INET_ADDRSTRLEN];
+    struct in_addr in;
+    in.s_addr = addr;
+    inet_ntop(AF_INET, &in, buf, sizeof(buf));
+    return buf;
+}
+
+// IANA numbers for the proto field; the decoder does not keep the number of other protocols
+static const uint32_t PROTO_NUMBERS[] = {6, 17, 1, 255}; // by PacketRecord::Protocol
+
+// Recursive-descent compiler from one rule line to RuleEngine bytecode
+class RuleCompiler {
+public:
+    RuleCompiler(RuleEngine &engine, const string &line) : engine(engine), line(line) { tokenize(); }
+
+    // Instructions that every match has to pass: single tests among the
+    // top-level `and` terms of a condition without a top-level `or`
+    vector<uint32_t> guards;
+    // Protocols a matching packet can have, one bit per PacketRecord::Protocol
+    uint8_t protocols = ALL_PROTOCOLS;
+    static const uint8_t ALL_PROTOCOLS = 0xF;
+
+    bool compile(RuleEngine::Rule &rule, RuleEngine::Program &program, string &error) {
+        size_t codeStart = engine.code.size();
+        size_t setStart = engine.sets.size();
+        try {
+            rule.name = expectWord("rule name");
+            expect(":");
+            program.start = engine.code.size();
+            protocols = parseExpr(true);
+            program.end = engine.code.size();
+            if (accept("|")) parseAggregate(rule);
+            if (pos < tokens.size()) fail("unexpected '" + tokens[pos] + "'");
+            return true;
+        } catch (const runtime_error &e) {
+            engine.code.resize(codeStart);
+            engine.sets.resize(setStart);
+            error = e.what();
+            return false;
+        }
+    }
+
+private:
+    RuleEngine &engine;
+    const string &line;
+    vector<string> tokens;
+    size_t pos = 0;
+
+    void tokenize() {
+        static const string SYMBOLS2[] = {"==", "!=", "<=", ">="};
+        for (size_t i = 0; i < line.size();) {
+            char c = line[i];
+            if (isspace(static_cast<unsigned char>(c))) {
+                i++;
+            } else if (isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.' || c == '/') {
+                size_t start = i;
+                while (i < line.size() && (isalnum(static_cast<unsigned char>(line[i])) || line[i] == '_' ||
+                                           line[i] == '.' || line[i] == '/'))
+                    i++;
+                tokens.push_back(line.substr(start, i - start));
+            } else {
+                string two = line.substr(i, 2);
+                if (find(begin(SYMBOLS2), end(SYMBOLS2), two) != end(SYMBOLS2)) {
+                    tokens.push_back(two);
+                    i += 2;
+                } else {
+                    tokens.push_back(string(1, c));
+                    i++;
+                }
+            }
+        }
+    }
+
+    [[noreturn]] void fail(const string &message) { throw runtime_error(message); }
+
+    const string &peek() const {
+        static const string END;
+        return pos < tokens.size() ? tokens[pos] : END;
+    }
+
+    bool accept(const string &token) {
+        if (peek() != token) return false;
+        pos++;
+        return true;
+    }
+
+    void expect(const string &token) {
+        if (!accept(token)) fail("expected '" + token + "'" + (pos < tokens.size() ? " before '" + peek() + "'" : ""));
+    }
+
+    string expectWord(const char *what) {
+        const string &token = peek();
+        if (token.empty() || !(isalnum(static_cast<unsigned char>(token[0])) || token[0] == '_'))
+            fail(string("expected ") + what);
+        pos++;
+        return token;
+    }
+
+    uint32_t emit(RuleEngine::Opcode op, uint8_t field = 0, uint32_t a = 0, uint32_t b = 0) {
+        engine.code.push_back({op, field, RuleEngine::NO_JUMP, a, b, 0});
+        return engine.code.size() - 1;
+    }
+
+    // a <= field <= b, or outside it; the `port` tests read the source port and then the destination port
+    void emitRange(uint8_t field, uint32_t low, uint32_t high, bool outside = false) {
+        if (field == RuleEngine::ANY_PORT)
+            emit(outside ? RuleEngine::PORT_NOT_RANGE : RuleEngine::PORT_RANGE, RuleEngine::SRC_PORT, low, high - low);
+        else
+            emit(outside ? RuleEngine::NOT_RANGE : RuleEngine::RANGE, field, low, high - low);
+    }
+
+    void emitNever(uint8_t field) { emitRange(field, 0, ~0u, true); }
+
+    // The jump of an `and` / `or` operand that started at `before`: on its
+    // last instruction when nothing inside jumps past that, else on a PASS
+    uint32_t emitJump(uint32_t before, RuleEngine::Jump jump) {
+        uint32_t end = engine.code.size();
+        bool inner = false;
+        for (uint32_t pc = before; pc < end; ++pc)
+            inner |= engine.code[pc].jump != RuleEngine::NO_JUMP && engine.code[pc].target == end;
+        if (inner || engine.code.back().jump != RuleEngine::NO_JUMP) emit(RuleEngine::PASS);
+        engine.code.back().jump = jump;
+        return engine.code.size() - 1;
+    }
+
+    void patch(const vector<uint32_t> &jumps) {
+        for (uint32_t jump : jumps) engine.code[jump].target = engine.code.size();
+    }
+
+    // `not` of the operand that started at `before`, folded into a single test
+    void negate(uint32_t before) {
+        static const pair<RuleEngine::Opcode, RuleEngine::Opcode> FLIPS[] = {
+            {RuleEngine::RANGE, RuleEngine::NOT_RANGE}, {RuleEngine::MASK, RuleEngine::NOT_MASK},
+            {RuleEngine::SET, RuleEngine::NOT_SET}};
+        RuleEngine::Instruction &last = engine.code.back();
+        if (engine.code.size() == before + 1 && last.jump == RuleEngine::NO_JUMP) {
+            for (const auto &flip : FLIPS) {
+                if (last.op == flip.first || last.op == flip.second) {
+                    last.op = last.op == flip.first ? flip.second : flip.first;
+                    return;
+                }
+            }
+        }
+        emit(RuleEngine::NOT);
+    }
+
+    // The parse functions return the protocols their operand can match,
+    // conservatively: anything that is not a protocol test allows all
+
+    // expr := term { "or" term }
+    uint8_t parseExpr(bool top = false) {
+        vector<uint32_t> jumps;
+        uint32_t before = engine.code.size();
+        uint8_t protocols = parseTerm(top);
+        while (accept("or")) {
+            if (top) guards.clear();
+            top = false;
+            jumps.push_back(emitJump(before, RuleEngine::JUMP_IF_TRUE));
+            before = engine.code.size();
+            protocols |= parseTerm(false);
+        }
+        patch(jumps);
+        return protocols;
+    }
+
+    // term := factor { "and" factor }
+    uint8_t parseTerm(bool top) {
+        vector<uint32_t> jumps;
+        uint32_t before = engine.code.size();
+        uint8_t protocols = parseGuardedFactor(top);
+        while (accept("and")) {
+            jumps.push_back(emitJump(before, RuleEngine::JUMP_IF_FALSE));
+            before = engine.code.size();
+            protocols &= parseGuardedFactor(top);
+        }
+        patch(jumps);
+        return protocols;
+    }
+
+    uint8_t parseGuardedFactor(bool top) {
+        uint32_t before = engine.code.size();
+        uint8_t protocols = parseFactor();
+        if (top && engine.code.size() == before + 1) guards.push_back(before);
+        return protocols;
+    }
+
+    // factor := "not" factor | "(" expr ")" | predicate
+    uint8_t parseFactor() {
+        uint32_t before = engine.code.size();
+        if (accept("not")) {
+            parseFactor();
+            negate(before);
+        } else if (accept("(")) {
+            uint8_t protocols = parseExpr();
+            expect(")");
+            return protocols;
+        } else {
+            parsePredicate();
+        }
+
+        // A single protocol test, negated or not, says which protocols pass it
+        const RuleEngine::Instruction &ins = engine.code.back();
+        if (engine.code.size() != before + 1 || ins.field != RuleEngine::PROTO || ins.op > RuleEngine::NOT_SET)
+            return ALL_PROTOCOLS;
+        uint8_t protocols = 0;
+        for (int p = 0; p < 4; ++p)
+            if (engine.test(ins, PROTO_NUMBERS[p])) protocols |= 1 << p;
+        return protocols;
+    }
+
+    void parsePredicate() {
+        static const pair<const char *, uint8_t> FLAGS[] = {
+            {"fin", PacketRecord::FLAG_FIN}, {"syn", PacketRecord::FLAG_SYN}, {"rst", PacketRecord::FLAG_RST},
+            {"psh", PacketRecord::FLAG_PSH}, {"ack", PacketRecord::FLAG_ACK}, {"urg", PacketRecord::FLAG_URG}};
+        static const pair<const char *, RuleEngine::Field> FIELDS[] = {
+            {"src", RuleEngine::SRC}, {"dst", RuleEngine::DST}, {"src_port", RuleEngine::SRC_PORT},
+            {"dst_port", RuleEngine::DST_PORT}, {"port", RuleEngine::ANY_PORT}, {"len", RuleEngine::LEN},
+            {"proto", RuleEngine::PROTO}};
+
+        string word = expectWord("a field, flag or protocol");
+        for (const auto &flag : FLAGS) {
+            if (word == flag.first) {
+                emit(RuleEngine::MASK, RuleEngine::FLAGS, flag.second, flag.second);
+                return;
+            }
+        }
+        uint32_t proto;
+        if (protocolNumber(word, proto)) {
+            emitRange(RuleEngine::PROTO, proto, proto);
+            return;
+        }
+
+        const pair<const char *, RuleEngine::Field> *field = nullptr;
+        for (const auto &candidate : FIELDS)
+            if (word == candidate.first) field = &candidate;
+        if (!field) fail("unknown field '" + word + "'");
+        bool isAddr = field->second == RuleEngine::SRC || field->second == RuleEngine::DST;
+
+        uint32_t before = engine.code.size();
+        bool negated = accept("not");
+        if (negated || accept("in")) {
+            if (negated) expect("in");
+            parseMembership(field->second, isAddr);
+            if (negated) negate(before);
+            return;
+        }
+
+        enum Compare { EQ, NE, LT, LE, GT, GE };
+        static const pair<const char *, Compare> COMPARES[] = {{"==", EQ}, {"!=", NE}, {"<", LT},
+                                                               {"<=", LE}, {">", GT},  {">=", GE}};
+        const pair<const char *, Compare> *compare = nullptr;
+        for (const auto &candidate : COMPARES)
+            if (peek() == candidate.first) compare = &candidate;
+        if (!compare) fail("expected a comparison or 'in' after '" + word + "'");
+        pos++;
+
+        if (isAddr && peek().find('/') != string::npos) {
+            if (compare->second != EQ && compare->second != NE) fail("address blocks only compare with == or !=");
+            parseMembership(field->second, true);
+            if (compare->second == NE) negate(before);
+            return;
+        }
+
+        // Every comparison is a range test; one that nothing passes never matches
+        uint32_t value = parseValue(field->second);
+        switch (compare->second) {
+        case EQ: emitRange(field->second, value, value); break;
+        case NE: emitRange(field->second, value, value, true); break;
+        case LT: value == 0 ? emitNever(field->second) : emitRange(field->second, 0, value - 1); break;
+        case LE: emitRange(field->second, 0, value); break;
+        case GT: value == ~0u ? emitNever(field->second) : emitRange(field->second, value + 1, ~0u); break;
+        case GE: emitRange(field->second, value, ~0u); break;
+        }
+    }
+
+    // Block (10.0.0.0/8), range (1024-65535) or set ({22, 23, 2222})
+    void parseMembership(uint8_t field, bool isAddr) {
+        if (accept("{")) {
+            vector<uint32_t> values;
+            do {
+                values.push_back(parseValue(field));
+            } while (accept(","));
+            expect("}");
+            sort(values.begin(), values.end());
+            values.erase(unique(values.begin(), values.end()), values.end());
+            engine.sets.push_back(values);
+            if (field == RuleEngine::ANY_PORT)
+                emit(RuleEngine::PORT_SET, RuleEngine::SRC_PORT, uint32_t(engine.sets.size() - 1));
+            else
+                emit(RuleEngine::SET, field, uint32_t(engine.sets.size() - 1));
+            return;
+        }
+
+        if (isAddr) {
+            string block = expectWord("an address block");
+            size_t slash = block.find('/');
+            uint32_t addr;
+            int bits = slash == string::npos ? 32 : atoi(block.c_str() + slash + 1);
+            if (!parseAddr(block.substr(0, slash), addr) || bits < 0 || bits > 32)
+                fail("bad address block '" + block + "'");
+            uint32_t mask = bits == 0 ? 0 : ~0u << (32 - bits);
+            emit(RuleEngine::MASK, field, addr & mask, mask);
+            return;
+        }
+
+        uint32_t low = parseValue(field);
+        expect("-");
+        uint32_t high = parseValue(field);
+        if (high < low) fail("empty range");
+        emitRange(field, low, high);
+    }
+
+    uint32_t parseValue(uint8_t field) {
+        string word = expectWord("a value");
+        uint32_t value;
+        if (field == RuleEngine::SRC || field == RuleEngine::DST) {
+            if (!parseAddr(word, value)) fail("bad address '" + word + "'");
+        } else if (field == RuleEngine::PROTO && protocolNumber(word, value)) {
+            // protocol name
+        } else if (!parseNumber(word, value)) {
+            fail("bad number '" + word + "'");
+        }
+        return value;
+    }
+
+    // agg := ("count" | "bytes") ["by" key] ">" number "per" duration
+    void parseAggregate(RuleEngine::Rule &rule) {
+        static const pair<const char *, RuleEngine::KeyKind> KEYS[] = {
+            {"src", RuleEngine::KEY_SRC}, {"dst", RuleEngine::KEY_DST}, {"src_port", RuleEngine::KEY_SRC_PORT},
+            {"dst_port", RuleEngine::KEY_DST_PORT}, {"pair", RuleEngine::KEY_PAIR}};
+
+        if (accept("bytes")) {
+            rule.bytes = true;
+        } else if (!accept("count")) {
+            fail("expected 'count' or 'bytes' after '|'");
+        }
+
+        if (accept("by")) {
+            string key = expectWord("a key");
+            auto it = find_if(begin(KEYS), end(KEYS), [&](const pair<const char *, RuleEngine::KeyKind> &k) {
+                return key == k.first;
+            });
+            if (it == end(KEYS)) fail("unknown key '" + key + "' (src, dst, src_port, dst_port or pair)");
+            rule.key = it->second;
+        }
+
+        expect(">");
+        string threshold = expectWord("a threshold");
+        char *endPtr;
+        rule.threshold = strtod(threshold.c_str(), &endPtr);
+        if (*endPtr || rule.threshold < 0) fail("bad threshold '" + threshold + "'");
+
+        expect("per");
+        string duration = expectWord("a window such as 1s");
+        rule.windowSeconds = strtod(duration.c_str(), &endPtr);
+        string unit = endPtr;
+        if (unit == "ms") rule.windowSeconds /= 1000;
+        else if (unit == "m") rule.windowSeconds *= 60;
+        else if (unit != "s" && !unit.empty()) fail("bad window '" + duration + "'");
+        if (!(rule.windowSeconds > 0)) fail("bad window '" + duration + "'");
+    }
+
+    static bool parseNumber(const string &word, uint32_t &value) {
+        if (word.empty() || word.find_first_not_of("0123456789") != string::npos || word.size() > 10) return false;
+        unsigned long parsed = strtoul(word.c_str(), nullptr, 10);
+        if (parsed > 0xFFFFFFFFul) return false;
+        value = parsed;
+        return true;
+    }
+
+    static bool parseAddr(const string &word, uint32_t &value) {
+        struct in_addr addr;
+        if (inet_pton(AF_INET, word.c_str(), &addr) != 1) return false;
+        value = ntohl(addr.s_addr);
+        return true;
+    }
+
+    static bool protocolNumber(const string &word, uint32_t &value) {
+        if (word == "tcp") value = PROTO_NUMBERS[PacketRecord::TCP];
+        else if (word == "udp") value = PROTO_NUMBERS[PacketRecord::UDP];
+        else if (word == "icmp") value = PROTO_NUMBERS[PacketRecord::ICMP];
+        else return false;
+        return true;
+    }
+};
+
+RuleEngine::RuleEngine(Emitter emitter, size_t maxKeysPerRule)
+    : emit(std::move(emitter)), maxKeysPerRule(maxKeysPerRule) {}
+
+bool RuleEngine::addRule(const string &line, string &error) {
+    Rule rule;
+    Program program;
+    RuleCompiler compiler(*this, line);
+    if (!compiler.compile(rule, program, error)) return false;
+    rules.push_back(std::move(rule));
+    programs.push_back(program);
+    index(rules.size() - 1, compiler.guards, compiler.protocols);
+    return true;
+}
+
+// Port ranges up to this many ports are indexed port by port
+static const uint32_t MAX_INDEXED_PORT_RANGE = 256;
+// Shorter address blocks cover too much traffic to be worth an index lookup
+static const int MIN_INDEXED_PREFIX = 8;
+
+void RuleEngine::index(uint32_t rule, const vector<uint32_t> &guards, uint8_t protocols) {
+    // A port guard splits traffic far finer than a protocol guard
+    for (uint32_t pc : guards)
+        if (indexPorts(rule, code[pc])) return;
+
+    // Then the longest address block; a set of addresses counts as /32
+    const Instruction *block = nullptr;
+    int blockBits = MIN_INDEXED_PREFIX - 1;
+    for (uint32_t pc : guards) {
+        const Instruction &ins = code[pc];
+        if (ins.field != SRC && ins.field != DST) continue;
+        int bits = ins.op == MASK                               ? __builtin_popcount(ins.b)
+                   : (ins.op == RANGE && ins.b == 0) || ins.op == SET ? 32
+                                                                      : -1;
+        if (bits > blockBits) {
+            block = &ins;
+            blockBits = bits;
+        }
+    }
+    if (block && indexAddrs(rule, *block)) return;
+
+    // Protocols it cannot match never see it; none at all, and it never runs
+    if (protocols != 0xF) {
+        if (protocols == 0) return;
+        if (byProtocols[protocols].empty())
+            for (int p = 0; p < 4; ++p)
+                if (protocols & (1 << p)) protocolLists[p].push_back(protocols);
+        byProtocols[protocols].push_back(rule);
+        return;
+    }
+
+    // Packets shorter than a lower bound, or longer than an upper bound alone, skip it
+    for (uint32_t pc : guards) {
+        const Instruction &ins = code[pc];
+        if (ins.field != LEN || ins.op != RANGE || (ins.a == 0 && ins.b == ~0u)) continue;
+        bool lower = ins.a > 0;
+        vector<uint32_t> &list = lower ? byMinLen : byMaxLen;
+        vector<uint32_t> &bounds = lower ? minLens : maxLens;
+        uint32_t bound = lower ? ins.a : ins.b;
+        size_t at = lower ? upper_bound(bounds.begin(), bounds.end(), bound) - bounds.begin()
+                          : upper_bound(bounds.begin(), bounds.end(), bound, greater<uint32_t>()) - bounds.begin();
+        bounds.insert(bounds.begin() + at, bound);
+        list.insert(list.begin() + at, rule);
+        return;
+    }
+    unguarded.push_back(rule);
+}
+
+bool RuleEngine::indexPorts(uint32_t rule, const Instruction &ins) {
+    if (ins.field != SRC_PORT && ins.field != DST_PORT) return false;
+    bool either = ins.op == PORT_RANGE || ins.op == PORT_SET;
+
+    vector<uint32_t> ports;
+    if ((ins.op == RANGE || ins.op == PORT_RANGE) && ins.b < MAX_INDEXED_PORT_RANGE && ins.a + ins.b <= 0xFFFF) {
+        for (uint32_t port = ins.a; port <= ins.a + ins.b; ++port) ports.push_back(port);
+    } else if (ins.op == SET || ins.op == PORT_SET) {
+        ports = sets[ins.a];
+    }
+    if (ports.empty() || ports.back() > 0xFFFF) return false;
+
+    for (uint32_t port : ports) {
+        // `port` rules sit under both sides; the packet stamp runs them once
+        for (uint32_t dst = 0; dst < 2; ++dst) {
+            if (!either && dst != (ins.field == DST_PORT)) continue;
+            uint32_t key = dst << 16 | port;
+            uint32_t *list = byPort.find(key);
+            if (!list) {
+                list = byPort.insert(key, portRules.size()).first;
+                portRules.emplace_back();
+            }
+            portRules[*list].push_back(rule);
+        }
+    }
+    return true;
+}
+
+bool RuleEngine::indexAddrs(uint32_t rule, const Instruction &ins) {
+    uint32_t dst = ins.field == DST;
+    int bits = ins.op == MASK ? __builtin_popcount(ins.b) : 32;
+    vector<uint32_t> prefixes;
+    if (ins.op == SET) prefixes = sets[ins.a];
+    else prefixes.push_back(ins.a);
+
+    for (uint32_t prefix : prefixes) {
+        uint64_t key = uint64_t(dst << 6 | bits) << 32 | prefix;
+        uint32_t *list = byAddr.find(key);
+        if (!list) {
+            list = byAddr.insert(key, addrRules.size()).first;
+            addrRules.emplace_back();
+        }
+        addrRules[*list].push_back(rule);
+    }
+    if (find(addrLengths[dst].begin(), addrLengths[dst].end(), bits) == addrLengths[dst].end())
+        addrLengths[dst].push_back(bits);
+    return true;
+}
+
+int RuleEngine::loadFile(const string &path) {
+    ifstream file(path);
+    if (!file.is_open()) return -1;
+
+    int loaded = 0;
+    int lineNumber = 0;
+    string line;
+    while (getline(file, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == string::npos) continue;
+
+        string error;
+        if (addRule(line, error)) {
+            loaded++;
+        } else {
+            cerr << "⚠️  " << path << ":" << lineNumber << ": " << error << "\n";
+        }
+    }
+    return loaded;
+}
+
+// Tests of one field, for the compiler; `port` tests are left to run()
+bool RuleEngine::test(const Instruction &ins, uint32_t value) const {
+    switch (ins.op) {
+    case RANGE: return value - ins.a <= ins.b;
+    case NOT_RANGE: return value - ins.a > ins.b;
+    case MASK: return (value & ins.b) == ins.a;
+    case NOT_MASK: return (value & ins.b) != ins.a;
+    case SET: return binary_search(sets[ins.a].begin(), sets[ins.a].end(), value);
+    case NOT_SET: return !binary_search(sets[ins.a].begin(), sets[ins.a].end(), value);
+    default: return false;
+    }
+}
+
+bool RuleEngine::run(uint32_t start, uint32_t end, const uint32_t fields[FIELDS]) const {
+    const Instruction *program = code.data();
+    auto inSet = [this](uint32_t set, uint32_t value) {
+        return binary_search(sets[set].begin(), sets[set].end(), value);
+    };
+    bool acc = true;
+    for (uint32_t pc = start; pc < end;) {
+        const Instruction &ins = program[pc++];
+        uint32_t value = fields[ins.field];
+        switch (ins.op) {
+        case RANGE: acc = value - ins.a <= ins.b; break;
+        case NOT_RANGE: acc = value - ins.a > ins.b; break;
+        case MASK: acc = (value & ins.b) == ins.a; break;
+        case NOT_MASK: acc = (value & ins.b) != ins.a; break;
+        case SET: acc = inSet(ins.a, value); break;
+        case NOT_SET: acc = !inSet(ins.a, value); break;
+        // `port` tests hold when either port passes
+        case PORT_RANGE: acc = value - ins.a <= ins.b || fields[DST_PORT] - ins.a <= ins.b; break;
+        case PORT_NOT_RANGE: acc = value - ins.a > ins.b || fields[DST_PORT] - ins.a > ins.b; break;
+        case PORT_SET: acc = inSet(ins.a, value) || inSet(ins.a, fields[DST_PORT]); break;
+        case NOT: acc = !acc; break;
+        case PASS: break;
+        }
+        if (ins.jump != NO_JUMP && acc == (ins.jump == JUMP_IF_TRUE)) pc = ins.target;
+    }
+    return acc;
+}
+
+template <typename Matched>
+void RuleEngine::runAll(const PacketRecord &packet, Matched &&matched) {
+    packets++;
+    uint32_t fields[FIELDS];
+    fields[SRC] = ntohl(packet.srcAddr);
+    fields[DST] = ntohl(packet.dstAddr);
+    fields[SRC_PORT] = packet.srcPort;
+    fields[DST_PORT] = packet.dstPort;
+    fields[LEN] = packet.length;
+    fields[PROTO] = PROTO_NUMBERS[packet.protocol & 0x3];
+    fields[FLAGS] = packet.tcpFlags;
+
+    runList(unguarded, fields, matched);
+    for (uint8_t protocols : protocolLists[packet.protocol & 0x3]) runList(byProtocols[protocols], fields, matched);
+    if (!byPort.empty()) {
+        if (const uint32_t *list = byPort.find(packet.srcPort)) runList(portRules[*list], fields, matched);
+        if (const uint32_t *list = byPort.find(1u << 16 | packet.dstPort)) runList(portRules[*list], fields, matched);
+    }
+    if (!byMinLen.empty()) {
+        size_t passed = upper_bound(minLens.begin(), minLens.end(), fields[LEN]) - minLens.begin();
+        runList(byMinLen.data(), byMinLen.data() + passed, fields, matched);
+    }
+    if (!byMaxLen.empty()) {
+        size_t passed =
+            upper_bound(maxLens.begin(), maxLens.end(), fields[LEN], greater<uint32_t>()) - maxLens.begin();
+        runList(byMaxLen.data(), byMaxLen.data() + passed, fields, matched);
+    }
+    // One probe per prefix length in use on each side
+    for (uint32_t dst = 0; dst < 2; ++dst) {
+        for (uint8_t bits : addrLengths[dst]) {
+            uint32_t mask = bits == 0 ? 0 : ~0u << (32 - bits);
+            uint64_t key = uint64_t(dst << 6 | bits) << 32 | (fields[SRC + dst] & mask);
+            if (const uint32_t *list = byAddr.find(key)) runList(addrRules[*list], fields, matched);
+        }
+    }
+}
+
+template <typename Matched>
+void RuleEngine::runList(const uint32_t *list, const uint32_t *end, const uint32_t fields[FIELDS], Matched &&matched) {
+    // Locals, as the stamp stores could otherwise alias them
+    uint64_t stamp = packets;
+    Program *all = programs.data();
+    for (; list < end; ++list) {
+        uint32_t index = *list;
+        Program &program = all[index];
+        if (program.packet == stamp) continue;
+        program.packet = stamp;
+        if (run(program.start, program.end, fields)) matched(index, fields);
+    }
+}
+
+void RuleEngine::add(const PacketRecord &packet) {
+    runAll(packet, [&](uint32_t rule, const uint32_t fields[FIELDS]) { count(rules[rule], packet, fields); });
+}
+
+void RuleEngine::match(const PacketRecord &packet, vector<uint32_t> &matched) {
+    matched.clear();
+    runAll(packet, [&](uint32_t rule, const uint32_t *) { matched.push_back(rule); });
+    sort(matched.begin(), matched.end());
+}
+
+void RuleEngine::count(Rule &rule, const PacketRecord &packet, const uint32_t fields[FIELDS]) {
+    if (packet.timestamp >= rule.windowEnd) {
+        int64_t index = static_cast<int64_t>(floor(packet.timestamp / rule.windowSeconds));
+        if (index > rule.windowIndex) {
+            if (!rule.totals.empty()) rule.totals.clear();
+            rule.total = 0;
+            rule.windowIndex = index;
+        }
+        rule.windowEnd = (index + 1) * rule.windowSeconds;
+    }
+    // Late packets are counted in the open window
+
+    uint64_t key = 0;
+    switch (rule.key) {
+    case KEY_NONE: break;
+    case KEY_SRC: key = fields[SRC]; break;
+    case KEY_DST: key = fields[DST]; break;
+    case KEY_SRC_PORT: key = fields[SRC_PORT]; break;
+    case KEY_DST_PORT: key = fields[DST_PORT]; break;
+    case KEY_PAIR: key = uint64_t(fields[SRC]) << 32 | fields[DST]; break;
+    }
+
+    uint64_t *total = rule.key == KEY_NONE ? &rule.total : rule.totals.find(key);
+    if (!total) {
+        if (rule.totals.size() >= maxKeysPerRule) {
+            rule.untracked++;
+            return;
+        }
+        total = rule.totals.insert(key, 0).first;
+    }
+
+    uint64_t before = *total;
+    *total += rule.bytes ? packet.length : 1;
+    if (before > rule.threshold || *total <= rule.threshold) return;
+
+    static const char *const KEY_NAMES[] = {nullptr, "src", "dst", "src_port", "dst_port", "pair"};
+
+    json record;
+    record["protocol"] = "RULE";
+    record["rule"] = rule.name;
+    record["metric"] = rule.bytes ? "bytes" : "count";
+    if (rule.key != KEY_NONE) {
+        record["by"] = KEY_NAMES[rule.key];
+        if (rule.key == KEY_SRC_PORT || rule.key == KEY_DST_PORT)
+            record["key"] = key;
+        else if (rule.key == KEY_PAIR)
+            record["key"] = addrToString(packet.srcAddr) + " -> " + addrToString(packet.dstAddr);
+        else
+            record["key"] = addrToString(rule.key == KEY_SRC ? packet.srcAddr : packet.dstAddr);
+    }
+    record["total"] = *total;
+    record["threshold"] = rule.threshold;
+    record["window_start"] = rule.windowIndex * rule.windowSeconds;
+    record["window_size"] = rule.windowSeconds;
+    record["timestamp"] = packet.timestamp;
+    record["src_ip"] = addrToString(packet.srcAddr);
+    record["dst_ip"] = addrToString(packet.dstAddr);
+    record["src_port"] = packet.srcPort;
+    record["dst_port"] = packet.dstPort;
+    emit(record);
+}
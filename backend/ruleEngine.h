@@ -0,0 +1,143 @@
+#ifndef RULEENGINE_H
+#define RULEENGINE_H
+
+#include "packetSniffer.h"
+#include "flatTable.h"
+#include <functional>
+
+// Operator-defined alert rules, compiled once and run on every packet.
+// One rule per line:
+//
+//   ssh_syn_flood: tcp and syn and not ack and dst_port == 22 | count by src > 500 per 1s
+//   big_dns:       udp and src_port == 53 and len > 512
+//
+// The condition is a boolean expression over the decoded fields (src, dst,
+// src_port, dst_port, port, len, proto, the TCP flags) and compiles to a
+// short bytecode with a single accumulator. Comparisons compile to range,
+// mask or set tests with the field, the comparison and any `not` folded
+// into the opcode, and the `and` / `or` jump past the rest of their
+// operands rides on the test before it, so `tcp and syn and len > 100` is
+// three instructions. Rules that require particular ports (`dst_port ==
+// 22`, `port in {53, 853}`, a short port range), addresses (`src in
+// 10.1.0.0/16`), protocols or a length bound as a top-level `and` term are
+// indexed by them and only run on packets that have them, so the cost of a
+// large rule set is mostly that of the rules without such a guard.
+// After `|` an optional aggregate counts matching packets (or sums their
+// bytes) per key in tumbling windows and raises a RULE alert the moment a
+// key crosses the threshold. Without one, a rule alerts on its first match
+// of every second.
+
+class RuleEngine {
+public:
+    using Emitter = std::function<void(const json &)>;
+
+    explicit RuleEngine(Emitter emitter, size_t maxKeysPerRule = 65536);
+
+    // Compile one rule line; false with a message in `error` if it does not parse
+    bool addRule(const std::string &line, std::string &error);
+    // Load a rules file, reporting bad lines on stderr; -1 if it cannot be read
+    int loadFile(const std::string &path);
+
+    size_t ruleCount() const { return rules.size(); }
+    size_t instructionCount() const { return code.size(); }
+
+    void add(const PacketRecord &packet);
+    // Indices (in order of addition) of the rules whose condition holds for
+    // `packet`, found as add() finds them but without counting; for checks
+    void match(const PacketRecord &packet, std::vector<uint32_t> &matched);
+
+    // Field slots filled from every packet before the rules run; `port`
+    // compiles to the PORT_ opcodes, which read both port slots
+    enum Field : uint8_t { SRC = 0, DST, SRC_PORT, DST_PORT, LEN, PROTO, FLAGS, FIELDS, ANY_PORT = FIELDS };
+
+    enum Opcode : uint8_t {
+        RANGE,          // acc = a <= field <= a + b   (==, <, <=, >, >=, ranges)
+        NOT_RANGE,      // acc = !(a <= field <= a + b) (!=)
+        MASK,           // acc = (field & b) == a       (CIDR blocks, TCP flags)
+        NOT_MASK,
+        SET,            // acc = field is in sets[a]
+        NOT_SET,
+        PORT_RANGE,     // acc = either port in a .. a + b
+        PORT_NOT_RANGE, // acc = either port outside a .. a + b
+        PORT_SET,       // acc = either port is in sets[a]
+        NOT,
+        PASS            // acc unchanged, for the jump of a compound operand
+    };
+    // After the operation, jump to `target` while acc is false (`and`) or true (`or`)
+    enum Jump : uint8_t { NO_JUMP, JUMP_IF_FALSE, JUMP_IF_TRUE };
+
+    struct Instruction {
+        Opcode op;
+        uint8_t field;
+        Jump jump;
+        uint32_t a;
+        uint32_t b;
+        uint32_t target;
+    };
+
+private:
+    enum KeyKind : uint8_t { KEY_NONE, KEY_SRC, KEY_DST, KEY_SRC_PORT, KEY_DST_PORT, KEY_PAIR };
+
+    struct Rule {
+        std::string name;
+        bool bytes = false;        // sum lengths instead of counting packets
+        KeyKind key = KEY_NONE;
+        double threshold = 0;      // alert when the total goes above this
+        double windowSeconds = 1;
+        int64_t windowIndex = -1;
+        double windowEnd = 0;      // start of the next window, to skip the division while it is open
+        uint64_t total = 0;        // the total of a rule without a key
+        FlatTable<uint64_t, uint64_t> totals; // key -> total in the current window
+        size_t untracked = 0;
+    };
+
+    // What every packet touches of a rule, apart from the rest
+    struct Program {
+        uint32_t start;            // code range of the condition
+        uint32_t end;
+        uint64_t packet = 0;       // last packet it ran on
+    };
+
+    Emitter emit;
+    size_t maxKeysPerRule;
+    std::vector<Instruction> code;            // all rules back to back
+    std::vector<std::vector<uint32_t>> sets;  // sorted values for the set tests
+    std::vector<Rule> rules;
+    std::vector<Program> programs;            // by rule
+
+    // Rule indices by guard; a rule is under one guard, though a port or
+    // address guard can put it under several keys
+    std::vector<uint32_t> unguarded;
+    std::vector<uint32_t> byProtocols[16];          // by the mask of PacketRecord::Protocol bits it can match
+    std::vector<uint8_t> protocolLists[4];          // non-empty byProtocols masks with each protocol's bit
+    FlatTable<uint32_t, uint32_t> byPort;           // dst flag << 16 | port -> portRules index
+    std::vector<std::vector<uint32_t>> portRules;
+    FlatTable<uint64_t, uint32_t> byAddr;           // (dst flag << 6 | prefix length) << 32 | prefix -> addrRules index
+    std::vector<std::vector<uint32_t>> addrRules;
+    std::vector<uint8_t> addrLengths[2];            // prefix lengths in byAddr, by src / dst
+    // Length guards: rules with a lowest length, ascending by it, and rules
+    // with only a highest length, descending by it, each with its bound
+    std::vector<uint32_t> byMinLen, minLens;
+    std::vector<uint32_t> byMaxLen, maxLens;
+
+    uint64_t packets = 0;                           // packets seen, to run a rule once per packet
+
+    void index(uint32_t rule, const std::vector<uint32_t> &guards, uint8_t protocols);
+    bool indexPorts(uint32_t rule, const Instruction &guard);
+    bool indexAddrs(uint32_t rule, const Instruction &guard);
+    template <typename Matched>
+    void runAll(const PacketRecord &packet, Matched &&matched);
+    template <typename Matched>
+    void runList(const uint32_t *list, const uint32_t *end, const uint32_t fields[FIELDS], Matched &&matched);
+    template <typename Matched>
+    void runList(const std::vector<uint32_t> &list, const uint32_t fields[FIELDS], Matched &&matched) {
+        runList(list.data(), list.data() + list.size(), fields, matched);
+    }
+    bool test(const Instruction &ins, uint32_t value) const;
+    bool run(uint32_t start, uint32_t end, const uint32_t fields[FIELDS]) const;
+    void count(Rule &rule, const PacketRecord &packet, const uint32_t fields[FIELDS]);
+
+    friend class RuleCompiler;
+};
+
+#endif // RULEENGINE_H
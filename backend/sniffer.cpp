@@ -1,4 +1,24 @@
 #include "packetSniffer.h"
+#include "pathMonitor.h"
+#include "traceCache.h"
+#include "routeTrie.h"
+#include "windowFeatures.h"
+#include "isolationForest.h"
+#include "heavyHitters.h"
+#include "fanoutTracker.h"
+#include "packetHistograms.h"
+#include "changeDetector.h"
+#include "ruleEngine.h"
+#include "tcpMetrics.h"
+#include "tlsInspector.h"
+#include "dnsSnooper.h"
+#include "prefixTagger.h"
+#include "xdpFlowCounter.h"
+#include "batchDecoder.h"
+#include "packetRing.h"
+#include "flowShards.h"
+#include "loadShedder.h"
+#include "flowExporter.h"
 #include <iostream>
 #include <arpa/inet.h>
 #include <cstring>
@@ -11,24 +31,176 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <chrono>
+#include <algorithm>
+#include <unistd.h>
+#include <poll.h>
+#include <cerrno>
+#include <csignal>
+#include <pthread.h>
 
 using namespace std;
 
-PacketSniffer::PacketSniffer(const string &interfaceName)
-    : interface(interfaceName), handle(nullptr), packetCount(0), chunkIndex(1) {
+PacketSniffer::PacketSniffer(const SnifferConfig &snifferConfig)
+    : config(snifferConfig), packetCount(0), chunkIndex(1) {
 
     memset(errbuf, 0, PCAP_ERRBUF_SIZE);
     filesystem::create_directory("packets");
     baseSessionName = "packets/session_" + to_string(time(nullptr));
     packets = json::array();
+    routeTrie = make_unique<RouteTrie>();
+
+    // Flow counts carry no headers or payload, so the stages that need them stay off
+    if (config.xdp) {
+        config.features = false;
+        config.histograms = false;
+        config.tcpMetrics = false;
+        config.tlsInspection = false;
+        config.dnsSnooping = false;
+        if (!config.rulesPath.empty()) cerr << "⚠️  Rules need packets, not running them in XDP mode\n";
+        config.rulesPath.clear();
+        config.shedding = false;
+    }
+
+    // Shedding gives up per-packet records, never the exact counters; flow export needs their conversations
+    if ((config.shedding || !config.exportTarget.empty()) && config.shards == 0) config.shards = 1;
+
+    // A collector merging several sniffers learns who this is before any other record
+    if (!config.sensor.empty()) {
+        emitRecord({{"protocol", "HELLO"}, {"sensor", config.sensor}, {"interfaces", config.interfaces}});
+    }
+
+    // Known paths from the previous run go out before any probing starts
+    if (!config.traceCachePath.empty()) {
+        traceCache = make_unique<TraceCache>(config.traceCachePath, config.traceCacheMaxAge);
+        replayTraceCache();
+    }
 
     // Start traceroute threads
     for (int i = 0; i < MAX_CONCURRENT_TRACES; ++i)
         tracerThreads.emplace_back(&PacketSniffer::tracerThreadFunc, this);
+
+    // Top talkers cannot be picked from a replayed capture's addresses
+    if (!config.readFile.empty()) config.monitorTop = 0;
+    if (config.topTalkers == 0) config.monitorTop = 0;
+
+    if (!config.monitorTargets.empty() || config.monitorTop > 0) {
+        pathMonitor = make_unique<PathMonitor>([this](const json &record) { emitRecord(record); },
+                                               config.monitorInterval);
+        for (const auto &target : config.monitorTargets) {
+            if (!pathMonitor->addDestination(target))
+                cerr << "⚠️  Not monitoring " << target << " (invalid, duplicate or too many paths)\n";
+        }
+        pathMonitor->start();
+    }
+
+    if (config.features) {
+        windowFeatures = make_unique<WindowFeatures>([this](const json &record) { emitRecord(record); },
+                                                     config.featureWindow, config.featureSlidingPanes);
+        if (!config.featuresCsvPath.empty() && !windowFeatures->openCsv(config.featuresCsvPath))
+            cerr << "⚠️  Could not open " << config.featuresCsvPath << " for feature rows\n";
+
+        if (!config.anomalyModelPath.empty()) {
+            anomalyModel = make_unique<IsolationForest>();
+            if (anomalyModel->load(config.anomalyModelPath) && windowFeatures->setAnomalyModel(anomalyModel.get())) {
+                cerr << "🌲 Scoring windows with " << anomalyModel->treeCount() << " isolation trees from "
+                     << config.anomalyModelPath << "\n";
+            } else {
+                anomalyModel.reset();
+            }
+        }
+    }
+
+    if (config.topTalkers > 0) {
+        heavyHitters = make_unique<HeavyHitters>([this](const json &record) { emitRecord(record); },
+                                                 config.topTalkers);
+        heavyHitters->setTopDestinationsCallback([this](const vector<string> &dstIPs) {
+            prioritizeTraces(dstIPs);
+            // The heaviest destinations stay monitored, up to MAX_MONITORED_PATHS in all
+            for (size_t i = 0; i < dstIPs.size() && i < size_t(config.monitorTop); ++i)
+                pathMonitor->addDestination(dstIPs[i]);
+        });
+    }
+
+    if (config.fanout) {
+        fanoutTracker = make_unique<FanoutTracker>([this](const json &record) { emitRecord(record); },
+                                                   config.fanoutWindow, config.fanoutPorts, config.fanoutPeers);
+    }
+
+    if (config.histograms) {
+        packetHistograms = make_unique<PacketHistograms>([this](const json &record) { emitRecord(record); },
+                                                         config.histogramInterval);
+    }
+
+    if (config.changeDetection) {
+        changeDetector = make_unique<ChangeDetector>([this](const json &record) { emitRecord(record); },
+                                                     config.changeInterval, config.changeThreshold,
+                                                     config.changeMinRate);
+    }
+
+    if (!config.rulesPath.empty()) {
+        ruleEngine = make_unique<RuleEngine>([this](const json &record) { emitRecord(record); });
+        int loaded = ruleEngine->loadFile(config.rulesPath);
+        if (loaded < 0) {
+            cerr << "⚠️  Could not read rules from " << config.rulesPath << "\n";
+            ruleEngine.reset();
+        } else {
+            cerr << "📜 Loaded " << loaded << " rules (" << ruleEngine->instructionCount() << " instructions) from "
+                 << config.rulesPath << "\n";
+        }
+    }
+
+    if (config.tcpMetrics) {
+        tcpMetrics = make_unique<TcpMetrics>([this](const json &record) { emitRecord(record); },
+                                             config.tcpReportInterval);
+    }
+
+    if (config.tlsInspection)
+        tlsInspector = make_unique<TlsInspector>([this](const json &record) { emitRecord(record); });
+
+    if (config.dnsSnooping)
+        dnsSnooper = make_unique<DnsSnooper>([this](const json &record) { emitRecord(record); });
+
+    if (!config.prefixFile.empty()) {
+        prefixTagger = make_unique<PrefixTagger>([this](const json &record) { emitRecord(record); }, config.prefixFile);
+        // Without a usable list yet, the tagger picks the file up once it appears or is fixed
+        if (!prefixTagger->load()) cerr << "⚠️  No prefix tags until " << config.prefixFile << " can be compiled\n";
+    }
+
+    if (config.shards > 0) {
+        // An exported flow ends after the export idle time, otherwise conversations count as active for a minute
+        double idleSeconds = config.exportTarget.empty() ? 60 : config.exportIdle;
+        flowShards = make_unique<FlowShards>([this](const json &record) { emitRecord(record); }, config.shards,
+                                             config.trafficInterval, 16384, idleSeconds);
+        cerr << "🧮 Counting traffic on " << flowShards->shardCount() << " worker threads\n";
+    }
+
+    if (!config.exportTarget.empty()) {
+        auto format = config.exportFormat == "v9" ? FlowExporter::NETFLOW_V9 : FlowExporter::IPFIX;
+        flowExporter = make_unique<FlowExporter>(format);
+        string error;
+        if (flowExporter->open(config.exportTarget, error)) {
+            flowShards->exportFlows(
+                [this](const vector<FlowRecord> &flows) {
+                    for (const auto &flow : flows) flowExporter->add(flow);
+                    flowExporter->flush();
+                },
+                config.exportActive);
+            cerr << "📤 Exporting flows to " << config.exportTarget << " ("
+                 << (format == FlowExporter::IPFIX ? "IPFIX" : "NetFlow v9") << ")\n";
+        } else {
+            cerr << "⚠️  Not exporting flows to " << config.exportTarget << ": " << error << "\n";
+            flowExporter.reset();
+        }
+    }
+
+    if (config.shedding)
+        loadShedder = make_unique<LoadShedder>([this](const json &record) { emitRecord(record); }, config.shedMaxRate);
 }
 
 PacketSniffer::~PacketSniffer() {
-    if (handle) pcap_close(handle);
+    for (auto &capture : captures) pcap_close(capture.handle);
+
+    if (pathMonitor) pathMonitor->stop();
 
     // Stop tracer threads
     {
@@ -39,104 +211,376 @@ PacketSniffer::~PacketSniffer() {
 
     for (auto &t : tracerThreads)
         if (t.joinable()) t.join();
+
+    if (traceCache) traceCache->save();
 }
 
 bool PacketSniffer::start() {
-    handle = pcap_open_live(interface.c_str(), BUFSIZ, 1, 1000, errbuf);
+    if (config.xdp) return runXdp();
+    if (!config.readFile.empty()) return runReplay();
+    if (config.ring) return runRing();
+
+    string names;
+    for (const auto &name : config.interfaces) {
+        pcap_t *handle = pcap_open_live(name.c_str(), BUFSIZ, 1, 1000, errbuf);
+        if (!handle) {
+            cerr << "pcap_open_live failed on " << name << ": " << errbuf << "\n";
+            return false;
+        }
+        captures.push_back({name, handle});
+        names += (names.empty() ? "" : ", ") + name;
+    }
+
+    // Several interfaces share this thread, and with it every stage after
+    // capture: it waits on all their handles and reads whichever are ready
+    bool multiple = captures.size() > 1;
+    vector<struct pollfd> fds;
+    for (auto &capture : captures) {
+        if (!multiple) break;
+        int fd = pcap_get_selectable_fd(capture.handle);
+        if (fd < 0 || pcap_setnonblock(capture.handle, 1, errbuf) < 0) {
+            cerr << "Cannot wait on " << capture.interface << " together with other interfaces\n";
+            return false;
+        }
+        fds.push_back({fd, POLLIN, 0});
+    }
+
+    cerr << "🔍 Listening on " << names << "...\nPress Ctrl+C to stop.\n";
+
+    while (!stopping) {
+        if (multiple && poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR) {
+            cerr << "poll error: " << strerror(errno) << "\n";
+            return false;
+        }
+        for (size_t i = 0; i < captures.size(); ++i) {
+            if (multiple && !fds[i].revents) continue;
+            captureInterface = &captures[i].interface;
+            int result = pcap_dispatch(captures[i].handle, -1, packetHandler, reinterpret_cast<u_char *>(this));
+            if (loadShedder) accountBusy();
+            if (result == PCAP_ERROR_BREAK) return true;
+            if (result < 0) {
+                cerr << "pcap_dispatch error on " << captures[i].interface << ": " << pcap_geterr(captures[i].handle)
+                     << "\n";
+                return false;
+            }
+        }
+        // Ticks end on time as well, when the link goes quiet
+        double now = chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+        if (flowShards) flowShards->advance(now);
+        if (flowExporter) flowExporter->retry();
+        if (loadShedder) updateShedding(now);
+    }
+    return true;
+}
+
+// Replays a capture file through the same stages as a live capture. Time is
+// the file's: every stage runs on packet timestamps, so nothing waits on the
+// wall clock and the file goes through as fast as it can be read.
+bool PacketSniffer::runReplay() {
+    pcap_t *handle = pcap_open_offline(config.readFile.c_str(), errbuf);
     if (!handle) {
-        cerr << "pcap_open_live failed: " << errbuf << "\n";
+        cerr << "pcap_open_offline failed on " << config.readFile << ": " << errbuf << "\n";
+        return false;
+    }
+    // Records name the replayed capture by the interface argument
+    captures.push_back({config.interfaces.front(), handle});
+    captureInterface = &captures.front().interface;
+    if (pcap_datalink(handle) != DLT_EN10MB) {
+        cerr << config.readFile << " is not an Ethernet capture\n";
         return false;
     }
 
-    cerr << "🔍 Listening on " << interface << "...\nPress Ctrl+C to stop.\n";
+    cerr << "📼 Replaying " << config.readFile << " as " << *captureInterface << "...\n";
+    while (!stopping) {
+        int result = pcap_dispatch(handle, -1, packetHandler, reinterpret_cast<u_char *>(this));
+        if (loadShedder) accountBusy();
+        if (result == 0) break; // end of the file
+        if (result == PCAP_ERROR_BREAK) return true;
+        if (result < 0) {
+            cerr << "pcap_dispatch error on " << config.readFile << ": " << pcap_geterr(handle) << "\n";
+            return false;
+        }
+    }
 
-    if (pcap_loop(handle, 0, packetHandler, reinterpret_cast<u_char *>(this)) < 0) {
-        cerr << "pcap_loop error\n";
-        return false;
+    cerr << "📼 Replayed " << packetCount << " packets from " << config.readFile << "\n";
+    return true;
+}
+
+// Frames come out of the kernel's ring a block at a time and are decoded
+// where they lie, the whole block in one batch, so the vector decoder gets
+// groups of frames without any copying. Blocks are given back once every
+// stage has seen their frames, payloads included.
+bool PacketSniffer::runRing() {
+    string names;
+    vector<struct pollfd> fds;
+    for (const auto &name : config.interfaces) {
+        auto ring = make_unique<PacketRing>();
+        string error;
+        if (!ring->open(name, error)) {
+            cerr << "Capture ring failed on " << name << ": " << error << "\n";
+            return false;
+        }
+        fds.push_back({ring->fd(), POLLIN, 0});
+        rings.push_back(std::move(ring));
+        names += (names.empty() ? "" : ", ") + name;
+    }
+
+    cerr << "🔍 Listening on " << names << " (TPACKET_V3 ring, " << BatchDecoder::implementation()
+         << " decoder)...\nPress Ctrl+C to stop.\n";
+
+    vector<DecodedFrame> frames;
+    while (!stopping) {
+        if (poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR) {
+            cerr << "poll error: " << strerror(errno) << "\n";
+            return false;
+        }
+        for (size_t i = 0; i < rings.size() && !stopping; ++i) {
+            captureInterface = &config.interfaces[i];
+            while (!stopping && rings[i]->next(frames)) {
+                for (const auto &frame : frames) processCaptured(frame);
+                rings[i]->release();
+                if (loadShedder) accountBusy();
+            }
+        }
+        // Ticks end on time as well, when the link goes quiet
+        double now = chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+        if (flowShards) flowShards->advance(now);
+        if (flowExporter) flowExporter->retry();
+        if (loadShedder) updateShedding(now);
     }
     return true;
 }
 
 void PacketSniffer::stop() {
-    if (handle) {
-        pcap_breakloop(handle);
-        saveToFile();
+    stopping = true;
+    for (auto &capture : captures) pcap_breakloop(capture.handle);
+}
+
+// The last ticks, windows and flows end with the capture
+void PacketSniffer::finish() {
+    saveToFile();
+    if (windowFeatures) windowFeatures->flush();
+    // Conversations still open go out as forced ends
+    if (flowShards) flowShards->finish();
+    if (flowExporter) {
+        flowExporter->flush();
+        cerr << "📤 Exported " << flowExporter->exportedRecords() << " flow records in "
+             << flowExporter->sentDatagrams() << " datagrams (" << flowExporter->droppedDatagrams() << " dropped)\n";
     }
 }
 
 void PacketSniffer::packetHandler(u_char *userData, const struct pcap_pkthdr *header, const u_char *packet) {
     PacketSniffer *sniffer = reinterpret_cast<PacketSniffer *>(userData);
-    sniffer->processPacket(header, packet);
+    // Decoded where libpcap left it, which holds only until this returns.
+    // Copying frames out to decode them in batches cost more than the batch
+    // decoder saved (decode_bench), as each frame is read once either way.
+    DecodedFrame frame;
+    BatchDecoder::decodeOne(packet, header->caplen, header->len, header->ts.tv_sec + header->ts.tv_usec / 1e6, frame);
+    sniffer->processCaptured(frame);
 }
 
-void PacketSniffer::processPacket(const struct pcap_pkthdr *header, const u_char *packet) {
-    if (header->len < 34) return; // Too small for IP packet
-    
-    const struct iphdr *ipHeader = (struct iphdr *)(packet + 14);
-    int ipHeaderLen = ipHeader->ihl * 4;
+void PacketSniffer::processCaptured(const DecodedFrame &frame) {
+    if (loadShedder && busyFrames++ == 0) busyStart = chrono::steady_clock::now();
+    if (frame.valid) {
+        // Thresholds, distinct counts and per-connection state cannot be
+        // scaled up from a sample, so these stages see every packet in every
+        // mode; shedding saves the records and the volume estimates
+        const PacketRecord &record = frame.record;
+        if (flowShards) flowShards->add(record);
+        if (ruleEngine) ruleEngine->add(record);
+        if (fanoutTracker) fanoutTracker->add(record);
+        if (tcpMetrics) tcpMetrics->add(record);
+        if (tlsInspector) tlsInspector->add(record);
+        if (dnsSnooper) dnsSnooper->add(record);
+        if (prefixTagger) prefixTagger->add(record);
+        if (!loadShedder || loadShedder->sample()) processFrame(frame);
+    }
+    // A saturated capture thread may not leave pcap_dispatch for a while
+    if (loadShedder && busyFrames == BUSY_FRAMES) accountBusy();
+}
+
+// From the first frame of a group to now: frames and libpcap's work between
+// them, not the wait for the next buffer, which ends a group
+void PacketSniffer::accountBusy() {
+    if (busyFrames == 0) return;
+    loadShedder->busy(chrono::duration<double>(chrono::steady_clock::now() - busyStart).count());
+    busyFrames = 0;
+    double now = chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+    updateShedding(now);
+}
+
+void PacketSniffer::updateShedding(double now) {
+    if (!loadShedder->due(now)) return;
+    uint64_t drops = 0;
+    for (auto &capture : captures) {
+        struct pcap_stat stats = {};
+        if (pcap_stats(capture.handle, &stats) == 0) drops += stats.ps_drop;
+    }
+    for (auto &ring : rings) drops += ring->drops();
+    loadShedder->update(now, flowShards ? flowShards->occupancy() : 0, drops);
+}
+
+void PacketSniffer::processFrame(const DecodedFrame &frame) {
+    const PacketRecord &record = frame.record;
 
     struct in_addr src_addr, dst_addr;
-    src_addr.s_addr = ipHeader->saddr;
-    dst_addr.s_addr = ipHeader->daddr;
+    src_addr.s_addr = record.srcAddr;
+    dst_addr.s_addr = record.dstAddr;
     
     string srcIP = inet_ntoa(src_addr);
     string dstIP = inet_ntoa(dst_addr);
 
     json packetData;
-    packetData["timestamp"] = header->ts.tv_sec + header->ts.tv_usec / 1e6;
+    packetData["timestamp"] = record.timestamp;
     packetData["src_ip"] = srcIP;
     packetData["dst_ip"] = dstIP;
-    packetData["length"] = header->len;
+    packetData["length"] = record.length;
+    packetData["interface"] = *captureInterface;
 
-    if (ipHeader->protocol == IPPROTO_TCP) {
-        if (header->len < 14 + ipHeaderLen + sizeof(struct tcphdr)) return;
-        
-        const struct tcphdr *tcpHeader = (struct tcphdr *)(packet + 14 + ipHeaderLen);
+    // A sampled packet stands for `rate` packets in the volume estimates
+    uint32_t rate = loadShedder ? loadShedder->rate() : 1;
+    const PacketRecord *volume = &record;
+    PacketRecord weighted;
+    if (rate > 1) {
+        packetData["sample_rate"] = rate;
+        weighted = record;
+        weighted.packets = rate;
+        weighted.length = record.length * rate;
+        volume = &weighted;
+    }
+
+    if (record.protocol == PacketRecord::TCP) {
         packetData["protocol"] = "TCP";
-        packetData["src_port"] = ntohs(tcpHeader->source);
-        packetData["dst_port"] = ntohs(tcpHeader->dest);
+        packetData["src_port"] = record.srcPort;
+        packetData["dst_port"] = record.dstPort;
         
         packetData["tcp_flags"] = {
-            {"FIN", tcpHeader->fin},
-            {"SYN", tcpHeader->syn},
-            {"RST", tcpHeader->rst},
-            {"PSH", tcpHeader->psh},
-            {"ACK", tcpHeader->ack},
-            {"URG", tcpHeader->urg}
+            {"FIN", (record.tcpFlags & PacketRecord::FLAG_FIN) ? 1 : 0},
+            {"SYN", (record.tcpFlags & PacketRecord::FLAG_SYN) ? 1 : 0},
+            {"RST", (record.tcpFlags & PacketRecord::FLAG_RST) ? 1 : 0},
+            {"PSH", (record.tcpFlags & PacketRecord::FLAG_PSH) ? 1 : 0},
+            {"ACK", (record.tcpFlags & PacketRecord::FLAG_ACK) ? 1 : 0},
+            {"URG", (record.tcpFlags & PacketRecord::FLAG_URG) ? 1 : 0}
         };
     }
-    else if (ipHeader->protocol == IPPROTO_UDP) {
-        if (header->len < 14 + ipHeaderLen + sizeof(struct udphdr)) return;
-        
-        const struct udphdr *udpHeader = (struct udphdr *)(packet + 14 + ipHeaderLen);
+    else if (record.protocol == PacketRecord::UDP) {
         packetData["protocol"] = "UDP";
-        packetData["src_port"] = ntohs(udpHeader->source);
-        packetData["dst_port"] = ntohs(udpHeader->dest);
+        packetData["src_port"] = record.srcPort;
+        packetData["dst_port"] = record.dstPort;
     }
-    else if (ipHeader->protocol == IPPROTO_ICMP) {
-        if (header->len < 14 + ipHeaderLen + sizeof(struct icmphdr)) return;
-        
-        const struct icmphdr *icmpHeader = (struct icmphdr *)(packet + 14 + ipHeaderLen);
+    else if (record.protocol == PacketRecord::ICMP) {
         packetData["protocol"] = "ICMP";
-        packetData["type"] = (int)icmpHeader->type;
-        packetData["code"] = (int)icmpHeader->code;
+        packetData["type"] = (int)frame.icmpType;
+        packetData["code"] = (int)frame.icmpCode;
     }
     else {
         packetData["protocol"] = "Other";
-        packetData["protocol_number"] = (int)ipHeader->protocol;
+        packetData["protocol_number"] = (int)frame.ipProtocol;
     }
 
+    if (windowFeatures) windowFeatures->add(*volume);
+    if (heavyHitters) heavyHitters->add(*volume);
+    if (packetHistograms) packetHistograms->add(*volume);
+    if (changeDetector) changeDetector->add(*volume);
+
     packets.push_back(packetData);
     packetCount++;
 
     if (packetCount % 40 == 0) saveToFile();
 
-    cout << packetData.dump() << endl;
-    cout.flush();
+    emitRecord(packetData);
 
     runTracerouteAsync(dstIP);
 }
 
+bool PacketSniffer::runXdp() {
+    string names;
+    for (const auto &name : config.interfaces) {
+        auto counter = make_unique<XdpFlowCounter>(config.xdpMaxFlows);
+        string error;
+        if (!counter->attach(name, error)) {
+            cerr << "XDP attach failed on " << name << ": " << error << "\n";
+            return false;
+        }
+        xdpCounters.push_back(std::move(counter));
+        names += (names.empty() ? "" : ", ") + name;
+    }
+
+    cerr << "🔍 Counting flows on " << names << " in the kernel (XDP), every " << config.xdpInterval
+         << "s...\nPress Ctrl+C to stop.\n";
+
+    auto interval = chrono::duration<double>(config.xdpInterval);
+    auto next = chrono::steady_clock::now() + interval;
+    while (!stopping) {
+        this_thread::sleep_until(next);
+        next += chrono::duration_cast<chrono::steady_clock::duration>(interval);
+        double now = chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+        for (size_t i = 0; i < xdpCounters.size(); ++i) processFlowCounts(*xdpCounters[i], config.interfaces[i], now);
+        if (flowShards) flowShards->advance(now);
+        if (flowExporter) flowExporter->retry();
+    }
+    return true;
+}
+
+void PacketSniffer::processFlowCounts(XdpFlowCounter &counter, const string &interface, double timestamp) {
+    vector<XdpFlowCounter::Flow> flows;
+    string error;
+    if (!counter.drain(flows, error)) {
+        cerr << "⚠️  XDP on " << interface << ": " << error << "\n";
+        return;
+    }
+
+    for (const auto &flow : flows) {
+        PacketRecord record;
+        record.timestamp = timestamp;
+        record.srcAddr = flow.srcAddr;
+        record.dstAddr = flow.dstAddr;
+        record.length = uint32_t(min<uint64_t>(flow.bytes, UINT32_MAX));
+        record.packets = uint32_t(min<uint64_t>(flow.packets, UINT32_MAX));
+
+        struct in_addr src_addr, dst_addr;
+        src_addr.s_addr = flow.srcAddr;
+        dst_addr.s_addr = flow.dstAddr;
+        string srcIP = inet_ntoa(src_addr);
+        string dstIP = inet_ntoa(dst_addr);
+
+        json packetData;
+        packetData["timestamp"] = timestamp;
+        packetData["src_ip"] = srcIP;
+        packetData["dst_ip"] = dstIP;
+        packetData["length"] = flow.bytes;
+        packetData["packets"] = flow.packets;
+        packetData["interface"] = interface;
+
+        if (flow.protocol == IPPROTO_TCP || flow.protocol == IPPROTO_UDP) {
+            record.protocol = flow.protocol == IPPROTO_TCP ? PacketRecord::TCP : PacketRecord::UDP;
+            record.dstPort = flow.dstPort;
+            packetData["protocol"] = flow.protocol == IPPROTO_TCP ? "TCP" : "UDP";
+            packetData["dst_port"] = flow.dstPort;
+        } else if (flow.protocol == IPPROTO_ICMP) {
+            record.protocol = PacketRecord::ICMP;
+            packetData["protocol"] = "ICMP";
+        } else {
+            packetData["protocol"] = "Other";
+            packetData["protocol_number"] = (int)flow.protocol;
+        }
+
+        if (heavyHitters) heavyHitters->add(record);
+        if (fanoutTracker) fanoutTracker->add(record);
+        if (changeDetector) changeDetector->add(record);
+        if (prefixTagger) prefixTagger->add(record);
+        if (flowShards) flowShards->add(record);
+
+        packets.push_back(packetData);
+        packetCount++;
+        if (packetCount % 40 == 0) saveToFile();
+
+        emitRecord(packetData);
+
+        runTracerouteAsync(dstIP);
+    }
+}
+
 void PacketSniffer::saveToFile() {
     if (packets.empty()) return;
     
@@ -149,69 +593,115 @@ void PacketSniffer::saveToFile() {
     packets.clear();
 }
 
+void PacketSniffer::replayTraceCache() {
+    if (!traceCache->load()) return;
+
+    time_t now = time(nullptr);
+    int replayed = 0, stale = 0;
+
+    for (const auto &trace : traceCache->snapshot()) {
+        string dstIP = trace.dstIP();
+        routeTrie->insert(trace.toHops(), [&](const RouteAttachment &attachment) {
+            json route = RouteTrie::toJson(dstIP, attachment, trace.timestamp);
+            route["cached"] = true;
+            emitRecord(route);
+        });
+        replayed++;
+
+        lock_guard<mutex> lock(queueMutex);
+        tracedIPs.insert(dstIP);
+        if (traceCache->isStale(trace, now)) {
+            taskQueue.push_back({dstIP});
+            stale++;
+        }
+    }
+
+    cerr << "♻️  Replayed " << replayed << " cached paths, re-tracing " << stale << " stale ones\n";
+}
+
+void PacketSniffer::emitRecord(const json &record) {
+    string line = record.dump();
+    lock_guard<mutex> lock(outputMutex);
+    if (outputClosed) return;
+    cout << line << endl;
+    // The reader or collector is gone; nothing more can be delivered
+    if (!cout) {
+        outputClosed = true;
+        cerr << "❌ Record output closed, stopping\n";
+        stop();
+    }
+}
+
 void PacketSniffer::runTracerouteAsync(const std::string &dstIP) {
     if (dstIP.empty() || dstIP == "127.0.0.1" || dstIP == "0.0.0.0") return;
+    // Paths from here say nothing about where a recorded capture was taken
+    if (!config.readFile.empty()) return;
 
     lock_guard<mutex> lock(queueMutex);
     if (tracedIPs.find(dstIP) != tracedIPs.end()) return;
 
     tracedIPs.insert(dstIP);
-    taskQueue.push({dstIP});
+    taskQueue.push_back({dstIP});
     queueCV.notify_one();
 }
 
+void PacketSniffer::prioritizeTraces(const vector<string> &dstIPs) {
+    if (!config.readFile.empty()) return;
+    lock_guard<mutex> lock(queueMutex);
+
+    // Walk from the weakest so the heaviest destination ends up first
+    for (auto it = dstIPs.rbegin(); it != dstIPs.rend(); ++it) {
+        const string &dstIP = *it;
+        if (dstIP == "127.0.0.1" || dstIP == "0.0.0.0") continue;
+
+        auto queued = find_if(taskQueue.begin(), taskQueue.end(),
+                              [&](const TracerouteTask &task) { return task.dstIP == dstIP; });
+        if (queued != taskQueue.end()) {
+            taskQueue.erase(queued);
+        } else if (tracedIPs.find(dstIP) != tracedIPs.end()) {
+            continue; // traced already or in progress
+        } else {
+            tracedIPs.insert(dstIP);
+        }
+        taskQueue.push_front({dstIP});
+    }
+    queueCV.notify_all();
+}
+
 void PacketSniffer::tracerThreadFunc() {
+    // Signals go to the capture thread, so they break its pcap loop
+    sigset_t signals;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
     while (true) {
         TracerouteTask task;
         {
             unique_lock<mutex> lock(queueMutex);
             queueCV.wait(lock, [this] { return !taskQueue.empty() || stopTracerThreads; });
 
-            if (stopTracerThreads && taskQueue.empty()) return;
+            // Traces still queued at shutdown are dropped, not waited for
+            if (stopTracerThreads) return;
 
             task = taskQueue.front();
-            taskQueue.pop();
+            taskQueue.pop_front();
         }
 
         try {
-            Traceroute tracer(task.dstIP, 20, 1000);
+            Traceroute tracer(task.dstIP, 20, 1000, &prefixRtts);
             auto hops = tracer.performTrace();
 
-            // Create traceroute JSON output matching standard traceroute format
             if (!hops.empty()) {
-                json tracerouteData;
-                tracerouteData["dst_ip"] = task.dstIP;
-                tracerouteData["protocol"] = "TRACEROUTE";
-                tracerouteData["timestamp"] = time(nullptr);
-                
-                json hopsArray = json::array();
-                for (const auto &hop : hops) {
-                    json hopData;
-                    hopData["ttl"] = hop.ttl;
-                    
-                    json responsesArray = json::array();
-                    for (const auto &response : hop.responses) {
-                        json responseData;
-                        responseData["ip"] = response.ip;
-                        
-                        json rttsArray = json::array();
-                        for (double rtt : response.rtts) {
-                            if (rtt > 0) {
-                                rttsArray.push_back(rtt);
-                            } else {
-                                rttsArray.push_back("*"); // Timeout
-                            }
-                        }
-                        responseData["rtts"] = rttsArray;
-                        responsesArray.push_back(responseData);
-                    }
-                    hopData["responses"] = responsesArray;
-                    hopsArray.push_back(hopData);
-                }
-                tracerouteData["hops"] = hopsArray;
+                time_t timestamp = time(nullptr);
+                // Only the part of the path that is not in the trie yet goes out
+                routeTrie->insert(hops, [&](const RouteAttachment &attachment) {
+                    emitRecord(RouteTrie::toJson(task.dstIP, attachment, timestamp));
+                });
 
-                cout << tracerouteData.dump() << endl;
-                cout.flush();
+                if (traceCache) {
+                    traceCache->store(task.dstIP, hops, timestamp);
+                    traceCache->saveIfDirty();
+                }
             }
         }
         catch (const std::exception &e) {
@@ -0,0 +1,71 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded single-producer / single-consumer queue. Each side owns one
+// index and only reads the other's, so a push or pop is a plain store plus
+// one acquire load, without locks or read-modify-write operations. Each
+// side also caches the other's index and only re-reads it when the ring
+// looks full (or empty), and the two indices sit on separate cache lines so
+// the threads do not keep stealing each other's line.
+
+template <typename T>
+class SpscRing {
+public:
+    // Capacity is rounded up to a power of two
+    explicit SpscRing(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    // Producer side; false if the ring is full
+    bool push(const T &item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead > mask) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead > mask) return false;
+        }
+        slots[t & mask] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; false if the ring is empty
+    bool pop(T &item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail) return false;
+        }
+        item = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Items waiting, exact from either side, a snapshot from anywhere else
+    size_t size() const {
+        size_t h = head.load(std::memory_order_acquire); // first, so it cannot pass the tail read after it
+        size_t t = tail.load(std::memory_order_acquire);
+        return t - h > mask ? mask + 1 : t - h;
+    }
+    size_t capacity() const { return mask + 1; }
+
+private:
+    std::vector<T> slots;
+    size_t mask;
+
+    alignas(64) std::atomic<size_t> head{0}; // next slot to pop, written by the consumer
+    size_t cachedTail = 0;                   // consumer's copy of tail
+    alignas(64) std::atomic<size_t> tail{0}; // next slot to push, written by the producer
+    size_t cachedHead = 0;                   // producer's copy of head
+};
+
+#endif // SPSCRING_H
@@ -0,0 +1,109 @@
+#include "streamMerger.h"
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <tuple>
+
+using namespace std;
+
+StreamMerger::StreamMerger(Emitter emitter, double lateness, double idleSeconds, size_t maxBuffered)
+    : emitter(std::move(emitter)), lateness(max(0.0, lateness)), idleSeconds(idleSeconds),
+      maxBuffered(max<size_t>(1, maxBuffered)) {}
+
+int StreamMerger::addSource(const string &name, double now) {
+    Source source;
+    source.name = name;
+    source.lastActive = now;
+    sources.push_back(std::move(source));
+    return int(sources.size()) - 1;
+}
+
+void StreamMerger::rename(int source, const string &name) { sources[source].name = name; }
+
+void StreamMerger::push(int source, json record, double now) {
+    Source &s = sources[source];
+    s.lastActive = now;
+
+    double timestamp;
+    auto field = record.find("timestamp");
+    if (field != record.end() && field->is_number()) {
+        timestamp = field->get<double>();
+        if (!s.started || timestamp > s.newest) s.newest = timestamp;
+        s.started = true;
+    } else {
+        timestamp = s.started ? s.newest : releasedUpTo;
+    }
+
+    // Behind what is already out: merging it in order is no longer possible
+    if (releasedAny && timestamp < releasedUpTo) {
+        late++;
+        Item item{timestamp, nextSequence++, std::move(record)};
+        emit(source, item);
+        return;
+    }
+
+    // Almost always the newest of its source, so the scan stops right away
+    auto position = s.queue.end();
+    while (position != s.queue.begin() && prev(position)->timestamp > timestamp) --position;
+    s.queue.insert(position, Item{timestamp, nextSequence++, std::move(record)});
+    bufferedCount++;
+
+    if (bufferedCount > maxBuffered) {
+        size_t excess = bufferedCount - maxBuffered;
+        forced += excess;
+        mergeUpTo(numeric_limits<double>::infinity(), excess);
+    }
+}
+
+void StreamMerger::close(int source) { sources[source].open = false; }
+
+size_t StreamMerger::openSources() const {
+    return size_t(count_if(sources.begin(), sources.end(), [](const Source &s) { return s.open; }));
+}
+
+double StreamMerger::watermark(double now) const {
+    double mark = numeric_limits<double>::infinity();
+    for (const Source &s : sources) {
+        if (!s.open || !s.started || now - s.lastActive >= idleSeconds) continue;
+        mark = min(mark, s.newest - lateness);
+    }
+    return mark;
+}
+
+void StreamMerger::release(double now) { mergeUpTo(watermark(now), numeric_limits<size_t>::max()); }
+
+void StreamMerger::flush() { mergeUpTo(numeric_limits<double>::infinity(), numeric_limits<size_t>::max()); }
+
+void StreamMerger::mergeUpTo(double limit, size_t count) {
+    // (timestamp, sequence, source) of every source's oldest record
+    using Head = tuple<double, uint64_t, int>;
+    priority_queue<Head, vector<Head>, greater<Head>> heads;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const auto &queue = sources[i].queue;
+        if (!queue.empty()) heads.emplace(queue.front().timestamp, queue.front().sequence, int(i));
+    }
+
+    while (count > 0 && !heads.empty()) {
+        auto [timestamp, sequence, source] = heads.top();
+        if (timestamp > limit) break;
+        heads.pop();
+
+        auto &queue = sources[source].queue;
+        Item item = std::move(queue.front());
+        queue.pop_front();
+        bufferedCount--;
+        count--;
+
+        releasedUpTo = max(releasedUpTo, timestamp);
+        releasedAny = true;
+        emit(source, item);
+
+        if (!queue.empty()) heads.emplace(queue.front().timestamp, queue.front().sequence, source);
+    }
+}
+
+void StreamMerger::emit(int source, Item &item) {
+    merged++;
+    emitter(item.record, sources[source].name);
+}
@@ -0,0 +1,90 @@
+#ifndef STREAMMERGER_H
+#define STREAMMERGER_H
+
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+// Merges the record streams of several sniffers into one, in timestamp
+// order. Each source keeps its records sorted as they arrive (a sniffer's
+// stream is almost in order, so a record usually goes to the back), and a
+// k-way merge over the heads of the sources releases records up to a
+// watermark: the newest timestamp every live source has reached, less
+// `lateness`. A record may therefore arrive up to `lateness` seconds behind
+// the newest record of the slowest source and still be merged in order;
+// one later than that is released right away, out of order, and counted.
+//
+// A source that sends nothing for `idleSeconds` of wall time stops holding
+// the watermark back until it speaks again, and a closed source releases
+// what it holds. Past `maxBuffered` records the oldest go out early, so a
+// stalled source costs ordering, never unbounded memory.
+
+class StreamMerger {
+public:
+    // A merged record, which the emitter may tag, and the name of the sensor it came from
+    using Emitter = std::function<void(json &, const std::string &)>;
+
+    explicit StreamMerger(Emitter emitter, double lateness = 2, double idleSeconds = 5,
+                          size_t maxBuffered = 200000);
+
+    int addSource(const std::string &name, double now);
+    void rename(int source, const std::string &name);
+    const std::string &name(int source) const { return sources[source].name; }
+    // Records without a timestamp take the source's previous one
+    void push(int source, json record, double now);
+    void close(int source);
+
+    // Release everything at or below the watermark
+    void release(double now);
+    // Release everything
+    void flush();
+
+    size_t buffered() const { return bufferedCount; }
+    size_t openSources() const;
+    uint64_t mergedRecords() const { return merged; }
+    uint64_t lateRecords() const { return late; }
+    uint64_t forcedRecords() const { return forced; }
+
+private:
+    struct Item {
+        double timestamp;
+        uint64_t sequence; // arrival order, breaks timestamp ties
+        json record;
+    };
+
+    struct Source {
+        std::string name;
+        std::deque<Item> queue; // sorted by (timestamp, sequence)
+        double newest = 0;      // newest timestamp received
+        bool started = false;   // has sent a timestamped record
+        double lastActive = 0;  // wall clock of the last record
+        bool open = true;
+    };
+
+    Emitter emitter;
+    double lateness;
+    double idleSeconds;
+    size_t maxBuffered;
+
+    std::vector<Source> sources;
+    size_t bufferedCount = 0;
+    uint64_t nextSequence = 0;
+    double releasedUpTo = 0; // timestamp of the last record released in order
+    bool releasedAny = false;
+
+    uint64_t merged = 0;
+    uint64_t late = 0;
+    uint64_t forced = 0;
+
+    double watermark(double now) const;
+    // Merge the source heads while they are at or below `limit`, at most `count` records
+    void mergeUpTo(double limit, size_t count);
+    void emit(int source, Item &item);
+};
+
+#endif // STREAMMERGER_H
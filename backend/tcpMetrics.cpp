@@ -0,0 +1,228 @@
+#include "tcpMetrics.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <arpa/inet.h>
+
+using namespace std;
+
+static const double REORDER_SECONDS = 0.003;    // out-of-order window while the RTT is unknown
+static const double HALF_OPEN_SECONDS = 30;     // idle timeout of unfinished handshakes
+static const char *const STATE_NAMES[] = {"midstream", "syn_sent", "syn_received", "established", "closing", "closed"};
+
+static string addrToString(uint32_t addr) {
+    char buf[INET_ADDRSTRLEN];
+    struct in_addr in;
+    in.s_addr = addr;
+    inet_ntop(AF_INET, &in, buf, sizeof(buf));
+    return buf;
+}
+
+static double milliseconds(double seconds) {
+    return std::round(seconds * 1e6) / 1e3;
+}
+
+static json summarize(const HistogramSnapshot &snapshot) {
+    if (snapshot.total() == 0) return nullptr;
+    json summary;
+    summary["count"] = snapshot.total();
+    summary["p50"] = snapshot.percentile(0.5) / 1e3;
+    summary["p90"] = snapshot.percentile(0.9) / 1e3;
+    summary["p99"] = snapshot.percentile(0.99) / 1e3;
+    summary["max"] = snapshot.max() / 1e3;
+    return summary;
+}
+
+TcpMetrics::TcpMetrics(Emitter emitter, double reportSeconds, double idleSeconds, size_t maxReported,
+                       size_t maxFlows)
+    : emit(std::move(emitter)), reportSeconds(reportSeconds), idleSeconds(idleSeconds),
+      maxReported(maxReported), maxFlows(maxFlows) {}
+
+void TcpMetrics::add(const PacketRecord &packet) {
+    if (packet.protocol != PacketRecord::TCP) return;
+
+    int64_t index = static_cast<int64_t>(floor(packet.timestamp / reportSeconds));
+    if (reportIndex < 0) {
+        reportIndex = index;
+    } else if (index > reportIndex) {
+        report((reportIndex + 1) * reportSeconds);
+        reportIndex = index;
+    }
+
+    bool srcIsA;
+    FlowKey key = FlowKey::of(packet, srcIsA);
+
+    Flow *flow = flows.find(key);
+    if (!flow) {
+        // A reset of a connection we never saw has nothing left to measure
+        if (packet.tcpFlags & PacketRecord::FLAG_RST) {
+            totals.resets++;
+            return;
+        }
+        if (flows.size() >= maxFlows) {
+            if (untracked++ == 0)
+                cerr << "⚠️  TCP metrics are tracking " << maxFlows << " flows, ignoring new ones until some expire\n";
+            return;
+        }
+        flow = flows.insert(key, Flow()).first;
+        flow->firstSeen = packet.timestamp;
+    }
+    track(*flow, srcIsA ? 0 : 1, packet);
+}
+
+void TcpMetrics::track(Flow &flow, int side, const PacketRecord &packet) {
+    uint8_t flags = packet.tcpFlags;
+    bool syn = flags & PacketRecord::FLAG_SYN;
+    bool ack = flags & PacketRecord::FLAG_ACK;
+
+    // A new connection reusing the ports of a closed one
+    if (syn && !ack && flow.state == CLOSED) {
+        flow = Flow();
+        flow.firstSeen = packet.timestamp;
+    }
+
+    Side &sender = flow.sides[side];
+    flow.lastSeen = packet.timestamp;
+    sender.packets++;
+    sender.bytes += packet.length;
+    flow.intervalBytes += packet.length;
+
+    // Handshake RTTs, from the latest SYN and the latest SYN/ACK
+    if (syn && !ack) {
+        if (flow.client == 2 || flow.client == side) {
+            flow.client = side;
+            flow.synTime = packet.timestamp;
+            if (flow.state == MIDSTREAM) flow.state = SYN_SENT;
+        }
+    } else if (syn) {
+        if (flow.client == 1 - side && (flow.state == SYN_SENT || flow.state == SYN_RECEIVED)) {
+            if (flow.state == SYN_SENT) flow.synRtt = max(0.0, packet.timestamp - flow.synTime);
+            flow.synAckTime = packet.timestamp;
+            flow.state = SYN_RECEIVED;
+        }
+    } else if (ack && side == flow.client && flow.state == SYN_RECEIVED) {
+        flow.ackRtt = max(0.0, packet.timestamp - flow.synAckTime);
+        flow.state = ESTABLISHED;
+        totals.opened++;
+        synRtts.record(static_cast<uint64_t>(flow.synRtt * 1e6));
+        ackRtts.record(static_cast<uint64_t>(flow.ackRtt * 1e6));
+    }
+
+    if (flags & PacketRecord::FLAG_RST) {
+        flow.resets++;
+        totals.resets++;
+        flow.state = CLOSED;
+        return;
+    }
+
+    trackSequence(flow, sender, packet);
+
+    // The window is only meaningful once it acknowledges something
+    if (ack && !syn) {
+        if (packet.tcpWindow == 0) {
+            if (!sender.inZeroWindow) {
+                sender.inZeroWindow = true;
+                sender.zeroWindows++;
+                totals.zeroWindows++;
+            }
+        } else {
+            sender.inZeroWindow = false;
+        }
+    }
+
+    if (flags & PacketRecord::FLAG_FIN) {
+        sender.finished = true;
+        flow.state = flow.sides[1 - side].finished ? CLOSED : CLOSING;
+    }
+}
+
+void TcpMetrics::trackSequence(Flow &flow, Side &sender, const PacketRecord &packet) {
+    bool synOrFin = packet.tcpFlags & (PacketRecord::FLAG_SYN | PacketRecord::FLAG_FIN);
+    uint32_t length = packet.payloadLength + ((packet.tcpFlags & PacketRecord::FLAG_SYN) ? 1 : 0) +
+                      ((packet.tcpFlags & PacketRecord::FLAG_FIN) ? 1 : 0);
+    if (length == 0) return; // pure ACKs carry no sequence space
+
+    uint32_t end = packet.tcpSeq + length;
+    if (!sender.seqKnown || static_cast<int32_t>(end - sender.nextSeq) > 0) {
+        sender.seqKnown = true;
+        sender.nextSeq = end;
+        sender.advanced = packet.timestamp;
+        return;
+    }
+
+    // Keep-alives re-send the last byte on purpose
+    if (!synOrFin && packet.payloadLength <= 1 && end == sender.nextSeq) return;
+
+    double reorder = flow.synRtt >= 0 && flow.ackRtt >= 0 ? flow.synRtt + flow.ackRtt : REORDER_SECONDS;
+    if (packet.timestamp - sender.advanced < reorder) {
+        sender.outOfOrder++;
+        totals.outOfOrder++;
+    } else {
+        sender.retransmits++;
+        totals.retransmits++;
+    }
+}
+
+void TcpMetrics::report(double now) {
+    vector<pair<uint64_t, FlowKey>> active;
+    flows.forEach([&](const FlowKey &key, const Flow &flow) {
+        if (flow.intervalBytes > 0) active.emplace_back(flow.intervalBytes, key);
+    });
+    size_t listed = min(active.size(), maxReported);
+    partial_sort(active.begin(), active.begin() + listed, active.end(),
+                 [](const pair<uint64_t, FlowKey> &a, const pair<uint64_t, FlowKey> &b) { return a.first > b.first; });
+
+    json record;
+    record["protocol"] = "TCP_METRICS";
+    record["timestamp"] = now;
+    record["interval"] = reportSeconds;
+    record["flows"] = flows.size();
+    record["active"] = active.size();
+    record["opened"] = totals.opened;
+    record["retransmits"] = totals.retransmits;
+    record["out_of_order"] = totals.outOfOrder;
+    record["zero_windows"] = totals.zeroWindows;
+    record["resets"] = totals.resets;
+    record["syn_rtt_ms"] = summarize(synRtts.snapshotAndReset());
+    record["ack_rtt_ms"] = summarize(ackRtts.snapshotAndReset());
+    json connections = json::array();
+    for (size_t i = 0; i < listed; ++i)
+        connections.push_back(flowToJson(active[i].second, *flows.find(active[i].second)));
+    record["connections"] = connections;
+    emit(record);
+
+    totals = Totals();
+    flows.eraseIf([&](const FlowKey &, Flow &flow) {
+        flow.intervalBytes = 0;
+        if (flow.state == CLOSED) return true; // reported above
+        double idle = now - flow.lastSeen;
+        bool halfOpen = flow.state == SYN_SENT || flow.state == SYN_RECEIVED;
+        return idle > (halfOpen ? min(idleSeconds, HALF_OPEN_SECONDS) : idleSeconds);
+    });
+}
+
+json TcpMetrics::flowToJson(const FlowKey &key, const Flow &flow) const {
+    // Without the handshake, assume the lower port is the server
+    int client = flow.client != 2 ? flow.client : (key.portA < key.portB ? 1 : 0);
+    const Side &c = flow.sides[client];
+    const Side &s = flow.sides[1 - client];
+
+    json entry;
+    entry["client_ip"] = addrToString(client == 0 ? key.addrA : key.addrB);
+    entry["client_port"] = client == 0 ? key.portA : key.portB;
+    entry["server_ip"] = addrToString(client == 0 ? key.addrB : key.addrA);
+    entry["server_port"] = client == 0 ? key.portB : key.portA;
+    entry["state"] = STATE_NAMES[flow.state];
+    entry["syn_rtt_ms"] = flow.synRtt >= 0 ? json(milliseconds(flow.synRtt)) : json(nullptr);
+    entry["ack_rtt_ms"] = flow.ackRtt >= 0 ? json(milliseconds(flow.ackRtt)) : json(nullptr);
+    entry["packets"] = c.packets + s.packets;
+    entry["bytes"] = c.bytes + s.bytes;
+    entry["client_retransmits"] = c.retransmits;
+    entry["server_retransmits"] = s.retransmits;
+    entry["out_of_order"] = c.outOfOrder + s.outOfOrder;
+    entry["client_zero_windows"] = c.zeroWindows;
+    entry["server_zero_windows"] = s.zeroWindows;
+    entry["resets"] = flow.resets;
+    entry["duration"] = flow.lastSeen - flow.firstSeen;
+    return entry;
+}
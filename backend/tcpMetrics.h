@@ -0,0 +1,89 @@
+#ifndef TCPMETRICS_H
+#define TCPMETRICS_H
+
+#include "packetSniffer.h"
+#include "flatTable.h"
+#include "flowKey.h"
+#include "histogram.h"
+#include <functional>
+
+// Passive latency and health of every TCP connection the sniffer sees.
+// Each flow is keyed by its FlowKey and keeps fixed-size state per side:
+//   syn_rtt   SYN -> SYN/ACK, the round trip between the tap and the server
+//   ack_rtt   SYN/ACK -> ACK, the round trip between the tap and the client
+//   sequence tracking: a segment that ends at or before the highest byte
+//   already seen from its sender is out of order when it arrives within
+//   one handshake RTT of that byte, and a retransmission otherwise
+//   zero_windows  transitions of a side to an advertised window of 0
+//   resets        RST segments
+// Every `reportSeconds` a TCP_METRICS record summarizes the interval and
+// lists the busiest connections. Closed flows are dropped after they have
+// been reported; idle ones after `idleSeconds` (half-open ones sooner).
+
+class TcpMetrics {
+public:
+    using Emitter = std::function<void(const json &)>;
+
+    TcpMetrics(Emitter emitter, double reportSeconds = 5, double idleSeconds = 120, size_t maxReported = 50,
+               size_t maxFlows = 65536);
+
+    void add(const PacketRecord &packet);
+
+private:
+    enum State : uint8_t { MIDSTREAM, SYN_SENT, SYN_RECEIVED, ESTABLISHED, CLOSING, CLOSED };
+
+    struct Side {
+        uint32_t nextSeq = 0;      // sequence number after the highest byte sent
+        bool seqKnown = false;
+        bool inZeroWindow = false;
+        bool finished = false;     // sent a FIN
+        double advanced = 0;       // when nextSeq last moved
+        uint32_t packets = 0;
+        uint64_t bytes = 0;
+        uint32_t retransmits = 0;
+        uint32_t outOfOrder = 0;
+        uint32_t zeroWindows = 0;
+    };
+
+    struct Flow {
+        Side sides[2];             // by endpoint, A then B
+        double firstSeen = 0;
+        double lastSeen = 0;
+        double synTime = 0;        // latest SYN from the client
+        double synAckTime = 0;     // latest SYN/ACK from the server
+        float synRtt = -1;         // seconds, -1 until measured
+        float ackRtt = -1;
+        uint8_t client = 2;        // side that sent the SYN, 2 if the handshake was missed
+        State state = MIDSTREAM;
+        uint16_t resets = 0;
+        uint64_t intervalBytes = 0;
+    };
+
+    // Events of the current report interval over all flows
+    struct Totals {
+        uint64_t opened = 0;       // completed handshakes
+        uint64_t retransmits = 0;
+        uint64_t outOfOrder = 0;
+        uint64_t zeroWindows = 0;
+        uint64_t resets = 0;
+    };
+
+    Emitter emit;
+    double reportSeconds;
+    double idleSeconds;
+    size_t maxReported;
+    size_t maxFlows;
+    FlatTable<FlowKey, Flow, FlowKeyHash> flows;
+    int64_t reportIndex = -1;
+    Totals totals;
+    Histogram synRtts;             // microseconds
+    Histogram ackRtts;
+    size_t untracked = 0;          // packets of flows that did not fit
+
+    void track(Flow &flow, int side, const PacketRecord &packet);
+    void trackSequence(Flow &flow, Side &sender, const PacketRecord &packet);
+    void report(double now);
+    json flowToJson(const FlowKey &key, const Flow &flow) const;
+};
+
+#endif // TCPMETRICS_H
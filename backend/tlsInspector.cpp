@@ -0,0 +1,293 @@
+#include "tlsInspector.h"
+#include "md5.h"
+#include <algorithm>
+#include <cstring>
+#include <arpa/inet.h>
+
+using namespace std;
+
+static const uint16_t EXT_SERVER_NAME = 0x0000;
+static const uint16_t EXT_SUPPORTED_GROUPS = 0x000a;
+static const uint16_t EXT_EC_POINT_FORMATS = 0x000b;
+static const uint16_t EXT_SUPPORTED_VERSIONS = 0x002b;
+
+static string addrToString(uint32_t addr) {
+    char buf[INET_ADDRSTRLEN];
+    struct in_addr in;
+    in.s_addr = addr;
+    inet_ntop(AF_INET, &in, buf, sizeof(buf));
+    return buf;
+}
+
+// Reserved values (RFC 8701) clients sprinkle into their lists; JA3 skips them
+static bool isGrease(uint16_t value) {
+    return (value & 0x0f0f) == 0x0a0a && (value >> 8) == (value & 0xff);
+}
+
+// Bounds-checked big-endian reads; once a read runs past the end every
+// further read returns 0 and `ok` stays false
+namespace {
+struct Reader {
+    const uint8_t *data;
+    size_t left;
+    bool ok = true;
+
+    Reader(const uint8_t *data, size_t left) : data(data), left(left) {}
+
+    bool has(size_t n) {
+        if (left < n) ok = false;
+        return ok;
+    }
+    uint8_t u8() {
+        if (!has(1)) return 0;
+        left--;
+        return *data++;
+    }
+    uint16_t u16() {
+        if (!has(2)) return 0;
+        uint16_t value = uint16_t(data[0]) << 8 | data[1];
+        data += 2;
+        left -= 2;
+        return value;
+    }
+    void skip(size_t n) {
+        if (!has(n)) return;
+        data += n;
+        left -= n;
+    }
+    // The next `n` bytes as their own reader
+    Reader take(size_t n) {
+        Reader sub(data, has(n) ? n : 0);
+        sub.ok = ok;
+        skip(n);
+        return sub;
+    }
+};
+} // namespace
+
+ClientHello::Status ClientHello::parse(const uint8_t *data, size_t length, ClientHello &hello) {
+    // Record header (type, version, length) and handshake header (type, length)
+    if (length < 9 || data[0] != 0x16 || data[1] != 0x03 || data[5] != 0x01) return NOT_HELLO;
+    size_t recordLength = size_t(data[3]) << 8 | data[4];
+    size_t helloLength = size_t(data[6]) << 16 | size_t(data[7]) << 8 | data[8];
+    if (helloLength + 4 > recordLength) return NOT_HELLO; // hellos split over records are not worth it
+    if (length < 9 + helloLength) return INCOMPLETE;
+
+    Reader body(data + 9, helloLength);
+    hello.version = body.u16();
+    hello.maxVersion = hello.version;
+    body.skip(32);                // random
+    body.skip(body.u8());         // session id
+
+    Reader ciphers = body.take(body.u16());
+    hello.cipherCount = 0;
+    while (ciphers.left >= 2) {
+        uint16_t cipher = ciphers.u16();
+        if (hello.cipherCount < MAX_CIPHERS) hello.ciphers[hello.cipherCount++] = cipher;
+    }
+    body.skip(body.u8());         // compression methods
+
+    hello.extensionCount = hello.groupCount = hello.pointFormatCount = 0;
+    hello.sni[0] = '\0';
+    Reader extensions = body.left >= 2 ? body.take(body.u16()) : Reader(nullptr, 0);
+    while (extensions.ok && extensions.left >= 4) {
+        uint16_t type = extensions.u16();
+        Reader ext = extensions.take(extensions.u16());
+        if (hello.extensionCount < MAX_EXTENSIONS) hello.extensions[hello.extensionCount++] = type;
+
+        switch (type) {
+        case EXT_SERVER_NAME: {
+            Reader names = ext.take(ext.u16());
+            while (names.ok && names.left >= 3) {
+                uint8_t nameType = names.u8();
+                Reader name = names.take(names.u16());
+                if (nameType != 0 || !name.ok) continue;
+                size_t n = min(name.left, sizeof(hello.sni) - 1);
+                // Keep the JSON printable whatever the client sent
+                for (size_t i = 0; i < n; ++i)
+                    hello.sni[i] = name.data[i] > 0x20 && name.data[i] < 0x7f ? char(name.data[i]) : '?';
+                hello.sni[n] = '\0';
+                break;
+            }
+            break;
+        }
+        case EXT_SUPPORTED_GROUPS: {
+            Reader groups = ext.take(ext.u16());
+            while (groups.left >= 2) {
+                uint16_t group = groups.u16();
+                if (hello.groupCount < MAX_GROUPS) hello.groups[hello.groupCount++] = group;
+            }
+            break;
+        }
+        case EXT_EC_POINT_FORMATS: {
+            Reader formats = ext.take(ext.u8());
+            while (formats.left >= 1) {
+                uint8_t format = formats.u8();
+                if (hello.pointFormatCount < MAX_POINT_FORMATS) hello.pointFormats[hello.pointFormatCount++] = format;
+            }
+            break;
+        }
+        case EXT_SUPPORTED_VERSIONS: {
+            Reader versions = ext.take(ext.u8());
+            while (versions.left >= 2) {
+                uint16_t version = versions.u16();
+                if (!isGrease(version)) hello.maxVersion = max(hello.maxVersion, version);
+            }
+            break;
+        }
+        }
+    }
+    return body.ok ? PARSED : NOT_HELLO;
+}
+
+// Appends "-"-separated decimal values, skipping GREASE, without snprintf's
+// locale and format parsing
+static size_t appendList(char *out, size_t pos, size_t size, const uint16_t *values, int count, bool grease) {
+    bool first = true;
+    for (int i = 0; i < count; ++i) {
+        if (grease && isGrease(values[i])) continue;
+        char digits[6];
+        int n = 0;
+        uint16_t v = values[i];
+        do {
+            digits[n++] = char('0' + v % 10);
+            v /= 10;
+        } while (v);
+        if (pos + n + 1 >= size) break;
+        if (!first) out[pos++] = '-';
+        while (n) out[pos++] = digits[--n];
+        first = false;
+    }
+    return pos;
+}
+
+size_t ClientHello::ja3String(char *out, size_t size) const {
+    uint16_t formats[MAX_POINT_FORMATS];
+    for (int i = 0; i < pointFormatCount; ++i) formats[i] = pointFormats[i];
+
+    size_t pos = appendList(out, 0, size, &version, 1, false);
+    const struct {
+        const uint16_t *values;
+        int count;
+    } lists[] = {{ciphers, cipherCount}, {extensions, extensionCount}, {groups, groupCount}, {formats, pointFormatCount}};
+    for (const auto &list : lists) {
+        if (pos + 1 >= size) break;
+        out[pos++] = ',';
+        pos = appendList(out, pos, size, list.values, list.count, true);
+    }
+    out[pos] = '\0';
+    return pos;
+}
+
+void ClientHello::ja3(char digest[33]) const {
+    char text[2048]; // the longest lists above fit with room to spare
+    size_t length = ja3String(text, sizeof(text));
+    Md5 md5;
+    md5.update(text, length);
+    md5.finishHex(digest);
+}
+
+TlsInspector::TlsInspector(Emitter emitter) : emit(std::move(emitter)) {}
+
+void TlsInspector::add(const PacketRecord &packet) {
+    if (packet.protocol != PacketRecord::TCP || packet.payloadCaptured == 0) return;
+    if (slotsUsed > 0 && continueReassembly(packet)) return;
+
+    const uint8_t *data = packet.payload;
+    if (packet.payloadCaptured < 6 || data[0] != 0x16 || data[1] != 0x03 || data[5] != 0x01) return;
+
+    ClientHello hello;
+    switch (ClientHello::parse(data, packet.payloadCaptured, hello)) {
+    case ClientHello::PARSED:
+        publish(hello, packet);
+        break;
+    case ClientHello::INCOMPLETE:
+        // The rest follows in the next segments, unless the snap length cut this one
+        if (packet.payloadCaptured == packet.payloadLength) startReassembly(packet);
+        break;
+    case ClientHello::NOT_HELLO:
+        break;
+    }
+}
+
+bool TlsInspector::continueReassembly(const PacketRecord &packet) {
+    bool fromA;
+    FlowKey key = FlowKey::of(packet, fromA);
+
+    for (Reassembly &slot : slots) {
+        if (!slot.used) continue;
+        if (packet.timestamp - slot.started > SLOT_TIMEOUT) {
+            slot.used = false;
+            slotsUsed--;
+            continue;
+        }
+        if (!(slot.key == key) || slot.fromA != fromA) continue;
+
+        if (packet.tcpSeq != slot.nextSeq) {
+            // Retransmission of what we have, or a gap we cannot fill
+            if (static_cast<int32_t>(packet.tcpSeq - slot.nextSeq) > 0) {
+                slot.used = false;
+                slotsUsed--;
+            }
+            return true;
+        }
+
+        size_t take = min<size_t>(packet.payloadCaptured, MAX_HELLO - slot.length);
+        memcpy(slot.data + slot.length, packet.payload, take);
+        slot.length += take;
+        slot.nextSeq += packet.payloadLength;
+
+        ClientHello hello;
+        ClientHello::Status status = ClientHello::parse(slot.data, slot.length, hello);
+        if (status == ClientHello::PARSED) publish(hello, packet);
+        if (status != ClientHello::INCOMPLETE || slot.length == MAX_HELLO || take < packet.payloadLength) {
+            slot.used = false;
+            slotsUsed--;
+        }
+        return true;
+    }
+    return false;
+}
+
+void TlsInspector::startReassembly(const PacketRecord &packet) {
+    // A free slot, or else the one waiting longest
+    Reassembly *slot = &slots[0];
+    for (Reassembly &candidate : slots) {
+        if (!candidate.used) {
+            slot = &candidate;
+            break;
+        }
+        if (candidate.started < slot->started) slot = &candidate;
+    }
+    if (!slot->used) slotsUsed++;
+
+    slot->used = true;
+    slot->key = FlowKey::of(packet, slot->fromA);
+    slot->nextSeq = packet.tcpSeq + packet.payloadLength;
+    slot->started = packet.timestamp;
+    slot->length = min<size_t>(packet.payloadCaptured, MAX_HELLO);
+    memcpy(slot->data, packet.payload, slot->length);
+}
+
+void TlsInspector::publish(const ClientHello &hello, const PacketRecord &packet) {
+    static const char *const VERSIONS[] = {"SSL 3.0", "TLS 1.0", "TLS 1.1", "TLS 1.2", "TLS 1.3"};
+
+    char ja3[33];
+    hello.ja3(ja3);
+    hellos++;
+
+    json record;
+    record["protocol"] = "TLS";
+    record["timestamp"] = packet.timestamp;
+    record["src_ip"] = addrToString(packet.srcAddr);
+    record["dst_ip"] = addrToString(packet.dstAddr);
+    record["src_port"] = packet.srcPort;
+    record["dst_port"] = packet.dstPort;
+    record["sni"] = hello.sni[0] ? json(hello.sni) : json(nullptr);
+    record["ja3"] = ja3;
+    if (hello.maxVersion >= 0x0300 && hello.maxVersion <= 0x0304)
+        record["version"] = VERSIONS[hello.maxVersion - 0x0300];
+    else
+        record["version"] = hello.maxVersion;
+    emit(record);
+}
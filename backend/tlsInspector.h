@@ -0,0 +1,84 @@
+#ifndef TLSINSPECTOR_H
+#define TLSINSPECTOR_H
+
+#include "packetSniffer.h"
+#include "flowKey.h"
+#include <functional>
+
+// Fields of a TLS ClientHello that identify the client and the server it asks for.
+// Lists longer than their arrays are cut, which only matters for fingerprints of
+// clients that nobody sends in practice.
+struct ClientHello {
+    static const int MAX_CIPHERS = 128;
+    static const int MAX_EXTENSIONS = 64;
+    static const int MAX_GROUPS = 32;
+    static const int MAX_POINT_FORMATS = 8;
+
+    uint16_t version = 0;           // legacy_version of the hello
+    uint16_t maxVersion = 0;        // highest of supported_versions (TLS 1.3), else `version`
+    uint16_t ciphers[MAX_CIPHERS];
+    uint16_t extensions[MAX_EXTENSIONS];
+    uint16_t groups[MAX_GROUPS];
+    uint8_t pointFormats[MAX_POINT_FORMATS];
+    uint8_t cipherCount = 0;
+    uint8_t extensionCount = 0;
+    uint8_t groupCount = 0;
+    uint8_t pointFormatCount = 0;
+    char sni[256] = "";             // server_name host, empty when absent
+
+    enum Status { PARSED, NOT_HELLO, INCOMPLETE };
+
+    // Parse a TLS record carrying a ClientHello from the start of a client's
+    // stream. INCOMPLETE means the record continues beyond `length`; every
+    // read is bounds-checked and nothing is allocated.
+    static Status parse(const uint8_t *data, size_t length, ClientHello &hello);
+
+    // JA3 string (version,ciphers,extensions,groups,point formats without
+    // GREASE values) and its MD5 as 32 hex digits
+    size_t ja3String(char *out, size_t size) const;
+    void ja3(char digest[33]) const;
+};
+
+// Finds ClientHellos in TCP payloads and emits a TLS record with the SNI and
+// JA3 fingerprint of every TLS connection. A hello is the first data a client
+// sends, and a 3-byte check of the record and handshake headers picks it out
+// of the rest of the traffic, so packets are only parsed when they start one
+// and no per-flow state is needed. Hellos that span segments (large key
+// shares) are collected in a small fixed pool of reassembly buffers.
+
+class TlsInspector {
+public:
+    using Emitter = std::function<void(const json &)>;
+
+    explicit TlsInspector(Emitter emitter);
+
+    void add(const PacketRecord &packet);
+
+    uint64_t helloCount() const { return hellos; }
+
+private:
+    static constexpr int SLOTS = 16;           // hellos being reassembled at once
+    static constexpr size_t MAX_HELLO = 8192;  // bytes kept per reassembly
+    static constexpr double SLOT_TIMEOUT = 2;  // seconds a partial hello waits for the rest
+
+    struct Reassembly {
+        FlowKey key;
+        bool fromA = false;                // direction of the client
+        bool used = false;
+        uint32_t nextSeq = 0;
+        double started = 0;
+        size_t length = 0;
+        uint8_t data[MAX_HELLO];
+    };
+
+    Emitter emit;
+    Reassembly slots[SLOTS];
+    int slotsUsed = 0;
+    uint64_t hellos = 0;
+
+    bool continueReassembly(const PacketRecord &packet);
+    void startReassembly(const PacketRecord &packet);
+    void publish(const ClientHello &hello, const PacketRecord &packet);
+};
+
+#endif // TLSINSPECTOR_H
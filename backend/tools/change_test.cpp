@@ -0,0 +1,86 @@
+// Change detector check across a load shedding level change: a host sends
+// SYNs at a steady rate, first as one record per packet and then sampled 1
+// in 8 with each record weighted by 8, as the sniffer hands them over while
+// shedding. The weighted counts must keep the rates where they were, so no
+// CHANGE alert may fire; a real SYN flood that follows, still sampled, must
+// raise one on syn_per_sec. The exit status is 1 if either check fails.
+//
+//   change_test [--rate N] [--sample N]
+
+#include "../changeDetector.h"
+#include <iostream>
+#include <cstdlib>
+#include <arpa/inet.h>
+
+using namespace std;
+
+static void printUsage(const char *program) {
+    cerr << "Usage: " << program << " [options]\n"
+         << "  --rate N    SYNs per second before the flood (default 200)\n"
+         << "  --sample N  packets per record once sampled (default 8)\n";
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t rate = 200;
+    uint32_t sample = 8;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--rate" && i + 1 < argc) {
+            rate = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--sample" && i + 1 < argc) {
+            sample = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (rate < 20 || sample == 0 || rate % sample != 0) {
+        cerr << "--rate must be at least 20 and a multiple of --sample\n";
+        return 1;
+    }
+
+    vector<json> alerts;
+    ChangeDetector detector([&](const json &record) { alerts.push_back(record); });
+
+    PacketRecord packet;
+    inet_pton(AF_INET, "10.0.0.1", &packet.srcAddr);
+    inet_pton(AF_INET, "10.0.0.2", &packet.dstAddr);
+    packet.protocol = PacketRecord::TCP;
+    packet.srcPort = 40000;
+    packet.dstPort = 80;
+    packet.tcpFlags = PacketRecord::FLAG_SYN;
+
+    // `perSecond` packets a second for `seconds`, one record per `weight` packets
+    double clock = 0;
+    auto send = [&](uint32_t perSecond, uint32_t weight, int seconds) {
+        uint32_t records = perSecond / weight;
+        for (int second = 0; second < seconds; ++second, clock += 1) {
+            for (uint32_t i = 0; i < records; ++i) {
+                packet.timestamp = clock + double(i) / records;
+                packet.packets = weight;
+                packet.length = 60 * weight;
+                detector.add(packet);
+            }
+        }
+    };
+
+    send(rate, 1, 60);
+    send(rate, sample, 60);
+    size_t atLevelChange = alerts.size();
+    send(rate * 10, sample, 10);
+    send(rate, 1, 2); // closes the flood's ticks
+
+    bool quiet = atLevelChange == 0;
+    bool flood = false;
+    for (size_t i = atLevelChange; i < alerts.size(); ++i)
+        flood |= alerts[i]["metric"] == "syn_per_sec" && alerts[i]["direction"] == "up";
+
+    for (const json &alert : alerts) cout << alert.dump() << "\n";
+    cout << "level change: " << (quiet ? "ok" : to_string(atLevelChange) + " alerts") << "\n";
+    cout << "syn flood:    " << (flood ? "ok" : "missed") << "\n";
+    return quiet && flood ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+// Header decoder benchmark: cycles per frame of the batch decoder against
+// its one-frame-at-a-time reference, over a synthetic capture block (ACKs,
+// full-size segments, DNS-sized UDP, ICMP, some IP options, ARP and
+// truncated frames). The block is larger than the caches, as a capture
+// ring would be. Every frame decoded by the batch path is checked against
+// the reference; the exit status is 1 on any mismatch.
+//
+//   decode_bench [--frames N] [--rounds N]
+
+#include "../batchDecoder.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+static void printUsage(const char *program) {
+    cerr << "Usage: " << program << " [options]\n"
+         << "  --frames N  frames in the capture block (default 200000)\n"
+         << "  --rounds N  passes over the block per decoder (default 20)\n";
+}
+
+static uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void put16(uint8_t *p, uint16_t value) {
+    p[0] = value >> 8;
+    p[1] = value & 0xff;
+}
+
+// One Ethernet frame; returns its length on the wire
+static uint32_t buildFrame(vector<uint8_t> &block, mt19937 &rng) {
+    uint32_t pick = rng() % 100;
+    uint8_t protocol = pick < 70 ? IPPROTO_TCP : pick < 90 ? IPPROTO_UDP : pick < 95 ? IPPROTO_ICMP : 47;
+    uint32_t ipHeaderLen = rng() % 20 == 0 ? 20 + 4 * (1 + rng() % 10) : 20;
+    uint32_t l4Len = protocol == IPPROTO_TCP ? 20 + 4 * (rng() % 4 == 0 ? 3 : 0) : 8;
+    uint32_t payload = 0;
+    if (protocol == IPPROTO_TCP) {
+        uint32_t size = rng() % 10;
+        payload = size < 4 ? 0 : size < 7 ? 1460 - ipHeaderLen + 20 - l4Len + 20 : rng() % 1000;
+    } else if (protocol == IPPROTO_UDP) {
+        payload = 30 + rng() % 500;
+    } else {
+        payload = 56;
+    }
+
+    uint32_t length = 14 + ipHeaderLen + l4Len + payload;
+    size_t at = block.size();
+    block.resize(at + length);
+    uint8_t *frame = &block[at];
+    for (uint32_t i = 0; i < 12; ++i) frame[i] = uint8_t(rng());
+    put16(frame + 12, rng() % 100 == 0 ? 0x0806 : 0x0800); // some ARP
+
+    uint8_t *ip = frame + 14;
+    ip[0] = 0x40 | (rng() % 200 == 0 ? 3 : ipHeaderLen / 4); // the odd bad header length
+    put16(ip + 2, ipHeaderLen + l4Len + payload);
+    ip[8] = 64;
+    ip[9] = protocol;
+    uint32_t src = rng(), dst = rng();
+    memcpy(ip + 12, &src, 4);
+    memcpy(ip + 16, &dst, 4);
+
+    uint8_t *l4 = ip + ipHeaderLen;
+    for (uint32_t i = 0; i < l4Len; ++i) l4[i] = uint8_t(rng());
+    if (protocol == IPPROTO_TCP) {
+        l4[12] = uint8_t(l4Len / 4) << 4;
+        l4[13] &= 0x3f;
+    } else if (protocol == IPPROTO_UDP) {
+        put16(l4 + 4, 8 + payload);
+    }
+    return length;
+}
+
+static bool sameFrame(const DecodedFrame &a, const DecodedFrame &b) {
+    if (a.valid != b.valid) return false;
+    if (!a.valid) return true;
+    const PacketRecord &x = a.record, &y = b.record;
+    return x.timestamp == y.timestamp && x.srcAddr == y.srcAddr && x.dstAddr == y.dstAddr && x.length == y.length &&
+           x.protocol == y.protocol && x.srcPort == y.srcPort && x.dstPort == y.dstPort && x.tcpFlags == y.tcpFlags &&
+           x.tcpSeq == y.tcpSeq && x.tcpAck == y.tcpAck && x.tcpWindow == y.tcpWindow &&
+           x.payloadLength == y.payloadLength && x.payload == y.payload && x.payloadCaptured == y.payloadCaptured &&
+           a.ipProtocol == b.ipProtocol && a.icmpType == b.icmpType && a.icmpCode == b.icmpCode;
+}
+
+int main(int argc, char *argv[]) {
+    size_t frameCount = 200000;
+    int rounds = 20;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc) {
+            frameCount = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--rounds" && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (frameCount == 0 || rounds <= 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    mt19937 rng(42);
+    vector<uint8_t> block;
+    vector<uint32_t> offsets(frameCount), caplens(frameCount), lens(frameCount);
+    vector<double> timestamps(frameCount);
+    for (size_t i = 0; i < frameCount; ++i) {
+        offsets[i] = uint32_t(block.size());
+        lens[i] = buildFrame(block, rng);
+        // A small snaplen cuts some frames short, a few inside their headers
+        caplens[i] = rng() % 50 == 0 ? min<uint32_t>(lens[i], 20 + rng() % 60) : lens[i];
+        timestamps[i] = 1700000000 + i * 1e-5;
+    }
+
+    vector<DecodedFrame> reference(frameCount), batched(frameCount);
+    BatchDecoder::decodeScalar(block.data(), offsets.data(), caplens.data(), lens.data(), timestamps.data(),
+                               frameCount, reference.data());
+    BatchDecoder::decode(block.data(), offsets.data(), caplens.data(), lens.data(), timestamps.data(), frameCount,
+                         batched.data());
+    size_t mismatches = 0, valid = 0;
+    for (size_t i = 0; i < frameCount; ++i) {
+        mismatches += !sameFrame(reference[i], batched[i]);
+        valid += reference[i].valid;
+    }
+
+    // Both decoders get the whole block, as a capture ring would hand it over
+    auto time = [&](bool batch, double &nsPerFrame) {
+        auto start = chrono::steady_clock::now();
+        uint64_t startCycles = cycles();
+        for (int round = 0; round < rounds; ++round) {
+            if (batch) {
+                BatchDecoder::decode(block.data(), offsets.data(), caplens.data(), lens.data(), timestamps.data(),
+                                     frameCount, batched.data());
+            } else {
+                BatchDecoder::decodeScalar(block.data(), offsets.data(), caplens.data(), lens.data(),
+                                           timestamps.data(), frameCount, batched.data());
+            }
+        }
+        double total = double(frameCount) * rounds;
+        nsPerFrame = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / total;
+        return (cycles() - startCycles) / total;
+    };
+
+    // The sniffer's path: each frame decoded where it lies, one call per frame
+    DecodedFrame decoded;
+    size_t inPlaceValid = 0;
+    auto inPlaceStart = chrono::steady_clock::now();
+    uint64_t inPlaceStartCycles = cycles();
+    for (int round = 0; round < rounds; ++round) {
+        for (size_t i = 0; i < frameCount; ++i) {
+            BatchDecoder::decodeOne(&block[offsets[i]], caplens[i], lens[i], timestamps[i], decoded);
+            inPlaceValid += decoded.valid;
+        }
+    }
+    double inPlaceTotal = double(frameCount) * rounds;
+    double inPlaceCycles = (cycles() - inPlaceStartCycles) / inPlaceTotal;
+    double inPlaceNs =
+        chrono::duration<double, nano>(chrono::steady_clock::now() - inPlaceStart).count() / inPlaceTotal;
+    if (inPlaceValid != valid * rounds) mismatches++;
+
+    double scalarNs, batchNs;
+    double scalarCycles = time(false, scalarNs);
+    double batchCycles = time(true, batchNs);
+
+    cout << fixed << setprecision(2);
+    cout << "frames:          " << frameCount << " (" << block.size() / (1024 * 1024) << " MB block, "
+         << 100.0 * valid / frameCount << "% decodable)\n";
+    cout << "batch decoder:   " << BatchDecoder::implementation() << "\n";
+    cout << "scalar:          " << scalarCycles << " cycles, " << scalarNs << " ns per frame\n";
+    cout << "batch:           " << batchCycles << " cycles, " << batchNs << " ns per frame\n";
+    cout << "one by one:      " << inPlaceCycles << " cycles, " << inPlaceNs << " ns per frame (decodeOne)\n";
+    cout << "check vs scalar: " << (mismatches ? to_string(mismatches) + " mismatches" : "ok") << "\n";
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,305 @@
+// Small IPFIX / NetFlow v9 collector for trying out and testing --export:
+// prints every flow record as a JSON line on stdout and the totals on
+// stderr when it stops (Ctrl+C, after --datagrams N, or --idle-exit seconds
+// without datagrams once the first has arrived). Templates are learnt from
+// the stream as a real collector would; data sets whose template has not
+// been seen yet are counted and skipped. Gaps in the sequence numbers are
+// counted as lost records (IPFIX) or datagrams (v9).
+//
+//   flow_collector [--port N] [--datagrams N] [--idle-exit SEC]
+
+#include <iostream>
+#include <map>
+#include <tuple>
+#include <vector>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) { stopRequested = 1; }
+
+static void printUsage(const char *program) {
+    cerr << "Usage: " << program << " [options]\n"
+         << "  --port N        UDP port to listen on (default 4739; the sniffer sends v9 to 2055)\n"
+         << "  --datagrams N   stop after N datagrams\n"
+         << "  --idle-exit S   stop S seconds after the last datagram\n";
+}
+
+struct Field {
+    uint16_t type;
+    uint16_t length; // 65535: variable length (IPFIX)
+};
+
+struct Totals {
+    uint64_t datagrams = 0;
+    uint64_t records = 0;
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    uint64_t templates = 0;
+    uint64_t skippedSets = 0; // data sets without a known template
+    uint64_t lost = 0;        // from sequence number gaps
+    uint64_t malformed = 0;
+};
+
+static uint64_t readUint(const uint8_t *p, size_t length) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < length && i < 8; ++i) value = value << 8 | p[i];
+    return value;
+}
+
+static string ipString(const uint8_t *p) {
+    char buf[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, p, buf, sizeof(buf));
+    return buf;
+}
+
+class Collector {
+public:
+    Totals totals;
+
+    void datagram(const uint8_t *data, size_t size) {
+        totals.datagrams++;
+        if (size < 16) {
+            totals.malformed++;
+            return;
+        }
+        int version = int(readUint(data, 2));
+        if (version == 10) {
+            ipfix(data, size);
+        } else if (version == 9 && size >= 20) {
+            netflow9(data, size);
+        } else {
+            totals.malformed++;
+        }
+    }
+
+private:
+    // (version, observation domain / source id, template id) -> fields
+    map<tuple<int, uint32_t, uint16_t>, vector<Field>> templates;
+    map<pair<int, uint32_t>, uint32_t> nextSequence;
+
+    void checkSequence(int version, uint32_t domain, uint32_t sequence, uint32_t next) {
+        auto key = make_pair(version, domain);
+        auto it = nextSequence.find(key);
+        if (it != nextSequence.end() && sequence != it->second) totals.lost += uint32_t(sequence - it->second);
+        nextSequence[key] = next;
+    }
+
+    void ipfix(const uint8_t *data, size_t size) {
+        size_t length = min<size_t>(size, readUint(data + 2, 2));
+        double exportTime = double(readUint(data + 4, 4));
+        uint32_t sequence = uint32_t(readUint(data + 8, 4));
+        uint32_t domain = uint32_t(readUint(data + 12, 4));
+        uint64_t before = totals.records;
+
+        for (size_t at = 16; at + 4 <= length;) {
+            uint16_t setId = uint16_t(readUint(data + at, 2));
+            size_t setLength = readUint(data + at + 2, 2);
+            if (setLength < 4 || at + setLength > length) {
+                totals.malformed++;
+                break;
+            }
+            if (setId == 2) {
+                learnTemplates(10, domain, data + at + 4, setLength - 4);
+            } else if (setId >= 256) {
+                dataSet(10, domain, setId, data + at + 4, setLength - 4, exportTime, 0);
+            }
+            at += setLength;
+        }
+        checkSequence(10, domain, sequence, sequence + uint32_t(totals.records - before));
+    }
+
+    void netflow9(const uint8_t *data, size_t size) {
+        double uptime = readUint(data + 4, 4) / 1000.0;
+        double unixSeconds = double(readUint(data + 8, 4));
+        uint32_t sequence = uint32_t(readUint(data + 12, 4));
+        uint32_t sourceId = uint32_t(readUint(data + 16, 4));
+        checkSequence(9, sourceId, sequence, sequence + 1);
+
+        for (size_t at = 20; at + 4 <= size;) {
+            uint16_t setId = uint16_t(readUint(data + at, 2));
+            size_t setLength = readUint(data + at + 2, 2);
+            if (setLength < 4 || at + setLength > size) {
+                totals.malformed++;
+                break;
+            }
+            if (setId == 0) {
+                learnTemplates(9, sourceId, data + at + 4, setLength - 4);
+            } else if (setId >= 256) {
+                // v9 times are exporter uptime in milliseconds
+                dataSet(9, sourceId, setId, data + at + 4, setLength - 4, unixSeconds, unixSeconds - uptime);
+            }
+            at += setLength;
+        }
+    }
+
+    void learnTemplates(int version, uint32_t domain, const uint8_t *p, size_t size) {
+        size_t at = 0;
+        while (at + 4 <= size) {
+            uint16_t templateId = uint16_t(readUint(p + at, 2));
+            size_t count = readUint(p + at + 2, 2);
+            at += 4;
+            vector<Field> fields;
+            for (size_t i = 0; i < count && at + 4 <= size; ++i) {
+                Field field{uint16_t(readUint(p + at, 2)), uint16_t(readUint(p + at + 2, 2))};
+                at += 4;
+                if (version == 10 && (field.type & 0x8000)) {
+                    at += 4; // enterprise number; its elements are skipped as unknown
+                    field.type = 0;
+                }
+                fields.push_back(field);
+            }
+            if (fields.size() != count) {
+                totals.malformed++;
+                return;
+            }
+            templates[make_tuple(version, domain, templateId)] = fields;
+            totals.templates++;
+        }
+    }
+
+    void dataSet(int version, uint32_t domain, uint16_t templateId, const uint8_t *p, size_t size,
+                 double exportTime, double bootTime) {
+        auto it = templates.find(make_tuple(version, domain, templateId));
+        if (it == templates.end()) {
+            totals.skippedSets++;
+            return;
+        }
+        const vector<Field> &fields = it->second;
+
+        size_t at = 0;
+        while (at < size) {
+            size_t start = at;
+            string src = "0.0.0.0", dst = "0.0.0.0";
+            uint64_t srcPort = 0, dstPort = 0, protocol = 0, packets = 0, bytes = 0, reason = 0;
+            double first = exportTime, last = exportTime;
+            bool complete = true;
+            for (const Field &field : fields) {
+                size_t length = field.length;
+                if (length == 65535) {
+                    if (at >= size) {
+                        complete = false;
+                        break;
+                    }
+                    length = p[at++];
+                    if (length == 255) {
+                        if (at + 2 > size) {
+                            complete = false;
+                            break;
+                        }
+                        length = readUint(p + at, 2);
+                        at += 2;
+                    }
+                }
+                if (at + length > size) {
+                    complete = false;
+                    break;
+                }
+                const uint8_t *value = p + at;
+                at += length;
+                switch (field.type) {
+                case 8: if (length == 4) src = ipString(value); break;
+                case 12: if (length == 4) dst = ipString(value); break;
+                case 7: srcPort = readUint(value, length); break;
+                case 11: dstPort = readUint(value, length); break;
+                case 4: protocol = readUint(value, length); break;
+                case 2: packets = readUint(value, length); break;
+                case 1: bytes = readUint(value, length); break;
+                case 136: reason = readUint(value, length); break;
+                case 152: first = readUint(value, length) / 1000.0; break;
+                case 153: last = readUint(value, length) / 1000.0; break;
+                case 22: if (version == 9) first = bootTime + readUint(value, length) / 1000.0; break;
+                case 21: if (version == 9) last = bootTime + readUint(value, length) / 1000.0; break;
+                default: break;
+                }
+            }
+            // What is left is padding (v9 flowsets end on 32 bits)
+            if (!complete || at == start) break;
+
+            totals.records++;
+            totals.packets += packets;
+            totals.bytes += bytes;
+            printf("{\"version\":%d,\"src_ip\":\"%s\",\"dst_ip\":\"%s\",\"src_port\":%llu,\"dst_port\":%llu,"
+                   "\"protocol\":%llu,\"packets\":%llu,\"bytes\":%llu,\"start\":%.3f,\"end\":%.3f,\"end_reason\":%llu}\n",
+                   version, src.c_str(), dst.c_str(), (unsigned long long)srcPort, (unsigned long long)dstPort,
+                   (unsigned long long)protocol, (unsigned long long)packets, (unsigned long long)bytes, first,
+                   last, (unsigned long long)reason);
+        }
+    }
+};
+
+int main(int argc, char *argv[]) {
+    int port = 4739;
+    uint64_t maxDatagrams = 0;
+    double idleExit = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (arg == "--datagrams" && i + 1 < argc) {
+            maxDatagrams = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--idle-exit" && i + 1 < argc) {
+            idleExit = atof(argv[++i]);
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (port <= 0 || port > 65535 || idleExit < 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int bufferSize = 4 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(uint16_t(port));
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (fd < 0 || bind(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) < 0) {
+        perror("bind");
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    cerr << "📥 Collecting IPFIX / NetFlow v9 on UDP port " << port << "\n";
+
+    Collector collector;
+    vector<uint8_t> buffer(65536);
+    double idle = 0;
+    while (!stopRequested && (maxDatagrams == 0 || collector.totals.datagrams < maxDatagrams)) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0) {
+            idle += 0.1;
+            if (idleExit > 0 && collector.totals.datagrams > 0 && idle >= idleExit) break;
+            continue;
+        }
+        ssize_t n = recv(fd, buffer.data(), buffer.size(), 0);
+        if (n <= 0) continue;
+        idle = 0;
+        collector.datagram(buffer.data(), size_t(n));
+    }
+    fflush(stdout);
+    close(fd);
+
+    const Totals &t = collector.totals;
+    cerr << "datagrams: " << t.datagrams << ", records: " << t.records << ", packets: " << t.packets
+         << ", bytes: " << t.bytes << ", templates: " << t.templates << ", skipped sets: " << t.skippedSets
+         << ", lost (sequence): " << t.lost << ", malformed: " << t.malformed << "\n";
+    return 0;
+}
@@ -0,0 +1,123 @@
+// Isolation forest scoring benchmark over a feature CSV such as
+// network_features.csv. Columns are matched to the model's features by name.
+// With --scores it prints one score per row, to compare with sklearn's
+// score_samples() on the same file.
+//
+//   iforest_bench [--model FILE] [--repeat N] [--scores] features.csv
+
+#include "../isolationForest.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+static void printUsage(const char *program) {
+    cerr << "Usage: " << program << " [options] features.csv\n"
+         << "  --model FILE   exported forest (default models/isolation_forest.bin)\n"
+         << "  --repeat N     score the file N times for timing (default 100)\n"
+         << "  --scores       print the score of every row instead of timings\n";
+}
+
+static vector<string> splitCsv(const string &line) {
+    vector<string> fields;
+    stringstream stream(line.substr(0, line.find_last_not_of("\r") + 1));
+    string field;
+    while (getline(stream, field, ',')) fields.push_back(field);
+    return fields;
+}
+
+int main(int argc, char *argv[]) {
+    string modelPath = "models/isolation_forest.bin";
+    int repeat = 100;
+    bool printScores = false;
+    string csvPath;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--model" && i + 1 < argc) {
+            modelPath = argv[++i];
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else if (arg == "--scores") {
+            printScores = true;
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            csvPath = arg;
+        }
+    }
+
+    if (csvPath.empty() || repeat <= 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    IsolationForest forest;
+    if (!forest.load(modelPath)) return 1;
+
+    ifstream csv(csvPath);
+    string line;
+    if (!csv.is_open() || !getline(csv, line)) {
+        cerr << "❌ Could not read " << csvPath << "\n";
+        return 1;
+    }
+
+    vector<string> header = splitCsv(line);
+    vector<size_t> columns;
+    for (const string &name : forest.featureNames()) {
+        auto it = find(header.begin(), header.end(), name);
+        if (it == header.end()) {
+            cerr << "❌ " << csvPath << " has no column " << name << "\n";
+            return 1;
+        }
+        columns.push_back(it - header.begin());
+    }
+
+    // Row-major samples in model feature order; missing values count as 0 like train_model.py
+    vector<double> rows;
+    size_t count = 0;
+    while (getline(csv, line)) {
+        if (line.empty()) continue;
+        vector<string> fields = splitCsv(line);
+        for (size_t column : columns)
+            rows.push_back(column < fields.size() && !fields[column].empty() ? atof(fields[column].c_str()) : 0.0);
+        count++;
+    }
+    if (count == 0) {
+        cerr << "❌ No rows in " << csvPath << "\n";
+        return 1;
+    }
+
+    vector<double> scores(count);
+    if (printScores) {
+        forest.score(rows.data(), count, scores.data());
+        cout << setprecision(17);
+        for (double score : scores) cout << score << "\n";
+        return 0;
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < repeat; ++i) forest.score(rows.data(), count, scores.data());
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    size_t anomalies = count_if(scores.begin(), scores.end(), [&](double s) { return forest.decision(s) < 0; });
+
+    cout << fixed << setprecision(2);
+    cout << "trees:            " << forest.treeCount() << " over " << forest.featureCount() << " features\n";
+    cout << "rows:             " << count << " x " << repeat << "\n";
+    cout << "elapsed:          " << elapsed << " s\n";
+    cout << "rows/sec:         " << count * repeat / elapsed << "\n";
+    cout << "us/row:           " << elapsed * 1e6 / (double(count) * repeat) << "\n";
+    cout << "anomalous rows:   " << anomalies << "/" << count << "\n";
+
+    return 0;
+}
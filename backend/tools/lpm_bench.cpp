@@ -0,0 +1,161 @@
+// Prefix table benchmark: compiles a synthetic prefix list shaped like a
+// routing table (mostly /24s and /16-/22s for IPv4, /32-/48 for IPv6),
+// maps it and times lookups of random addresses. A sample of lookups is
+// checked against a linear scan of the list; the exit status is 1 on any
+// mismatch.
+//
+//   lpm_bench [--prefixes N] [--lookups N] [--file path]
+
+#include "../lpmTable.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <array>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+static void printUsage(const char *program) {
+    cerr << "Usage: " << program << " [options]\n"
+         << "  --prefixes N  IPv4 prefixes in the list, plus a quarter as many IPv6 (default 200000)\n"
+         << "  --lookups N   lookups per run (default 10000000)\n"
+         << "  --file path   where to write the list; the image goes to path.lpm (default /tmp/lpm_bench.txt)\n";
+}
+
+struct Entry {
+    bool v6;
+    uint8_t key[16];
+    int length;
+    uint32_t asn;
+};
+
+static bool covers(const Entry &entry, const uint8_t *addr) {
+    int full = entry.length / 8;
+    if (memcmp(entry.key, addr, full) != 0) return false;
+    int rest = entry.length % 8;
+    return rest == 0 || ((entry.key[full] ^ addr[full]) & (0xff00 >> rest)) == 0;
+}
+
+// Longest covering entry, the later one among equal lengths, as the compiler does
+static const Entry *scan(const vector<Entry> &entries, bool v6, const uint8_t *addr) {
+    const Entry *best = nullptr;
+    for (const Entry &entry : entries)
+        if (entry.v6 == v6 && covers(entry, addr) && (!best || entry.length >= best->length)) best = &entry;
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    size_t prefixCount = 200000;
+    size_t lookupCount = 10000000;
+    string path = "/tmp/lpm_bench.txt";
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--prefixes" && i + 1 < argc) {
+            prefixCount = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--lookups" && i + 1 < argc) {
+            lookupCount = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--file" && i + 1 < argc) {
+            path = argv[++i];
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (lookupCount == 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    mt19937 rng(42);
+    vector<Entry> entries;
+    {
+        ofstream list(path);
+        list << "# synthetic prefix list written by lpm_bench\n";
+        for (size_t i = 0; i < prefixCount + prefixCount / 4; ++i) {
+            Entry entry = {};
+            entry.v6 = i >= prefixCount;
+            uint32_t pick = rng() % 100;
+            if (!entry.v6) {
+                entry.length = pick < 60 ? 24 : pick < 90 ? 16 + int(rng() % 7) : pick < 97 ? 8 + int(rng() % 8) : 25 + int(rng() % 8);
+                uint32_t addr = rng();
+                for (int b = 0; b < 4; ++b) entry.key[b] = uint8_t(addr >> (24 - 8 * b));
+            } else {
+                entry.length = pick < 50 ? 48 : pick < 80 ? 32 + int(rng() % 16) : 49 + int(rng() % 16);
+                entry.key[0] = 0x20;
+                entry.key[1] = uint8_t(rng() & 0x0f); // 2000::/12, where unicast space is
+                for (int b = 2; b < 16; ++b) entry.key[b] = uint8_t(rng());
+            }
+            for (int bit = entry.length; bit < 128; ++bit) entry.key[bit / 8] &= ~(0x80 >> (bit % 8));
+            entry.asn = 64512 + rng() % 1000;
+            entries.push_back(entry);
+
+            char text[INET6_ADDRSTRLEN];
+            inet_ntop(entry.v6 ? AF_INET6 : AF_INET, entry.key, text, sizeof(text));
+            list << text << "/" << entry.length << " AS" << entry.asn << " site" << entry.asn % 7 << "\n";
+        }
+    }
+
+    string error;
+    auto start = chrono::steady_clock::now();
+    if (!LpmTable::compile(path, path + ".lpm", error)) {
+        cerr << error << "\n";
+        return 1;
+    }
+    double compileMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    unique_ptr<LpmTable> table = LpmTable::map(path + ".lpm", error);
+    if (!table) {
+        cerr << error << "\n";
+        return 1;
+    }
+
+    // Addresses drawn beforehand, so the loops time the lookups alone
+    vector<uint32_t> addrs(1 << 20);
+    vector<array<uint8_t, 16>> addrs6(1 << 18);
+    for (auto &addr : addrs) addr = rng();
+    for (auto &addr : addrs6) {
+        for (auto &byte : addr) byte = uint8_t(rng());
+        addr[0] = 0x20;
+        addr[1] &= 0x0f;
+    }
+
+    size_t mismatches = 0;
+    for (int i = 0; i < 2000; ++i) {
+        uint8_t bytes[16];
+        memcpy(bytes, &addrs[i], 4);
+        const Entry *expected = scan(entries, false, bytes);
+        const PrefixTag *tag = table->lookup(addrs[i]);
+        if ((expected ? expected->asn : 0) != (tag ? tag->asn : 0)) mismatches++;
+
+        expected = scan(entries, true, addrs6[i].data());
+        tag = table->lookup6(addrs6[i].data());
+        if ((expected ? expected->asn : 0) != (tag ? tag->asn : 0)) mismatches++;
+    }
+
+    size_t matched = 0;
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < lookupCount; ++i) matched += table->lookup(addrs[i & (addrs.size() - 1)]) != nullptr;
+    double perLookup = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / lookupCount;
+
+    size_t lookup6Count = lookupCount / 4 + 1;
+    size_t matched6 = 0;
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < lookup6Count; ++i) matched6 += table->lookup6(addrs6[i & (addrs6.size() - 1)].data()) != nullptr;
+    double perLookup6 = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / lookup6Count;
+
+    cout << fixed << setprecision(2);
+    cout << "prefixes:        " << table->prefixCount() << "\n";
+    cout << "image:           " << table->imageBytes() / 1024 << " KB (" << table->nodeCount() << " nodes)\n";
+    cout << "compile:         " << compileMs << " ms\n";
+    cout << "IPv4 lookup:     " << perLookup << " ns (" << 100.0 * matched / lookupCount << "% matched)\n";
+    cout << "IPv6 lookup:     " << perLookup6 << " ns (" << 100.0 * matched6 / lookup6Count << "% matched)\n";
+    cout << "check vs scan:   " << (mismatches ? to_string(mismatches) + " mismatches" : "ok") << "\n";
+    return mismatches ? 1 : 0;
+}
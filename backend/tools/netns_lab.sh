@@ -0,0 +1,149 @@
+#!/bin/bash
+# Local traceroute lab built from network namespaces, no outside network needed.
+#
+#   client -- r1 -- r2 -- ... -- rN --+-- leaf1
+#                                     +-- leaf2 ...
+#
+# Every link is a veth pair with netem delay/loss on both ends, so hop n is
+# 2 * n * delay away from the client. The routers can be given an ICMP rate
+# limit to mimic routers that throttle time exceeded messages.
+#
+# Usage (as root):
+#   tools/netns_lab.sh up    [options]   build the lab
+#   tools/netns_lab.sh bench [options]   build, run traceroute_bench, tear down
+#   tools/netns_lab.sh down              remove every lab namespace
+#
+# Options:
+#   --hops N            routers between client and leaves (default 5)
+#   --leaves N          target namespaces behind the last router (default 1)
+#   --delay MS          one-way delay per link (default 2)
+#   --loss PCT          netem loss per link direction (default 0)
+#   --icmp-ratelimit MS router net.ipv4.icmp_ratelimit (default: kernel default)
+#   --traces N          traces for the bench command (default 20)
+#   --cold              run the bench without shared RTT estimates
+
+set -e
+
+PREFIX=nvlab
+HOPS=5
+LEAVES=1
+DELAY=2
+LOSS=0
+RATELIMIT=
+TRACES=20
+COLD=
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+BENCH="$SCRIPT_DIR/../traceroute_bench"
+
+usage() {
+    sed -n '2,/^$/p' "$0" | sed 's/^# \{0,1\}//'
+    exit 1
+}
+
+lab_down() {
+    for ns in $(ip netns list | awk '{print $1}' | grep "^${PREFIX}" || true); do
+        ip netns del "$ns"
+    done
+}
+
+# add_link <ns-a> <ns-b> <addr-a> <addr-b>: veth pair with netem on both ends
+add_link() {
+    local a=$1 b=$2 addr_a=$3 addr_b=$4
+    local if_a="${b}" if_b="${a}"
+
+    ip link add "$if_a" netns "$a" type veth peer name "$if_b" netns "$b"
+    ip -n "$a" addr add "$addr_a/24" dev "$if_a"
+    ip -n "$b" addr add "$addr_b/24" dev "$if_b"
+    ip -n "$a" link set "$if_a" up
+    ip -n "$b" link set "$if_b" up
+
+    local netem="delay ${DELAY}ms"
+    if [ "$LOSS" != "0" ]; then netem="$netem loss ${LOSS}%"; fi
+    ip netns exec "$a" tc qdisc add dev "$if_a" root netem $netem
+    ip netns exec "$b" tc qdisc add dev "$if_b" root netem $netem
+}
+
+lab_up() {
+    lab_down
+
+    ip netns add "${PREFIX}c"
+    ip -n "${PREFIX}c" link set lo up
+    for i in $(seq 1 "$HOPS"); do
+        ip netns add "${PREFIX}r$i"
+        ip -n "${PREFIX}r$i" link set lo up
+        ip netns exec "${PREFIX}r$i" sysctl -qw net.ipv4.ip_forward=1
+        if [ -n "$RATELIMIT" ]; then
+            ip netns exec "${PREFIX}r$i" sysctl -qw net.ipv4.icmp_ratelimit="$RATELIMIT"
+        fi
+    done
+
+    # Chain: link k joins r(k) (10.77.k.1) and r(k+1) (10.77.k.2), r0 is the client
+    add_link "${PREFIX}c" "${PREFIX}r1" 10.77.0.1 10.77.0.2
+    ip -n "${PREFIX}c" route add default via 10.77.0.2
+    for i in $(seq 1 $((HOPS - 1))); do
+        add_link "${PREFIX}r$i" "${PREFIX}r$((i + 1))" "10.77.$i.1" "10.77.$i.2"
+        ip -n "${PREFIX}r$i" route add 10.78.0.0/16 via "10.77.$i.2"
+    done
+    ip -n "${PREFIX}r1" route add default via 10.77.0.1
+    for i in $(seq 2 "$HOPS"); do
+        ip -n "${PREFIX}r$i" route add default via "10.77.$((i - 1)).1"
+    done
+
+    # Leaves hang off the last router on 10.78.j.0/24
+    for j in $(seq 1 "$LEAVES"); do
+        ip netns add "${PREFIX}l$j"
+        ip -n "${PREFIX}l$j" link set lo up
+        add_link "${PREFIX}r$HOPS" "${PREFIX}l$j" "10.78.$j.1" "10.78.$j.2"
+        ip -n "${PREFIX}l$j" route add default via "10.78.$j.1"
+    done
+
+    echo "✅ Lab up: $HOPS router(s), $LEAVES leaf target(s), ${DELAY}ms/link, ${LOSS}% loss" >&2
+    echo "   targets: $(lab_targets)" >&2
+}
+
+lab_targets() {
+    for j in $(seq 1 "$LEAVES"); do printf '10.78.%d.2 ' "$j"; done
+}
+
+lab_bench() {
+    if [ ! -x "$BENCH" ]; then
+        echo "❌ $BENCH not found, build it with 'make bench'" >&2
+        exit 1
+    fi
+
+    lab_up
+    trap lab_down EXIT
+    ip netns exec "${PREFIX}c" "$BENCH" --traces "$TRACES" --max-hops $((HOPS + 5)) \
+        --link-delay "$DELAY" $COLD $(lab_targets)
+}
+
+[ $# -ge 1 ] || usage
+COMMAND=$1
+shift
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --hops) HOPS=$2; shift ;;
+        --leaves) LEAVES=$2; shift ;;
+        --delay) DELAY=$2; shift ;;
+        --loss) LOSS=$2; shift ;;
+        --icmp-ratelimit) RATELIMIT=$2; shift ;;
+        --traces) TRACES=$2; shift ;;
+        --cold) COLD=--cold ;;
+        *) usage ;;
+    esac
+    shift
+done
+
+if [ "$(id -u)" -ne 0 ]; then
+    echo "❌ The lab needs root to create namespaces" >&2
+    exit 1
+fi
+
+case "$COMMAND" in
+    up) lab_up ;;
+    down) lab_down ;;
+    bench) lab_bench ;;
+    *) usage ;;
+esac
@@ -0,0 +1,239 @@
+// Federated collector: takes the record streams of several sniffers
+// (packet_sniffer --send host:port) over TCP and writes them to stdout as
+// one stream, in timestamp order and tagged with "sensor", ready for
+// app.py. The sensors' TRAFFIC records are replaced by one TRAFFIC record
+// per interval whose edges are counted once however many sensors saw them.
+// Status and totals go to stderr.
+//
+//   record_collector [--port N] [--lateness SEC] [--idle SEC] [--interval SEC]
+//                    [--max-buffered N] [--aggregate-only] [--exit-when-done]
+
+#include "../streamMerger.h"
+#include "../federatedTraffic.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) { stopRequested = 1; }
+
+static void printUsage(const char *program) {
+    cerr << "Usage: " << program << " [options]\n"
+         << "  --port N          TCP port the sniffers send to, IPv4 and IPv6 (default 9700)\n"
+         << "  --lateness S      seconds a record may trail the slowest sensor and still merge in order (default 2)\n"
+         << "  --idle S          seconds without records after which a sensor stops holding the merge (default 5)\n"
+         << "  --interval S      seconds per unified TRAFFIC record (default 1, as the sniffers' --traffic-interval)\n"
+         << "  --max-buffered N  records held for ordering before the oldest go out early (default 200000)\n"
+         << "  --aggregate-only  do not pass packet records on, only the unified TRAFFIC and other records\n"
+         << "  --exit-when-done  stop once every sensor that connected has disconnected\n";
+}
+
+static double wallClock() {
+    return chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static void writeRecord(const json &record) {
+    string line = record.dump();
+    line += '\n';
+    fwrite(line.data(), 1, line.size(), stdout);
+}
+
+static bool isPacketRecord(const json &record) {
+    auto protocol = record.find("protocol");
+    if (protocol == record.end() || !protocol->is_string()) return false;
+    const string &type = protocol->get_ref<const string &>();
+    return type == "TCP" || type == "UDP" || type == "ICMP" || type == "Other";
+}
+
+// "address:port", "[address]:port" for IPv6; IPv4 peers arrive as mapped addresses
+static string peerName(const struct sockaddr_storage &peer, socklen_t length) {
+    char host[NI_MAXHOST], service[NI_MAXSERV];
+    if (getnameinfo(reinterpret_cast<const struct sockaddr *>(&peer), length, host, sizeof(host), service,
+                    sizeof(service), NI_NUMERICHOST | NI_NUMERICSERV) != 0)
+        return "unknown";
+    string name = host;
+    if (name.compare(0, 7, "::ffff:") == 0 && name.find('.') != string::npos) return name.substr(7) + ":" + service;
+    if (name.find(':') != string::npos) return "[" + name + "]:" + service;
+    return name + ":" + service;
+}
+
+struct Connection {
+    int fd;
+    int source;
+    string pending; // an incomplete last line
+};
+
+int main(int argc, char *argv[]) {
+    int port = 9700;
+    double lateness = 2;
+    double idleSeconds = 5;
+    double interval = 1;
+    size_t maxBuffered = 200000;
+    bool aggregateOnly = false;
+    bool exitWhenDone = false;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (arg == "--lateness" && i + 1 < argc) {
+            lateness = atof(argv[++i]);
+        } else if (arg == "--idle" && i + 1 < argc) {
+            idleSeconds = atof(argv[++i]);
+        } else if (arg == "--interval" && i + 1 < argc) {
+            interval = atof(argv[++i]);
+        } else if (arg == "--max-buffered" && i + 1 < argc) {
+            maxBuffered = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--aggregate-only") {
+            aggregateOnly = true;
+        } else if (arg == "--exit-when-done") {
+            exitWhenDone = true;
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (port <= 0 || port > 65535 || lateness < 0 || idleSeconds <= 0 || interval <= 0 || maxBuffered == 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // One dual-stack socket takes IPv6 sensors and, as mapped addresses, IPv4 ones
+    int listener = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int reuse = 1, v6Only = 0;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    setsockopt(listener, IPPROTO_IPV6, IPV6_V6ONLY, &v6Only, sizeof(v6Only));
+    struct sockaddr_in6 address = {};
+    address.sin6_family = AF_INET6;
+    address.sin6_port = htons(uint16_t(port));
+    address.sin6_addr = in6addr_any;
+    if (listener < 0 || bind(listener, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) < 0 ||
+        listen(listener, 16) < 0) {
+        perror("listen");
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    cerr << "📥 Collecting sniffer records on TCP port " << port << "\n";
+
+    FederatedTraffic traffic(writeRecord, interval);
+    StreamMerger merger(
+        [&](json &record, const string &sensor) {
+            if (!traffic.add(record, sensor)) return;
+            if (aggregateOnly && isPacketRecord(record)) return;
+            record["sensor"] = sensor;
+            writeRecord(record);
+        },
+        lateness, idleSeconds, maxBuffered);
+
+    vector<Connection> connections;
+    bool connectedOnce = false;
+    uint64_t malformed = 0;
+    vector<char> buffer(1 << 16);
+
+    auto handleLine = [&](Connection &connection, const string &line, double now) {
+        if (line.empty() || line[0] != '{') return; // status lines of a sniffer piped in whole
+        json record = json::parse(line, nullptr, false);
+        if (record.is_discarded() || !record.is_object()) {
+            malformed++;
+            return;
+        }
+        if (record.value("protocol", "") == "HELLO") {
+            string sensor = record.value("sensor", "");
+            if (!sensor.empty()) merger.rename(connection.source, sensor);
+            cerr << "📡 " << merger.name(connection.source) << " ("
+                 << record.value("interfaces", json::array()).dump() << ") connected\n";
+            return;
+        }
+        merger.push(connection.source, std::move(record), now);
+    };
+
+    while (!stopRequested) {
+        vector<struct pollfd> fds;
+        fds.push_back({listener, POLLIN, 0});
+        for (const auto &connection : connections) fds.push_back({connection.fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), 100) < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        double now = wallClock();
+
+        if (fds[0].revents & POLLIN) {
+            struct sockaddr_storage peer = {};
+            socklen_t peerLength = sizeof(peer);
+            int fd;
+            while ((fd = accept4(listener, reinterpret_cast<struct sockaddr *>(&peer), &peerLength, SOCK_NONBLOCK)) >=
+                   0) {
+                // Named by its address until its HELLO record says otherwise
+                connections.push_back({fd, merger.addSource(peerName(peer, peerLength), now), ""});
+                connectedOnce = true;
+                peerLength = sizeof(peer);
+            }
+        }
+
+        for (size_t i = 0; i < connections.size(); ++i) {
+            if (!fds[i + 1].revents) continue;
+            Connection &connection = connections[i];
+            bool closed = false;
+            while (true) {
+                ssize_t n = recv(connection.fd, buffer.data(), buffer.size(), 0);
+                if (n > 0) {
+                    connection.pending.append(buffer.data(), size_t(n));
+                    continue;
+                }
+                closed = n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+                break;
+            }
+
+            size_t start = 0, end;
+            while ((end = connection.pending.find('\n', start)) != string::npos) {
+                handleLine(connection, connection.pending.substr(start, end - start), now);
+                start = end + 1;
+            }
+            connection.pending.erase(0, start);
+
+            if (closed) {
+                cerr << "🔌 " << merger.name(connection.source) << " disconnected\n";
+                merger.close(connection.source);
+                close(connection.fd);
+                connection.fd = -1;
+            }
+        }
+        connections.erase(remove_if(connections.begin(), connections.end(),
+                                    [](const Connection &connection) { return connection.fd < 0; }),
+                          connections.end());
+
+        merger.release(now);
+        fflush(stdout);
+        if (exitWhenDone && connectedOnce && connections.empty()) break;
+    }
+
+    for (auto &connection : connections) close(connection.fd);
+    close(listener);
+    merger.flush();
+    traffic.flush();
+    fflush(stdout);
+
+    cerr << "records: " << merger.mergedRecords() << ", late: " << merger.lateRecords()
+         << ", released early: " << merger.forcedRecords() << ", malformed: " << malformed
+         << ", late for their interval: " << traffic.lateRecords()
+         << ", duplicate packets: " << traffic.duplicatePackets() << "\n";
+    return 0;
+}
@@ -0,0 +1,482 @@
+// Rule engine benchmark: per-packet cost of a rule set over synthetic
+// traffic, against a run without rules. Rules come from a file, or a
+// built-in mix of typical rules repeated with different constants. The
+// rules, plus a set covering every kind of test and guard, are then checked
+// against a reference evaluator that walks each condition as parsed, with
+// no bytecode or indexes: the rules matching each packet and the alerts
+// each rule raises must agree. The exit status is 1 on any mismatch.
+//
+//   rule_bench [--rules FILE] [--count N] [--packets N] [--check N]
+
+#include "../ruleEngine.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <cstdlib>
+#include <arpa/inet.h>
+
+using namespace std;
+
+static void printUsage(const char *program) {
+    cerr << "Usage: " << program << " [options]\n"
+         << "  --rules FILE    rules to measure (default: built-in mix)\n"
+         << "  --count N       rules generated from the built-in mix (default 200)\n"
+         << "  --packets N     synthetic packets per run (default 2000000)\n"
+         << "  --check N       packets checked against the reference evaluator (default 200000)\n";
+}
+
+static vector<string> builtinRules(int count) {
+    vector<string> rules;
+    for (int i = 0; i < count; ++i) {
+        int port = 1000 + i;
+        switch (i % 5) {
+        case 0:
+            rules.push_back("syn" + to_string(i) + ": tcp and syn and not ack and dst_port == " + to_string(port) +
+                            " | count by src > 500 per 1s");
+            break;
+        case 1:
+            rules.push_back("dns" + to_string(i) + ": udp and src_port == 53 and len > " + to_string(512 + i));
+            break;
+        case 2:
+            rules.push_back("net" + to_string(i) + ": src in 10." + to_string(i % 256) +
+                            ".0.0/16 and not dst == 10.0.0.0/8 | bytes by pair > 10000000 per 10s");
+            break;
+        case 3:
+            rules.push_back("ports" + to_string(i) + ": port in {" + to_string(port) + ", " + to_string(port + 1) +
+                            ", 3389} | count by dst > 1000 per 1s");
+            break;
+        default:
+            rules.push_back("range" + to_string(i) + ": (icmp or udp) and dst_port in " + to_string(port) + "-" +
+                            to_string(port + 100) + " and len < 100");
+            break;
+        }
+    }
+    return rules;
+}
+
+// Every kind of test, negation and guard, on addresses the synthetic traffic uses
+static const char *const CHECK_RULES[] = {
+    "c_block: src == 10.0.3.0/24",
+    "c_block_ne: dst != 10.0.0.0/8 and tcp",
+    "c_block_in: dst in 192.168.8.0/21 and not syn",
+    "c_addr: src == 10.0.0.7 or dst == 192.168.0.9",
+    "c_addrs: dst in {10.0.1.1, 10.0.2.2, 192.168.3.3} | count > 2 per 1s",
+    "c_addr_lt: src < 10.0.2.0 and len >= 1000",
+    "c_wide: src in 0.0.0.0/4 and dst not in 10.0.0.0/20",
+    "c_port_ne: port != 443 and udp",
+    "c_port_not_in: tcp and port not in {443, 53}",
+    "c_port_range: port in 1-1023 | count by src_port > 50 per 1s",
+    "c_port_wide: dst_port in 1024-65535 and ack",
+    "c_port_gt: src_port > 65000 | count by dst > 1 per 100ms",
+    "c_proto: proto in {udp, icmp} and len <= 100",
+    "c_not_tcp: not tcp and not (len > 1400)",
+    "c_or: (syn and ack) or (udp and src_port == 53) or icmp",
+    "c_nested: not (tcp and (dst_port == 443 or src_port == 443)) and len < 200",
+    "c_never: tcp and udp",
+    "c_len_lt0: len < 0",
+    "c_len_band: len in 500-600 | bytes by pair > 100000 per 1s",
+    "c_len_max: len <= 64 | count by dst > 10 per 1s",
+    "c_proto_ne: proto != tcp and dst == 192.168.0.0/16",
+    "c_flags: fin or rst or psh or urg or not (syn or ack)",
+};
+
+// Reference evaluator: a condition parsed into closures over the packet
+using Test = function<bool(const PacketRecord &)>;
+
+struct Reference {
+    string name;
+    Test condition;
+    bool bytes = false;
+    string key; // empty for none
+    double threshold = 0;
+    double windowSeconds = 1;
+    int64_t windowIndex = -1;
+    map<uint64_t, uint64_t> totals;
+    size_t alerts = 0;
+};
+
+class ReferenceParser {
+public:
+    explicit ReferenceParser(const string &line) {
+        static const string SYMBOLS2[] = {"==", "!=", "<=", ">="};
+        auto word = [](char c) { return isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.' || c == '/'; };
+        for (size_t i = 0; i < line.size();) {
+            char c = line[i];
+            if (isspace(static_cast<unsigned char>(c))) {
+                i++;
+            } else if (word(c)) {
+                size_t start = i;
+                while (i < line.size() && word(line[i])) i++;
+                tokens.push_back(line.substr(start, i - start));
+            } else if (find(begin(SYMBOLS2), end(SYMBOLS2), line.substr(i, 2)) != end(SYMBOLS2)) {
+                tokens.push_back(line.substr(i, 2));
+                i += 2;
+            } else {
+                tokens.push_back(string(1, c));
+                i++;
+            }
+        }
+    }
+
+    Reference parse() {
+        Reference rule;
+        rule.name = next();
+        expect(":");
+        rule.condition = expr();
+        if (accept("|")) {
+            rule.bytes = next() == "bytes";
+            if (accept("by")) rule.key = next();
+            expect(">");
+            rule.threshold = stod(next());
+            expect("per");
+            string window = next();
+            size_t unit;
+            rule.windowSeconds = stod(window, &unit);
+            if (window.substr(unit) == "ms") rule.windowSeconds /= 1000;
+            if (window.substr(unit) == "m") rule.windowSeconds *= 60;
+        }
+        if (pos != tokens.size()) throw runtime_error("trailing '" + tokens[pos] + "'");
+        return rule;
+    }
+
+private:
+    vector<string> tokens;
+    size_t pos = 0;
+
+    string next() {
+        if (pos == tokens.size()) throw runtime_error("unexpected end");
+        return tokens[pos++];
+    }
+    bool accept(const string &token) {
+        if (pos == tokens.size() || tokens[pos] != token) return false;
+        pos++;
+        return true;
+    }
+    void expect(const string &token) {
+        if (!accept(token)) throw runtime_error("expected '" + token + "'");
+    }
+
+    Test expr() {
+        Test left = term();
+        while (accept("or")) {
+            Test right = term();
+            left = [left, right](const PacketRecord &p) { return left(p) || right(p); };
+        }
+        return left;
+    }
+
+    Test term() {
+        Test left = factor();
+        while (accept("and")) {
+            Test right = factor();
+            left = [left, right](const PacketRecord &p) { return left(p) && right(p); };
+        }
+        return left;
+    }
+
+    Test factor() {
+        if (accept("not")) {
+            Test operand = factor();
+            return [operand](const PacketRecord &p) { return !operand(p); };
+        }
+        if (accept("(")) {
+            Test inner = expr();
+            expect(")");
+            return inner;
+        }
+        return predicate();
+    }
+
+    static uint32_t protocolNumber(int protocol) {
+        switch (protocol) {
+        case PacketRecord::TCP: return 6;
+        case PacketRecord::UDP: return 17;
+        case PacketRecord::ICMP: return 1;
+        default: return 255;
+        }
+    }
+
+    uint32_t value(const string &field) {
+        string word = next();
+        if (field == "src" || field == "dst") {
+            struct in_addr addr;
+            if (inet_pton(AF_INET, word.c_str(), &addr) != 1) throw runtime_error("bad address " + word);
+            return ntohl(addr.s_addr);
+        }
+        if (field == "proto" && (word == "tcp" || word == "udp" || word == "icmp"))
+            return word == "tcp" ? 6 : word == "udp" ? 17 : 1;
+        return stoul(word);
+    }
+
+    Test predicate() {
+        string word = next();
+        static const map<string, uint8_t> FLAGS = {
+            {"fin", PacketRecord::FLAG_FIN}, {"syn", PacketRecord::FLAG_SYN}, {"rst", PacketRecord::FLAG_RST},
+            {"psh", PacketRecord::FLAG_PSH}, {"ack", PacketRecord::FLAG_ACK}, {"urg", PacketRecord::FLAG_URG}};
+        if (FLAGS.count(word)) {
+            uint8_t flag = FLAGS.at(word);
+            return [flag](const PacketRecord &p) { return (p.tcpFlags & flag) != 0; };
+        }
+        if (word == "tcp" || word == "udp" || word == "icmp") {
+            int protocol = word == "tcp" ? PacketRecord::TCP : word == "udp" ? PacketRecord::UDP : PacketRecord::ICMP;
+            return [protocol](const PacketRecord &p) { return p.protocol == protocol; };
+        }
+
+        function<uint32_t(const PacketRecord &)> get;
+        if (word == "src") get = [](const PacketRecord &p) { return ntohl(p.srcAddr); };
+        else if (word == "dst") get = [](const PacketRecord &p) { return ntohl(p.dstAddr); };
+        else if (word == "src_port") get = [](const PacketRecord &p) { return uint32_t(p.srcPort); };
+        else if (word == "dst_port") get = [](const PacketRecord &p) { return uint32_t(p.dstPort); };
+        else if (word == "len") get = [](const PacketRecord &p) { return uint32_t(p.length); };
+        else if (word == "proto") get = [](const PacketRecord &p) { return protocolNumber(p.protocol); };
+        else if (word != "port") throw runtime_error("unknown field " + word);
+        bool isAddr = word == "src" || word == "dst";
+
+        // `port` passes when either port does
+        auto on = [word, get](function<bool(uint32_t)> pass) -> Test {
+            if (word == "port")
+                return [pass](const PacketRecord &p) { return pass(p.srcPort) || pass(p.dstPort); };
+            return [get, pass](const PacketRecord &p) { return pass(get(p)); };
+        };
+        auto negated = [](Test test) -> Test { return [test](const PacketRecord &p) { return !test(p); }; };
+
+        bool negate = accept("not");
+        if (negate || accept("in")) {
+            if (negate) expect("in");
+            Test test = on(membership(word, isAddr));
+            return negate ? negated(test) : test;
+        }
+
+        string compare = next();
+        if (isAddr && tokens[pos].find('/') != string::npos) {
+            Test test = on(membership(word, true));
+            return compare == "!=" ? negated(test) : test;
+        }
+        uint32_t constant = value(word);
+        return on([compare, constant](uint32_t v) {
+            if (compare == "==") return v == constant;
+            if (compare == "!=") return v != constant;
+            if (compare == "<") return v < constant;
+            if (compare == "<=") return v <= constant;
+            if (compare == ">") return v > constant;
+            return v >= constant;
+        });
+    }
+
+    function<bool(uint32_t)> membership(const string &field, bool isAddr) {
+        if (accept("{")) {
+            set<uint32_t> values;
+            do {
+                values.insert(value(field));
+            } while (accept(","));
+            expect("}");
+            return [values](uint32_t v) { return values.count(v) > 0; };
+        }
+        if (isAddr) {
+            string block = next();
+            size_t slash = block.find('/');
+            int bits = slash == string::npos ? 32 : stoi(block.substr(slash + 1));
+            struct in_addr addr;
+            inet_pton(AF_INET, block.substr(0, slash).c_str(), &addr);
+            uint32_t prefix = ntohl(addr.s_addr);
+            return [prefix, bits](uint32_t v) { return bits == 0 || (v ^ prefix) >> (32 - bits) == 0; };
+        }
+        uint32_t low = value(field);
+        expect("-");
+        uint32_t high = value(field);
+        return [low, high](uint32_t v) { return v >= low && v <= high; };
+    }
+};
+
+// Counts as RuleEngine::count() does: per key and tumbling window, an alert
+// when a total first goes above the threshold, at most maxKeys keys a window
+static void referenceCount(Reference &rule, const PacketRecord &p, size_t maxKeys) {
+    int64_t index = static_cast<int64_t>(floor(p.timestamp / rule.windowSeconds));
+    if (index > rule.windowIndex) {
+        rule.totals.clear();
+        rule.windowIndex = index;
+    }
+    uint64_t key = 0;
+    if (rule.key == "src") key = ntohl(p.srcAddr);
+    else if (rule.key == "dst") key = ntohl(p.dstAddr);
+    else if (rule.key == "src_port") key = p.srcPort;
+    else if (rule.key == "dst_port") key = p.dstPort;
+    else if (rule.key == "pair") key = uint64_t(ntohl(p.srcAddr)) << 32 | ntohl(p.dstAddr);
+
+    auto it = rule.totals.find(key);
+    if (it == rule.totals.end()) {
+        if (rule.totals.size() >= maxKeys) return;
+        it = rule.totals.emplace(key, 0).first;
+    }
+    uint64_t before = it->second;
+    it->second += rule.bytes ? p.length : 1;
+    if (before <= rule.threshold && it->second > rule.threshold) rule.alerts++;
+}
+
+static vector<PacketRecord> syntheticPackets(size_t count) {
+    mt19937 rng(42);
+    uniform_int_distribution<uint32_t> host(0, 4095);
+    uniform_int_distribution<int> port(1, 65535);
+    uniform_int_distribution<int> length(40, 1500);
+    uniform_int_distribution<int> percent(0, 99);
+
+    vector<PacketRecord> packets(count);
+    for (size_t i = 0; i < count; ++i) {
+        PacketRecord &p = packets[i];
+        p.timestamp = 1000 + i * 1e-5;
+        p.srcAddr = htonl(0x0a000000 | host(rng));
+        p.dstAddr = htonl((percent(rng) < 50 ? 0x0a000000 : 0xc0a80000) | host(rng));
+        int kind = percent(rng);
+        p.protocol = kind < 70 ? PacketRecord::TCP : kind < 95 ? PacketRecord::UDP : PacketRecord::ICMP;
+        if (p.protocol != PacketRecord::ICMP) {
+            p.srcPort = kind % 10 == 0 ? 53 : port(rng);
+            p.dstPort = kind % 3 == 0 ? 443 : port(rng);
+        }
+        int flags = p.protocol == PacketRecord::TCP ? percent(rng) : 0;
+        p.tcpFlags = p.protocol != PacketRecord::TCP ? 0
+                     : flags < 10                    ? PacketRecord::FLAG_SYN
+                     : flags < 12                    ? PacketRecord::FLAG_SYN | PacketRecord::FLAG_ACK
+                     : flags < 14                    ? PacketRecord::FLAG_FIN | PacketRecord::FLAG_ACK
+                     : flags < 15                    ? PacketRecord::FLAG_RST
+                                                     : PacketRecord::FLAG_ACK;
+        p.length = length(rng);
+    }
+    return packets;
+}
+
+static double nsPerPacket(RuleEngine &engine, const vector<PacketRecord> &packets) {
+    auto start = chrono::steady_clock::now();
+    for (const auto &packet : packets) engine.add(packet);
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / packets.size();
+}
+
+int main(int argc, char *argv[]) {
+    string rulesPath;
+    int count = 200;
+    size_t packetCount = 2000000;
+    size_t checkCount = 200000;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--rules" && i + 1 < argc) {
+            rulesPath = argv[++i];
+        } else if (arg == "--count" && i + 1 < argc) {
+            count = atoi(argv[++i]);
+        } else if (arg == "--packets" && i + 1 < argc) {
+            packetCount = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--check" && i + 1 < argc) {
+            checkCount = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (packetCount == 0 || count < 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    vector<string> lines;
+    if (!rulesPath.empty()) {
+        ifstream file(rulesPath);
+        if (!file.is_open()) {
+            cerr << "❌ Could not read " << rulesPath << "\n";
+            return 1;
+        }
+        string line;
+        while (getline(file, line)) {
+            line = line.substr(0, line.find('#'));
+            if (line.find_first_not_of(" \t\r") != string::npos) lines.push_back(line);
+        }
+    } else {
+        lines = builtinRules(count);
+    }
+
+    size_t alerts = 0;
+    auto emitter = [&](const json &) { alerts++; };
+    RuleEngine engine(emitter);
+    vector<string> accepted;
+    for (const string &line : lines) {
+        string error;
+        if (engine.addRule(line, error)) accepted.push_back(line);
+        else cerr << "⚠️  " << line << ": " << error << "\n";
+    }
+
+    vector<PacketRecord> packets = syntheticPackets(max(packetCount, checkCount));
+    RuleEngine empty(emitter);
+    double baseline = nsPerPacket(empty, packets);
+    double withRules = nsPerPacket(engine, packets);
+
+    cout << fixed << setprecision(2);
+    cout << "rules:            " << engine.ruleCount() << " (" << engine.instructionCount() << " instructions)\n";
+    cout << "packets:          " << packets.size() << "\n";
+    cout << "no rules:         " << baseline << " ns/packet\n";
+    cout << "with rules:       " << withRules << " ns/packet\n";
+    if (engine.ruleCount() > 0)
+        cout << "per rule:         " << (withRules - baseline) / engine.ruleCount() << " ns/packet\n";
+    cout << "alerts:           " << alerts << "\n";
+    if (checkCount == 0) return 0;
+
+    // The same rules plus the check set, through the engine and the reference
+    for (const char *rule : CHECK_RULES) accepted.push_back(rule);
+    map<string, size_t> engineAlerts;
+    RuleEngine checked([&](const json &record) { engineAlerts[record["rule"].get<string>()]++; });
+    vector<Reference> references;
+    size_t mismatches = 0;
+    for (const string &line : accepted) {
+        string error;
+        if (!checked.addRule(line, error)) {
+            cerr << "❌ " << line << ": " << error << "\n";
+            return 1;
+        }
+        try {
+            references.push_back(ReferenceParser(line).parse());
+        } catch (const exception &e) {
+            cerr << "❌ reference cannot parse " << line << ": " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    const size_t MAX_KEYS = 65536; // RuleEngine's default
+    vector<uint32_t> matched, expected;
+    size_t matches = 0;
+    for (size_t i = 0; i < checkCount; ++i) {
+        const PacketRecord &packet = packets[i];
+        expected.clear();
+        for (uint32_t r = 0; r < references.size(); ++r) {
+            if (!references[r].condition(packet)) continue;
+            expected.push_back(r);
+            referenceCount(references[r], packet, MAX_KEYS);
+        }
+        checked.match(packet, matched);
+        checked.add(packet);
+        matches += expected.size();
+        if (matched != expected && mismatches++ < 5) {
+            cerr << "packet " << i << ": " << matched.size() << " rules matched, reference " << expected.size() << "\n";
+            for (uint32_t r : expected)
+                if (!binary_search(matched.begin(), matched.end(), r)) cerr << "  missed  " << accepted[r] << "\n";
+            for (uint32_t r : matched)
+                if (!binary_search(expected.begin(), expected.end(), r)) cerr << "  extra   " << accepted[r] << "\n";
+        }
+    }
+    for (const Reference &reference : references) {
+        if (engineAlerts[reference.name] == reference.alerts) continue;
+        if (mismatches++ < 10)
+            cerr << reference.name << ": " << engineAlerts[reference.name] << " alerts, reference " << reference.alerts
+                 << "\n";
+    }
+
+    cout << "checked:          " << references.size() << " rules, " << checkCount << " packets, " << matches
+         << " matches\n";
+    cout << "check vs reference: " << (mismatches ? to_string(mismatches) + " mismatches" : "ok") << "\n";
+    return mismatches ? 1 : 0;
+}
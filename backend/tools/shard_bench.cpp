@@ -0,0 +1,117 @@
+// Sharded traffic counter benchmark: pushes synthetic packets (both
+// directions of a pool of conversations) through FlowShards with 1, 2, 4
+// ... workers and reports packets per second from the capture thread's
+// side, until every tick has been merged. The merged totals are checked
+// against what was fed in; the exit status is 1 on any difference.
+//
+//   shard_bench [--packets N] [--flows N] [--max-shards N]
+
+#include "../flowShards.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <cstdlib>
+#include <arpa/inet.h>
+
+using namespace std;
+
+static void printUsage(const char *program) {
+    cerr << "Usage: " << program << " [options]\n"
+         << "  --packets N     packets per run (default 5000000)\n"
+         << "  --flows N       conversations in the pool (default 100000)\n"
+         << "  --max-shards N  largest worker count, doubling from 1 (default: hardware threads)\n";
+}
+
+int main(int argc, char *argv[]) {
+    size_t packetCount = 5000000;
+    size_t flowCount = 100000;
+    int maxShards = max(1u, thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--packets" && i + 1 < argc) {
+            packetCount = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--flows" && i + 1 < argc) {
+            flowCount = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--max-shards" && i + 1 < argc) {
+            maxShards = atoi(argv[++i]);
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (packetCount == 0 || flowCount == 0 || maxShards < 1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Packets drawn beforehand, 10 ticks' worth, so the loop times the hand-off alone
+    mt19937 rng(42);
+    vector<PacketRecord> flows(flowCount);
+    for (auto &flow : flows) {
+        flow.srcAddr = htonl(0x0a000000 | (rng() & 0xffff));
+        flow.dstAddr = htonl(0xc0000000 | (rng() & 0xfffff));
+        flow.protocol = PacketRecord::TCP;
+        flow.srcPort = 1024 + rng() % 60000;
+        flow.dstPort = rng() % 2 ? 443 : 80;
+    }
+    vector<PacketRecord> packets(min<size_t>(packetCount, 1 << 20));
+    uint64_t cycleBytes = 0;
+    for (size_t i = 0; i < packets.size(); ++i) {
+        PacketRecord &packet = packets[i];
+        packet = flows[rng() % flowCount];
+        if (rng() % 2) {
+            swap(packet.srcAddr, packet.dstAddr);
+            swap(packet.srcPort, packet.dstPort);
+        }
+        packet.length = 60 + rng() % 1400;
+        cycleBytes += packet.length;
+    }
+    uint64_t expectedBytes = 0;
+    for (size_t i = 0; i < packetCount; ++i) expectedBytes += packets[i % packets.size()].length;
+
+    bool ok = true;
+    cout << fixed << setprecision(2);
+    for (int shardCount = 1; shardCount <= maxShards; shardCount *= 2) {
+        uint64_t seenPackets = 0, seenBytes = 0, records = 0, untrackedPackets = 0, edgePackets = 0;
+        FlowShards counters([&](const json &record) {
+            // Every tracked edge is listed, on one of the tick's pages
+            if (record["protocol"] != "TRAFFIC") {
+                for (const json &edge : record["edges"]) edgePackets += edge[2].get<uint64_t>();
+                return;
+            }
+            for (const json &edge : record["edges"]) edgePackets += edge["packets"].get<uint64_t>();
+            seenPackets += record["packets"].get<uint64_t>();
+            seenBytes += record["bytes"].get<uint64_t>();
+            untrackedPackets += record["untracked"]["packets"].get<uint64_t>();
+            records++;
+        }, shardCount);
+
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < packetCount; ++i) {
+            PacketRecord &packet = packets[i % packets.size()];
+            packet.timestamp = 1000.0 + 10.0 * i / packetCount;
+            counters.add(packet);
+        }
+        counters.advance(1e9);
+        while (seenPackets < packetCount && chrono::steady_clock::now() - start < chrono::seconds(60)) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+            counters.advance(1e9);
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        // A packet of an untracked host may still have its edge listed
+        bool exact = seenPackets == packetCount && seenBytes == expectedBytes &&
+                     edgePackets + untrackedPackets >= seenPackets && edgePackets <= seenPackets;
+        ok = ok && exact;
+        cout << setw(2) << shardCount << " shards: " << setw(7) << packetCount / seconds / 1e6 << " Mpps, "
+             << records << " TRAFFIC records, totals " << (exact ? "exact" : "WRONG") << "\n";
+    }
+    cout << "hardware threads: " << thread::hardware_concurrency() << "\n";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+// TLS inspector benchmark: per-packet cost of ClientHello detection over a
+// replayed synthetic TCP stream (mostly application data and ACKs, with a
+// ClientHello every --hello-every packets, some of them large enough to
+// span two segments), and the cost of one hello parse with its JA3.
+//
+//   tls_bench [--packets N] [--hello-every N]
+
+#include "../tlsInspector.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <arpa/inet.h>
+
+using namespace std;
+
+static void printUsage(const char *program) {
+    cerr << "Usage: " << program << " [options]\n"
+         << "  --packets N      packets per run (default 2000000)\n"
+         << "  --hello-every N  one ClientHello per N packets (default 100)\n";
+}
+
+static void put16(vector<uint8_t> &out, uint16_t value) {
+    out.push_back(value >> 8);
+    out.push_back(value & 0xff);
+}
+
+// A Chrome-like hello: GREASE values, SNI, groups, point formats and a key
+// share of `keyShareBytes` (1200+ for post-quantum hybrids)
+static vector<uint8_t> clientHello(const string &host, size_t keyShareBytes, mt19937 &rng) {
+    vector<uint8_t> ext;
+    auto extension = [&](uint16_t type, const vector<uint8_t> &body) {
+        put16(ext, type);
+        put16(ext, body.size());
+        ext.insert(ext.end(), body.begin(), body.end());
+    };
+    extension(0x2a2a, {});
+    vector<uint8_t> sni;
+    put16(sni, host.size() + 3);
+    sni.push_back(0);
+    put16(sni, host.size());
+    sni.insert(sni.end(), host.begin(), host.end());
+    extension(0x0000, sni);
+    extension(0x0017, {});
+    extension(0xff01, {0});
+    extension(0x000a, {0, 8, 0x3a, 0x3a, 0, 0x1d, 0, 0x17, 0, 0x18});
+    extension(0x000b, {1, 0});
+    extension(0x0023, {});
+    extension(0x0010, {0, 12, 2, 'h', '2', 8, 'h', 't', 't', 'p', '/', '1', '.', '1'});
+    extension(0x000d, {0, 8, 4, 3, 8, 4, 4, 1, 5, 3});
+    vector<uint8_t> share(keyShareBytes + 6);
+    share[0] = uint8_t((keyShareBytes + 4) >> 8);
+    share[1] = uint8_t(keyShareBytes + 4);
+    share[2] = 0;
+    share[3] = 0x1d;
+    share[4] = uint8_t(keyShareBytes >> 8);
+    share[5] = uint8_t(keyShareBytes);
+    for (size_t i = 6; i < share.size(); ++i) share[i] = rng();
+    extension(0x0033, share);
+    extension(0x002b, {6, 0x1a, 0x1a, 3, 4, 3, 3});
+    extension(0x1a1a, {0});
+
+    vector<uint8_t> body;
+    put16(body, 0x0303);
+    for (int i = 0; i < 32; ++i) body.push_back(rng());
+    body.push_back(32);
+    for (int i = 0; i < 32; ++i) body.push_back(rng());
+    const uint16_t ciphers[] = {0x0a0a, 0x1301, 0x1302, 0x1303, 0xc02b, 0xc02f, 0xc02c, 0xc030,
+                                0xcca9, 0xcca8, 0xc013, 0xc014, 0x009c, 0x009d, 0x002f, 0x0035};
+    put16(body, sizeof(ciphers));
+    for (uint16_t cipher : ciphers) put16(body, cipher);
+    body.push_back(1);
+    body.push_back(0);
+    put16(body, ext.size());
+    body.insert(body.end(), ext.begin(), ext.end());
+
+    vector<uint8_t> record = {0x16, 0x03, 0x01};
+    put16(record, body.size() + 4);
+    record.push_back(0x01);
+    record.push_back(uint8_t(body.size() >> 16));
+    put16(record, body.size() & 0xffff);
+    record.insert(record.end(), body.begin(), body.end());
+    return record;
+}
+
+int main(int argc, char *argv[]) {
+    size_t packetCount = 2000000;
+    size_t helloEvery = 100;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--packets" && i + 1 < argc) {
+            packetCount = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--hello-every" && i + 1 < argc) {
+            helloEvery = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (packetCount == 0 || helloEvery == 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    mt19937 rng(42);
+    const size_t MSS = 1448;
+    vector<vector<uint8_t>> hellos;
+    for (int i = 0; i < 64; ++i)
+        hellos.push_back(clientHello("host" + to_string(i) + ".example.com", i % 4 == 0 ? 1216 : 32, rng));
+    vector<uint8_t> appData(MSS);
+    for (auto &byte : appData) byte = rng();
+    appData[0] = 0x17;
+
+    // Payloads point into `hellos` and `appData`, which outlive the runs
+    vector<PacketRecord> packets;
+    packets.reserve(packetCount + packetCount / helloEvery);
+    size_t helloPackets = 0;
+    for (size_t i = 0; packets.size() < packetCount; ++i) {
+        PacketRecord p;
+        p.timestamp = 1000 + i * 1e-5;
+        p.srcAddr = htonl(0x0a000000 | (rng() & 0xfff));
+        p.dstAddr = htonl(0x5db8d800 | (rng() & 0xff));
+        p.protocol = PacketRecord::TCP;
+        p.srcPort = 32768 + rng() % 28000;
+        p.dstPort = 443;
+        p.tcpFlags = PacketRecord::FLAG_ACK;
+        p.tcpSeq = rng();
+
+        if (i % helloEvery == 0) {
+            const vector<uint8_t> &hello = hellos[(i / helloEvery) % hellos.size()];
+            for (size_t offset = 0; offset < hello.size(); offset += MSS) {
+                p.payload = hello.data() + offset;
+                p.payloadLength = p.payloadCaptured = min(MSS, hello.size() - offset);
+                p.length = 54 + p.payloadLength;
+                packets.push_back(p);
+                p.tcpSeq += p.payloadLength;
+                helloPackets++;
+            }
+        } else if (rng() % 3 == 0) {
+            p.length = 54; // pure ACK
+            packets.push_back(p);
+        } else {
+            p.payload = appData.data();
+            p.payloadLength = p.payloadCaptured = MSS;
+            p.length = 54 + MSS;
+            packets.push_back(p);
+        }
+    }
+
+    // Replay alone: what every stage pays to walk the records
+    volatile uint64_t touched = 0;
+    auto start = chrono::steady_clock::now();
+    for (const auto &packet : packets) touched = touched + packet.payloadCaptured;
+    double baseline = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / packets.size();
+
+    size_t emitted = 0;
+    TlsInspector inspector([&](const json &) { emitted++; });
+    start = chrono::steady_clock::now();
+    for (const auto &packet : packets) inspector.add(packet);
+    double perPacket = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / packets.size();
+
+    // Hello parse and fingerprint alone
+    const int PARSES = 200000;
+    char digest[33];
+    size_t checksum = 0;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < PARSES; ++i) {
+        const vector<uint8_t> &hello = hellos[i % hellos.size()];
+        ClientHello parsed;
+        if (ClientHello::parse(hello.data(), hello.size(), parsed) == ClientHello::PARSED) {
+            parsed.ja3(digest);
+            checksum += digest[0];
+        }
+    }
+    double perHello = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / PARSES;
+
+    cout << fixed << setprecision(2);
+    cout << "packets:          " << packets.size() << " (" << helloPackets << " carrying hellos)\n";
+    cout << "hellos found:     " << inspector.helloCount() << "\n";
+    cout << "replay only:      " << baseline << " ns/packet\n";
+    cout << "with inspector:   " << perPacket << " ns/packet (" << 1e3 / perPacket << " Mpps)\n";
+    cout << "inspector cost:   " << perPacket - baseline << " ns/packet\n";
+    cout << "parse + JA3:      " << perHello << " ns/hello\n";
+    return checksum == 0 && emitted == 0 ? 1 : 0;
+}
@@ -0,0 +1,134 @@
+// Traceroute benchmark, meant to run inside the netns lab (tools/netns_lab.sh)
+// where the path length and per-link delay are known in advance.
+//
+//   traceroute_bench [--traces N] [--max-hops N] [--timeout MS]
+//                    [--link-delay MS] [--cold] target...
+
+#include "../packetSniffer.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+struct TtlTiming {
+    int samples = 0;
+    double rttSum = 0;
+    double absErrorSum = 0;
+};
+
+static void printUsage(const char *program) {
+    cerr << "Usage: " << program << " [options] target...\n"
+         << "  --traces N        traces to run, spread over the targets (default 20)\n"
+         << "  --max-hops N      TTL limit per trace (default 30)\n"
+         << "  --timeout MS      per-probe timeout ceiling (default 1000)\n"
+         << "  --link-delay MS   one-way delay of every lab link, enables timing accuracy\n"
+         << "  --cold            do not share RTT estimates between traces\n";
+}
+
+int main(int argc, char *argv[]) {
+    int traces = 20;
+    int maxHops = 30;
+    int timeout = 1000;
+    double linkDelay = -1;
+    bool cold = false;
+    vector<string> targets;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--traces" && i + 1 < argc) {
+            traces = atoi(argv[++i]);
+        } else if (arg == "--max-hops" && i + 1 < argc) {
+            maxHops = atoi(argv[++i]);
+        } else if (arg == "--timeout" && i + 1 < argc) {
+            timeout = atoi(argv[++i]);
+        } else if (arg == "--link-delay" && i + 1 < argc) {
+            linkDelay = atof(argv[++i]);
+        } else if (arg == "--cold") {
+            cold = true;
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            targets.push_back(arg);
+        }
+    }
+
+    if (targets.empty() || traces <= 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    PrefixRttTable prefixRtts;
+    map<int, TtlTiming> timing;
+    long totalProbes = 0;
+    long totalHops = 0;
+    int reached = 0;
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < traces; ++i) {
+        const string &target = targets[i % targets.size()];
+        Traceroute tracer(target, maxHops, timeout, cold ? nullptr : &prefixRtts);
+
+        vector<Hop> hops;
+        try {
+            hops = tracer.performTrace();
+        } catch (const exception &e) {
+            cerr << "❌ " << e.what() << "\n";
+            return 1;
+        }
+
+        totalProbes += tracer.probeCount();
+        totalHops += hops.size();
+
+        for (const auto &hop : hops) {
+            for (const auto &response : hop.responses) {
+                if (response.ip == target) reached++;
+                if (linkDelay < 0 || response.ip == "*") continue;
+
+                // Every link delays both directions, so hop n sits 2 * n links away
+                double expected = 2 * hop.ttl * linkDelay;
+                for (double rtt : response.rtts) {
+                    if (rtt <= 0) continue;
+                    TtlTiming &entry = timing[hop.ttl];
+                    entry.samples++;
+                    entry.rttSum += rtt;
+                    entry.absErrorSum += fabs(rtt - expected);
+                }
+            }
+        }
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << fixed << setprecision(2);
+    cout << "traces:           " << traces << " over " << targets.size() << " target(s)\n";
+    cout << "elapsed:          " << elapsed << " s\n";
+    cout << "traces/sec:       " << traces / elapsed << "\n";
+    cout << "probes/trace:     " << double(totalProbes) / traces << "\n";
+    cout << "hops/trace:       " << double(totalHops) / traces << "\n";
+    cout << "reached target:   " << reached << "/" << traces << "\n";
+
+    if (linkDelay >= 0 && !timing.empty()) {
+        cout << "\n ttl  expected ms   mean ms  mean |err| ms  samples\n";
+        double errorSum = 0;
+        int samples = 0;
+        for (const auto &entry : timing) {
+            const TtlTiming &t = entry.second;
+            cout << setw(4) << entry.first
+                 << setw(13) << 2 * entry.first * linkDelay
+                 << setw(10) << t.rttSum / t.samples
+                 << setw(15) << t.absErrorSum / t.samples
+                 << setw(9) << t.samples << "\n";
+            errorSum += t.absErrorSum;
+            samples += t.samples;
+        }
+        cout << "timing error:     " << errorSum / samples << " ms mean over " << samples << " samples\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,255 @@
+#include "traceCache.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <arpa/inet.h>
+
+using namespace std;
+
+static const char CACHE_MAGIC[4] = {'N', 'V', 'T', 'C'};
+static const uint16_t CACHE_VERSION = 1;
+
+// Little-endian field helpers
+template <typename T>
+static void put(string &out, T value) {
+    unsigned char bytes[sizeof(T)];
+    memcpy(bytes, &value, sizeof(T));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    reverse(bytes, bytes + sizeof(T));
+#endif
+    out.append(reinterpret_cast<const char *>(bytes), sizeof(T));
+}
+
+template <typename T>
+static bool get(const string &in, size_t &pos, T &value) {
+    if (pos + sizeof(T) > in.size()) return false;
+    unsigned char bytes[sizeof(T)];
+    memcpy(bytes, in.data() + pos, sizeof(T));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    reverse(bytes, bytes + sizeof(T));
+#endif
+    memcpy(&value, bytes, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+string CachedTrace::dstIP() const {
+    char buf[INET_ADDRSTRLEN];
+    struct in_addr in;
+    in.s_addr = dst;
+    inet_ntop(AF_INET, &in, buf, sizeof(buf));
+    return buf;
+}
+
+vector<Hop> CachedTrace::toHops() const {
+    vector<Hop> result;
+    for (const auto &cachedHop : hops) {
+        Hop hop;
+        hop.ttl = cachedHop.ttl;
+        for (const auto &cached : cachedHop.responses) {
+            HopResponse response;
+            if (cached.addr) {
+                char buf[INET_ADDRSTRLEN];
+                struct in_addr in;
+                in.s_addr = cached.addr;
+                inet_ntop(AF_INET, &in, buf, sizeof(buf));
+                response.ip = buf;
+            } else {
+                response.ip = "*";
+            }
+
+            // min/avg/max stand in for the individual samples
+            if (cached.answered == 1) {
+                response.rtts.push_back(cached.rttAvg);
+            } else if (cached.answered == 2) {
+                response.rtts = {cached.rttMin, cached.rttMax};
+            } else if (cached.answered >= 3) {
+                response.rtts = {cached.rttMin, cached.rttAvg, cached.rttMax};
+            }
+            for (int i = cached.answered; i < cached.probes; ++i)
+                response.rtts.push_back(-1.0);
+
+            hop.responses.push_back(response);
+        }
+        result.push_back(hop);
+    }
+    return result;
+}
+
+TraceCache::TraceCache(const string &filePath, int maxAgeSec)
+    : path(filePath), maxAge(maxAgeSec) {}
+
+bool TraceCache::load() {
+    ifstream file(path, ios::binary);
+    if (!file.is_open()) return false;
+
+    string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    size_t pos = 0;
+
+    if (data.size() < sizeof(CACHE_MAGIC) || memcmp(data.data(), CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0) {
+        cerr << "⚠️  Ignoring traceroute cache " << path << " (bad header)\n";
+        return false;
+    }
+    pos += sizeof(CACHE_MAGIC);
+
+    uint16_t version;
+    uint32_t count;
+    if (!get(data, pos, version) || version != CACHE_VERSION || !get(data, pos, count)) {
+        cerr << "⚠️  Ignoring traceroute cache " << path << " (unsupported version)\n";
+        return false;
+    }
+
+    // An old or foreign file may hold more than the cache keeps: only the newest stay
+    vector<CachedTrace> loaded;
+    auto keepNewest = [&loaded]() {
+        if (loaded.size() <= MAX_CACHED_TRACES) return;
+        nth_element(loaded.begin(), loaded.begin() + MAX_CACHED_TRACES, loaded.end(),
+                    [](const CachedTrace &a, const CachedTrace &b) { return a.timestamp > b.timestamp; });
+        loaded.resize(MAX_CACHED_TRACES);
+    };
+    for (uint32_t i = 0; i < count; ++i) {
+        CachedTrace trace;
+        uint8_t hopCount;
+        if (!get(data, pos, trace.dst) || !get(data, pos, trace.timestamp) || !get(data, pos, hopCount)) break;
+
+        bool complete = true;
+        for (uint8_t h = 0; h < hopCount && complete; ++h) {
+            CachedHop hop;
+            uint8_t responseCount;
+            complete = get(data, pos, hop.ttl) && get(data, pos, responseCount);
+            for (uint8_t r = 0; r < responseCount && complete; ++r) {
+                CachedResponse response;
+                complete = get(data, pos, response.addr) && get(data, pos, response.probes) &&
+                           get(data, pos, response.answered) && get(data, pos, response.rttMin) &&
+                           get(data, pos, response.rttAvg) && get(data, pos, response.rttMax);
+                hop.responses.push_back(response);
+            }
+            trace.hops.push_back(hop);
+        }
+        if (!complete) break; // truncated file: keep what was read in full
+
+        loaded.push_back(std::move(trace));
+        if (loaded.size() >= 2 * MAX_CACHED_TRACES) keepNewest();
+    }
+    keepNewest();
+
+    lock_guard<mutex> lock(cacheMutex);
+    traces.clear();
+    for (auto &trace : loaded) traces[trace.dst] = std::move(trace);
+    unsavedChanges = 0;
+    return true;
+}
+
+bool TraceCache::save() {
+    // Held from the snapshot to the rename, so an older snapshot never replaces a newer file
+    lock_guard<mutex> fileLock(fileMutex);
+
+    string data(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    size_t saved;
+    {
+        lock_guard<mutex> lock(cacheMutex);
+        put<uint16_t>(data, CACHE_VERSION);
+        put<uint32_t>(data, traces.size());
+        for (const auto &entry : traces) {
+            const CachedTrace &trace = entry.second;
+            put<uint32_t>(data, trace.dst);
+            put<int64_t>(data, trace.timestamp);
+            put<uint8_t>(data, trace.hops.size());
+            for (const auto &hop : trace.hops) {
+                put<uint8_t>(data, hop.ttl);
+                put<uint8_t>(data, hop.responses.size());
+                for (const auto &response : hop.responses) {
+                    put<uint32_t>(data, response.addr);
+                    put<uint8_t>(data, response.probes);
+                    put<uint8_t>(data, response.answered);
+                    put<float>(data, response.rttMin);
+                    put<float>(data, response.rttAvg);
+                    put<float>(data, response.rttMax);
+                }
+            }
+        }
+        saved = unsavedChanges;
+    }
+
+    // Write to a temporary file and rename so a crash never leaves half a cache
+    string tmpPath = path + ".tmp";
+    {
+        ofstream file(tmpPath, ios::binary | ios::trunc);
+        if (!file.is_open()) return false;
+        file.write(data.data(), data.size());
+        if (!file) return false;
+    }
+    if (rename(tmpPath.c_str(), path.c_str()) != 0) return false;
+
+    // Changes stored while writing stay unsaved; a failed write keeps them all
+    lock_guard<mutex> lock(cacheMutex);
+    unsavedChanges -= min(saved, unsavedChanges);
+    return true;
+}
+
+void TraceCache::saveIfDirty(size_t minChanges) {
+    {
+        lock_guard<mutex> lock(cacheMutex);
+        if (unsavedChanges == 0 || unsavedChanges < minChanges) return;
+    }
+    if (!save()) cerr << "⚠️  Failed to write traceroute cache " << path << "\n";
+}
+
+void TraceCache::store(const string &dstIP, const vector<Hop> &hops, time_t timestamp) {
+    struct in_addr addr;
+    if (inet_aton(dstIP.c_str(), &addr) == 0) return;
+
+    CachedTrace trace;
+    trace.dst = addr.s_addr;
+    trace.timestamp = timestamp;
+
+    for (const auto &hop : hops) {
+        if (hop.ttl < 0 || hop.ttl > 255) continue;
+        CachedHop cachedHop;
+        cachedHop.ttl = hop.ttl;
+
+        for (const auto &response : hop.responses) {
+            CachedResponse cached;
+            struct in_addr responseAddr;
+            cached.addr = (response.ip != "*" && inet_aton(response.ip.c_str(), &responseAddr)) ? responseAddr.s_addr : 0;
+
+            double sum = 0;
+            for (double rtt : response.rtts) {
+                cached.probes++;
+                if (rtt <= 0) continue;
+                if (cached.answered == 0 || rtt < cached.rttMin) cached.rttMin = rtt;
+                if (cached.answered == 0 || rtt > cached.rttMax) cached.rttMax = rtt;
+                cached.answered++;
+                sum += rtt;
+            }
+            if (cached.answered > 0) cached.rttAvg = sum / cached.answered;
+            cachedHop.responses.push_back(cached);
+        }
+        trace.hops.push_back(cachedHop);
+    }
+
+    lock_guard<mutex> lock(cacheMutex);
+    if (traces.size() >= MAX_CACHED_TRACES && traces.find(trace.dst) == traces.end()) {
+        // Make room by dropping the oldest result
+        auto oldest = min_element(traces.begin(), traces.end(), [](const auto &a, const auto &b) {
+            return a.second.timestamp < b.second.timestamp;
+        });
+        traces.erase(oldest);
+    }
+    traces[trace.dst] = std::move(trace);
+    unsavedChanges++;
+}
+
+vector<CachedTrace> TraceCache::snapshot() {
+    lock_guard<mutex> lock(cacheMutex);
+    vector<CachedTrace> result;
+    result.reserve(traces.size());
+    for (const auto &entry : traces) result.push_back(entry.second);
+    return result;
+}
+
+bool TraceCache::isStale(const CachedTrace &trace, time_t now) const {
+    return now - trace.timestamp > maxAge;
+}
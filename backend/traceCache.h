@@ -0,0 +1,64 @@
+#ifndef TRACECACHE_H
+#define TRACECACHE_H
+
+#include "packetSniffer.h"
+#include <cstdint>
+
+// Compact on-disk cache of traceroute results so a restarted sniffer can
+// replay known paths at once and only re-probe the stale ones.
+//
+// File layout (little endian):
+//   "NVTC" u16 version u32 traceCount
+//   per trace:    u32 dst, i64 timestamp, u8 hopCount
+//   per hop:      u8 ttl, u8 responseCount
+//   per response: u32 addr (0 = no answer), u8 probes, u8 answered, f32 min/avg/max rtt
+
+struct CachedResponse {
+    uint32_t addr = 0; // network byte order
+    uint8_t probes = 0;
+    uint8_t answered = 0;
+    float rttMin = 0;
+    float rttAvg = 0;
+    float rttMax = 0;
+};
+
+struct CachedHop {
+    uint8_t ttl = 0;
+    std::vector<CachedResponse> responses;
+};
+
+struct CachedTrace {
+    uint32_t dst = 0;
+    int64_t timestamp = 0;
+    std::vector<CachedHop> hops;
+
+    std::string dstIP() const;
+    // Expand the RTT summaries back into the Hop format the tracer produces
+    std::vector<Hop> toHops() const;
+};
+
+class TraceCache {
+public:
+    static const size_t MAX_CACHED_TRACES = 4096;
+
+    TraceCache(const std::string &filePath, int maxAgeSec);
+
+    bool load();
+    bool save();
+    // Save only if enough new results piled up since the last write
+    void saveIfDirty(size_t minChanges = 16);
+
+    void store(const std::string &dstIP, const std::vector<Hop> &hops, time_t timestamp);
+    std::vector<CachedTrace> snapshot();
+    bool isStale(const CachedTrace &trace, time_t now) const;
+
+private:
+    std::string path;
+    int maxAge;
+    std::map<uint32_t, CachedTrace> traces;
+    size_t unsavedChanges = 0;
+    std::mutex cacheMutex;
+    std::mutex fileMutex; // one save at a time, taken before cacheMutex
+};
+
+#endif // TRACECACHE_H
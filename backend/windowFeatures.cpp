@@ -0,0 +1,219 @@
+#include "windowFeatures.h"
+#include "isolationForest.h"
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+const char *const FEATURE_NAMES[FEATURE_COUNT] = {
+    "avg_packet_size", "unique_src_ips", "unique_dst_ips", "unique_src_ports",
+    "protocol_tcp", "protocol_udp", "protocol_icmp", "protocol_other",
+    "packet_rate", "port_scan_signals", "tcp_flag_syn", "tcp_flag_ack",
+    "tcp_flag_syn_without_ack", "tcp_flag_syn_without_ack_ratio"
+};
+
+template <typename Key>
+static void addKeys(unordered_map<Key, uint32_t> &refs, const unordered_set<Key> &keys) {
+    for (const Key &key : keys) refs[key]++;
+}
+
+template <typename Key>
+static void removeKeys(unordered_map<Key, uint32_t> &refs, const unordered_set<Key> &keys) {
+    for (const Key &key : keys) {
+        auto it = refs.find(key);
+        if (it != refs.end() && --it->second == 0) refs.erase(it);
+    }
+}
+
+void FeatureCounts::add(const FeatureCounts &other) {
+    packets += other.packets;
+    bytes += other.bytes;
+    for (int i = 0; i < 4; ++i) protocols[i] += other.protocols[i];
+    syn += other.syn;
+    ack += other.ack;
+}
+
+void FeatureCounts::subtract(const FeatureCounts &other) {
+    packets -= other.packets;
+    bytes -= other.bytes;
+    for (int i = 0; i < 4; ++i) protocols[i] -= other.protocols[i];
+    syn -= other.syn;
+    ack -= other.ack;
+}
+
+WindowFeatures::WindowFeatures(Emitter emitter, double paneSeconds, int slidingPanes)
+    : emit(std::move(emitter)), paneSeconds(paneSeconds), slidingPanes(slidingPanes) {}
+
+WindowFeatures::~WindowFeatures() {
+    if (csv.is_open()) csv.close();
+}
+
+bool WindowFeatures::openCsv(const string &path) {
+    csv.open(path, ios::trunc);
+    if (!csv.is_open()) return false;
+
+    csv.precision(15);
+    csv << "window_start";
+    for (const char *name : FEATURE_NAMES) csv << "," << name;
+    csv << "\n";
+    return true;
+}
+
+bool WindowFeatures::setAnomalyModel(const IsolationForest *model) {
+    vector<int> columns;
+    for (const string &name : model->featureNames()) {
+        auto it = find(begin(FEATURE_NAMES), end(FEATURE_NAMES), name);
+        if (it == end(FEATURE_NAMES)) {
+            cerr << "⚠️  Anomaly model uses unknown feature " << name << "\n";
+            return false;
+        }
+        columns.push_back(it - begin(FEATURE_NAMES));
+    }
+    anomalyModel = model;
+    modelColumns = std::move(columns);
+    return true;
+}
+
+FeatureVector WindowFeatures::compute(const FeatureCounts &counts, size_t srcIPs, size_t dstIPs,
+                                      size_t srcPorts, size_t scanPairs) {
+    FeatureVector values{};
+    if (counts.packets == 0) return values;
+
+    double packets = counts.packets;
+    uint64_t tcpPackets = counts.protocols[PacketRecord::TCP];
+    uint64_t synWithoutAck = counts.syn > counts.ack ? counts.syn - counts.ack : 0;
+
+    values[0] = counts.bytes / packets;
+    values[1] = srcIPs;
+    values[2] = dstIPs;
+    values[3] = srcPorts;
+    values[4] = counts.protocols[PacketRecord::TCP] / packets;
+    values[5] = counts.protocols[PacketRecord::UDP] / packets;
+    values[6] = counts.protocols[PacketRecord::ICMP] / packets;
+    values[7] = counts.protocols[PacketRecord::OTHER] / packets;
+    values[8] = packets; // dataExtracter.py divides by a fixed 1 s whatever the window size
+    values[9] = scanPairs;
+    values[10] = counts.syn;
+    values[11] = counts.ack;
+    values[12] = synWithoutAck;
+    values[13] = tcpPackets ? double(synWithoutAck) / tcpPackets : 0.0;
+    return values;
+}
+
+void WindowFeatures::add(const PacketRecord &packet) {
+    int64_t index = static_cast<int64_t>(floor(packet.timestamp / paneSeconds));
+    if (!havePane) {
+        current.index = index;
+        havePane = true;
+    } else if (index > current.index) {
+        advanceTo(index);
+    }
+    // Packets that arrive late for their pane are counted in the open one
+
+    // A sampled packet stands for `packets`; the distinct keys stay as sampled
+    FeatureCounts &counts = current.counts;
+    counts.packets += packet.packets;
+    counts.bytes += packet.length;
+    counts.protocols[packet.protocol] += packet.packets;
+
+    FeatureKeys &keys = current.keys;
+    keys.srcIPs.insert(packet.srcAddr);
+    keys.dstIPs.insert(packet.dstAddr);
+
+    if (packet.protocol == PacketRecord::TCP || packet.protocol == PacketRecord::UDP) {
+        keys.srcPorts.insert(packet.srcPort);
+        keys.scanPairs.insert(uint64_t(packet.srcAddr) << 16 | packet.dstPort);
+    }
+    if (packet.protocol == PacketRecord::TCP) {
+        if (packet.tcpFlags & PacketRecord::FLAG_SYN) counts.syn += packet.packets;
+        if (packet.tcpFlags & PacketRecord::FLAG_ACK) counts.ack += packet.packets;
+    }
+}
+
+void WindowFeatures::flush() {
+    if (!havePane) return;
+    closePane();
+    havePane = false;
+    current = Pane();
+    if (csv.is_open()) csv.flush();
+}
+
+void WindowFeatures::advanceTo(int64_t index) {
+    int64_t closed = current.index;
+    closePane();
+
+    // Empty panes in between still move the sliding window along
+    for (int64_t empty = closed + 1; empty < index && !history.empty(); ++empty)
+        slideTo(empty);
+
+    current = Pane();
+    current.index = index;
+}
+
+void WindowFeatures::closePane() {
+    double start = current.index * paneSeconds;
+
+    if (current.counts.packets > 0) {
+        FeatureVector values = compute(current.counts, current.keys.srcIPs.size(), current.keys.dstIPs.size(),
+                                       current.keys.srcPorts.size(), current.keys.scanPairs.size());
+        emitWindow("tumbling", start, paneSeconds, values);
+
+        if (csv.is_open()) {
+            csv << start;
+            for (double value : values) csv << "," << value;
+            csv << "\n";
+        }
+    }
+
+    if (slidingPanes <= 0) return;
+
+    int64_t index = current.index;
+    if (current.counts.packets > 0) {
+        slidingCounts.add(current.counts);
+        addKeys(slidingSrcIPs, current.keys.srcIPs);
+        addKeys(slidingDstIPs, current.keys.dstIPs);
+        addKeys(slidingSrcPorts, current.keys.srcPorts);
+        addKeys(slidingScanPairs, current.keys.scanPairs);
+        history.push_back(std::move(current));
+    }
+    slideTo(index);
+}
+
+void WindowFeatures::slideTo(int64_t index) {
+    while (!history.empty() && history.front().index <= index - slidingPanes) {
+        const Pane &expired = history.front();
+        slidingCounts.subtract(expired.counts);
+        removeKeys(slidingSrcIPs, expired.keys.srcIPs);
+        removeKeys(slidingDstIPs, expired.keys.dstIPs);
+        removeKeys(slidingSrcPorts, expired.keys.srcPorts);
+        removeKeys(slidingScanPairs, expired.keys.scanPairs);
+        history.pop_front();
+    }
+
+    if (slidingCounts.packets > 0) {
+        emitWindow("sliding", (index - slidingPanes + 1) * paneSeconds, slidingPanes * paneSeconds,
+                   compute(slidingCounts, slidingSrcIPs.size(), slidingDstIPs.size(),
+                           slidingSrcPorts.size(), slidingScanPairs.size()));
+    }
+}
+
+void WindowFeatures::emitWindow(const char *kind, double start, double size, const FeatureVector &values) {
+    json record;
+    record["protocol"] = "FEATURES";
+    record["window"] = kind;
+    record["window_start"] = start;
+    record["window_size"] = size;
+    record["values"] = values;
+
+    if (anomalyModel) {
+        vector<double> row;
+        row.reserve(modelColumns.size());
+        for (int column : modelColumns) row.push_back(values[column]);
+        double score;
+        anomalyModel->score(row.data(), 1, &score);
+        record["score"] = score;
+        record["anomalous"] = anomalyModel->decision(score) < 0;
+    }
+    emit(record);
+}
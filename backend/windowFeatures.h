@@ -0,0 +1,96 @@
+#ifndef WINDOWFEATURES_H
+#define WINDOWFEATURES_H
+
+#include "packetSniffer.h"
+#include <array>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+// Streaming version of dataExtracter.py's calculate_features().
+// Time is cut into panes of `paneSeconds`; every closed pane is a tumbling
+// window, and the last `slidingPanes` panes form the sliding window. Each
+// packet updates the open pane in O(1); distinct counts of the sliding window
+// are kept as reference counts that expiring panes give back.
+
+class IsolationForest;
+
+static const int FEATURE_COUNT = 14;
+extern const char *const FEATURE_NAMES[FEATURE_COUNT]; // network_features.csv column order
+
+using FeatureVector = std::array<double, FEATURE_COUNT>;
+
+// Additive part of a window
+struct FeatureCounts {
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    uint64_t protocols[4] = {0, 0, 0, 0}; // indexed by PacketRecord::Protocol
+    uint64_t syn = 0;
+    uint64_t ack = 0;
+
+    void add(const FeatureCounts &other);
+    void subtract(const FeatureCounts &other);
+};
+
+// Distinct keys of a window (IPs, ports, source/port pairs)
+struct FeatureKeys {
+    std::unordered_set<uint32_t> srcIPs;
+    std::unordered_set<uint32_t> dstIPs;
+    std::unordered_set<uint16_t> srcPorts;
+    std::unordered_set<uint64_t> scanPairs; // src addr << 16 | dst port
+};
+
+class WindowFeatures {
+public:
+    using Emitter = std::function<void(const json &)>;
+
+    WindowFeatures(Emitter emitter, double paneSeconds = 0.2, int slidingPanes = 5);
+    ~WindowFeatures();
+
+    // Also write every tumbling window as a network_features.csv row
+    bool openCsv(const std::string &path);
+
+    // Score every window with the forest and flag outliers in the record;
+    // false if the model needs a feature not computed here
+    bool setAnomalyModel(const IsolationForest *model);
+
+    void add(const PacketRecord &packet);
+    void flush(); // close the open pane, e.g. on shutdown
+
+    static FeatureVector compute(const FeatureCounts &counts, size_t srcIPs, size_t dstIPs,
+                                 size_t srcPorts, size_t scanPairs);
+
+private:
+    struct Pane {
+        int64_t index = 0;
+        FeatureCounts counts;
+        FeatureKeys keys;
+    };
+
+    Emitter emit;
+    double paneSeconds;
+    int slidingPanes;
+    std::ofstream csv;
+    const IsolationForest *anomalyModel = nullptr;
+    std::vector<int> modelColumns; // model feature -> FeatureVector index
+
+    bool havePane = false;
+    Pane current;
+    std::deque<Pane> history; // closed panes still inside the sliding window
+
+    // Sliding window totals
+    FeatureCounts slidingCounts;
+    std::unordered_map<uint32_t, uint32_t> slidingSrcIPs;
+    std::unordered_map<uint32_t, uint32_t> slidingDstIPs;
+    std::unordered_map<uint16_t, uint32_t> slidingSrcPorts;
+    std::unordered_map<uint64_t, uint32_t> slidingScanPairs;
+
+    void closePane();
+    void advanceTo(int64_t index);
+    void slideTo(int64_t index); // expire panes that left the window ending at pane `index`
+    void emitWindow(const char *kind, double start, double size, const FeatureVector &values);
+};
+
+#endif // WINDOWFEATURES_H
@@ -0,0 +1,314 @@
+#include "xdpFlowCounter.h"
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+// Map layout shared by the program and drain()
+static const int KEY_SIZE = 12;   // src addr, dst addr, dst port (network order), protocol, pad
+static const int VALUE_SIZE = 16; // packets, bytes; one copy per possible CPU
+static const uint32_t DRAIN_BATCH = 1024;
+
+// Stack slots of the program
+static const int16_t KEY_SLOT = -16;
+static const int16_t VALUE_SLOT = -32;
+
+static long bpf(int command, union bpf_attr &attr) {
+    return syscall(SYS_bpf, command, &attr, sizeof(attr));
+}
+
+static uint64_t pointer(const void *p) {
+    return reinterpret_cast<uintptr_t>(p);
+}
+
+// Per-CPU map values come back as one slot per possible CPU, not per online one
+static int countPossibleCpus() {
+    ifstream file("/sys/devices/system/cpu/possible");
+    string ranges;
+    if (!getline(file, ranges)) return 0;
+
+    int count = 0;
+    stringstream stream(ranges);
+    string range;
+    while (getline(stream, range, ',')) {
+        int first = 0, last = 0;
+        if (sscanf(range.c_str(), "%d-%d", &first, &last) == 2) {
+            count += last - first + 1;
+        } else if (sscanf(range.c_str(), "%d", &first) == 1) {
+            count++;
+        }
+    }
+    return count;
+}
+
+namespace {
+
+// Jump targets in the program
+enum Label { PORTS, LOOKUP, INSERT, PASS, LABELS };
+
+// Just enough of an assembler to write the program with named jump targets
+class Assembler {
+public:
+    void op(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm) {
+        bpf_insn insn = {};
+        insn.code = code;
+        insn.dst_reg = dst;
+        insn.src_reg = src;
+        insn.off = off;
+        insn.imm = imm;
+        insns.push_back(insn);
+    }
+
+    void movReg(uint8_t dst, uint8_t src) { op(BPF_ALU64 | BPF_MOV | BPF_X, dst, src, 0, 0); }
+    void movImm(uint8_t dst, int32_t imm) { op(BPF_ALU64 | BPF_MOV | BPF_K, dst, 0, 0, imm); }
+    void aluImm(uint8_t alu, uint8_t dst, int32_t imm) { op(BPF_ALU64 | alu | BPF_K, dst, 0, 0, imm); }
+    void aluReg(uint8_t alu, uint8_t dst, uint8_t src) { op(BPF_ALU64 | alu | BPF_X, dst, src, 0, 0); }
+    void load(uint8_t size, uint8_t dst, uint8_t base, int16_t off) { op(BPF_LDX | BPF_MEM | size, dst, base, off, 0); }
+    void store(uint8_t size, uint8_t base, int16_t off, uint8_t src) { op(BPF_STX | BPF_MEM | size, base, src, off, 0); }
+    void storeImm(uint8_t size, uint8_t base, int16_t off, int32_t imm) { op(BPF_ST | BPF_MEM | size, base, 0, off, imm); }
+    void call(int32_t helper) { op(BPF_JMP | BPF_CALL, 0, 0, 0, helper); }
+    void exit() { op(BPF_JMP | BPF_EXIT, 0, 0, 0, 0); }
+
+    // 64-bit immediate holding a map, resolved by the kernel at load time
+    void loadMap(uint8_t dst, int fd) {
+        op(BPF_LD | BPF_DW | BPF_IMM, dst, BPF_PSEUDO_MAP_FD, 0, fd);
+        op(0, 0, 0, 0, 0);
+    }
+
+    void jumpImm(uint8_t jump, uint8_t reg, int32_t imm, Label target) {
+        fixups.push_back({insns.size(), target});
+        op(BPF_JMP | jump | BPF_K, reg, 0, 0, imm);
+    }
+    void jumpReg(uint8_t jump, uint8_t reg, uint8_t src, Label target) {
+        fixups.push_back({insns.size(), target});
+        op(BPF_JMP | jump | BPF_X, reg, src, 0, 0);
+    }
+    void jump(Label target) { jumpImm(BPF_JA, 0, 0, target); }
+
+    void bind(Label label) { bound[label] = insns.size(); }
+
+    vector<bpf_insn> finish() {
+        for (const auto &fixup : fixups) insns[fixup.first].off = int16_t(bound[fixup.second] - fixup.first - 1);
+        return insns;
+    }
+
+private:
+    vector<bpf_insn> insns;
+    vector<pair<size_t, Label>> fixups;
+    size_t bound[LABELS] = {};
+};
+
+} // namespace
+
+// r2 = data, r3 = data_end, r5 = IP protocol, r7 = frame bytes, key at KEY_SLOT
+static vector<bpf_insn> buildProgram(int mapFd) {
+    const int ETH = sizeof(struct ethhdr);
+    Assembler a;
+
+    a.load(BPF_W, BPF_REG_2, BPF_REG_1, offsetof(struct xdp_md, data));
+    a.load(BPF_W, BPF_REG_3, BPF_REG_1, offsetof(struct xdp_md, data_end));
+    a.movReg(BPF_REG_4, BPF_REG_2);
+    a.aluImm(BPF_ADD, BPF_REG_4, ETH + 20);
+    a.jumpReg(BPF_JGT, BPF_REG_4, BPF_REG_3, PASS); // shorter than Ethernet + IPv4 headers
+
+    // The program runs in host byte order, the header fields are big-endian
+    a.load(BPF_H, BPF_REG_4, BPF_REG_2, offsetof(struct ethhdr, h_proto));
+    a.jumpImm(BPF_JNE, BPF_REG_4, htons(ETH_P_IP), PASS);
+
+    a.load(BPF_W, BPF_REG_4, BPF_REG_2, ETH + 12);
+    a.store(BPF_W, BPF_REG_10, KEY_SLOT, BPF_REG_4);
+    a.load(BPF_W, BPF_REG_4, BPF_REG_2, ETH + 16);
+    a.store(BPF_W, BPF_REG_10, KEY_SLOT + 4, BPF_REG_4);
+    a.storeImm(BPF_W, BPF_REG_10, KEY_SLOT + 8, 0); // no port, clear pad byte
+    a.load(BPF_B, BPF_REG_5, BPF_REG_2, ETH + 9);
+    a.store(BPF_B, BPF_REG_10, KEY_SLOT + 10, BPF_REG_5);
+
+    // Bytes from the IP total length, as pcap would report the frame
+    a.load(BPF_H, BPF_REG_7, BPF_REG_2, ETH + 2);
+    a.op(BPF_ALU | BPF_END | BPF_TO_BE, BPF_REG_7, 0, 0, 16);
+    a.aluImm(BPF_ADD, BPF_REG_7, ETH);
+
+    a.load(BPF_B, BPF_REG_4, BPF_REG_2, ETH);
+    a.aluImm(BPF_AND, BPF_REG_4, 0x0f);
+    a.aluImm(BPF_LSH, BPF_REG_4, 2);
+    a.jumpImm(BPF_JLT, BPF_REG_4, 20, LOOKUP); // bad IHL, count without a port
+    a.jumpImm(BPF_JEQ, BPF_REG_5, IPPROTO_TCP, PORTS);
+    a.jumpImm(BPF_JNE, BPF_REG_5, IPPROTO_UDP, LOOKUP);
+
+    // TCP and UDP both have the destination port at offset 2 of their header
+    a.bind(PORTS);
+    a.aluReg(BPF_ADD, BPF_REG_2, BPF_REG_4);
+    a.movReg(BPF_REG_4, BPF_REG_2);
+    a.aluImm(BPF_ADD, BPF_REG_4, ETH + 4);
+    a.jumpReg(BPF_JGT, BPF_REG_4, BPF_REG_3, LOOKUP);
+    a.load(BPF_H, BPF_REG_4, BPF_REG_2, ETH + 2);
+    a.store(BPF_H, BPF_REG_10, KEY_SLOT + 8, BPF_REG_4);
+
+    // This CPU's counters: only this CPU writes them, so plain adds are safe
+    a.bind(LOOKUP);
+    a.loadMap(BPF_REG_1, mapFd);
+    a.movReg(BPF_REG_2, BPF_REG_10);
+    a.aluImm(BPF_ADD, BPF_REG_2, KEY_SLOT);
+    a.call(BPF_FUNC_map_lookup_elem);
+    a.jumpImm(BPF_JEQ, BPF_REG_0, 0, INSERT);
+    a.load(BPF_DW, BPF_REG_1, BPF_REG_0, 0);
+    a.aluImm(BPF_ADD, BPF_REG_1, 1);
+    a.store(BPF_DW, BPF_REG_0, 0, BPF_REG_1);
+    a.load(BPF_DW, BPF_REG_1, BPF_REG_0, 8);
+    a.aluReg(BPF_ADD, BPF_REG_1, BPF_REG_7);
+    a.store(BPF_DW, BPF_REG_0, 8, BPF_REG_1);
+    a.jump(PASS);
+
+    // New flow. Another CPU may add it first; BPF_ANY then sets only this
+    // CPU's copy, which it had not counted into yet. Fails if the map is full.
+    a.bind(INSERT);
+    a.storeImm(BPF_DW, BPF_REG_10, VALUE_SLOT, 1);
+    a.store(BPF_DW, BPF_REG_10, VALUE_SLOT + 8, BPF_REG_7);
+    a.loadMap(BPF_REG_1, mapFd);
+    a.movReg(BPF_REG_2, BPF_REG_10);
+    a.aluImm(BPF_ADD, BPF_REG_2, KEY_SLOT);
+    a.movReg(BPF_REG_3, BPF_REG_10);
+    a.aluImm(BPF_ADD, BPF_REG_3, VALUE_SLOT);
+    a.movImm(BPF_REG_4, BPF_ANY);
+    a.call(BPF_FUNC_map_update_elem);
+
+    a.bind(PASS);
+    a.movImm(BPF_REG_0, XDP_PASS);
+    a.exit();
+    return a.finish();
+}
+
+XdpFlowCounter::XdpFlowCounter(uint32_t maxFlows) : capacity(maxFlows) {}
+
+XdpFlowCounter::~XdpFlowCounter() {
+    // Closing the link detaches the program
+    if (linkFd >= 0) close(linkFd);
+    if (progFd >= 0) close(progFd);
+    if (mapFd >= 0) close(mapFd);
+}
+
+bool XdpFlowCounter::attach(const string &interface, string &error) {
+    unsigned int ifindex = if_nametoindex(interface.c_str());
+    if (ifindex == 0) {
+        error = "no interface " + interface;
+        return false;
+    }
+    possibleCpus = countPossibleCpus();
+    if (possibleCpus <= 0) {
+        error = "cannot read /sys/devices/system/cpu/possible";
+        return false;
+    }
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_PERCPU_HASH;
+    attr.key_size = KEY_SIZE;
+    attr.value_size = VALUE_SIZE;
+    attr.max_entries = capacity;
+    strncpy(attr.map_name, "nv_flows", sizeof(attr.map_name) - 1);
+    mapFd = bpf(BPF_MAP_CREATE, attr);
+    if (mapFd < 0) {
+        error = string("map create: ") + strerror(errno);
+        return false;
+    }
+
+    vector<bpf_insn> program = buildProgram(mapFd);
+    static const char license[] = "GPL";
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = pointer(program.data());
+    attr.insn_cnt = program.size();
+    attr.license = pointer(license);
+    strncpy(attr.prog_name, "nv_flow_count", sizeof(attr.prog_name) - 1);
+    progFd = bpf(BPF_PROG_LOAD, attr);
+    if (progFd < 0) {
+        // Load again with the verifier log for the reason
+        int loadErrno = errno;
+        vector<char> log(64 * 1024);
+        attr.log_level = 1;
+        attr.log_buf = pointer(log.data());
+        attr.log_size = log.size();
+        progFd = bpf(BPF_PROG_LOAD, attr);
+        if (progFd < 0) {
+            error = string("program load: ") + strerror(loadErrno);
+            if (log[0]) error += "\n" + string(log.data());
+            return false;
+        }
+    }
+
+    memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd = progFd;
+    attr.link_create.target_ifindex = ifindex;
+    attr.link_create.attach_type = BPF_XDP;
+    linkFd = bpf(BPF_LINK_CREATE, attr);
+    if (linkFd < 0) {
+        error = string("attach to ") + interface + ": " + strerror(errno);
+        if (errno == EBUSY) error += " (another XDP program is attached)";
+        return false;
+    }
+
+    keys.resize(size_t(DRAIN_BATCH) * KEY_SIZE);
+    values.resize(size_t(DRAIN_BATCH) * VALUE_SIZE * possibleCpus);
+    return true;
+}
+
+bool XdpFlowCounter::drain(vector<Flow> &flows, string &error) {
+    flows.clear();
+    if (mapFd < 0) {
+        error = "not attached";
+        return false;
+    }
+
+    uint64_t inBatch = 0, outBatch = 0;
+    bool first = true;
+    while (true) {
+        union bpf_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.batch.in_batch = first ? 0 : pointer(&inBatch);
+        attr.batch.out_batch = pointer(&outBatch);
+        attr.batch.keys = pointer(keys.data());
+        attr.batch.values = pointer(values.data());
+        attr.batch.count = DRAIN_BATCH;
+        attr.batch.map_fd = mapFd;
+        long result = bpf(BPF_MAP_LOOKUP_AND_DELETE_BATCH, attr);
+        int batchErrno = errno;
+
+        // The entries of a partial batch are valid even when the call fails with ENOENT
+        for (uint32_t i = 0; i < attr.batch.count; ++i) {
+            const uint8_t *key = &keys[size_t(i) * KEY_SIZE];
+            Flow flow = {};
+            memcpy(&flow.srcAddr, key, 4);
+            memcpy(&flow.dstAddr, key + 4, 4);
+            uint16_t port;
+            memcpy(&port, key + 8, 2);
+            flow.dstPort = ntohs(port);
+            flow.protocol = key[10];
+
+            const uint8_t *perCpu = &values[size_t(i) * VALUE_SIZE * possibleCpus];
+            for (int cpu = 0; cpu < possibleCpus; ++cpu) {
+                uint64_t counts[2];
+                memcpy(counts, perCpu + cpu * VALUE_SIZE, sizeof(counts));
+                flow.packets += counts[0];
+                flow.bytes += counts[1];
+            }
+            if (flow.packets) flows.push_back(flow);
+        }
+
+        if (result < 0) {
+            if (batchErrno == ENOENT) return true; // map empty
+            error = string("map drain: ") + strerror(batchErrno);
+            return false;
+        }
+        inBatch = outBatch;
+        first = false;
+    }
+}
@@ -8,6 +8,7 @@
 #include <QDebug>
 #include <QGroupBox>
 #include <QtMath>
+#include <QUrl>
 
 AnomalyWidget::AnomalyWidget(QWidget *parent)
     : QWidget(parent)
@@ -15,6 +16,7 @@ AnomalyWidget::AnomalyWidget(QWidget *parent)
     , maliciousCount(0)
     , benignCount(0)
     , isPaused(false)
+    , nextPacketId(1)
 {
     qDebug() << "=== AnomalyWidget Constructor ===";
 
@@ -23,7 +25,8 @@ AnomalyWidget::AnomalyWidget(QWidget *parent)
     fetchTimer = new QTimer(this);
 
     connect(packetApi, &ApiCaller::responseReceived, this, &AnomalyWidget::onPacketsReceived);
-    connect(predictionApi, &ApiCaller::responseReceived, this, &AnomalyWidget::onPredictionReceived);
+    connect(predictionApi, &ApiCaller::requestFinished, this, &AnomalyWidget::onBatchPredictionReceived);
+    connect(predictionApi, &ApiCaller::requestFailed, this, &AnomalyWidget::onBatchPredictionFailed);
     connect(fetchTimer, &QTimer::timeout, this, &AnomalyWidget::fetchPackets);
 
     qDebug() << "ApiCaller connections established";
@@ -210,6 +213,8 @@ void AnomalyWidget::startMonitoring(const QString &url, int intervalMs)
     qDebug() << "Interval:" << intervalMs << "ms";
 
     apiUrl = url;
+    // Prediction routes live on the same server, without the /api prefix
+    predictionUrl = QUrl(url).resolved(QUrl("/predict/malicious-packets/batch")).toString();
     fetchTimer->start(intervalMs);
     statusLabel->setText("🔄 Analyzing packets...");
 
@@ -273,14 +278,8 @@ void AnomalyWidget::onPacketsReceived(const QString &data)
 
     qDebug() << "Number of packets to process:" << packets.size();
 
-    // Process only the latest packets (limit to avoid overload)
     int count = 0;
     for (const QJsonValue &val : packets) {
-        if (count >= 5) {
-            qDebug() << "Limiting to 5 packets, skipping rest";
-            break;
-        }
-
         if (!val.isObject()) {
             qWarning() << "Packet" << count << "is not an object, skipping";
             continue;
@@ -321,6 +320,10 @@ void AnomalyWidget::onPacketsReceived(const QString &data)
 
         // Calculate duration from last packet with same src/dst pair
         QString pairKey = packet.srcIp + ":" + packet.dstIp;
+        if (lastPacketTime.contains(pairKey) && packet.timestamp <= lastPacketTime[pairKey]) {
+            qDebug() << "  Already analyzed, skipping";
+            continue;
+        }
         if (lastPacketTime.contains(pairKey)) {
             packet.duration = packet.timestamp - lastPacketTime[pairKey];
             qDebug() << "  Duration calculated:" << packet.duration;
@@ -330,99 +333,152 @@ void AnomalyWidget::onPacketsReceived(const QString &data)
         }
         lastPacketTime[pairKey] = packet.timestamp;
 
-        qDebug() << "  Calling analyzePacket()...";
-        analyzePacket(packet);
+        queuePacket(packet);
         count++;
     }
 
-    qDebug() << "=== Finished processing" << count << "packets ===\n";
+    qDebug() << "=== Queued" << count << "packets ===\n";
+    dispatchBatches();
 }
 
-void AnomalyWidget::analyzePacket(const Packet &packet)
+void AnomalyWidget::queuePacket(const Packet &packet)
 {
-    qDebug() << "\n>>> ANALYZE PACKET CALLED <<<";
-
-    // Store current packet for prediction response
-    currentAnalyzingPacket = packet;
+    if (pendingPackets.size() >= MAX_QUEUED) {
+        qWarning() << "Prediction queue full, dropping oldest packet";
+        pendingPackets.dequeue();
+    }
+    pendingPackets.enqueue(qMakePair(nextPacketId++, packet));
+}
 
+QJsonObject AnomalyWidget::predictionRequest(const Packet &packet)
+{
     // Handle port 0 (common for ICMP) - use a default port
     int dstPort = packet.dstPort;
     if (dstPort == 0) {
         // For ICMP or packets without ports, use a safe default
         dstPort = 80;  // Use port 80 as default for analysis
-        qDebug() << "  Port 0 detected, using default port 80 for analysis";
     }
 
-    // Build prediction request
-    QJsonObject predictionRequest;
-    predictionRequest["packet_size"] = packet.length;
-    predictionRequest["duration"] = qMax(0.1, packet.duration);  // Ensure positive
-    predictionRequest["dst_port"] = dstPort;
-    predictionRequest["protocol"] = protocolToNumber(packet.protocol);
-    predictionRequest["syn_flag"] = packet.synFlag;
+    QJsonObject request;
+    request["packet_size"] = packet.length;
+    request["duration"] = qMax(0.1, packet.duration);  // Ensure positive
+    request["dst_port"] = dstPort;
+    request["protocol"] = protocolToNumber(packet.protocol);
+    request["syn_flag"] = packet.synFlag;
+    return request;
+}
 
-    QJsonDocument doc(predictionRequest);
-    QString jsonString = doc.toJson(QJsonDocument::Compact);
+void AnomalyWidget::dispatchBatches()
+{
+    while (inFlightBatches.size() < MAX_IN_FLIGHT && !pendingPackets.isEmpty()) {
+        QJsonArray batch;
+        QList<quint64> packetIds;
+
+        while (batch.size() < BATCH_SIZE && !pendingPackets.isEmpty()) {
+            QPair<quint64, Packet> pending = pendingPackets.dequeue();
+            QJsonObject request = predictionRequest(pending.second);
+            request["id"] = QString::number(pending.first);
+            batch.append(request);
+            packetIds.append(pending.first);
+            inFlightPackets.insert(pending.first, pending.second);
+        }
 
-    qDebug() << "Prediction JSON:" << jsonString;
-    qDebug() << "Posting to: http://localhost:5000/predict/malicious-packet";
+        QJsonObject body;
+        body["packets"] = batch;
+        QByteArray payload = QJsonDocument(body).toJson(QJsonDocument::Compact);
 
-    // POST to prediction endpoint (note: no /api prefix based on your Flask routes)
-    predictionApi->post("http://localhost:5000/predict/malicious-packet", jsonString);
+        quint64 requestId = predictionApi->postTracked(predictionUrl, payload, REQUEST_TIMEOUT_MS);
+        inFlightBatches.insert(requestId, packetIds);
+        qDebug() << "Posted batch" << requestId << "with" << packetIds.size() << "packets to" << predictionUrl;
+    }
 
-    qDebug() << "POST request sent!\n";
+    updateStatus();
 }
 
-void AnomalyWidget::onPredictionReceived(const QString &data)
+void AnomalyWidget::finishBatch(quint64 requestId)
 {
-    qDebug() << "\n<<< PREDICTION RESPONSE RECEIVED >>>";
-    qDebug() << "Response:" << data;
+    // Packets the response did not mention are dropped with their batch
+    for (quint64 packetId : inFlightBatches.take(requestId))
+        inFlightPackets.remove(packetId);
 
-    QJsonDocument doc = QJsonDocument::fromJson(data.toUtf8());
-    if (!doc.isObject()) {
-        qWarning() << "ERROR: Invalid prediction response (not JSON object):" << data;
+    dispatchBatches();
+}
+
+void AnomalyWidget::updateStatus()
+{
+    analysisProgress->setVisible(!inFlightBatches.isEmpty());
+    if (isPaused)
         return;
+
+    if (!inFlightBatches.isEmpty() || !pendingPackets.isEmpty()) {
+        statusLabel->setText(QString("🔄 Analyzing %1 packets (%2 queued)")
+                                 .arg(inFlightPackets.size())
+                                 .arg(pendingPackets.size()));
+    } else {
+        statusLabel->setText("🔄 Analyzing packets...");
     }
+}
 
+void AnomalyWidget::onBatchPredictionReceived(quint64 requestId, const QString &data)
+{
+    if (!inFlightBatches.contains(requestId))
+        return;
+
+    QJsonDocument doc = QJsonDocument::fromJson(data.toUtf8());
     QJsonObject response = doc.object();
-    qDebug() << "Response keys:" << response.keys();
-
-    PredictionResult result;
-    result.packet = currentAnalyzingPacket;
-
-    // Parse prediction result (adjust based on your API response format)
-    if (response.contains("prediction")) {
-        QString pred = response["prediction"].toString();
-        int predInt = response["prediction"].toInt(-1);
-        result.isMalicious = (pred == "malicious" || pred == "1" || predInt == 1);
-        qDebug() << "Prediction field found:" << pred << "isMalicious:" << result.isMalicious;
-    } else if (response.contains("is_malicious")) {
-        result.isMalicious = response["is_malicious"].toBool();
-        qDebug() << "is_malicious field found:" << result.isMalicious;
-    } else {
-        qWarning() << "ERROR: Unknown response format - no prediction field found!";
-        qWarning() << "Available keys:" << response.keys();
+    if (!doc.isObject() || !response["results"].isArray()) {
+        qWarning() << "ERROR: Invalid batch prediction response:" << data.left(200);
+        finishBatch(requestId);
         return;
     }
 
-    result.confidence = response.contains("confidence") ?
-                            response["confidence"].toDouble() : 0.85;
-    qDebug() << "Confidence:" << result.confidence;
+    const QList<quint64> &packetIds = inFlightBatches[requestId];
+    for (const QJsonValue &value : response["results"].toArray()) {
+        QJsonObject prediction = value.toObject();
 
-    totalAnalyzed++;
-    if (result.isMalicious) {
-        maliciousCount++;
-        qDebug() << "MALICIOUS packet detected!";
-    } else {
-        benignCount++;
-        qDebug() << "Benign packet";
+        // Correlation id maps the result back to its packet
+        quint64 packetId = prediction["id"].toString().toULongLong();
+        if (!packetIds.contains(packetId) || !inFlightPackets.contains(packetId)) {
+            qWarning() << "Prediction for unknown packet id" << prediction["id"];
+            continue;
+        }
+
+        if (prediction["status"].toString() != "success") {
+            qWarning() << "Prediction failed for packet" << packetId << ":" << prediction["message"].toString();
+            continue;
+        }
+
+        PredictionResult result;
+        result.packet = inFlightPackets.take(packetId);
+        result.isMalicious = prediction["is_malicious"].toBool();
+        result.confidence = prediction.contains("confidence") ?
+                                prediction["confidence"].toDouble() : 0.85;
+
+        totalAnalyzed++;
+        if (result.isMalicious) {
+            maliciousCount++;
+        } else {
+            benignCount++;
+        }
+
+        addPredictionToTable(result);
     }
 
-    addPredictionToTable(result);
     updateStatistics();
+    qDebug() << "Batch" << requestId << "done - Total:" << totalAnalyzed
+             << "Malicious:" << maliciousCount << "Benign:" << benignCount;
+
+    finishBatch(requestId);
+}
+
+void AnomalyWidget::onBatchPredictionFailed(quint64 requestId, const QString &message)
+{
+    if (!inFlightBatches.contains(requestId))
+        return;
 
-    qDebug() << "Stats - Total:" << totalAnalyzed << "Malicious:" << maliciousCount << "Benign:" << benignCount;
-    qDebug() << "<<< PREDICTION PROCESSING COMPLETE >>>\n";
+    qWarning() << "Batch prediction" << requestId << "failed:" << message;
+    finishBatch(requestId);
+    statusLabel->setText("⚠ Prediction request failed: " + message);
 }
 
 void AnomalyWidget::addPredictionToTable(const PredictionResult &result)
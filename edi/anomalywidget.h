@@ -7,6 +7,9 @@
 #include <QTimer>
 #include <QPushButton>
 #include <QProgressBar>
+#include <QQueue>
+#include <QHash>
+#include <QJsonObject>
 #include "api_caller.h"
 
 struct Packet {
@@ -44,12 +47,25 @@ public:
 private slots:
     void fetchPackets();
     void onPacketsReceived(const QString &data);
-    void onPredictionReceived(const QString &data);
+    void onBatchPredictionReceived(quint64 requestId, const QString &data);
+    void onBatchPredictionFailed(quint64 requestId, const QString &message);
     void clearResults();
 
 private:
+    // Packets go to the batch endpoint in batches of BATCH_SIZE, with at most
+    // MAX_IN_FLIGHT requests outstanding; each packet carries its own
+    // correlation id so results land on the right row in any order
+    static const int BATCH_SIZE = 64;
+    static const int MAX_IN_FLIGHT = 2;
+    static const int MAX_QUEUED = 1024;          // oldest packets are dropped beyond this
+    static const int REQUEST_TIMEOUT_MS = 10000;
+
     void setupUI();
-    void analyzePacket(const Packet &packet);
+    void queuePacket(const Packet &packet);
+    void dispatchBatches();
+    void finishBatch(quint64 requestId);
+    void updateStatus();
+    QJsonObject predictionRequest(const Packet &packet);
     void updateStatistics();
     void addPredictionToTable(const PredictionResult &result);
     int protocolToNumber(const QString &protocol);
@@ -58,6 +74,7 @@ private:
     ApiCaller *predictionApi;
     QTimer *fetchTimer;
     QString apiUrl;
+    QString predictionUrl;
 
     // UI Components
     QWidget *statsPanel;
@@ -80,7 +97,12 @@ private:
     QMap<QString, double> lastPacketTime;  // Track timing between packets
 
     bool isPaused;
-    Packet currentAnalyzingPacket;
+
+    // Prediction pipeline
+    quint64 nextPacketId;
+    QQueue<QPair<quint64, Packet>> pendingPackets;  // waiting for a batch
+    QHash<quint64, Packet> inFlightPackets;         // by packet id
+    QHash<quint64, QList<quint64>> inFlightBatches; // request id -> packet ids
 };
 
 #endif // ANOMALYWIDGET_H
@@ -21,20 +21,20 @@ void ApiCaller::post(const QString& url, const QByteArray& payload) {
 }
 void ApiCaller::post(const QString &url, const QString &jsonData)
 {
-    QNetworkRequest request(url);
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    // The manager's finished signal already reports the reply
+    post(url, jsonData.toUtf8());
+}
 
-    QNetworkReply *reply = manager->post(request, jsonData.toUtf8());
+quint64 ApiCaller::postTracked(const QString& url, const QByteArray& payload, int timeoutMs) {
+    QNetworkRequest request{ QUrl(url) };
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    if (timeoutMs > 0)
+        request.setTransferTimeout(timeoutMs);
 
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
-        if (reply->error() == QNetworkReply::NoError) {
-            QString response = reply->readAll();
-            emit responseReceived(response);
-        } else {
-            qWarning() << "POST Error:" << reply->errorString();
-        }
-        reply->deleteLater();
-    });
+    quint64 requestId = nextRequestId++;
+    QNetworkReply* reply = manager->post(request, payload);
+    reply->setProperty("requestId", requestId);
+    return requestId;
 }
 void ApiCaller::put(const QString& url, const QByteArray& payload) {
     QNetworkRequest request{ QUrl(url) };
@@ -43,7 +43,14 @@ void ApiCaller::put(const QString& url, const QByteArray& payload) {
 }
 
 void ApiCaller::onReplyFinished(QNetworkReply* reply) {
-    if (reply->error() == QNetworkReply::NoError) {
+    QVariant requestId = reply->property("requestId");
+    if (requestId.isValid()) {
+        if (reply->error() == QNetworkReply::NoError) {
+            emit requestFinished(requestId.toULongLong(), reply->readAll());
+        } else {
+            emit requestFailed(requestId.toULongLong(), reply->errorString());
+        }
+    } else if (reply->error() == QNetworkReply::NoError) {
         emit responseReceived(reply->readAll());
     } else {
         emit errorOccurred(reply->errorString());
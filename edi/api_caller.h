@@ -14,9 +14,15 @@ public:
     void post(const QString& url, const QByteArray& payload);
     void put(const QString& url, const QByteArray& payload);
 
+    // POST whose reply is reported through requestFinished/requestFailed
+    // with the returned id, so concurrent requests can be told apart
+    quint64 postTracked(const QString& url, const QByteArray& payload, int timeoutMs = 0);
+
 signals:
     void responseReceived(const QString& data);
     void errorOccurred(const QString& message);
+    void requestFinished(quint64 requestId, const QString& data);
+    void requestFailed(quint64 requestId, const QString& message);
 public slots:
     void post(const QString &url, const QString &jsonData);
 private slots:
@@ -24,6 +30,7 @@ private slots:
 
 private:
     QNetworkAccessManager* manager;
+    quint64 nextRequestId = 1;
 };
 
 
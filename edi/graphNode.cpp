@@ -135,3 +135,13 @@ void GraphNode::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
     }
     QGraphicsEllipseItem::mouseReleaseEvent(event);
 }
+
+void GraphNode::mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton && onDoubleClick) {
+        // Handlers must not delete this item right away; GraphWindow refetches instead
+        onDoubleClick(nodeId);
+        return;
+    }
+    QGraphicsEllipseItem::mouseDoubleClickEvent(event);
+}
@@ -5,6 +5,7 @@
 #include <QGraphicsTextItem>
 #include <QGraphicsSceneHoverEvent>
 #include <QGraphicsSceneMouseEvent>
+#include <functional>
 
 class GraphNode : public QGraphicsEllipseItem
 {
@@ -19,6 +20,7 @@ public:
     void setHighlight(bool highlight);
     void updateLabel();
     QString getNodeId() const { return nodeId; }
+    void setDoubleClickHandler(std::function<void(const QString &)> handler) { onDoubleClick = handler; }
 
 protected:
     void hoverEnterEvent(QGraphicsSceneHoverEvent *event) override;
@@ -26,6 +28,7 @@ protected:
     void mousePressEvent(QGraphicsSceneMouseEvent *event) override;
     void mouseMoveEvent(QGraphicsSceneMouseEvent *event) override;
     void mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override;
+    void mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event) override;
 
 private:
     QString nodeId;
@@ -34,6 +37,7 @@ private:
     QPointF dragStartPos;
     double baseSize;
     QColor baseColor;
+    std::function<void(const QString &)> onDoubleClick;
 };
 
 #endif // GRAPHNODE_H
@@ -13,6 +13,7 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QUrl>
 
 GraphWindow::GraphWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -73,6 +74,16 @@ GraphWindow::GraphWindow(QWidget *parent)
     refreshButton = new QPushButton("Refresh Data", this);
     traceRouteCheckbox = new QCheckBox("Show Trace Routes", this);
 
+    // Thousands of remote addresses are unreadable (and slow to lay out) one
+    // node each; the server can merge them and the view expands groups on demand
+    rollupCombo = new QComboBox(this);
+    rollupCombo->addItem("Every Address", "none");
+    rollupCombo->addItem("Group by /24", "/24");
+    rollupCombo->addItem("Group by /16", "/16");
+    rollupCombo->addItem("Group by ASN", "asn");
+    rollupCombo->addItem("Group by Site", "site");
+    rollupCombo->setToolTip("Merge addresses into groups; double-click a group to expand it");
+
     QString buttonStyle =
         "QPushButton {"
         "  background: qlineargradient(x1:0, y1:0, x2:0, y2:1, "
@@ -104,6 +115,7 @@ GraphWindow::GraphWindow(QWidget *parent)
     controlLayout->addWidget(resetButton);
     controlLayout->addWidget(refreshButton);
     controlLayout->addWidget(traceRouteCheckbox);
+    controlLayout->addWidget(rollupCombo);
     controlLayout->addStretch();
 
     // Connection status indicator
@@ -174,6 +186,7 @@ GraphWindow::GraphWindow(QWidget *parent)
     legendLayout->addWidget(createLegendItem(QColor(255, 107, 107), "Local Machine"));
     legendLayout->addWidget(createLegendItem(QColor(78, 205, 196), "Routers"));
     legendLayout->addWidget(createLegendItem(QColor(69, 183, 209), "Destinations"));
+    legendLayout->addWidget(createLegendItem(QColor(162, 155, 254), "Address Groups"));
     legendLayout->addWidget(createLegendItem(QColor(150, 206, 180), "Direct Connection", true));
     legendLayout->addWidget(createLegendItem(QColor(254, 202, 87), "Traceroute Path", true));
     legendLayout->addStretch();
@@ -215,6 +228,7 @@ GraphWindow::GraphWindow(QWidget *parent)
     connect(resetButton, &QPushButton::clicked, this, &GraphWindow::resetView);
     connect(refreshButton, &QPushButton::clicked, this, &GraphWindow::refreshData);
     connect(traceRouteCheckbox, &QCheckBox::toggled, this, &GraphWindow::toggleTraceRoute);
+    connect(rollupCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &GraphWindow::changeRollup);
 }
 
 void GraphWindow::initialize()
@@ -230,7 +244,35 @@ void GraphWindow::initialize()
 
 void GraphWindow::fetchGraphData()
 {
-    api->get("http://localhost:5000/api/graph");
+    QString url = "http://localhost:5000/api/graph?rollup=" + rollupCombo->currentData().toString();
+    if (!expandedGroups.isEmpty()) {
+        QStringList groups = expandedGroups.values();
+        url += "&expand=" + QString::fromUtf8(QUrl::toPercentEncoding(groups.join(",")));
+    }
+    api->get(url);
+}
+
+void GraphWindow::changeRollup(int index)
+{
+    Q_UNUSED(index);
+    expandedGroups.clear();
+    fetchGraphData();
+}
+
+void GraphWindow::toggleGroup(const QString &nodeId)
+{
+    if (!nodeDataMap.contains(nodeId)) return;
+
+    // A group expands into its addresses; any of those collapses it again
+    const NodeData &node = nodeDataMap[nodeId];
+    if (node.isGroup) {
+        expandedGroups.insert(nodeId);
+    } else if (!node.group.isEmpty()) {
+        expandedGroups.remove(node.group);
+    } else {
+        return;
+    }
+    fetchGraphData();
 }
 
 void GraphWindow::onApiResponse(const QString &data)
@@ -246,6 +288,8 @@ void GraphWindow::onApiResponse(const QString &data)
 
     // Parse nodes if available
     if (root.contains("nodes") && root["nodes"].isArray()) {
+        // Node ids change with the roll-up, so keep only what this response lists
+        nodeDataMap.clear();
         QJsonArray nodesArray = root["nodes"].toArray();
         for (const auto &val : nodesArray) {
             if (!val.isObject()) continue;
@@ -257,6 +301,13 @@ void GraphWindow::onApiResponse(const QString &data)
             node.type = obj["type"].toString();
             node.isLocal = obj["is_local"].toBool();
             node.packetCount = obj["packet_count"].toInt();
+            node.name = obj["name"].toString();
+            node.subnet = obj["subnet"].toString();
+            node.asn = quint32(obj["asn"].toDouble()); // 32-bit ASNs overflow toInt()
+            node.site = obj["site"].toString();
+            node.isGroup = obj["is_group"].toBool();
+            node.memberCount = obj["member_count"].toInt();
+            node.group = obj["group"].toString();
 
             if (obj["protocols"].isArray()) {
                 for (auto p : obj["protocols"].toArray())
@@ -322,6 +373,9 @@ void GraphWindow::updateNodeData(const QString &nodeId)
         node.type = "destination";
         node.isLocal = false;
         node.packetCount = 0;
+        node.asn = 0;
+        node.isGroup = false;
+        node.memberCount = 0;
         nodeDataMap[nodeId] = node;
     }
 }
@@ -528,6 +582,7 @@ QColor GraphWindow::getNodeColor(const QString &nodeId)
     if (nodeDataMap.contains(nodeId)) {
         const NodeData &node = nodeDataMap[nodeId];
         if (node.isLocal) return QColor(255, 107, 107);
+        if (node.isGroup) return QColor(162, 155, 254);
         if (node.type == "router") return QColor(78, 205, 196);
     }
     return QColor(69, 183, 209);
@@ -538,6 +593,7 @@ double GraphWindow::getNodeSize(const QString &nodeId)
     if (nodeDataMap.contains(nodeId)) {
         const NodeData &node = nodeDataMap[nodeId];
         if (node.isLocal) return 20.0;
+        if (node.isGroup) return qMin(15.0 + 3.0 * std::log2(qMax(1, node.memberCount)), 35.0);
         if (node.type == "router") return 12.0;
     }
     return 15.0;
@@ -601,24 +657,53 @@ void GraphWindow::drawNode(const QString &node, const QPointF &pos)
     QColor color = getNodeColor(node);
     double size = getNodeSize(node);
 
+    // Names keep their right end, where the domain is; addresses fit whole
     QString displayText = node;
     if (nodeDataMap.contains(node) && nodeDataMap[node].isLocal) {
         displayText = "LOCAL";
-    } else if (node.length() > 12) {
-        displayText = node.left(10) + "...";
+    } else if (nodeDataMap.contains(node) && nodeDataMap[node].isGroup) {
+        displayText = QString("%1 (%2)").arg(node).arg(nodeDataMap[node].memberCount);
+    } else if (nodeDataMap.contains(node) && !nodeDataMap[node].name.isEmpty()) {
+        const QString &name = nodeDataMap[node].name;
+        displayText = name.length() > 20 ? "..." + name.right(17) : name;
+    } else if (node.length() > 15) {
+        displayText = node.left(12) + "...";
     }
 
     GraphNode *graphNode = new GraphNode(node, pos, size, color, displayText);
+    graphNode->setDoubleClickHandler([this](const QString &nodeId) { toggleGroup(nodeId); });
 
-    if (nodeDataMap.contains(node)) {
+    if (nodeDataMap.contains(node) && nodeDataMap[node].isGroup) {
+        const NodeData &data = nodeDataMap[node];
+        QString tooltip = QString("Group: %1\nAddresses: %2\nPackets: %3")
+                              .arg(data.ip)
+                              .arg(data.memberCount)
+                              .arg(data.packetCount);
+        if (!data.protocols.isEmpty()) {
+            tooltip += "\nProtocols: " + data.protocols.join(", ");
+        }
+        tooltip += "\nDouble-click to expand";
+        graphNode->setToolTip(tooltip);
+    } else if (nodeDataMap.contains(node)) {
         const NodeData &data = nodeDataMap[node];
         QString tooltip = QString("IP: %1\nType: %2\nPackets: %3")
                               .arg(data.ip)
                               .arg(data.type)
                               .arg(data.packetCount);
+        if (!data.name.isEmpty()) {
+            tooltip = "Name: " + data.name + "\n" + tooltip;
+        }
         if (!data.protocols.isEmpty()) {
             tooltip += "\nProtocols: " + data.protocols.join(", ");
         }
+        if (!data.subnet.isEmpty()) {
+            tooltip += "\nSubnet: " + data.subnet;
+            if (data.asn) tooltip += QString("\nASN: AS%1").arg(data.asn);
+            if (!data.site.isEmpty()) tooltip += "\nSite: " + data.site;
+        }
+        if (!data.group.isEmpty()) {
+            tooltip += "\nGroup: " + data.group + " (double-click to collapse)";
+        }
         graphNode->setToolTip(tooltip);
     }
 
@@ -5,6 +5,7 @@
 #include <QGraphicsScene>
 #include <QPushButton>
 #include <QCheckBox>
+#include <QComboBox>
 #include <QLabel>
 #include <QTimer>
 #include <QMap>
@@ -33,6 +34,13 @@ struct NodeData {
     bool isLocal;
     int packetCount;
     QStringList protocols;
+    QString name;       // from the DNS answers the sniffer saw, empty if none
+    QString subnet;     // longest matching prefix of the sniffer's prefix list, empty if none
+    quint32 asn;
+    QString site;
+    bool isGroup;       // addresses merged by the server's roll-up
+    int memberCount;
+    QString group;      // roll-up group this address was expanded from, empty if none
 };
 
 enum TopologyType {
@@ -57,6 +65,7 @@ private slots:
     void resetView();
     void refreshData();
     void fetchGraphData();
+    void changeRollup(int index);
 
 private:
     void addEdge(const Edge &edge);
@@ -71,6 +80,7 @@ private:
     double getNodeSize(const QString &nodeId);
     void updateStatistics();
     void updateConnectionStatus(bool connected);
+    void toggleGroup(const QString &nodeId);
 
     QGraphicsScene *scene;
     ZoomGraphicsView *view;
@@ -81,6 +91,7 @@ private:
     QPushButton *resetButton;
     QPushButton *refreshButton;
     QCheckBox *traceRouteCheckbox;
+    QComboBox *rollupCombo;
     QLabel *nodeCountLabel;
     QLabel *edgeCountLabel;
     QLabel *pathCountLabel;
@@ -97,6 +108,7 @@ private:
 
     TopologyType currentTopology;
     bool showTraceRoute;
+    QSet<QString> expandedGroups;
 
     const double REPULSION_STRENGTH = 5000.0;
     const double ATTRACTION_STRENGTH = 0.05;
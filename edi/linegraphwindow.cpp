@@ -9,6 +9,7 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QDebug>
+#include <QUrl>
 #include <algorithm>
 #include <cmath>
 
@@ -181,7 +182,11 @@ LineGraphWindow::LineGraphWindow(QWidget *parent)
     m_metricSelector(nullptr),
     m_statsLabel(nullptr),
     m_titleLabel(nullptr),
-    m_statusLabel(nullptr) {
+    m_statusLabel(nullptr),
+    m_hasSizePercentiles(false),
+    m_sizeP50(0),
+    m_sizeP99(0),
+    m_sizeP999(0) {
 
     // Initialize API caller
     m_apiCaller = new ApiCaller(this);
@@ -335,12 +340,26 @@ void LineGraphWindow::updateStatistics() {
                         .arg(max, 0, 'f', 2)
                         .arg(avg, 0, 'f', 2);
 
+    // The sample above is only the last few packets; the sniffer sees all of them
+    if (metric == "length" && m_hasSizePercentiles) {
+        stats += QString(" | All traffic p50: %1 p99: %2 p99.9: %3")
+                     .arg(m_sizeP50, 0, 'f', 0)
+                     .arg(m_sizeP99, 0, 'f', 0)
+                     .arg(m_sizeP999, 0, 'f', 0);
+    }
+
     m_statsLabel->setText(stats);
 }
 
 void LineGraphWindow::startPeriodicFetch(const QString &apiUrl, int intervalMs) {
     m_apiUrl = apiUrl;
 
+    // Percentiles come from the same server
+    QUrl histogramUrl(apiUrl);
+    histogramUrl.setPath("/api/histograms");
+    histogramUrl.setQuery("class=all&limit=1");
+    m_histogramUrl = histogramUrl.toString();
+
     // Fetch immediately
     fetchPacketData();
 
@@ -362,6 +381,7 @@ void LineGraphWindow::stopPeriodicFetch() {
 void LineGraphWindow::fetchPacketData() {
     if (!m_apiUrl.isEmpty() && m_apiCaller) {
         m_apiCaller->get(m_apiUrl);
+        if (!m_histogramUrl.isEmpty()) m_apiCaller->get(m_histogramUrl);
         m_statusLabel->setText("Status: Fetching...");
         m_statusLabel->setStyleSheet("color: #ffff00; padding: 5px; background-color: #2b2b2b;");
     }
@@ -391,6 +411,19 @@ void LineGraphWindow::parsePacketJson(const QString &jsonData) {
 
     QJsonObject root = doc.object();
 
+    // Percentiles from /api/histograms
+    if (root.contains("latest") && root.contains("history")) {
+        QJsonObject length = root["latest"].toObject()["length"].toObject();
+        m_hasSizePercentiles = !length.isEmpty();
+        if (m_hasSizePercentiles) {
+            m_sizeP50 = length["p50"].toDouble();
+            m_sizeP99 = length["p99"].toDouble();
+            m_sizeP999 = length["p999"].toDouble();
+        }
+        updateStatistics();
+        return;
+    }
+
     // Check if this is a single packet response (from /api/packets/stream)
     if (root.contains("src_ip") && root.contains("dst_ip")) {
         PacketData packet;
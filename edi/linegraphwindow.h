@@ -93,6 +93,13 @@ private:
     ApiCaller *m_apiCaller;
     QTimer *m_fetchTimer;
     QString m_apiUrl;
+    QString m_histogramUrl;
+
+    // Packet length percentiles over all captured traffic, from the sniffer's histograms
+    bool m_hasSizePercentiles;
+    double m_sizeP50;
+    double m_sizeP99;
+    double m_sizeP999;
 };
 
 #endif // LINEGRAPHWINDOW_H
@@ -45,7 +45,7 @@ void MainWindow::createAnalyticsPage(NavbarWidget *navbar) {
     AnomalyWidget *anomalyWidget = new AnomalyWidget();
 
     // Start monitoring packets every 3 seconds
-    anomalyWidget->startMonitoring("http://localhost:5000/api/packets/stream", 3000);
+    anomalyWidget->startMonitoring("http://localhost:5000/api/packets/recent", 3000);
 
     layout->addWidget(anomalyWidget);
 